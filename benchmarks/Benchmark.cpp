@@ -0,0 +1,688 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "AllocationTracker.h"
+#include "BoundingBoxOverlay.h"
+#include "Common.h"
+#include "DepthPrepass.h"
+#include "DynamicResolution.h"
+#include "Environment.h"
+#include "FrameStatistics.h"
+#include "GLState.h"
+#include "GPUProfiler.h"
+#include "GeometryPool.h"
+#include "InputRecorder.h"
+#include "LightClusters.h"
+#include "PolygonMesh.h"
+#include "RenderQueue.h"
+#include "RenderThread.h"
+#include "SceneGenerator.h"
+#include "ShadowMap.h"
+#include "StaticBatch.h"
+#include "Utilities.h"
+
+#include <SDL2/SDL.h>
+
+namespace model_viewer_3d {
+
+constexpr unsigned defaultBenchmarkFrames = 300;
+constexpr unsigned defaultBenchmarkWarmupFrames = 30;
+constexpr unsigned defaultStaticMeshes = 64;
+constexpr unsigned defaultSkinnedMeshes = 16;
+constexpr unsigned defaultInstances = 1024;
+constexpr unsigned loadTimeRepetitions = 3;
+constexpr unsigned allocationMeshes = 16;
+
+constexpr unsigned syntheticObjects = 10000;
+constexpr unsigned syntheticObjectTriangles = 500;
+constexpr unsigned syntheticTriangleObjects = 1000;
+constexpr unsigned syntheticTrianglesPerMesh = 100000;
+constexpr unsigned syntheticCharacters = 500;
+constexpr unsigned syntheticCharacterTriangles = 5000;
+constexpr unsigned syntheticCharacterBones = 32;
+
+const char* const benchmarkFormats[] = { ".fbx", ".dae", ".obj", ".3ds", ".blend", ".md5mesh" };
+const char* const skinnedFormats[] = { ".fbx", ".dae", ".blend", ".md5mesh" };
+
+class Benchmark final {
+public:
+    struct Options {
+        std::string scenario = "all";
+        std::string outputPath;
+        std::string modelsDirectory = std::string(rootDirectory) + "res/models/";
+        std::string staticModel = std::string(rootDirectory) + "res/models/Sphere.obj";
+        unsigned frames = defaultBenchmarkFrames;
+        unsigned warmupFrames = defaultBenchmarkWarmupFrames;
+        unsigned count = 0;
+        long maxFrameAllocations = -1;
+        bool depthPrepass = false;
+        bool shadows = false;
+        unsigned lights = 0;
+        // Dynamic resolution is off unless a GPU frame budget in milliseconds is given.
+        float frameBudget = 0.f;
+    };
+
+    static bool Initialize();
+    static void CleanUp();
+    static int Run(const Options& options);
+
+private:
+    static void LoadTime(const Options& options);
+    static void StaticMeshes(const Options& options);
+    static void SkinnedMeshes(const Options& options);
+    static void ManyInstances(const Options& options);
+    static void BoundingBoxes(const Options& options);
+    static void SyntheticObjects(const Options& options);
+    static void SyntheticTriangles(const Options& options);
+    static void SyntheticSkinned(const Options& options);
+    static void SteadyStateAllocations(const Options& options);
+    static void RenderSyntheticScene(const std::string& scenario, const SceneGenerator::Settings& settings,
+                                     const Options& options);
+
+    static bool LoadScene(const std::string& path, unsigned count, std::vector<PolygonMesh>& meshes);
+    static void UnloadScene(std::vector<PolygonMesh>& meshes);
+    static FrameStatistics::Summary RenderFrames(std::vector<PolygonMesh>& meshes, const Options& options);
+    static std::vector<std::string> FindModels(const std::string& directory, const char* extension);
+
+    static void AddResult(const std::string& scenario, const std::string& fields);
+    static void AddSkipped(const std::string& scenario, const std::string& reason);
+    static void AddFailure(const std::string& scenario, const std::string& reason);
+    static std::string FormatSummary(const FrameStatistics::Summary& summary);
+    static std::string Escape(const std::string& text);
+
+    static SDL_Window* window;
+    static SDL_GLContext glContext;
+    static std::vector<std::string> results;
+    static std::uint64_t worstFrameAllocations;
+    static bool failed;
+};
+
+SDL_Window* Benchmark::window = nullptr;
+SDL_GLContext Benchmark::glContext = nullptr;
+std::vector<std::string> Benchmark::results;
+std::uint64_t Benchmark::worstFrameAllocations = 0;
+bool Benchmark::failed = false;
+
+bool Benchmark::Initialize() {
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        std::cerr << "Could not initialize SDL! SDL error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+
+    window = SDL_CreateWindow("3D Model Viewer Benchmark", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                              static_cast<int>(windowWidth), static_cast<int>(windowHeight),
+                              SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+    if (window == nullptr) {
+        std::cerr << "Could not create window! SDL Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    glContext = SDL_GL_CreateContext(window);
+    if (glContext == nullptr) {
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+        glContext = SDL_GL_CreateContext(window);
+    }
+    if (glContext == nullptr) {
+        std::cerr << "Could not create OpenGL context! SDL error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        std::cerr << "Could not initialize GLEW!" << std::endl;
+        return false;
+    }
+
+    // Frames are timed to completion with glFinish, so presentation must never block on vsync.
+    SDL_GL_SetSwapInterval(0);
+
+    glViewport(0, 0, static_cast<GLsizei>(windowWidth), static_cast<GLsizei>(windowHeight));
+    glEnable(GL_DEPTH_TEST);
+
+    Environment::Initialize();
+    GLState::Initialize();
+    GPUProfiler::Initialize();
+    GeometryPool::Initialize();
+    StaticBatch::Initialize();
+    DepthPrepass::Initialize();
+    LightClusters::Initialize();
+    ShadowMap::Initialize();
+    BoundingBoxOverlay::Initialize();
+    DynamicResolution::Initialize();
+    return true;
+}
+
+void Benchmark::CleanUp() {
+    DynamicResolution::CleanUp();
+    BoundingBoxOverlay::CleanUp();
+    ShadowMap::CleanUp();
+    LightClusters::CleanUp();
+    DepthPrepass::CleanUp();
+    StaticBatch::CleanUp();
+    GeometryPool::CleanUp();
+    GPUProfiler::CleanUp();
+    SDL_GL_DeleteContext(glContext);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+}
+
+int Benchmark::Run(const Options& options) {
+    const auto runAll = options.scenario == "all";
+    auto ranScenario = false;
+
+    DepthPrepass::enabled = options.depthPrepass;
+    ShadowMap::enabled = options.shadows;
+    DynamicResolution::enabled = options.frameBudget > 0.f;
+    if (DynamicResolution::enabled) {
+        DynamicResolution::frameBudget = options.frameBudget;
+    }
+
+    // One in five local lights is a spot light, as in the default settings of the generator.
+    if (options.lights) {
+        auto settings = LightClusters::settings;
+        settings.numSpotLights = static_cast<int>(options.lights / 5);
+        settings.numPointLights = static_cast<int>(options.lights) - settings.numSpotLights;
+        LightClusters::Generate(settings);
+    }
+
+    const std::pair<const char*, void (*)(const Options&)> scenarios[] = {
+        { "load-time", LoadTime },
+        { "static-meshes", StaticMeshes },
+        { "skinned-meshes", SkinnedMeshes },
+        { "many-instances", ManyInstances },
+        { "bounding-boxes", BoundingBoxes },
+        { "synthetic-objects", SyntheticObjects },
+        { "synthetic-triangles", SyntheticTriangles },
+        { "synthetic-skinned", SyntheticSkinned },
+        { "steady-state-allocations", SteadyStateAllocations }
+    };
+
+    for (const auto& scenario : scenarios) {
+        if (runAll || options.scenario == scenario.first) {
+            scenario.second(options);
+            ranScenario = true;
+        }
+    }
+
+    if (!ranScenario) {
+        std::cerr << "Unknown scenario \"" << options.scenario << "\"!" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ostringstream json;
+    json << "{\n"
+         << "  \"renderer\": \"" << Escape(reinterpret_cast<const char*>(glGetString(GL_RENDERER))) << "\",\n"
+         << "  \"version\": \"" << Escape(reinterpret_cast<const char*>(glGetString(GL_VERSION))) << "\",\n"
+         << "  \"results\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        json << "    " << results[i] << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    json << "  ]\n}\n";
+
+    if (options.outputPath.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream file(options.outputPath);
+        if (!(file << json.str())) {
+            std::cerr << "Could not write benchmark results to \"" << options.outputPath << "\"!" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Formats without a model are skipped, but the scenario fails unless at least one format was measured.
+void Benchmark::LoadTime(const Options& options) {
+    auto measured = false;
+    for (const auto* extension : benchmarkFormats) {
+        const auto models = FindModels(options.modelsDirectory, extension);
+        if (models.empty()) {
+            AddSkipped("load-time", std::string("no ") + extension + " model found in " + options.modelsDirectory);
+            continue;
+        }
+
+        auto total = 0.0;
+        auto best = 0.0;
+        unsigned repetitions = 0;
+        for (unsigned repetition = 0; repetition < loadTimeRepetitions; ++repetition) {
+            std::vector<PolygonMesh> meshes;
+            const auto start = Utilities::GetCurrentTime();
+            const auto loaded = LoadScene(models.front(), 1, meshes);
+            glFinish();
+            const auto milliseconds = std::chrono::duration<double, std::milli>(Utilities::GetCurrentTime() - start).count();
+            UnloadScene(meshes);
+
+            if (!loaded) {
+                break;
+            }
+
+            total += milliseconds;
+            best = repetition ? std::min(best, milliseconds) : milliseconds;
+            ++repetitions;
+        }
+
+        if (!repetitions) {
+            AddFailure("load-time", "could not load " + models.front());
+            continue;
+        }
+
+        std::ostringstream fields;
+        fields << "\"format\": \"" << extension << "\", \"path\": \"" << Escape(models.front()) << "\", "
+               << "\"repetitions\": " << repetitions << ", \"mean_ms\": " << total / repetitions
+               << ", \"min_ms\": " << best;
+        AddResult("load-time", fields.str());
+        measured = true;
+    }
+
+    if (!measured) {
+        AddFailure("load-time", "no model could be loaded from " + options.modelsDirectory);
+    }
+}
+
+void Benchmark::StaticMeshes(const Options& options) {
+    const auto count = options.count ? options.count : defaultStaticMeshes;
+
+    std::vector<PolygonMesh> meshes;
+    if (!LoadScene(options.staticModel, count, meshes)) {
+        AddFailure("static-meshes", "could not load " + options.staticModel);
+        return;
+    }
+
+    for (auto& mesh : meshes) {
+        mesh.SetBoundingBoxVisible(false);
+    }
+
+    std::ostringstream fields;
+    fields << "\"meshes\": " << count << ", " << FormatSummary(RenderFrames(meshes, options));
+    AddResult("static-meshes", fields.str());
+
+    UnloadScene(meshes);
+}
+
+void Benchmark::SkinnedMeshes(const Options& options) {
+    const auto count = options.count ? options.count : defaultSkinnedMeshes;
+
+    for (const auto* extension : skinnedFormats) {
+        for (const auto& path : FindModels(options.modelsDirectory, extension)) {
+            std::vector<PolygonMesh> meshes;
+            if (!LoadScene(path, count, meshes) || !meshes.front().IsAnimated()) {
+                UnloadScene(meshes);
+                continue;
+            }
+
+            for (auto& mesh : meshes) {
+                mesh.SetBoundingBoxVisible(false);
+                mesh.SetAnimationEnabled(true);
+            }
+
+            std::ostringstream fields;
+            fields << "\"path\": \"" << Escape(path) << "\", \"meshes\": " << count << ", "
+                   << FormatSummary(RenderFrames(meshes, options));
+            AddResult("skinned-meshes", fields.str());
+
+            UnloadScene(meshes);
+            return;
+        }
+    }
+
+    // Without an animated asset, fall back to generated characters so the scenario still measures skinning.
+    auto settings = SceneGenerator::Settings();
+    settings.numObjects = static_cast<int>(count);
+    settings.trianglesPerMesh = syntheticCharacterTriangles;
+    settings.instancingRatio = 1.f;
+    settings.skinnedRatio = 1.f;
+    settings.bonesPerSkeleton = syntheticCharacterBones;
+    settings.tori = false;
+    settings.terrains = false;
+    RenderSyntheticScene("skinned-meshes", settings, options);
+}
+
+// Unlike static-meshes, where every copy of the model has geometry of its own, all instances here share one generated
+// mesh and the geometry it was uploaded to.
+void Benchmark::ManyInstances(const Options& options) {
+    auto settings = SceneGenerator::Settings();
+    settings.numObjects = static_cast<int>(options.count ? options.count : defaultInstances);
+    settings.trianglesPerMesh = syntheticObjectTriangles;
+    settings.instancingRatio = 1.f;
+    settings.tori = false;
+    settings.terrains = false;
+    RenderSyntheticScene("many-instances", settings, options);
+}
+
+void Benchmark::BoundingBoxes(const Options& options) {
+    const auto count = options.count ? options.count : defaultStaticMeshes;
+
+    std::vector<PolygonMesh> meshes;
+    if (!LoadScene(options.staticModel, count, meshes)) {
+        AddFailure("bounding-boxes", "could not load " + options.staticModel);
+        return;
+    }
+
+    for (auto& mesh : meshes) {
+        mesh.SetBoundingBoxVisible(false);
+    }
+    const auto withoutBoundingBoxes = RenderFrames(meshes, options);
+
+    for (auto& mesh : meshes) {
+        mesh.SetBoundingBoxVisible(true);
+    }
+    const auto withBoundingBoxes = RenderFrames(meshes, options);
+
+    std::ostringstream fields;
+    fields << "\"meshes\": " << count << ", " << FormatSummary(withBoundingBoxes)
+           << ", \"baseline_mean_ms\": " << withoutBoundingBoxes.average
+           << ", \"overlay_cost_ms\": " << withBoundingBoxes.average - withoutBoundingBoxes.average;
+    AddResult("bounding-boxes", fields.str());
+
+    UnloadScene(meshes);
+}
+
+void Benchmark::SyntheticObjects(const Options& options) {
+    auto settings = SceneGenerator::Settings();
+    settings.numObjects = static_cast<int>(options.count ? options.count : syntheticObjects);
+    settings.trianglesPerMesh = syntheticObjectTriangles;
+    settings.instancingRatio = 0.99f;
+    RenderSyntheticScene("synthetic-objects", settings, options);
+}
+
+void Benchmark::SyntheticTriangles(const Options& options) {
+    auto settings = SceneGenerator::Settings();
+    settings.numObjects = static_cast<int>(options.count ? options.count : syntheticTriangleObjects);
+    settings.trianglesPerMesh = syntheticTrianglesPerMesh;
+    settings.instancingRatio = 0.99f;
+    RenderSyntheticScene("synthetic-triangles", settings, options);
+}
+
+void Benchmark::SyntheticSkinned(const Options& options) {
+    auto settings = SceneGenerator::Settings();
+    settings.numObjects = static_cast<int>(options.count ? options.count : syntheticCharacters);
+    settings.trianglesPerMesh = syntheticCharacterTriangles;
+    settings.instancingRatio = 0.98f;
+    settings.skinnedRatio = 1.f;
+    settings.bonesPerSkeleton = syntheticCharacterBones;
+    settings.tori = false;
+    settings.terrains = false;
+    RenderSyntheticScene("synthetic-skinned", settings, options);
+}
+
+void Benchmark::RenderSyntheticScene(const std::string& scenario, const SceneGenerator::Settings& settings,
+                                     const Options& options) {
+    std::vector<PolygonMesh> meshes;
+
+    const auto start = Utilities::GetCurrentTime();
+    SceneGenerator::Generate(settings, meshes);
+    glFinish();
+    const auto generationTime = std::chrono::duration<double, std::milli>(Utilities::GetCurrentTime() - start).count();
+
+    unsigned long triangles = 0;
+    for (const auto& mesh : meshes) {
+        triangles += mesh.GetIndices().size() / 3;
+    }
+
+    std::ostringstream fields;
+    fields << "\"path\": \"synthetic\", \"meshes\": " << meshes.size() << ", \"triangles\": " << triangles
+           << ", \"skinned_ratio\": " << settings.skinnedRatio << ", \"generation_ms\": " << generationTime << ", "
+           << FormatSummary(RenderFrames(meshes, options));
+    AddResult(scenario, fields.str());
+
+    UnloadScene(meshes);
+}
+
+// Renders a loaded model with bounding boxes and a mixed static/skinned synthetic scene, and fails the run when any
+// frame after warm-up allocates more than --max-allocations times.
+void Benchmark::SteadyStateAllocations(const Options& options) {
+    if (!AllocationTracker::IsAvailable()) {
+        AddSkipped("steady-state-allocations", "built without ALLOCATION_TRACKING");
+        return;
+    }
+
+    const auto count = options.count ? options.count : allocationMeshes;
+    auto worstAllocations = std::uint64_t(0);
+
+    std::vector<PolygonMesh> meshes;
+    if (LoadScene(options.staticModel, count, meshes)) {
+        for (auto& mesh : meshes) {
+            mesh.SetBoundingBoxVisible(true);
+        }
+        RenderFrames(meshes, options);
+        worstAllocations = worstFrameAllocations;
+    } else {
+        AddFailure("steady-state-allocations", "could not load " + options.staticModel);
+    }
+    UnloadScene(meshes);
+
+    auto settings = SceneGenerator::Settings();
+    settings.numObjects = static_cast<int>(count);
+    settings.trianglesPerMesh = syntheticCharacterTriangles;
+    settings.instancingRatio = 0.5f;
+    settings.skinnedRatio = 0.5f;
+    SceneGenerator::Generate(settings, meshes);
+    RenderFrames(meshes, options);
+    worstAllocations = std::max(worstAllocations, worstFrameAllocations);
+    UnloadScene(meshes);
+
+    std::ostringstream fields;
+    fields << "\"meshes\": " << count << ", \"max_allocations_per_frame\": " << worstAllocations
+           << ", \"budget\": " << options.maxFrameAllocations;
+    AddResult("steady-state-allocations", fields.str());
+
+    if (options.maxFrameAllocations >= 0 && worstAllocations > static_cast<std::uint64_t>(options.maxFrameAllocations)) {
+        std::cerr << "Steady-state frames allocated " << worstAllocations << " times, over the budget of "
+                  << options.maxFrameAllocations << "!" << std::endl;
+        failed = true;
+    }
+}
+
+bool Benchmark::LoadScene(const std::string& path, unsigned count, std::vector<PolygonMesh>& meshes) {
+    meshes.reserve(count);
+
+    try {
+        for (unsigned i = 0; i < count; ++i) {
+            Environment::numObjects = meshes.size() + 1;
+            meshes.emplace_back(path, i);
+            meshes.back().Initialize();
+        }
+    } catch (const std::string& errorMessage) {
+        std::cerr << errorMessage << std::endl;
+        return false;
+    }
+
+    if (meshes.empty() || meshes.front().GetPositions().empty()) {
+        return false;
+    }
+
+    // Lay the copies out on a square grid, spaced by the model's largest extent.
+    const auto& boundingBox = meshes.front().boundingBox;
+    const auto spacing = 1.5f * std::max({boundingBox.size.x, boundingBox.size.y, boundingBox.size.z});
+    const auto side = static_cast<unsigned>(std::ceil(std::sqrt(static_cast<float>(count))));
+    for (unsigned i = 0; i < count; ++i) {
+        const auto column = static_cast<float>(i % side) - 0.5f * static_cast<float>(side - 1);
+        const auto row = static_cast<float>(i / side) - 0.5f * static_cast<float>(side - 1);
+        meshes[i].SetTranslation(glm::vec3(column * spacing, 0.f, row * spacing));
+        meshes[i].UpdateModelMatrix();
+    }
+
+    auto extent = 0.f;
+    for (const auto& mesh : meshes) {
+        const auto center = mesh.modelMatrix * glm::vec4(boundingBox.center, 1.f);
+        extent = std::max(extent, glm::length(glm::vec3(center / center.w)));
+    }
+
+    auto& camera = Environment::camera;
+    camera.LoadDefaultValues();
+    camera.focusOnOrigin = true;
+    camera.position = glm::vec3(std::max(2.f * extent, 1.f));
+
+    Environment::numObjects = meshes.size();
+    return true;
+}
+
+void Benchmark::UnloadScene(std::vector<PolygonMesh>& meshes) {
+    for (auto& mesh : meshes) {
+        mesh.CleanUp();
+    }
+    meshes.clear();
+    Environment::numObjects = 0;
+}
+
+FrameStatistics::Summary Benchmark::RenderFrames(std::vector<PolygonMesh>& meshes, const Options& options) {
+    FrameStatistics::Reset();
+    AllocationTracker::EndFrame();
+    worstFrameAllocations = 0;
+
+    for (unsigned frame = 0; frame < options.warmupFrames + options.frames; ++frame) {
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
+        }
+
+        const auto frameStart = Utilities::GetCurrentTime();
+
+        InputRecorder::BeginFrame();
+        auto frameTime = InputRecorder::GetFrameTime();
+        Environment::camera.Update(frameTime);
+
+        // Packets are drawn inline, so that each frame is timed to completion on a single thread.
+        auto& packet = RenderThread::BeginPacket();
+        for (auto& mesh : meshes) {
+            mesh.Prepare(packet);
+        }
+        RenderQueue::Sort(packet);
+        LightClusters::Assign(packet);
+        ShadowMap::Prepare(packet);
+        RenderThread::Draw(packet);
+        glFinish();
+        SDL_GL_SwapWindow(window);
+        GPUProfiler::Publish();
+        AllocationTracker::EndFrame();
+
+        if (frame >= options.warmupFrames) {
+            worstFrameAllocations = std::max(worstFrameAllocations, AllocationTracker::GetFrameCounts().allocations);
+            const auto milliseconds = std::chrono::duration<float, std::milli>(Utilities::GetCurrentTime() - frameStart).count();
+            FrameStatistics::AddFrame(milliseconds, milliseconds);
+        }
+    }
+
+    return FrameStatistics::GetSummary();
+}
+
+std::vector<std::string> Benchmark::FindModels(const std::string& directory, const char* extension) {
+    std::vector<std::string> models;
+
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        auto entryExtension = Utilities::GetExtensionFromPath(entry.path().string());
+        std::transform(entryExtension.begin(), entryExtension.end(), entryExtension.begin(), ::tolower);
+        if (entry.is_regular_file() && entryExtension == extension) {
+            models.push_back(entry.path().string());
+        }
+    }
+
+    std::sort(models.begin(), models.end());
+    return models;
+}
+
+void Benchmark::AddResult(const std::string& scenario, const std::string& fields) {
+    results.push_back("{\"scenario\": \"" + scenario + "\", " + fields + "}");
+}
+
+void Benchmark::AddSkipped(const std::string& scenario, const std::string& reason) {
+    results.push_back("{\"scenario\": \"" + scenario + "\", \"skipped\": true, \"reason\": \"" + Escape(reason) + "\"}");
+}
+
+// A scenario that could not measure what it is meant to, such as one whose asset is missing, fails the run.
+void Benchmark::AddFailure(const std::string& scenario, const std::string& reason) {
+    results.push_back("{\"scenario\": \"" + scenario + "\", \"failed\": true, \"reason\": \"" + Escape(reason) + "\"}");
+    std::cerr << "Scenario \"" << scenario << "\" failed: " << reason << "!" << std::endl;
+    failed = true;
+}
+
+std::string Benchmark::FormatSummary(const FrameStatistics::Summary& summary) {
+    std::ostringstream fields;
+    fields << "\"frames\": " << summary.frames << ", \"mean_ms\": " << summary.average << ", \"p50_ms\": "
+           << summary.p50 << ", \"p95_ms\": " << summary.p95 << ", \"p99_ms\": " << summary.p99
+           << ", \"worst_ms\": " << summary.worst;
+    return fields.str();
+}
+
+std::string Benchmark::Escape(const std::string& text) {
+    std::string escaped;
+    for (const auto character : text) {
+        if (character == '"' || character == '\\') {
+            escaped += '\\';
+        }
+        escaped += character;
+    }
+    return escaped;
+}
+
+} // namespace model_viewer_3d
+
+using namespace model_viewer_3d;
+
+int main(int argc, char* argv[]) {
+    auto options = Benchmark::Options();
+
+    for (int i = 1; i < argc; i += 2) {
+        const auto argument = std::string(argv[i]);
+        if (i + 1 == argc) {
+            std::cerr << "Missing value for argument \"" << argument << "\"!" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        const auto value = std::string(argv[i + 1]);
+        if (argument == "--scenario") {
+            options.scenario = value;
+        } else if (argument == "--output") {
+            options.outputPath = value;
+        } else if (argument == "--models") {
+            options.modelsDirectory = value;
+        } else if (argument == "--model") {
+            options.staticModel = value;
+        } else if (argument == "--frames") {
+            options.frames = static_cast<unsigned>(std::max(1, std::atoi(value.c_str())));
+        } else if (argument == "--warmup") {
+            options.warmupFrames = static_cast<unsigned>(std::max(0, std::atoi(value.c_str())));
+        } else if (argument == "--count") {
+            options.count = static_cast<unsigned>(std::max(1, std::atoi(value.c_str())));
+        } else if (argument == "--max-allocations") {
+            options.maxFrameAllocations = std::atol(value.c_str());
+        } else if (argument == "--depth-prepass") {
+            options.depthPrepass = value == "on";
+        } else if (argument == "--shadows") {
+            options.shadows = value == "on";
+        } else if (argument == "--lights") {
+            options.lights = static_cast<unsigned>(std::max(0, std::atoi(value.c_str())));
+        } else if (argument == "--frame-budget") {
+            options.frameBudget = std::max(0.f, static_cast<float>(std::atof(value.c_str())));
+        } else {
+            std::cerr << "Unknown argument \"" << argument << "\"!" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!Benchmark::Initialize()) {
+        return EXIT_FAILURE;
+    }
+
+    const auto result = Benchmark::Run(options);
+    Benchmark::CleanUp();
+    return result;
+}
@@ -0,0 +1,304 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Environment.h"
+#include "ModelImporter.h"
+#include "SceneGenerator.h"
+#include "Utilities.h"
+
+#define GLM_SWIZZLE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace model_viewer_3d {
+
+constexpr unsigned defaultMicrobenchmarkRepetitions = 30;
+constexpr double microbenchmarkWarmupTime = 0.05;
+constexpr double microbenchmarkSampleTime = 0.01;
+
+constexpr unsigned boundsPoints = 1 << 16;
+constexpr unsigned matrixInputs = 256;
+constexpr unsigned distancePairs = 1024;
+constexpr unsigned paletteBones = maxBones - 1;
+constexpr unsigned paletteTriangles = 1280;
+constexpr unsigned paletteKeys = 30;
+
+template <typename T>
+inline void KeepAlive(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+class Microbenchmark final {
+public:
+    struct Options {
+        std::string filter;
+        std::string outputPath;
+        unsigned repetitions = defaultMicrobenchmarkRepetitions;
+    };
+
+    struct Result {
+        std::string name;
+        unsigned long iterations;
+        unsigned samples;
+        double minimum;
+        double median;
+        double mean;
+        double standardDeviation;
+    };
+
+    static int Run(const Options& options);
+
+private:
+    template <typename Function>
+    static void Measure(const std::string& name, const Options& options, Function&& function);
+
+    static void Bounds(const Options& options);
+    static void MatrixComposition(const Options& options);
+    static void CameraUpdate(const Options& options);
+    static void Distance(const Options& options);
+    static void BonePalette(const Options& options);
+    static void ImportedBonePalette(const Options& options);
+
+    static std::vector<Result> results;
+    static std::mt19937 generator;
+};
+
+std::vector<Microbenchmark::Result> Microbenchmark::results;
+std::mt19937 Microbenchmark::generator(42);
+
+int Microbenchmark::Run(const Options& options) {
+    Bounds(options);
+    MatrixComposition(options);
+    CameraUpdate(options);
+    Distance(options);
+    BonePalette(options);
+    ImportedBonePalette(options);
+
+    std::ostringstream json;
+    json << "{\n  \"results\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto& result = results[i];
+        json << "    {\"name\": \"" << result.name << "\", \"iterations\": " << result.iterations
+             << ", \"samples\": " << result.samples << ", \"min_ns\": " << result.minimum
+             << ", \"median_ns\": " << result.median << ", \"mean_ns\": " << result.mean
+             << ", \"stddev_ns\": " << result.standardDeviation << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    json << "  ]\n}\n";
+
+    if (options.outputPath.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream file(options.outputPath);
+        if (!(file << json.str())) {
+            std::cerr << "Could not write microbenchmark results to \"" << options.outputPath << "\"!" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Calibrates the batch size during warm-up so that each sample lasts roughly microbenchmarkSampleTime, then
+// reports per-call statistics over the timed samples.
+template <typename Function>
+void Microbenchmark::Measure(const std::string& name, const Options& options, Function&& function) {
+    if (name.find(options.filter) == std::string::npos) {
+        return;
+    }
+
+    const auto runBatch = [&function](unsigned long iterations) {
+        const auto start = Utilities::GetCurrentTime();
+        for (unsigned long i = 0; i < iterations; ++i) {
+            function(i);
+        }
+        return std::chrono::duration<double>(Utilities::GetCurrentTime() - start).count();
+    };
+
+    unsigned long iterations = 1;
+    auto warmupElapsed = 0.0;
+    while (warmupElapsed < microbenchmarkWarmupTime) {
+        const auto elapsed = runBatch(iterations);
+        warmupElapsed += elapsed;
+        if (elapsed < microbenchmarkSampleTime) {
+            iterations *= 2;
+        }
+    }
+
+    std::vector<double> samples(options.repetitions);
+    for (auto& sample : samples) {
+        sample = runBatch(iterations) * 1e9 / static_cast<double>(iterations);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    const auto mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    auto variance = 0.0;
+    for (const auto sample : samples) {
+        variance += (sample - mean) * (sample - mean);
+    }
+    variance /= std::max<std::size_t>(samples.size() - 1, 1);
+
+    const auto middle = samples.size() / 2;
+    const auto median = samples.size() % 2 ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2;
+
+    results.push_back({name, iterations, options.repetitions, samples.front(), median, mean, std::sqrt(variance)});
+    std::cerr << name << ": " << median << " ns (median)" << std::endl;
+}
+
+void Microbenchmark::Bounds(const Options& options) {
+    std::uniform_real_distribution<float> distribution(-100.f, 100.f);
+    std::vector<glm::vec3> points(boundsPoints);
+    for (auto& point : points) {
+        point = glm::vec3(distribution(generator), distribution(generator), distribution(generator));
+    }
+
+    Measure("Utilities::ComputeBounds/" + std::to_string(boundsPoints), options, [&points](unsigned long) {
+        glm::vec3 min, max;
+        Utilities::ComputeBounds(points, min, max);
+        KeepAlive(min);
+        KeepAlive(max);
+    });
+}
+
+void Microbenchmark::MatrixComposition(const Options& options) {
+    std::uniform_real_distribution<float> distribution(-3.f, 3.f);
+    std::vector<glm::vec3> inputs(matrixInputs);
+    for (auto& input : inputs) {
+        input = glm::vec3(distribution(generator), distribution(generator), distribution(generator));
+    }
+
+    Measure("Utilities::ComposeModelMatrix", options, [&inputs](unsigned long i) {
+        const auto& translation = inputs[i % matrixInputs];
+        const auto& rotation = inputs[(i + 1) % matrixInputs];
+        const auto& scaling = inputs[(i + 2) % matrixInputs];
+        const auto modelMatrix = Utilities::ComposeModelMatrix(translation, rotation, scaling);
+        KeepAlive(modelMatrix);
+    });
+}
+
+void Microbenchmark::CameraUpdate(const Options& options) {
+    auto& camera = Environment::camera;
+    camera.LoadDefaultValues();
+    // No model is loaded, so there is no selected model for the camera to follow.
+    camera.focusOnOrigin = true;
+    auto currentTime = Utilities::GetCurrentTime();
+
+    Measure("Environment::Camera::Update", options, [&camera, &currentTime](unsigned long) {
+        currentTime += std::chrono::milliseconds(16);
+        camera.Update(currentTime);
+        KeepAlive(camera.position);
+    });
+}
+
+void Microbenchmark::Distance(const Options& options) {
+    std::uniform_real_distribution<float> distribution(-100.f, 100.f);
+    std::vector<glm::vec3> points(2 * distancePairs);
+    for (auto& point : points) {
+        point = glm::vec3(distribution(generator), distribution(generator), distribution(generator));
+    }
+
+    Measure("Utilities::DistanceBetween3DPoints", options, [&points](unsigned long i) {
+        const auto pair = 2 * (i % distancePairs);
+        const auto distance = Utilities::DistanceBetween3DPoints(points[pair], points[pair + 1]);
+        KeepAlive(distance);
+    });
+}
+
+// Evaluates the skinning palette of a generated character, as PolygonMesh does for every animated synthetic mesh.
+void Microbenchmark::BonePalette(const Options& options) {
+    auto character = SceneGenerator::GenerateSphere(paletteTriangles);
+    SceneGenerator::AttachSkeleton(*character, paletteBones, 1);
+
+    const auto& skeleton = *character->skeleton;
+    std::vector<glm::mat4> globalTransforms;
+    std::vector<glm::mat4> palette;
+
+    Measure("Skeleton::Evaluate/" + std::to_string(skeleton.parents.size()), options,
+            [&skeleton, &globalTransforms, &palette](unsigned long i) {
+        skeleton.Evaluate(static_cast<float>(i % 1000) * 0.001f, globalTransforms, palette);
+        KeepAlive(palette.front());
+    });
+}
+
+// Evaluates the palette of an animation laid out the way ModelImporter fills it from a model file: a chain of bones,
+// each with a channel keyed once per tick, so that every evaluation interpolates between keys.
+void Microbenchmark::ImportedBonePalette(const Options& options) {
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+
+    ImportedMesh::Animation animation;
+    animation.duration = static_cast<float>(paletteKeys - 1);
+    animation.ticksPerSecond = 30.f;
+    animation.globalInverseTransform = glm::mat4(1.f);
+    for (unsigned bone = 0; bone < paletteBones; ++bone) {
+        ImportedMesh::Channel channel;
+        for (unsigned key = 0; key < paletteKeys; ++key) {
+            const auto time = static_cast<float>(key);
+            const auto axis = glm::normalize(glm::vec3(distribution(generator), 1.f, distribution(generator)));
+            channel.positionTimes.push_back(time);
+            channel.positions.emplace_back(0.f, .1f, 0.f);
+            channel.rotationTimes.push_back(time);
+            channel.rotations.push_back(glm::angleAxis(distribution(generator), axis));
+            channel.scalingTimes.push_back(time);
+            channel.scalings.emplace_back(1.f);
+        }
+
+        const auto index = static_cast<int>(bone);
+        animation.nodes.push_back({index - 1, index, index, glm::mat4(1.f)});
+        animation.channels.push_back(std::move(channel));
+        animation.boneOffsets.push_back(glm::translate(glm::mat4(1.f), glm::vec3(0.f, -.1f * bone, 0.f)));
+    }
+
+    std::vector<glm::mat4> globalTransforms;
+    std::vector<glm::mat4> palette;
+
+    Measure("ImportedMesh::Animation::Evaluate/" + std::to_string(animation.boneOffsets.size()), options,
+            [&animation, &globalTransforms, &palette](unsigned long i) {
+        animation.Evaluate(static_cast<float>(i % 1000) * 0.001f, globalTransforms, palette);
+        KeepAlive(palette.front());
+    });
+}
+
+} // namespace model_viewer_3d
+
+using namespace model_viewer_3d;
+
+int main(int argc, char* argv[]) {
+    auto options = Microbenchmark::Options();
+
+    for (int i = 1; i < argc; i += 2) {
+        const auto argument = std::string(argv[i]);
+        if (i + 1 == argc) {
+            std::cerr << "Missing value for argument \"" << argument << "\"!" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        const auto value = std::string(argv[i + 1]);
+        if (argument == "--filter") {
+            options.filter = value;
+        } else if (argument == "--output") {
+            options.outputPath = value;
+        } else if (argument == "--repetitions") {
+            options.repetitions = static_cast<unsigned>(std::max(2, std::atoi(value.c_str())));
+        } else {
+            std::cerr << "Unknown argument \"" << argument << "\"!" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    return Microbenchmark::Run(options);
+}
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace model_viewer_3d {
+
+constexpr unsigned allocationTrackerMaxCallSites = 1024;
+constexpr unsigned allocationTrackerStackDepth = 16;
+constexpr unsigned allocationTrackerHistoryFrames = 120;
+constexpr unsigned allocationTrackerDisplayedCallSites = 16;
+constexpr unsigned allocationTrackerDescriptionLength = 160;
+
+// Counts heap allocations made through the global operator new. The operators are only replaced when the project is
+// configured with -DALLOCATION_TRACKING=ON; otherwise every count stays zero and IsAvailable() returns false.
+class AllocationTracker final {
+public:
+    struct Counts {
+        std::uint64_t allocations;
+        std::uint64_t bytes;
+    };
+
+    struct CallSite {
+        void* stack[allocationTrackerStackDepth];
+        unsigned stackDepth;
+        const char* scope;
+        std::uint64_t hash;
+        Counts frame;
+        Counts latest;
+        Counts total;
+        char description[allocationTrackerDescriptionLength];
+        bool described;
+    };
+
+    static void EndFrame();
+    static void Reset();
+    static void DisplayControls();
+
+    static bool IsAvailable();
+    static Counts GetThreadCounts();
+    static Counts GetFrameCounts();
+    static Counts GetTotalCounts();
+
+    static const char* EnterScope(const char* name);
+    static void LeaveScope(const char* parentScope);
+
+    static void RecordAllocation(std::size_t size);
+    static void RecordFree();
+
+    // Attributing allocations to call sites takes a lock, and a backtrace when call stacks are captured, on every
+    // allocation, so it only happens while enabled. The counts are kept either way.
+    static std::atomic<bool> enabled;
+    static std::atomic<bool> captureCallStacks;
+
+private:
+    static CallSite* FindCallSite(void* const* stack, unsigned stackDepth, const char* scope);
+    static const char* Describe(CallSite& callSite);
+    static void Symbolize(void* address, char* buffer, std::size_t size);
+    static bool IsAllocatorFrame(const char* symbol);
+    static void DisplayCallSites();
+
+    static std::atomic<std::uint64_t> frameAllocations;
+    static std::atomic<std::uint64_t> frameBytes;
+    static std::atomic<std::uint64_t> totalAllocations;
+    static std::atomic<std::uint64_t> totalBytes;
+    static std::atomic<std::uint64_t> totalFrees;
+    static Counts latestFrame;
+    static Counts worstFrame;
+    static unsigned long steadyFrames;
+
+    static thread_local Counts threadCounts;
+    static thread_local const char* currentScope;
+    static thread_local bool recording;
+
+    static std::array<CallSite, allocationTrackerMaxCallSites> callSites;
+    static std::array<unsigned, allocationTrackerMaxCallSites> sortedCallSites;
+    static unsigned numCallSites;
+    static unsigned numSortedCallSites;
+    static std::atomic<unsigned long> droppedCallSites;
+    static std::atomic_flag callSitesLock;
+
+    static std::array<float, allocationTrackerHistoryFrames> history;
+    static unsigned historyOffset;
+};
+
+} // namespace model_viewer_3d
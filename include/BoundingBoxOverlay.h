@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "RenderPacket.h"
+
+#include <GL/glew.h>
+
+namespace model_viewer_3d {
+
+// Per-instance attribute locations of BoundingBox.vert, after the ones reserved by GeometryPool.
+constexpr GLuint boundingBoxTransformAttribute = 6;
+constexpr GLuint boundingBoxColorAttribute = 10;
+
+constexpr GLsizeiptr boundingBoxOverlayInitialCapacity = 256;
+
+// Draws the bounding boxes collected in the packet with a single instanced draw of the unit cube of GeometryPool, after
+// the scene, so that the overlay costs one program switch and one draw call no matter how many boxes are shown. The
+// instance buffer is only uploaded when a transform or colour differs from the previous frame.
+class BoundingBoxOverlay final {
+public:
+    static void Initialize();
+    static void CleanUp();
+
+    static void Draw(const RenderPacket& packet);
+
+    static std::atomic<unsigned> numBoxes;
+
+private:
+    static void SetupVertexArray();
+    static void UploadInstances(const RenderPacket& packet);
+
+    static GLuint program;
+    static GLuint vertexArray;
+    static GLuint instanceBuffer;
+    static GLsizeiptr instanceCapacity;
+
+    static GLuint viewMatrixUniform;
+    static GLuint projectionMatrixUniform;
+
+    static std::vector<RenderPacket::BoundingBox> instances;
+    static unsigned geometryGeneration;
+};
+
+} // namespace model_viewer_3d
@@ -6,7 +6,7 @@
 #define IMVEC4_POINTER(x) (reinterpret_cast<float *>(&(x)))
 #define SETUP_UNIFORM(x)  (x##Uniform = static_cast<GLuint>(glGetUniformLocation(program, #x)))
 
-namespace 3d_model_viewer {
+namespace model_viewer_3d {
 
 constexpr auto rootDirectory = "<root_directory>";
 constexpr auto audioFileName = "Dreamy.mp3";
@@ -14,4 +14,4 @@ constexpr auto audioFileName = "Dreamy.mp3";
 constexpr float windowWidth = 1280;
 constexpr float windowHeight = 720;
 
-} // namespace 3d_model_viewer
+} // namespace model_viewer_3d
@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include "RenderPacket.h"
+
+#include <GL/glew.h>
+
+namespace model_viewer_3d {
+
+// Lays down the depth of the solid, unanimated items with a shader that reads nothing but positions, before they are
+// shaded with an equal depth test, so that every pixel is shaded at most once regardless of the order of the items.
+// Worth it when the fragment shading is expensive and the depth complexity high; otherwise it only costs a second pass
+// over the vertices.
+class DepthPrepass final {
+public:
+    static void Initialize();
+    static void CleanUp();
+    static void Draw(const RenderPacket& packet);
+
+    static bool enabled;
+
+private:
+    static GLuint program;
+
+    static GLuint modelMatrixUniform;
+    static GLuint viewMatrixUniform;
+    static GLuint projectionMatrixUniform;
+};
+
+} // namespace model_viewer_3d
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include "RenderPacket.h"
+
+#include <GL/glew.h>
+
+namespace model_viewer_3d {
+
+// Renders the scene into an offscreen target of a fraction of the window size whenever the GPU frame time exceeds the
+// budget, and upscales it to the window before ImGui is drawn at native resolution. The scale is adjusted on the main
+// thread from the frame times read back by GPUProfiler; at full scale the scene is drawn to the window directly.
+class DynamicResolution final {
+public:
+    static void Initialize();
+    static void CleanUp();
+
+    // Runs on the main thread and sets the render size of the packet.
+    static void Prepare(RenderPacket& packet);
+    // Run on the render thread, around everything that is drawn at the render size.
+    static void Begin(const RenderPacket& packet);
+    static void Resolve(const RenderPacket& packet);
+    static void DisplayControls();
+
+    static bool enabled;
+    static float frameBudget;
+    static float minScale;
+    static float scale;
+
+private:
+    static void Adjust(float frameTime);
+    static bool IsNative(const RenderPacket& packet);
+
+    static GLuint framebuffer;
+    static GLuint colorRenderbuffer;
+    static GLuint depthRenderbuffer;
+
+    static bool consuming;
+    static unsigned long resultsSequence;
+    static unsigned cooldown;
+};
+
+} // namespace model_viewer_3d
@@ -13,7 +13,11 @@
 #include <SDL2/SDL.h>
 #include <ImGUI/imgui.h>
 
-namespace 3d_model_viewer {
+namespace model_viewer_3d {
+
+constexpr float cameraUpdateStep = 1.f / 120.f;
+constexpr float cameraMaxAccumulatedTime = 0.25f;
+constexpr float cameraWheelStep = 1.f / 60.f;
 
 struct Environment {
     static void Initialize();
@@ -21,7 +25,6 @@ struct Environment {
     static void ProcessEvent(SDL_Event* event);
 
     static void LoadDefaultValues();
-    static void ForceUpdate();
 
     struct Camera {
     public:
@@ -32,6 +35,8 @@ struct Environment {
 
         void LoadDefaultValues();
         void UpdateAngleInformation();
+        void Step(float timeStep);
+        void Interpolate(float alpha);
 
         glm::vec3 position;
         glm::vec3 center;
@@ -57,6 +62,11 @@ struct Environment {
         Time currentFrame;
         Time lastFrame;
         float deltaTime;
+        float accumulatedTime;
+
+        float previousThetaInDegrees;
+        float previousPhiInDegrees;
+        float previousFieldOfViewDegrees;
 
         float fieldOfView;
         float fieldOfViewDegrees;
@@ -67,11 +77,21 @@ struct Environment {
         glm::vec3 origin;
         bool focusOnOrigin;
 
-        unsigned long changed;
-
     private:
+        enum HeldKey : unsigned {
+            HeldKeyUp = 1 << 0,
+            HeldKeyDown = 1 << 1,
+            HeldKeyLeft = 1 << 2,
+            HeldKeyRight = 1 << 3,
+            HeldKeyZoomIn = 1 << 4,
+            HeldKeyZoomOut = 1 << 5
+        };
+
         void ProcessKeyboardEvent(SDL_Event* event);
         void ProcessMouseWheelEvent(SDL_Event* event);
+        static unsigned GetHeldKey(SDL_Keycode key);
+
+        unsigned heldKeys;
     };
 
     struct Light {
@@ -82,8 +102,6 @@ struct Environment {
         ImVec4 diffuseColor;
         ImVec4 specularColor;
         float intensity;
-
-        unsigned long changed;
     };
 
     static Camera camera;
@@ -92,4 +110,4 @@ struct Environment {
     static unsigned long numObjects;
 };
 
-} // namespace 3d_model_viewer
+} // namespace model_viewer_3d
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <string>
+
+namespace model_viewer_3d {
+
+constexpr unsigned frameStatisticsWindow = 1024;
+constexpr unsigned frameStatisticsHistogramBuckets = 50;
+constexpr float frameStatisticsBucketWidth = 1.0f;
+constexpr float frameStatisticsTargetTime = 1000.0f / 60.0f;
+
+class FrameStatistics final {
+public:
+    struct Summary {
+        unsigned frames;
+        float average;
+        float p50;
+        float p95;
+        float p99;
+        float worst;
+        float averageWork;
+        unsigned missedDeadlines;
+    };
+
+    static void Initialize(const std::string& outputPath = "");
+    static void CleanUp();
+    static void AddFrame(float frameTime, float workTime);
+    static void Reset();
+    static void DisplayControls();
+
+    static Summary GetSummary();
+    static bool Dump(const std::string& path);
+
+    static float targetFrameTime;
+
+private:
+    struct Sample {
+        float frameTime;
+        float workTime;
+    };
+
+    static void Update();
+    static void HandleSignal(int signal);
+    static bool WriteCSV(const std::string& path);
+    static bool WriteJSON(const std::string& path);
+    static std::string GetDefaultOutputPath();
+
+    static std::array<Sample, frameStatisticsWindow> samples;
+    static unsigned numSamples;
+    static unsigned nextSample;
+    static unsigned long totalFrames;
+
+    static Summary summary;
+    static std::array<float, frameStatisticsHistogramBuckets> histogram;
+    static bool dirty;
+
+    static std::string outputPath;
+    static std::string lastOutputPath;
+    static std::atomic<bool> dumpRequested;
+};
+
+} // namespace model_viewer_3d
@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <array>
+#include <atomic>
+
+#include <GL/glew.h>
+
+namespace model_viewer_3d {
+
+constexpr unsigned glStateMaxTextureUnits = 16;
+constexpr unsigned glStateMaxIndexedBuffers = 8;
+
+// Shadows the OpenGL state that the renderer changes while drawing, so that setting something to what it already is
+// never reaches the driver. All of the renderer's binds and state changes go through it; after code that changes state
+// behind its back, such as ImGui or glGA, Invalidate() makes the next call of every kind go through again. Must only be
+// used from the thread that owns the context.
+class GLState final {
+public:
+    static void Initialize();
+    static void BeginFrame();
+    static void Invalidate();
+    static void InvalidateTextures();
+
+    static void UseProgram(GLuint program);
+    static void BindVertexArray(GLuint vertexArray);
+    static void BindBuffer(GLenum target, GLuint buffer);
+    static void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    // Also leaves the unit active, so that it can be followed by calls that act on the bound texture.
+    static void BindTexture(GLuint unit, GLenum target, GLuint texture);
+    static void BindFramebuffer(GLuint framebuffer);
+
+    static void Enable(GLenum capability);
+    static void Disable(GLenum capability);
+    static void PolygonMode(GLenum mode);
+    static void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    static void ColorMask(GLboolean mask);
+    static void DepthFunc(GLenum function);
+    static void DepthMask(GLboolean mask);
+
+    // Deleting a bound object resets its bindings to zero, which the shadowed state has to follow.
+    static void DeleteBuffers(GLsizei count, const GLuint* buffers);
+    static void DeleteVertexArrays(GLsizei count, const GLuint* vertexArrays);
+    static void DeleteTextures(GLsizei count, const GLuint* textures);
+    static void DeleteFramebuffers(GLsizei count, const GLuint* framebuffers);
+
+    static void DisplayControls();
+
+private:
+    enum Category : unsigned {
+        CategoryProgram,
+        CategoryVertexArray,
+        CategoryBuffer,
+        CategoryTexture,
+        CategoryCapability,
+        CategoryRaster,
+        CategoryDepth,
+        CategoryFramebuffer,
+        CategoryCount
+    };
+
+    // Indexed buffer bindings are only shadowed for the last two targets.
+    enum BufferTarget : unsigned {
+        BufferTargetArray,
+        BufferTargetElementArray,
+        BufferTargetCopyRead,
+        BufferTargetCopyWrite,
+        BufferTargetDrawIndirect,
+        BufferTargetShaderStorage,
+        BufferTargetUniform,
+        BufferTargetCount
+    };
+
+    enum TextureTarget : unsigned {
+        TextureTarget2D,
+        TextureTarget2DArray,
+        TextureTargetCount
+    };
+
+    enum Capability : unsigned {
+        CapabilityDepthTest,
+        CapabilityCullFace,
+        CapabilityBlend,
+        CapabilityScissorTest,
+        CapabilityPolygonOffsetFill,
+        CapabilityCount
+    };
+
+    static bool Changed(GLuint& cached, GLuint value, Category category);
+    static int GetBufferTarget(GLenum target);
+    static int GetTextureTarget(GLenum target);
+    static int GetCapability(GLenum capability);
+    static void SetCapability(GLenum capability, bool enabled);
+
+    static GLuint program;
+    static GLuint vertexArray;
+    static std::array<GLuint, BufferTargetCount> buffers;
+    static std::array<std::array<GLuint, glStateMaxIndexedBuffers>, 2> indexedBuffers;
+    static GLuint activeTextureUnit;
+    static std::array<std::array<GLuint, TextureTargetCount>, glStateMaxTextureUnits> textures;
+    static std::array<GLuint, CapabilityCount> capabilities;
+    static GLuint framebuffer;
+    static GLuint polygonMode;
+    static std::array<GLint, 4> viewport;
+    static GLuint colorMask;
+    static GLuint depthFunction;
+    static GLuint depthMask;
+
+    static std::array<unsigned, CategoryCount> issued;
+    static std::array<unsigned, CategoryCount> skipped;
+    static std::array<std::atomic<unsigned>, CategoryCount> issuedLastFrame;
+    static std::array<std::atomic<unsigned>, CategoryCount> skippedLastFrame;
+};
+
+} // namespace model_viewer_3d
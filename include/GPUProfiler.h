@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "Profiler.h"
+
+#include <GL/glew.h>
+
+#define GPU_PROFILE_SCOPE(name) const GPUProfiler::Scope PROFILER_CONCATENATE(gpuProfilerScope, __LINE__)(name)
+
+#define PROFILE_GPU_SCOPE(name)                                                             \
+    const Profiler::Scope PROFILER_CONCATENATE(profilerScope, __LINE__)(name);              \
+    const GPUProfiler::Scope PROFILER_CONCATENATE(gpuProfilerScope, __LINE__)(name)
+
+namespace model_viewer_3d {
+
+constexpr unsigned gpuProfilerFrameLatency = 4;
+constexpr unsigned gpuProfilerMaxScopes = 2048;
+
+class GPUProfiler final {
+public:
+    struct Timestamp {
+        const char* name;
+        std::uint64_t begin;
+        std::uint64_t end;
+    };
+
+    class Scope {
+    public:
+        explicit Scope(const char* name);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        int scopeIndex;
+    };
+
+    static void Initialize();
+    static void CleanUp();
+    static void BeginFrame();
+    static void EndFrame();
+    static void Publish();
+
+    static void AddConsumer();
+    static void RemoveConsumer();
+    // Frame times alone only take two queries per frame, so they can be kept on without recording any scopes.
+    static void AddFrameTimeConsumer();
+    static void RemoveFrameTimeConsumer();
+
+    static float GetScopeTime(const char* name);
+    static float GetFrameTime();
+    static const std::vector<Profiler::ScopeTotal>& GetScopeTotals();
+    static const std::vector<Timestamp>& GetLatestScopes();
+    static unsigned long GetResultsSequence();
+    static std::int64_t GetTimestamp();
+
+    static std::atomic<bool> enabled;
+    static std::atomic<bool> frameTimeEnabled;
+    static bool supported;
+    static unsigned long framesDropped;
+    // Scopes of the latest frame that found every query of the frame taken and went unmeasured.
+    static unsigned scopesDropped;
+
+private:
+    struct ScopeQueries {
+        const char* name;
+        GLuint beginQuery;
+        GLuint endQuery;
+    };
+
+    struct Frame {
+        std::array<ScopeQueries, gpuProfilerMaxScopes> scopes;
+        unsigned numScopes;
+        unsigned numScopesDropped;
+        GLuint frameBeginQuery;
+        GLuint frameEndQuery;
+        bool recorded;
+        bool scopesRecorded;
+    };
+
+    static void ReadBack(Frame& frame);
+
+    static std::array<Frame, gpuProfilerFrameLatency> frames;
+    static std::vector<GLuint> queries;
+    static unsigned currentFrame;
+    static unsigned numConsumers;
+    static unsigned numFrameTimeConsumers;
+
+    static std::vector<Profiler::ScopeTotal> latestTotals;
+    static float latestFrameTime;
+    static std::vector<Timestamp> latestScopes;
+    static unsigned long resultsSequence;
+
+    static std::vector<Profiler::ScopeTotal> readBackTotals;
+    static float readBackFrameTime;
+    static std::vector<Timestamp> readBackScopes;
+    static unsigned long readBackFramesDropped;
+    static unsigned readBackScopesDropped;
+    static bool readBackPending;
+};
+
+} // namespace model_viewer_3d
@@ -3,20 +3,30 @@
 
 #pragma once
 
+#include <atomic>
+#include <deque>
 #include <filesystem>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <cstdint>
 
+#include "JobSystem.h"
+#include "ModelImporter.h"
 #include "PolygonMesh.h"
+#include "SceneGenerator.h"
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_mixer.h>
 #include <ImGUI/imgui.h>
 #include <tiny-file-dialogs/tinyfiledialogs.h>
 
-namespace 3d_model_viewer {
+namespace model_viewer_3d {
+
+constexpr unsigned modelFilterLength = 128;
 
 using DisplayFunction = std::function<void(void)>;
 using EventHandler = std::function<void(SDL_Event* event)>;
@@ -48,23 +58,54 @@ public:
     };
 
 private:
+    // Filled by a JobSystem worker, and read on the main thread once its job finished.
+    struct PendingImport {
+        std::string path;
+        std::unique_ptr<ImportedMesh> importedMesh;
+        std::string errorMessage;
+        JobSystem::Handle job;
+    };
+
+    // Filled by a JobSystem worker, and instantiated on the main thread once its job finished.
+    struct PendingScene {
+        SceneGenerator::GeneratedScene scene;
+        std::string errorMessage;
+        JobSystem::Handle job;
+    };
+
     static void LoadModel();
+    static void LoadModel(const std::string& path, std::unique_ptr<ImportedMesh> importedMesh = nullptr);
+    static void QueueModel(const std::string& path);
+    static void QueueDroppedPath(const std::string& path);
+    static void LoadQueuedModels();
+    static void LoadGeneratedScene();
+    static void ReportImportError(const std::string& errorMessage);
     static void UnloadSelectedModel();
+    static void SelectModel(int index);
+    static void TogglePinned(PolygonMesh& model);
+    static void UpdateModelFilter();
 
     static void InstallDisplayFunction(DisplayFunction displayFunction);
     static void InstallInternalDisplayFunction(DisplayFunction displayFunction);
 
     static void DisplayWindowControls();
+    static void DisplayRenderingControls();
     static void DisplayAudioControls();
     static void DisplayModelControls();
+    static void DisplaySceneGenerator();
     static void DisplayMetrics();
+    static void DisplayFrameTimings();
+    static void ToggleMetrics();
     static void DisplayHelp();
+    static void DisplayImportErrors();
 
     static void LoadDefaultValues();
     static void FocusOnOrigin();
 
     static bool showHelp;
     static bool showMetrics;
+    static int modelTimingsSortColumn;
+    static bool modelTimingsSortDescending;
 
     static ImVec4 backgroundColor;
 
@@ -73,8 +114,22 @@ private:
 
     static int selectedModelIndex;
     static std::vector<PolygonMesh> loadedModels;
+    static std::vector<unsigned> filteredModels;
+    static std::thread fileDialogThread;
+    static std::atomic<bool> fileDialogOpen;
+    static std::mutex queuedModelsMutex;
+    static std::deque<std::string> queuedModels;
+    // Counts the models from when they are queued until they are added, including the ones being imported.
+    static std::atomic<unsigned> numQueuedModels;
+    static std::deque<std::shared_ptr<PendingImport>> pendingImports;
+    static std::shared_ptr<PendingScene> pendingScene;
+    static std::atomic<bool> closing;
+    static std::vector<std::string> importErrors;
+    static char modelFilter[modelFilterLength];
+    static bool showPinnedModelsOnly;
+    static bool modelListChanged;
     static std::vector<DisplayFunction> displayFunctions;
     static std::vector<DisplayFunction> internalDisplayFunctions;
 };
 
-} // namespace 3d_model_viewer
+} // namespace model_viewer_3d
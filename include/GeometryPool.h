@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#define GLM_SWIZZLE
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+
+namespace model_viewer_3d {
+
+// Every format has its own vertex arena and vertex array object; all of them share the index arena.
+enum class VertexFormat {
+    Position,
+    PositionNormal,
+    PositionNormalTexCoord,
+    Skinned
+};
+
+constexpr unsigned numVertexFormats = 4;
+
+// Attribute locations, as declared by the vertex shaders, so that one vertex array object can serve every program.
+constexpr GLuint positionAttribute = 0;
+constexpr GLuint normalAttribute = 1;
+constexpr GLuint texCoordAttribute = 2;
+constexpr GLuint boneIDsAttribute = 3;
+constexpr GLuint weightsAttribute = 4;
+constexpr GLuint drawIDAttribute = 5;
+
+constexpr GLsizeiptr geometryPoolInitialVertexCapacity = 1 << 16;
+constexpr GLsizeiptr geometryPoolInitialIndexCapacity = 1 << 18;
+constexpr GLsizeiptr geometryPoolInitialDrawIDCapacity = 256;
+
+struct PositionNormalVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+};
+
+struct PositionNormalTexCoordVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoord;
+};
+
+struct SkinnedVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoord;
+    std::int32_t boneIDs[4];
+    float weights[4];
+};
+
+// Suballocates the vertices and indices of every mesh from a few large buffers, so that loading and unloading models
+// neither creates buffer objects nor leaves the driver with many small allocations. Ranges are handed out first fit
+// from free lists sorted by offset; when the holes between live ranges waste more than a quarter of an arena, the
+// arena is compacted with GPU-side copies. Must only be used from the thread that owns the context.
+class GeometryPool final {
+public:
+    struct Range {
+        GLsizeiptr offset;
+        GLsizeiptr size;
+    };
+
+    // Absolute within the arenas once allocated, so that they can be passed to glDrawElementsBaseVertex directly.
+    struct Submesh {
+        GLuint numIndices;
+        GLuint firstIndex;
+        GLint baseVertex;
+    };
+
+    struct Geometry {
+        VertexFormat format;
+        Range vertices;
+        Range indices;
+        std::vector<Submesh> submeshes;
+        bool allocated;
+    };
+
+    static void Initialize();
+    static void CleanUp();
+    static void Update();
+
+    // The submeshes are given relative to the vertices and indices passed in.
+    static int Allocate(VertexFormat format, const void* vertices, std::size_t numVertices,
+                        const std::vector<GLuint>& indices, const std::vector<Submesh>& submeshes);
+    static void Free(int geometry);
+
+    static bool IsAllocated(int geometry);
+    static const Geometry& GetGeometry(int geometry);
+    static GLuint GetVertexArray(VertexFormat format);
+    // Reads only the positions (and draw IDs) of the arena of the format, for depth-only passes.
+    static GLuint GetPositionOnlyVertexArray(VertexFormat format);
+    static GLuint GetVertexBuffer(VertexFormat format);
+    static GLuint GetIndexBuffer();
+    static int GetUnitCube();
+    static unsigned GetGeneration();
+
+    static void ReserveDrawIDs(GLsizeiptr count);
+    static void DisplayControls();
+
+private:
+    struct Arena {
+        const char* name;
+        GLuint buffer;
+        GLsizeiptr elementSize;
+        GLsizeiptr capacity;
+        std::vector<Range> freeRanges;
+    };
+
+    struct ArenaStatistics {
+        std::atomic<std::uint64_t> capacity;
+        std::atomic<std::uint64_t> used;
+        std::atomic<unsigned> numFreeRanges;
+    };
+
+    static bool AllocateRange(Arena& arena, GLsizeiptr size, Range& range);
+    static void FreeRange(Arena& arena, const Range& range);
+    static void Grow(Arena& arena, GLsizeiptr capacity);
+    static bool IsFragmented(const Arena& arena);
+    static void Compact(Arena& arena, Range Geometry::*member, int format);
+    static void SetupVertexArray(VertexFormat format);
+    static void PublishStatistics();
+
+    static std::array<Arena, numVertexFormats> vertexArenas;
+    static Arena indexArena;
+    static std::array<GLuint, numVertexFormats> vertexArrays;
+    static std::array<GLuint, numVertexFormats> positionOnlyVertexArrays;
+    static GLuint drawIDBuffer;
+    static GLsizeiptr drawIDCapacity;
+
+    static std::vector<Geometry> geometries;
+    static std::vector<int> freeGeometries;
+    static unsigned generation;
+    static int unitCube;
+
+    static std::array<ArenaStatistics, numVertexFormats + 1> statistics;
+    static std::atomic<unsigned> numAllocations;
+    static std::atomic<unsigned> numDefragmentations;
+    static std::atomic<bool> defragmentRequested;
+};
+
+} // namespace model_viewer_3d
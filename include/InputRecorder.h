@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Utilities.h"
+
+#include <SDL2/SDL.h>
+
+namespace model_viewer_3d {
+
+using LoadModelHandler = std::function<void(const std::string& path)>;
+
+constexpr char inputRecordingMagic[8] = { '3', 'D', 'M', 'V', 'R', 'E', 'C', '\0' };
+constexpr std::uint32_t inputRecordingVersion = 1;
+
+class InputRecorder final {
+public:
+    static bool StartRecording(const std::string& path);
+    static bool StartReplay(const std::string& path);
+    static void CleanUp();
+
+    static void BeginFrame();
+    static bool PollEvent(SDL_Event* event);
+    static void RecordEvent(const SDL_Event& event);
+    static void RecordLoadModel(const std::string& path);
+    static void SetLoadModelHandler(LoadModelHandler handler);
+
+    static const Time& GetFrameTime();
+    static bool IsRecording();
+    static bool IsReplaying();
+    static bool ReplayFinished();
+
+private:
+    enum class RecordType : std::uint8_t {
+        Frame,
+        Event,
+        LoadModel
+    };
+
+    struct Action {
+        RecordType type;
+        SDL_Event event;
+        std::string path;
+    };
+
+    struct Frame {
+        std::int64_t deltaTime;
+        std::vector<Action> actions;
+    };
+
+    static Time frameTime;
+    static Time lastRealFrameTime;
+
+    static std::ofstream recording;
+    static bool recordingStarted;
+
+    static std::vector<Frame> replayFrames;
+    static std::size_t replayFrame;
+    static std::size_t replayAction;
+    static bool replaying;
+    static bool replayStarted;
+
+    static LoadModelHandler loadModelHandler;
+};
+
+} // namespace model_viewer_3d
@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace model_viewer_3d {
+
+constexpr unsigned jobSystemMaxJobs = 4096;
+constexpr unsigned jobSystemNumPriorities = 3;
+constexpr unsigned jobSystemHistoryFrames = 120;
+
+// Lanes are drained in order, so interactive work always runs before queued background imports.
+enum class JobPriority {
+    Interactive,
+    Normal,
+    Background
+};
+
+// Main thread jobs only run from JobSystem::RunMainThreadJobs() or while the main thread waits, which is where
+// OpenGL work can be done directly or handed to the render thread.
+enum class JobAffinity {
+    Any,
+    MainThread
+};
+
+// Work-stealing scheduler: every worker owns one deque per priority lane, runs its own jobs newest first and steals
+// the oldest jobs of the others when it runs out. Threads that wait on a job help by running queued jobs.
+class JobSystem final {
+public:
+    struct Handle {
+        unsigned index;
+        unsigned generation;
+    };
+
+    using ParallelForFunction = std::function<void(unsigned begin, unsigned end)>;
+
+    static void Initialize(unsigned numWorkers = 0);
+    static void CleanUp();
+
+    static Handle Schedule(const char* name, std::function<void()> function,
+                           JobPriority priority = JobPriority::Normal, JobAffinity affinity = JobAffinity::Any,
+                           std::initializer_list<Handle> dependencies = {});
+    static void Wait(Handle handle);
+    static bool IsFinished(Handle handle);
+
+    static void ParallelFor(const char* name, unsigned count, unsigned grainSize, const ParallelForFunction& function,
+                            JobPriority priority = JobPriority::Interactive);
+
+    static void RunMainThreadJobs();
+    static void EndFrame();
+    static void DisplayControls();
+
+    static unsigned GetNumWorkers();
+
+private:
+    struct Job {
+        const char* name;
+        std::function<void()> function;
+        std::atomic<unsigned> generation;
+        std::atomic<unsigned> pendingDependencies;
+        std::vector<unsigned> continuations;
+        JobPriority priority;
+        JobAffinity affinity;
+    };
+
+    struct Queue {
+        bool PopBack(unsigned& index);
+        bool PopFront(unsigned& index);
+        void PushBack(unsigned index);
+
+        std::array<unsigned, jobSystemMaxJobs> jobs;
+        unsigned head;
+        unsigned tail;
+    };
+
+    struct Lanes {
+        std::mutex mutex;
+        std::array<Queue, jobSystemNumPriorities> queues;
+    };
+
+    struct Worker {
+        Lanes lanes;
+        std::atomic<std::uint64_t> busyTime;
+        std::atomic<unsigned> jobsExecuted;
+        std::atomic<unsigned> jobsStolen;
+        const char* threadName;
+
+        std::uint64_t lastBusyTime;
+        std::array<float, jobSystemHistoryFrames> utilisation;
+    };
+
+    static void WorkerLoop(unsigned workerIndex);
+
+    static unsigned AllocateJob();
+    static void Enqueue(unsigned index);
+    static bool FindJob(unsigned& index);
+    static void RunJob(unsigned index);
+    static void FinishJob(unsigned index);
+    static bool HelpOnce();
+
+    static std::unique_ptr<Job[]> jobs;
+    static std::vector<unsigned> freeJobs;
+    static std::mutex freeJobsMutex;
+    static std::mutex dependencyMutex;
+
+    static std::unique_ptr<Worker[]> workers;
+    static std::vector<std::thread> threads;
+    static unsigned numWorkers;
+    static thread_local int workerIndex;
+    static std::atomic<unsigned> nextWorker;
+
+    static Lanes mainThreadLanes;
+    static std::thread::id mainThreadId;
+
+    static std::mutex sleepMutex;
+    static std::condition_variable workAvailable;
+    static std::atomic<unsigned> numQueuedJobs;
+    static std::atomic<unsigned> numMainThreadJobs;
+    static std::atomic<unsigned> peakQueuedJobs;
+    static std::atomic<unsigned> numRunningWorkers;
+    static std::atomic<bool> stopping;
+
+    static std::uint64_t lastFrameEnd;
+    static std::array<float, jobSystemHistoryFrames> queueDepthHistory;
+    static unsigned historyIndex;
+    static unsigned jobsPerFrame;
+    static unsigned stealsPerFrame;
+};
+
+} // namespace model_viewer_3d
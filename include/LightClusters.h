@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "RenderPacket.h"
+
+#define GLM_SWIZZLE
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+
+namespace model_viewer_3d {
+
+// The view frustum is divided into a grid of froxels: tiles of the screen, sliced exponentially in depth.
+constexpr unsigned lightClustersX = 16;
+constexpr unsigned lightClustersY = 9;
+constexpr unsigned lightClustersZ = 24;
+constexpr unsigned lightClustersCount = lightClustersX * lightClustersY * lightClustersZ;
+constexpr int maxLocalLights = 16384;
+
+// Shades any number of point and spot lights in a single forward pass. Every frame, the lights in view are assigned
+// to the froxels they touch on the job system, one depth slice per job, and the lights, the per-froxel ranges and the
+// light indices are uploaded to shader storage buffers 1 to 3. Object.frag then only loops over the lights of the
+// froxel of each fragment, so shading costs as much as the lights around it rather than all of them. Requires OpenGL
+// 4.3; without it, only Environment::light is shaded.
+class LightClusters final {
+public:
+    struct LocalLight {
+        glm::vec3 position;
+        glm::vec3 color;
+        float intensity;
+        float range;
+
+        // Spot lights only; the angles are measured from the direction, in degrees.
+        bool spot;
+        glm::vec3 direction;
+        float innerAngle;
+        float outerAngle;
+    };
+
+    struct Settings {
+        int numPointLights = 512;
+        int numSpotLights = 128;
+        float range = 4.f;
+        float intensity = 1.f;
+        float spread = 30.f;
+        float height = 2.f;
+        int seed = 1;
+    };
+
+    static void Initialize();
+    static void CleanUp();
+
+    static void Generate(const Settings& settings);
+    // Runs on the main thread once the camera of the packet is known.
+    static void Assign(RenderPacket& packet);
+    // Runs on the render thread before anything in the scene is shaded.
+    static void Upload(const RenderPacket& packet);
+    static void DisplayControls();
+
+    static bool supported;
+    static bool enabled;
+
+    static Settings settings;
+    static std::vector<LocalLight> lights;
+
+private:
+    // Matches the header of LightBuffer in Object.frag, which the lights follow.
+    struct GridHeader {
+        glm::uvec4 size;
+        glm::vec4 parameters;
+    };
+
+    struct VisibleLight {
+        glm::vec3 position;
+        float range;
+        glm::vec3 direction;
+        float cosOuterAngle;
+        float sinOuterAngle;
+        bool spot;
+
+        glm::uvec3 minCluster;
+        glm::uvec3 maxCluster;
+    };
+
+    struct ClusterBounds {
+        glm::vec3 min;
+        glm::vec3 max;
+        glm::vec4 sphere;
+    };
+
+    static void UpdateGrid(float nearPlane, float farPlane, float xScale, float yScale);
+    static void CullLights(RenderPacket& packet, const glm::mat4& viewMatrix, float xScale, float yScale);
+    static void AssignSlice(unsigned slice, RenderPacket& packet);
+    static unsigned GetSlice(float depth);
+    static unsigned GetTile(float ndc, unsigned numTiles);
+
+    static GLuint lightBuffer;
+    static GLuint clusterBuffer;
+    static GLuint indexBuffer;
+    static GLsizeiptr lightCapacity;
+    static GLsizeiptr indexCapacity;
+
+    static float gridNearPlane;
+    static float gridFarPlane;
+    static float gridXScale;
+    static float gridYScale;
+    static float sliceScale;
+    static float sliceBias;
+    static std::vector<ClusterBounds> clusterBounds;
+
+    static std::vector<VisibleLight> visibleLights;
+    static std::array<std::vector<std::uint32_t>, lightClustersZ> sliceCandidates;
+    static std::array<std::vector<std::uint32_t>, lightClustersZ> sliceIndices;
+
+    static unsigned numVisibleLights;
+    static unsigned numLightIndices;
+    static unsigned maxLightsPerCluster;
+};
+
+} // namespace model_viewer_3d
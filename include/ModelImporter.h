@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SyntheticMesh.h"
+
+#define GLM_SWIZZLE
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace model_viewer_3d {
+
+// Everything PolygonMesh needs from a model file, without a single OpenGL object, so that it can be filled on any
+// thread and uploaded later by the render thread.
+struct ImportedMesh {
+    struct Entry {
+        unsigned numIndices;
+        unsigned baseIndex;
+        unsigned baseVertex;
+        unsigned materialIndex;
+    };
+
+    // Decoded to RGBA8, one per material.
+    struct Image {
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> pixels;
+    };
+
+    struct Channel {
+        std::vector<float> positionTimes;
+        std::vector<glm::vec3> positions;
+        std::vector<float> rotationTimes;
+        std::vector<glm::quat> rotations;
+        std::vector<float> scalingTimes;
+        std::vector<glm::vec3> scalings;
+    };
+
+    // Nodes are stored parents first, so that the hierarchy is evaluated in a single pass.
+    struct Node {
+        int parent;
+        int channel;
+        int bone;
+        glm::mat4 transform;
+    };
+
+    // The first animation of the scene, played in a loop. The global transforms are scratch space owned by the caller,
+    // so that instances sharing the animation can be evaluated concurrently.
+    struct Animation {
+        void Evaluate(float time, std::vector<glm::mat4>& globalTransforms, std::vector<glm::mat4>& palette) const;
+
+        float duration;
+        float ticksPerSecond;
+        std::vector<Node> nodes;
+        std::vector<Channel> channels;
+        std::vector<glm::mat4> boneOffsets;
+        glm::mat4 globalInverseTransform;
+    };
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texCoords;
+    std::vector<unsigned int> indices;
+    std::vector<BoneWeights> boneWeights;
+    std::vector<Entry> entries;
+    std::vector<Image> images;
+    // Only set for meshes with bones in scenes with animations.
+    std::unique_ptr<Animation> animation;
+};
+
+// Reads a model file with Assimp and decodes its textures. Touches no OpenGL state, so it runs on JobSystem workers.
+class ModelImporter final {
+public:
+    static std::unique_ptr<ImportedMesh> Import(const std::string& path);
+};
+
+} // namespace model_viewer_3d
@@ -5,6 +5,9 @@
 
 #include <string>
 #include <memory>
+#include <unordered_map>
+
+#include "RenderPacket.h"
 
 #define GLM_SWIZZLE
 #include <glm/glm.hpp>
@@ -12,37 +15,54 @@
 #include <SDL2/SDL.h>
 #include <ImGUI/imgui.h>
 
-#define UI_COMPONENT_NAME(x) ((x "##[" + name + " " + id + "]##").c_str())
+#define UI_COMPONENT_NAME(x) (GetLabel(x))
 
-namespace 3d_model_viewer {
+namespace model_viewer_3d {
 
 class Object {
 public:
     explicit Object(const std::string& name, unsigned long id);
 
     virtual void Initialize() = 0;
-    virtual void Display();
+    virtual void Prepare(RenderPacket& packet);
+    virtual void Draw(const RenderPacket& packet, const RenderPacket::Item& item) const;
     virtual void DisplayControls();
     virtual void ProcessEvent(SDL_Event* event);
 
     void Select();
     void Deselect();
+    void SetName(const std::string& name);
+    void SetTranslation(const glm::vec3& translation);
+    void SetRotation(const glm::vec3& rotationInDegrees);
+    void SetBoundingBoxVisible(bool visible);
+    // Only takes effect on objects that have an animation.
+    void SetAnimationEnabled(bool enabled);
+    bool IsAnimated() const;
+    bool IsHidden() const;
+    const ImVec4& GetMaterialAmbientColor() const;
+    const ImVec4& GetMaterialDiffuseColor() const;
+    const ImVec4& GetMaterialSpecularColor() const;
+    float GetMaterialShininess() const;
+    bool UpdateModelMatrix();
 
     std::string name;
     std::string id;
     std::string formattedName;
     std::unique_ptr<const char[]> formattedNameCString;
+    const char* displayScopeName;
+    bool pinned = false;
 
     glm::mat4 modelMatrix;
-    glm::mat4 viewMatrix;
-    glm::mat4 projectionMatrix;
 
 protected:
-    virtual void Render() = 0;
+    virtual void PrepareRender(RenderPacket& packet, RenderPacket::Item& item) = 0;
+    virtual void Render(const RenderPacket& packet, const RenderPacket::Item& item) const = 0;
     virtual void CleanUp() = 0;
     virtual void SetupUniforms();
     virtual void LoadDefaultValues();
 
+    const char* GetLabel(const char* text);
+
     GLuint program;
     GLuint vao;
 
@@ -56,10 +76,6 @@ protected:
     GLuint diffuseProductUniform;
     GLuint specularProductUniform;
 
-    glm::mat4 translationMatrix;
-    glm::mat4 rotationMatrix;
-    glm::mat4 scaleMatrix;
-
     glm::vec4 translation;
     glm::vec4 rotation;
     glm::vec4 scaling;
@@ -68,16 +84,13 @@ protected:
     float scaleFactor;
 
     bool transformed;
+    bool modelMatrixChanged;
 
     ImVec4 materialAmbientColor;
     ImVec4 materialDiffuseColor;
     ImVec4 materialSpecularColor;
     float materialShininess;
 
-    glm::vec4 ambientProduct;
-    glm::vec4 diffuseProduct;
-    glm::vec4 specularProduct;
-
     bool wireframe;
     bool hidden;
     bool showBoundingBox;
@@ -87,12 +100,13 @@ protected:
     ImVec4 defaultBoundingBoxColor;
     ImVec4 selectedBoundingBoxColor;
 
-    bool boundingBoxColorChanged;
     bool isSelected;
     bool isAnimated;
 
 private:
     ImColor GetRandomBoundingBoxColor();
+
+    std::unordered_map<const char*, std::string> labels;
 };
 
-} // namespace 3d_model_viewer
+} // namespace model_viewer_3d
@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "PolygonMesh.h"
+#include "Utilities.h"
+
+#define GLM_SWIZZLE
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+#include <ImGUI/imgui.h>
+
+namespace model_viewer_3d {
+
+constexpr int pathTracerTileSize = 16;
+constexpr int pathTracerMaxBounces = 4;
+constexpr unsigned pathTracerMaxSamples = 4096;
+constexpr int rayPacketSize = 4;
+constexpr int bvhMaxLeafSize = 4;
+constexpr int bvhNumBins = 12;
+
+class PathTracer final {
+public:
+    static void Initialize();
+    static void CleanUp();
+    static void Update(std::vector<PolygonMesh>& models, const ImVec4& backgroundColor);
+    static void Display();
+    static void DisplayControls();
+
+    static void Enable();
+    static void Disable();
+    static void Toggle();
+
+    static bool enabled;
+
+private:
+    struct Triangle {
+        glm::vec3 vertex0;
+        glm::vec3 edge1;
+        glm::vec3 edge2;
+        glm::vec3 normal0;
+        glm::vec3 normal1;
+        glm::vec3 normal2;
+    };
+
+    struct BVHNode {
+        glm::vec3 min;
+        std::uint32_t leftOrFirst;
+        glm::vec3 max;
+        std::uint32_t count;
+    };
+
+    struct MeshBVH {
+        void Build(const PolygonMesh& model);
+
+        std::vector<BVHNode> nodes;
+        std::vector<Triangle> triangles;
+        // Keeps the synthetic mesh alive, so that its address is not reused by another mesh while it is a cache key.
+        std::shared_ptr<const SyntheticMesh> syntheticMesh;
+    };
+
+    struct Instance {
+        std::shared_ptr<const MeshBVH> bvh;
+
+        glm::mat4 objectToWorld;
+        glm::mat4 worldToObject;
+        glm::mat3 normalMatrix;
+
+        glm::vec3 ambientProduct;
+        glm::vec3 diffuseProduct;
+        glm::vec3 specularProduct;
+        glm::vec3 albedo;
+        float shininess;
+
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    struct Scene {
+        std::vector<Instance> instances;
+        std::vector<BVHNode> nodes;
+
+        glm::vec3 cameraPosition;
+        glm::vec3 cameraForward;
+        glm::vec3 cameraRight;
+        glm::vec3 cameraUp;
+
+        glm::vec3 lightPosition;
+        float lightIntensity;
+        glm::vec3 environmentColor;
+        // Copied from the controls, which the UI keeps changing while the workers trace.
+        float environmentIntensity;
+        int maxBounces;
+    };
+
+    struct alignas(16) RayPacket {
+        float originX[rayPacketSize];
+        float originY[rayPacketSize];
+        float originZ[rayPacketSize];
+        float directionX[rayPacketSize];
+        float directionY[rayPacketSize];
+        float directionZ[rayPacketSize];
+        float inverseDirectionX[rayPacketSize];
+        float inverseDirectionY[rayPacketSize];
+        float inverseDirectionZ[rayPacketSize];
+        float distance[rayPacketSize];
+
+        int instanceIndex[rayPacketSize];
+        int triangleIndex[rayPacketSize];
+        float u[rayPacketSize];
+        float v[rayPacketSize];
+
+        int activeMask;
+    };
+
+    struct Tile {
+        int x;
+        int y;
+        int width;
+        int height;
+        std::atomic<unsigned> samples;
+        std::atomic<bool> busy;
+    };
+
+    static void StartWorkers();
+    static void StopWorkers();
+    static void PauseWorkers();
+    static void ResumeWorkers();
+    static void WorkerLoop();
+    static Tile* AcquireTile();
+
+    static std::string GetMeshKey(const PolygonMesh& model);
+    static bool SceneChanged(std::vector<PolygonMesh>& models, const ImVec4& backgroundColor);
+    static void BuildScene(std::vector<PolygonMesh>& models, const ImVec4& backgroundColor);
+    static void BuildTopLevelBVH();
+    static void BuildBVH(std::vector<BVHNode>& nodes, const std::vector<glm::vec3>& primitiveMin,
+                         const std::vector<glm::vec3>& primitiveMax, std::vector<std::uint32_t>& order);
+    static void ResetAccumulation();
+
+    static void RenderTile(Tile& tile);
+    static void ResolveTile(const Tile& tile);
+
+    static void SetRayDirection(RayPacket& packet, int lane, const glm::vec3& direction);
+    static int IntersectBounds(const glm::vec3& min, const glm::vec3& max, const RayPacket& packet, int mask);
+    static void IntersectTriangle(const Triangle& triangle, int triangleIndex, int instanceIndex,
+                                  RayPacket& packet, int mask);
+    static void IntersectMesh(const MeshBVH& bvh, int instanceIndex, RayPacket& packet, int mask);
+    static void IntersectScene(RayPacket& packet);
+
+    static std::unique_ptr<Scene> scene;
+    static std::unordered_map<std::string, std::shared_ptr<const MeshBVH>> meshBVHs;
+
+    static int width;
+    static int height;
+    static float resolutionScale;
+    static float environmentIntensity;
+    static int maxBounces;
+
+    static std::vector<glm::vec3> accumulation;
+    static std::vector<std::uint32_t> displayPixels;
+    static std::unique_ptr<Tile[]> tiles;
+    static int numTiles;
+
+    static std::vector<std::thread> workers;
+    static std::mutex workerMutex;
+    static std::condition_variable workerCondition;
+    static std::atomic<unsigned> nextTile;
+    static std::atomic<int> activeWorkers;
+    static std::atomic<bool> paused;
+    static std::atomic<bool> stopping;
+    static std::atomic<unsigned long long> raysTraced;
+    static bool converged;
+
+    static std::mutex displayMutex;
+    static int displayWidth;
+    static int displayHeight;
+    static bool displayChanged;
+
+    static std::uint64_t sceneSignature;
+    static Time raysTracedSince;
+    static float raysPerSecond;
+
+    static GLuint program;
+    static GLuint vao;
+    static GLuint texture;
+    static int textureWidth;
+    static int textureHeight;
+};
+
+} // namespace model_viewer_3d
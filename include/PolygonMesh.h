@@ -5,36 +5,47 @@
 
 #include <string>
 #include <chrono>
+#include <memory>
+#include <vector>
 
+#include "GeometryPool.h"
+#include "ModelImporter.h"
 #include "Object.h"
+#include "SyntheticMesh.h"
 #include "Utilities.h"
 
 #include <GL/glew.h>
-#include <glGA/glGARigMesh.h>
 
-namespace 3d_model_viewer {
-
-using Point4 = glm::vec4;
-
-constexpr int numVertices = 8;
-constexpr int numIndices = 16;
-constexpr unsigned maxBones = 100;
+namespace model_viewer_3d {
 
 class PolygonMesh : public Object {
 public:
     explicit PolygonMesh(const std::string& path, unsigned long id);
+    explicit PolygonMesh(std::shared_ptr<const SyntheticMesh> syntheticMesh, const std::string& name, unsigned long id);
+
+    // Throws unless the extension is one of the formats that the importer is known to handle.
+    static void ValidatePath(const std::string& path);
 
+    // Uploads the imported mesh, importing it first unless a JobSystem worker already did.
     void Initialize() override;
-    void Render() override;
+    void PrepareRender(RenderPacket& packet, RenderPacket::Item& item) override;
+    void Render(const RenderPacket& packet, const RenderPacket::Item& item) const override;
     void CleanUp() override;
 
+    struct Submesh {
+        unsigned numIndices;
+        unsigned baseIndex;
+        unsigned baseVertex;
+    };
+
+    const std::vector<glm::vec3>& GetPositions() const;
+    const std::vector<glm::vec3>& GetNormals() const;
+    const std::vector<unsigned int>& GetIndices() const;
+    std::vector<Submesh> GetSubmeshes() const;
+
     class BoundingBox {
     public:
-        void Initialize();
-        void Render(PolygonMesh& polygonMesh);
-
-        GLuint program;
-        GLuint boundingBoxColorUniform;
+        void Initialize(const PolygonMesh& polygonMesh);
 
         glm::vec3 size;
         glm::vec3 center;
@@ -42,56 +53,40 @@ public:
 
         glm::vec3 max;
         glm::vec3 min;
-
-    private:
-        void SetupUniforms();
-
-        Point4 vertices[numVertices] = {
-            Point4(-0.5, -0.5,  0.5, 1.0),
-            Point4(-0.5,  0.5,  0.5, 1.0),
-            Point4( 0.5,  0.5,  0.5, 1.0),
-            Point4( 0.5, -0.5,  0.5, 1.0),
-            Point4(-0.5, -0.5, -0.5, 1.0),
-            Point4(-0.5,  0.5, -0.5, 1.0),
-            Point4( 0.5,  0.5, -0.5, 1.0),
-            Point4( 0.5, -0.5, -0.5, 1.0)
-        };
-
-        GLushort indices[numIndices] = {
-          0, 1, 2, 3,
-          4, 5, 6, 7,
-          0, 4, 1, 5,
-          2, 6, 3, 7
-        };
-
-        GLuint vao;
-        GLuint vbo[2];
-
-        GLuint modelMatrixUniform;
-        GLuint viewMatrixUniform;
-        GLuint projectionMatrixUniform;
-        GLuint boundingBoxTransformUniform;
-        GLuint vAnimationEnabledUniform;
     };
 
     std::string path;
-    RigMesh mesh;
+    std::unique_ptr<ImportedMesh> importedMesh;
+    std::shared_ptr<const SyntheticMesh> syntheticMesh;
     BoundingBox boundingBox;
 
 private:
+    void InitializeSynthetic();
+    void DrawSubmeshes() const;
     void SetupUniforms() override;
     float GetRunningTime();
 
-    GLuint vbo[5];
+    // Allocated from GeometryPool; meshes in the position and normal format are drawn by StaticBatch when it is enabled.
+    int geometry = -1;
+    VertexFormat vertexFormat;
+    // The index of the shared program in ProgramCache, which sorts first among the state in the key.
+    unsigned programIndex = 0;
+    // Distinguishes the textures of each loaded model in the sort key; zero for untextured meshes.
+    unsigned textureSet = 0;
+
+    // Reused every frame by both skinning paths so that animated meshes do not allocate while preparing packets.
+    std::vector<glm::mat4> bonePalette;
+    std::vector<glm::mat4> globalTransforms;
+    // One per material of the imported mesh.
+    std::vector<GLuint> textures;
 
     GLuint boneUniforms[maxBones];
     GLuint hasTexturesUniform;
     GLuint vAnimationEnabledUniform;
 
     GLuint hasTextures;
-    GLuint vAnimationEnabled;
 
     Time animationStartTime;
 };
 
-} // namespace 3d_model_viewer
+} // namespace model_viewer_3d
@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "AllocationTracker.h"
+
+#include <ImGUI/imgui.h>
+
+#define PROFILER_CONCATENATE_IMPL(x, y) x##y
+#define PROFILER_CONCATENATE(x, y) PROFILER_CONCATENATE_IMPL(x, y)
+#define PROFILE_SCOPE(name) const Profiler::Scope PROFILER_CONCATENATE(profilerScope, __LINE__)(name)
+
+namespace model_viewer_3d {
+
+constexpr unsigned profilerMaxThreads = 64;
+constexpr unsigned profilerRingCapacity = 8192;
+constexpr unsigned profilerHistoryFrames = 120;
+constexpr unsigned profilerMaxScopeTotals = 64;
+constexpr unsigned profilerMaxCounters = 32;
+
+class Profiler final {
+public:
+    struct Event {
+        const char* name;
+        std::uint64_t begin;
+        std::uint64_t end;
+        std::uint16_t depth;
+        std::uint16_t threadIndex;
+        std::uint32_t allocations;
+        std::uint64_t allocatedBytes;
+    };
+
+    struct ScopeTotal {
+        const char* name;
+        float milliseconds;
+        unsigned calls;
+    };
+
+    struct Counter {
+        const char* name;
+        double value;
+    };
+
+    class Scope {
+    public:
+        explicit Scope(const char* name);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* name;
+        const char* parentAllocationScope;
+        std::uint64_t begin;
+        AllocationTracker::Counts allocationsBegin;
+        bool active;
+    };
+
+    static void BeginFrame();
+    static void EndFrame();
+    static void Display();
+    static void Toggle();
+
+    static void AddConsumer();
+    static void RemoveConsumer();
+
+    static float GetScopeTime(const char* name);
+    static void MergeScopeTotals(std::vector<ScopeTotal>& totals);
+    static const ScopeTotal* FindScopeTotal(const std::vector<ScopeTotal>& totals, const char* name);
+
+    static const std::vector<Event>& GetLatestFrameEvents();
+    // Advances with every frame added to the history, which stops while the profiler is paused.
+    static unsigned long GetFrameSequence();
+    static const char* GetThreadName(unsigned threadIndex);
+    static unsigned GetNumThreads();
+
+    static void SetCounter(const char* name, double value);
+    static const Counter* GetCounters(unsigned& numCounters);
+
+    static void SetThreadName(const char* threadName);
+    static const char* Intern(const std::string& name);
+    static std::uint64_t Now();
+
+    // Set on the main thread and read by every thread that opens a scope.
+    static std::atomic<bool> enabled;
+    static bool showWindow;
+
+private:
+    struct ThreadBuffer {
+        std::array<Event, profilerRingCapacity> events;
+        std::atomic<std::uint64_t> head;
+        std::atomic<std::uint64_t> tail;
+        std::atomic<std::uint64_t> dropped;
+        std::uint16_t depth;
+        std::uint16_t threadIndex;
+        const char* threadName;
+        // Cleared when the owning thread exits, after which the next thread to start profiling takes the buffer over.
+        std::atomic<bool> inUse;
+    };
+
+    struct ThreadBufferReleaser {
+        ~ThreadBufferReleaser();
+
+        ThreadBuffer* buffer = nullptr;
+    };
+
+    struct Frame {
+        std::uint64_t begin;
+        std::uint64_t end;
+        std::vector<Event> events;
+    };
+
+    static ThreadBuffer* GetThreadBuffer();
+    static void Record(ThreadBuffer* buffer, const Event& event);
+    static void Collect(Frame& frame);
+
+    static void DisplayTimeline();
+    static void DisplayFlameGraph(const Frame& frame);
+    static void DisplayScopeTotals(const Frame& frame);
+
+    static std::array<std::atomic<ThreadBuffer*>, profilerMaxThreads> threadBuffers;
+    static std::atomic<unsigned> numThreadBuffers;
+    static thread_local ThreadBuffer* threadBuffer;
+    static thread_local ThreadBufferReleaser threadBufferReleaser;
+
+    static unsigned numConsumers;
+    static std::array<Counter, profilerMaxCounters> counters;
+    static unsigned numCounters;
+    static std::vector<ScopeTotal> latestTotals;
+
+    static std::array<Frame, profilerHistoryFrames> frames;
+    static Frame discardedFrame;
+    static unsigned latestFrame;
+    static unsigned long frameSequence;
+    static int selectedFrameOffset;
+    static bool paused;
+    static std::uint64_t frameBegin;
+
+    static std::mutex internMutex;
+    static std::unordered_set<std::string> internedNames;
+};
+
+} // namespace model_viewer_3d
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+namespace model_viewer_3d {
+
+// Links each pair of shaders once and shares the program between every object built from it, so that loading or
+// generating thousands of objects does not compile thousands of identical programs. Programs are reference counted and
+// deleted when their last user releases them. Must only be used from the thread that owns the context.
+class ProgramCache final {
+public:
+    static GLuint Acquire(const std::string& vertexShader, const std::string& fragmentShader);
+    static void Release(GLuint program);
+    // A small index that stays the same for as long as the program is cached, for the sort key of RenderQueue.
+    static unsigned GetIndex(GLuint program);
+
+private:
+    struct Entry {
+        std::string vertexShader;
+        std::string fragmentShader;
+        GLuint program;
+        unsigned numUsers;
+    };
+
+    static std::vector<Entry> entries;
+};
+
+} // namespace model_viewer_3d
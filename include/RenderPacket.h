@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define GLM_SWIZZLE
+#include <glm/glm.hpp>
+#include <ImGUI/imgui.h>
+
+namespace model_viewer_3d {
+
+class Object;
+
+// Everything needed to draw one frame, built by the main thread and then only read by the render thread. Whatever an
+// object may change after Initialize() is copied into its item; the object itself is only used for the OpenGL objects
+// it created, must stay alive until RenderThread::WaitForIdle() returns, and is never written to while drawing.
+struct RenderPacket {
+    struct Item {
+        const Object* object;
+        const char* scopeName;
+        std::uint64_t sortKey;
+
+        glm::mat4 modelMatrix;
+        // Maps the unit cube onto the bounds of the item in object space.
+        glm::mat4 boundsTransform;
+        glm::vec4 ambientProduct;
+        glm::vec4 diffuseProduct;
+        glm::vec4 specularProduct;
+        float materialShininess;
+
+        unsigned firstBone;
+        unsigned numBones;
+
+        // Batched items are drawn together by StaticBatch::Draw() from the geometry it registered for the object.
+        int geometry;
+        bool batched;
+        // Whether the depth of the item was laid down by DepthPrepass::Draw(), which it then has to be shaded against.
+        bool depthPrepass;
+
+        bool wireframe;
+        bool animationEnabled;
+
+        bool uploadModelMatrix;
+    };
+
+    // Matches the std430 layout of LocalLight in Object.frag. Everything is in view space; the range is in the w of the
+    // position, and the cosines of the outer and inner cone angles in the w of the direction and the colour.
+    struct Light {
+        glm::vec4 position;
+        glm::vec4 direction;
+        glm::vec4 color;
+    };
+
+    // Filled by ShadowMap::Prepare(). The matrix maps view-space positions into the shadow map, and the region is the
+    // rectangle of the static layer, in texels, that has to be redrawn.
+    struct Shadow {
+        glm::mat4 viewMatrix;
+        glm::mat4 projectionMatrix;
+        glm::mat4 matrix;
+
+        bool enabled;
+        bool drawStatic;
+        bool drawDynamic;
+        glm::ivec4 staticRegion;
+        std::vector<std::uint32_t> staticCasters;
+        std::vector<std::uint32_t> dynamicCasters;
+    };
+
+    // Matches the per-instance attributes of BoundingBox.vert; the transform maps the unit cube onto the bounds.
+    struct BoundingBox {
+        glm::mat4 transform;
+        glm::vec4 color;
+    };
+
+    glm::mat4 viewMatrix;
+    glm::mat4 projectionMatrix;
+    glm::vec4 lightPosition;
+    float lightIntensity;
+
+    ImVec4 backgroundColor;
+    bool pathTracing;
+    bool depthPrepass;
+    // The size the scene is drawn at, as set by DynamicResolution::Prepare(). Equals the window size at full scale.
+    int renderWidth;
+    int renderHeight;
+
+    std::vector<Item> items;
+    // Indices into the items in the order they are drawn, as sorted by RenderQueue::Sort().
+    std::vector<std::uint32_t> drawOrder;
+    std::vector<glm::mat4> bonePalettes;
+    std::vector<BoundingBox> boundingBoxes;
+
+    // Filled by LightClusters::Assign(). Each cluster is an offset into the light indices and a count.
+    glm::uvec4 lightGridSize;
+    glm::vec4 lightGridParameters;
+    std::vector<Light> localLights;
+    std::vector<glm::uvec2> lightClusters;
+    std::vector<std::uint32_t> lightIndices;
+
+    Shadow shadow;
+
+    std::vector<std::unique_ptr<ImDrawList>> drawLists;
+    std::vector<ImDrawList*> drawListPointers;
+    ImDrawData drawData;
+};
+
+} // namespace model_viewer_3d
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "GeometryPool.h"
+#include "RenderPacket.h"
+
+namespace model_viewer_3d {
+
+// Widths of the sort key fields, from the most significant down: whether the item is drawn on its own, the program, as
+// its index in ProgramCache, the vertex format, which selects the vertex array and the skinning path of the program, the
+// polygon mode, the texture set and the depth.
+constexpr unsigned renderQueueProgramBits = 5;
+constexpr unsigned renderQueueFormatBits = 3;
+constexpr unsigned renderQueueTextureSetBits = 19;
+constexpr unsigned renderQueueDepthBits = 24;
+
+// Orders the items of a packet by a 64-bit key, so that items sharing pipeline state are drawn together and opaque
+// items of the same state are drawn front to back for early depth rejection. The keys are radix sorted on the main
+// thread before the packet is submitted; the render thread draws the items in the resulting order.
+class RenderQueue final {
+public:
+    // The depth is the view-space distance divided by the far clipping plane; anything outside [0, 1] is clamped.
+    static std::uint64_t MakeKey(bool batched, unsigned program, VertexFormat format, bool wireframe, unsigned textureSet,
+                                 float depth);
+    static void Sort(RenderPacket& packet);
+
+    static bool enabled;
+
+private:
+    struct Entry {
+        std::uint64_t key;
+        std::uint32_t item;
+    };
+
+    static void RadixSort();
+
+    static std::vector<Entry> entries;
+    static std::vector<Entry> scratch;
+};
+
+} // namespace model_viewer_3d
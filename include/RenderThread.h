@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "RenderPacket.h"
+
+#include <SDL2/SDL.h>
+#include <ImGUI/imgui.h>
+
+namespace model_viewer_3d {
+
+using RenderDrawListsFunction = void (*)(ImDrawData* drawData);
+
+// Owns the OpenGL context and draws the packet of frame N while the main thread builds the packet of frame N + 1.
+// With the thread disabled, packets are drawn and presented inline, through the same code path.
+class RenderThread final {
+public:
+    static void Initialize(SDL_Window* window, SDL_GLContext glContext);
+    static void CleanUp();
+
+    static RenderPacket& BeginPacket();
+    static void Submit();
+    static void Draw(RenderPacket& packet);
+
+    static void Execute(const std::function<void()>& task);
+    static void WaitForIdle();
+    static bool IsRunning();
+
+    static bool enabled;
+
+private:
+    static void Run();
+    static void WaitUntilIdle(std::unique_lock<std::mutex>& lock);
+    static void Present(RenderPacket& packet);
+    static void CaptureDrawLists(ImDrawData* drawData);
+
+    static SDL_Window* window;
+    static SDL_GLContext glContext;
+    static RenderDrawListsFunction renderDrawLists;
+
+    static std::array<RenderPacket, 2> packets;
+    static unsigned buildIndex;
+
+    static std::thread thread;
+    static std::mutex mutex;
+    static std::condition_variable workAvailable;
+    static std::condition_variable workFinished;
+    static RenderPacket* submittedPacket;
+    static const std::function<void()>* task;
+    static std::exception_ptr taskException;
+    static bool stopping;
+};
+
+} // namespace model_viewer_3d
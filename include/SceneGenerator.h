@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "PolygonMesh.h"
+#include "SyntheticMesh.h"
+
+namespace model_viewer_3d {
+
+constexpr int maxSyntheticObjects = 100000;
+constexpr int maxSyntheticTriangles = 20000000;
+
+class SceneGenerator final {
+public:
+    struct Settings {
+        int numObjects = 100;
+        int trianglesPerMesh = 20000;
+        float instancingRatio = 0.9f;
+        float skinnedRatio = 0.f;
+        int bonesPerSkeleton = 16;
+        bool spheres = true;
+        bool tori = true;
+        bool terrains = true;
+        int seed = 1;
+    };
+
+    // The unique meshes of a scene, one name each, before any object is made of them.
+    struct GeneratedScene {
+        Settings settings;
+        std::vector<std::shared_ptr<const SyntheticMesh>> meshes;
+        std::vector<std::string> names;
+        unsigned long uniqueTriangles = 0;
+    };
+
+    static std::shared_ptr<SyntheticMesh> GenerateSphere(unsigned numTriangles);
+    static std::shared_ptr<SyntheticMesh> GenerateTorus(unsigned numTriangles);
+    static std::shared_ptr<SyntheticMesh> GenerateTerrain(unsigned numTriangles, unsigned seed);
+    static void AttachSkeleton(SyntheticMesh& mesh, unsigned numBones, unsigned seed);
+
+    // Builds the meshes on the CPU only, so that it can run on a JobSystem worker.
+    static GeneratedScene GenerateMeshes(const Settings& settings);
+    // Replaces the previously generated objects with instances of the meshes and uploads them, on the thread that owns
+    // the context.
+    static void Instantiate(const GeneratedScene& scene, std::vector<PolygonMesh>& models);
+    // Both of the above, one after the other.
+    static void Generate(const Settings& settings, std::vector<PolygonMesh>& models);
+    static bool DisplayControls();
+
+    static Settings settings;
+
+private:
+    static void Finalize(SyntheticMesh& mesh);
+    static float Noise(float x, float z, unsigned seed);
+    static float TerrainHeight(float x, float z, unsigned seed);
+
+    static unsigned long lastUniqueTriangles;
+    static unsigned long lastDrawnTriangles;
+};
+
+} // namespace model_viewer_3d
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "RenderPacket.h"
+
+#define GLM_SWIZZLE
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+
+namespace model_viewer_3d {
+
+class Object;
+
+constexpr GLsizei shadowMapSize = 2048;
+constexpr GLuint shadowMapTextureUnit = 1;
+constexpr GLuint shadowMapUniformBlockBinding = 0;
+
+// Casts the shadows of Environment::light from a single perspective frustum fitted around the scene. The map is a
+// texture array with two cached layers: static casters are only redrawn inside the rectangle that the objects which
+// moved, appeared or disappeared covered before and after, and the whole layer only when the light moves or the scene
+// outgrows the frustum; animated casters have a layer of their own, which is only redrawn while one of them is in the
+// frustum. Frames in which nothing moved draw nothing. Object.frag takes the nearer occluder of the two layers.
+class ShadowMap final {
+public:
+    static void Initialize();
+    static void CleanUp();
+
+    // Points the sampler and the uniform block of a program built from Object.frag at the shadow map.
+    static void SetupProgram(GLuint program);
+    // Runs on the main thread once the items of the packet are known.
+    static void Prepare(RenderPacket& packet);
+    // Casters are identified by the address of their object, which moves when the list of loaded models is erased from
+    // or regenerated, so the whole map has to be redrawn afterwards. Runs on the main thread.
+    static void Invalidate();
+    // Runs on the render thread after StaticBatch::Update() and before anything in the scene is shaded.
+    static void Draw(const RenderPacket& packet);
+
+    static bool enabled;
+
+    static unsigned numStaticUpdates;
+    static unsigned numDynamicUpdates;
+    static float staticUpdateCoverage;
+
+private:
+    // Matches the std140 layout of ShadowBlock in Object.frag.
+    struct ShadowBlock {
+        glm::mat4 matrix;
+        glm::vec4 parameters;
+    };
+
+    // The region is the rectangle of the shadow map covered by the bounds, as minimum and maximum texture coordinates.
+    struct Caster {
+        glm::vec3 min;
+        glm::vec3 max;
+        glm::vec4 region;
+        std::uint64_t frame;
+        int geometry;
+        bool dynamic;
+        bool changed;
+    };
+
+    static bool FitFrustum(const glm::vec3& lightPosition, const glm::vec3& sceneMin, const glm::vec3& sceneMax);
+    static glm::vec4 GetRegion(const glm::mat4& lightMatrix, const glm::vec3& min, const glm::vec3& max);
+    static void DrawCasters(const RenderPacket& packet, const std::vector<std::uint32_t>& indices, bool skinned);
+
+    static GLuint texture;
+    static GLuint framebuffer;
+    static GLuint uniformBuffer;
+    static GLuint depthProgram;
+    static GLuint skinnedProgram;
+
+    static GLuint modelMatrixUniform;
+    static GLuint viewMatrixUniform;
+    static GLuint projectionMatrixUniform;
+    static GLuint skinnedModelMatrixUniform;
+    static GLuint skinnedViewMatrixUniform;
+    static GLuint skinnedProjectionMatrixUniform;
+    static GLuint bonesUniform;
+
+    static ShadowBlock uploadedBlock;
+
+    static std::unordered_map<const Object*, Caster> casters;
+    static std::vector<std::pair<std::uint32_t, Caster*>> frameCasters;
+    static std::uint64_t frame;
+    static bool valid;
+    static bool dynamicLayerEmpty;
+    static glm::vec3 lightPosition;
+    static glm::vec3 frustumCenter;
+    static float frustumRadius;
+    static glm::mat4 viewMatrix;
+    static glm::mat4 projectionMatrix;
+};
+
+} // namespace model_viewer_3d
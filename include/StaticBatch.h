@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "RenderPacket.h"
+
+#define GLM_SWIZZLE
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+
+namespace model_viewer_3d {
+
+class Object;
+
+// Draws every untextured, unanimated mesh with one glMultiDrawElementsIndirect call per polygon mode. The geometry comes
+// from the position and normal arena of GeometryPool, the per-object transforms and materials from a shader storage
+// buffer indexed by the base instance of each command, and the commands are only rebuilt when the set of batched
+// objects or the geometry changes. Requires OpenGL 4.3.
+class StaticBatch final {
+public:
+    static void Initialize();
+    static void CleanUp();
+
+    // Brings the commands and per-object data up to date; must run before either of the draws below.
+    static void Update(const RenderPacket& packet);
+    static void Draw(const RenderPacket& packet);
+    // Also used to render the static casters into the shadow map, from the point of view of the light.
+    static void DrawDepth(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
+
+    static bool supported;
+    static bool enabled;
+
+    static std::atomic<unsigned> numObjects;
+    static std::atomic<unsigned> numCommands;
+    static std::atomic<unsigned> numRebuilds;
+
+private:
+    // Matches the layout of DrawIndirectCommand in the OpenGL specification.
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    // Matches the std430 layout of DrawData in StaticObject.vert.
+    struct DrawData {
+        glm::mat4 modelMatrix;
+        glm::vec4 ambientProduct;
+        glm::vec4 diffuseProduct;
+        glm::vec4 specularProduct;
+        glm::vec4 shininess;
+    };
+
+    struct DrawKey {
+        const Object* object;
+        int geometry;
+        bool wireframe;
+
+        bool operator==(const DrawKey& other) const {
+            return object == other.object && geometry == other.geometry && wireframe == other.wireframe;
+        }
+    };
+
+    static void RebuildCommands(const RenderPacket& packet);
+    static void UpdateDrawData(const RenderPacket& packet, bool uploadAll);
+
+    static GLuint program;
+    static GLuint depthProgram;
+    static GLuint commandBuffer;
+    static GLuint drawDataBuffer;
+
+    static GLuint viewMatrixUniform;
+    static GLuint projectionMatrixUniform;
+    static GLuint lightPositionUniform;
+    static GLuint lightIntensityUniform;
+    static GLuint hasTexturesUniform;
+    static GLuint depthViewMatrixUniform;
+    static GLuint depthProjectionMatrixUniform;
+
+    static std::vector<DrawKey> drawKeys;
+    static std::vector<DrawCommand> commands;
+    static std::vector<DrawData> drawData;
+    static GLsizei numSolidCommands;
+    static unsigned geometryGeneration;
+};
+
+} // namespace model_viewer_3d
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define GLM_SWIZZLE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace model_viewer_3d {
+
+constexpr unsigned bonesPerVertex = 4;
+// The size of the shaders' bone array; a palette holds at most maxBones - 1 bones.
+constexpr unsigned maxBones = 100;
+
+struct BoneWeights {
+    std::int32_t ids[bonesPerVertex];
+    float weights[bonesPerVertex];
+};
+
+// The global transforms are scratch space owned by the caller, so that instances sharing the skeleton can be evaluated
+// concurrently.
+struct Skeleton {
+    void Evaluate(float time, std::vector<glm::mat4>& globalTransforms, std::vector<glm::mat4>& palette) const {
+        const auto numBones = parents.size();
+        globalTransforms.resize(numBones);
+        palette.resize(numBones);
+
+        for (std::size_t bone = 0; bone < numBones; ++bone) {
+            const auto angle = amplitudes[bone] * std::sin(frequencies[bone] * time + phases[bone]);
+            const auto localTransform = glm::rotate(glm::translate(glm::mat4(1.f), jointOffsets[bone]), angle, axes[bone]);
+            globalTransforms[bone] = parents[bone] < 0 ? localTransform : globalTransforms[parents[bone]] * localTransform;
+            palette[bone] = globalTransforms[bone] * inverseBindTransforms[bone];
+        }
+    }
+
+    std::vector<int> parents;
+    std::vector<glm::vec3> jointOffsets;
+    std::vector<glm::mat4> inverseBindTransforms;
+    std::vector<glm::vec3> axes;
+    std::vector<float> amplitudes;
+    std::vector<float> frequencies;
+    std::vector<float> phases;
+};
+
+struct SyntheticMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<unsigned int> indices;
+    std::vector<BoneWeights> boneWeights;
+    std::shared_ptr<const Skeleton> skeleton;
+
+    glm::vec3 min;
+    glm::vec3 max;
+
+    // The GeometryPool allocation is shared by every PolygonMesh instancing this mesh.
+    mutable int geometry = -1;
+    mutable unsigned numUsers = 0;
+};
+
+} // namespace model_viewer_3d
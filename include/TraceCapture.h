@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GPUProfiler.h"
+#include "Profiler.h"
+
+namespace model_viewer_3d {
+
+constexpr int defaultTraceCaptureFrames = 120;
+
+class TraceCapture final {
+public:
+    static void Start(int numFrames, const std::string& outputPath = "");
+    static void EndFrame();
+    static void DisplayControls();
+
+    static bool IsCapturing();
+
+    static int numFramesToCapture;
+
+private:
+    struct CounterSample {
+        const char* name;
+        std::uint64_t timestamp;
+        double value;
+    };
+
+    static void Finish();
+    static bool Write(const std::string& path);
+    static std::string GetDefaultOutputPath();
+
+    static bool capturing;
+    static int framesRemaining;
+    static int gpuFramesRemaining;
+    static std::string outputPath;
+    static std::string lastOutputPath;
+
+    static std::int64_t gpuClockOffset;
+    static unsigned long cpuFrameSequence;
+    static unsigned long gpuResultsSequence;
+    static std::uint64_t captureStart;
+
+    static std::vector<Profiler::Event> cpuEvents;
+    static std::vector<GPUProfiler::Timestamp> gpuEvents;
+    static std::vector<CounterSample> counterSamples;
+};
+
+} // namespace model_viewer_3d
@@ -5,14 +5,17 @@
 
 #define GLM_SWIZZLE
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
 #include <string>
 #include <thread>
+#include <vector>
 #include <cassert>
 
-namespace 3d_model_viewer {
+namespace model_viewer_3d {
 
 using Time = std::chrono::time_point<std::chrono::high_resolution_clock>;
 
@@ -35,6 +38,35 @@ struct Utilities final {
                                             std::pow(point1.z - point2.z, 2)));
     }
 
+    template <typename Point>
+    static void ComputeBounds(const std::vector<Point>& points, glm::vec3& min, glm::vec3& max) {
+        min = glm::vec3(points[0].x, points[0].y, points[0].z);
+        max = min;
+
+        const auto numPoints = points.size();
+        for (std::size_t i = 1; i < numPoints; ++i) {
+            const auto& point = points[i];
+
+            min.x = std::min(point.x, min.x);
+            max.x = std::max(point.x, max.x);
+            min.y = std::min(point.y, min.y);
+            max.y = std::max(point.y, max.y);
+            min.z = std::min(point.z, min.z);
+            max.z = std::max(point.z, max.z);
+        }
+    }
+
+    static glm::mat4 ComposeModelMatrix(const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scaling) {
+        const auto translationMatrix = glm::translate(glm::mat4(1.f), translation);
+        auto rotationMatrix = glm::mat4(1.f);
+        rotationMatrix = glm::rotate(rotationMatrix, rotation.x, glm::vec3(1.f, 0.f, 0.f));
+        rotationMatrix = glm::rotate(rotationMatrix, rotation.y, glm::vec3(0.f, 1.f, 0.f));
+        rotationMatrix = glm::rotate(rotationMatrix, rotation.z, glm::vec3(0.f, 0.f, 1.f));
+        const auto scaleMatrix = glm::scale(glm::mat4(.2f), scaling);
+
+        return scaleMatrix * rotationMatrix * translationMatrix;
+    }
+
     static float DurationToFloat(const std::chrono::duration<float>& durationInNanoseconds) {
         return durationInNanoseconds.count();
     }
@@ -44,4 +76,4 @@ struct Utilities final {
     }
 };
 
-} // namespace 3d_model_viewer
+} // namespace model_viewer_3d
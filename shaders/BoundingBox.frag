@@ -3,9 +3,9 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright (c) 2017 Vangelis Tsiatsianas
 
-out vec4 color;
+flat in vec4 boundingBoxColor;
 
-uniform vec4 boundingBoxColor;
+out vec4 color;
 
 void main() {
     color = boundingBoxColor;
@@ -1,15 +1,18 @@
-#version 150 core
+#version 330 core
 
 // SPDX-License-Identifier: MPL-2.0
 // Copyright (c) 2017 Vangelis Tsiatsianas
 
-in vec3 vPosition;
+layout(location = 0) in vec3 vPosition;
+layout(location = 6) in mat4 boundingBoxTransform;
+layout(location = 10) in vec4 vBoundingBoxColor;
+
+flat out vec4 boundingBoxColor;
 
-uniform mat4 modelMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
-uniform mat4 boundingBoxTransform;
 
 void main() {
-    gl_Position = projectionMatrix * viewMatrix * modelMatrix * boundingBoxTransform * vec4(vPosition, 1.0);
+    boundingBoxColor = vBoundingBoxColor;
+    gl_Position = projectionMatrix * viewMatrix * boundingBoxTransform * vec4(vPosition, 1.0);
 }
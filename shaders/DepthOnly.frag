@@ -0,0 +1,7 @@
+#version 150 core
+
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+void main() {
+}
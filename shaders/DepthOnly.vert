@@ -0,0 +1,17 @@
+#version 330 core
+
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+layout(location = 0) in vec3 vPosition;
+
+// Computed exactly as in Object.vert, so that the shading pass can test against the pre-pass depth with GL_EQUAL.
+invariant gl_Position;
+
+uniform mat4 modelMatrix;
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+
+void main() {
+    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(vPosition, 1.0);
+}
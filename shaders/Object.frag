@@ -1,4 +1,6 @@
 #version 150 core
+#extension GL_ARB_shader_storage_buffer_object : enable
+#extension GL_ARB_shading_language_420pack : enable
 
 // SPDX-License-Identifier: MPL-2.0
 // Copyright (c) 2017 Vangelis Tsiatsianas
@@ -7,40 +9,136 @@ in vec3 worldPosition;
 in vec3 worldEye;
 in vec3 worldNormal;
 in vec2 texCoord;
+in vec3 viewPosition;
+in vec3 viewNormal;
+
+in Material {
+    flat vec4 ambientProduct;
+    flat vec4 diffuseProduct;
+    flat vec4 specularProduct;
+    flat float shininess;
+} material;
 
 out vec4 fragColor;
 
-uniform vec4 ambientProduct;
-uniform vec4 diffuseProduct;
-uniform vec4 specularProduct;
 uniform vec4 lightPosition;
-
 uniform float lightIntensity;
-uniform float materialShininess;
 
 uniform sampler2D tex;
 uniform uint hasTextures;
 
+// Maps view-space positions into the shadow map of the light; see ShadowMap.
+uniform sampler2DArrayShadow shadowMap;
+
+layout(std140) uniform ShadowBlock {
+    mat4 shadowMatrix;
+    vec4 shadowParameters;
+};
+
+// Static and dynamic casters are cached in separate layers, so a fragment is only lit if neither occludes it.
+float GetShadowVisibility() {
+    if (shadowParameters.x == 0.0) {
+        return 1.0;
+    }
+
+    vec4 position = shadowMatrix * vec4(viewPosition, 1.0);
+    if (position.w <= 0.0) {
+        return 1.0;
+    }
+
+    position.xyz /= position.w;
+    if (any(lessThan(position.xyz, vec3(0.0))) || any(greaterThan(position.xyz, vec3(1.0)))) {
+        return 1.0;
+    }
+
+    float depth = position.z - shadowParameters.y;
+    return min(texture(shadowMap, vec4(position.xy, 0.0, depth)), texture(shadowMap, vec4(position.xy, 1.0, depth)));
+}
+
+// The local lights are only shaded where shader storage buffers are available; see LightClusters.
+#ifdef GL_ARB_shader_storage_buffer_object
+struct LocalLight {
+    vec4 position;
+    vec4 direction;
+    vec4 color;
+};
+
+layout(std430, binding = 1) readonly buffer LightBuffer {
+    uvec4 lightGridSize;
+    vec4 lightGridParameters;
+    LocalLight lights[];
+};
+
+layout(std430, binding = 2) readonly buffer LightClusterBuffer {
+    uvec2 lightClusters[];
+};
+
+layout(std430, binding = 3) readonly buffer LightIndexBuffer {
+    uint lightIndices[];
+};
+
+vec4 ShadeLocalLights(vec3 normal) {
+    vec4 color = vec4(0.0);
+    if (lightGridSize.w == uint(0)) {
+        return color;
+    }
+
+    // The tile comes from the window position and the slice from the logarithm of the depth, as in LightClusters.
+    float slice = floor(log(-viewPosition.z) * lightGridParameters.z + lightGridParameters.w);
+    uvec3 cluster = uvec3(clamp(vec3(floor(gl_FragCoord.xy * lightGridParameters.xy), slice), vec3(0.0),
+                                vec3(lightGridSize.xyz) - 1.0));
+    uvec2 range = lightClusters[(cluster.z * lightGridSize.y + cluster.y) * lightGridSize.x + cluster.x];
+
+    vec3 eye = normalize(-viewPosition);
+    for (uint i = range.x; i < range.x + range.y; ++i) {
+        LocalLight light = lights[lightIndices[i]];
+
+        vec3 toLight = light.position.xyz - viewPosition;
+        float distanceSquared = dot(toLight, toLight);
+        float rangeSquared = light.position.w * light.position.w;
+        if (distanceSquared >= rangeSquared) {
+            continue;
+        }
+
+        vec3 direction = toLight * inversesqrt(distanceSquared);
+        float falloff = 1.0 - (distanceSquared * distanceSquared) / (rangeSquared * rangeSquared);
+        float attenuation = falloff * falloff / (distanceSquared + 1.0);
+        attenuation *= smoothstep(light.direction.w, light.color.w, dot(-direction, light.direction.xyz));
+
+        float kd = max(dot(direction, normal), 0.0);
+        float ks = kd > 0.0 ? pow(max(dot(normal, normalize(direction + eye)), 0.0), material.shininess) : 0.0;
+        color += attenuation * vec4(light.color.rgb, 0.0) * (kd * material.diffuseProduct + ks * material.specularProduct);
+    }
+
+    return color;
+}
+#else
+vec4 ShadeLocalLights(vec3 normal) {
+    return vec4(0.0);
+}
+#endif
+
 void main() {
     vec3 normal = normalize(worldNormal);
     vec3 eye = normalize(worldEye);
     vec3 light = normalize(vec3(lightPosition) - worldPosition);
     vec3 halfway = normalize(light + eye);
 
-    vec4 ambient = ambientProduct;
+    vec4 ambient = material.ambientProduct;
 
     float kd = max(dot(light, normal), 0.0);
-    vec4 diffuse = kd * diffuseProduct;
+    vec4 diffuse = kd * material.diffuseProduct;
 
-    float ks = pow(max(dot(normal, halfway), 0.0), materialShininess);
+    float ks = pow(max(dot(normal, halfway), 0.0), material.shininess);
     vec4 specular;
     if (dot(light, normal) < 0.0) {
         specular = vec4(0.0, 0.0, 0.0, 1.0);
     } else {
-        specular = ks * specularProduct;
+        specular = ks * material.specularProduct;
     }
 
-    fragColor = ambient + (lightIntensity / 100) * (diffuse + specular);
+    fragColor = ambient + GetShadowVisibility() * (lightIntensity / 100) * (diffuse + specular) +
+                ShadeLocalLights(normalize(viewNormal));
     fragColor.a = 1.0;
 
     if (hasTextures != uint(0)) {
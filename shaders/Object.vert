@@ -1,18 +1,30 @@
-#version 150 core
+#version 330 core
 
 // SPDX-License-Identifier: MPL-2.0
 // Copyright (c) 2017 Vangelis Tsiatsianas
 
-in vec3 vPosition;
-in vec3 vNormal;
-in vec2 vTexCoord;
-in ivec4 boneIDs;
-in vec4 weights;
+// Locations match the vertex array objects of GeometryPool.
+layout(location = 0) in vec3 vPosition;
+layout(location = 1) in vec3 vNormal;
+layout(location = 2) in vec2 vTexCoord;
+layout(location = 3) in ivec4 boneIDs;
+layout(location = 4) in vec4 weights;
+
+invariant gl_Position;
 
 out vec3 worldPosition;
 out vec3 worldEye;
 out vec3 worldNormal;
 out vec2 texCoord;
+out vec3 viewPosition;
+out vec3 viewNormal;
+
+out Material {
+    flat vec4 ambientProduct;
+    flat vec4 diffuseProduct;
+    flat vec4 specularProduct;
+    flat float shininess;
+} material;
 
 uniform mat4 modelMatrix;
 uniform mat4 viewMatrix;
@@ -22,6 +34,11 @@ const int MAX_BONES = 100;
 uniform mat4 bones[MAX_BONES];
 uniform uint vAnimationEnabled;
 
+uniform vec4 ambientProduct;
+uniform vec4 diffuseProduct;
+uniform vec4 specularProduct;
+uniform float materialShininess;
+
 void main() {
     if (vAnimationEnabled != uint(0)) {
         mat4 boneTransform = bones[boneIDs[0]] * weights[0];
@@ -32,6 +49,7 @@ void main() {
         worldPosition = (modelMatrix * boneTransform * vec4(vPosition, 1.0)).xyz;
         worldNormal = (modelMatrix * boneTransform * vec4(vNormal, 0.0)).xyz;
 
+        viewPosition = (viewMatrix * modelMatrix * boneTransform * vec4(vPosition, 1.0)).xyz;
         gl_Position = projectionMatrix * viewMatrix * modelMatrix * boneTransform * vec4(vPosition, 1.0);
     } else {
         mat3 modelMatrixMat3 = mat3(modelMatrix);
@@ -39,9 +57,16 @@ void main() {
         worldPosition = modelMatrixMat3 * vPosition;
         worldNormal = modelMatrixMat3 * vNormal;
 
+        viewPosition = (viewMatrix * modelMatrix * vec4(vPosition, 1.0)).xyz;
         gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(vPosition, 1.0);
     }
 
     worldEye = worldPosition;
+    viewNormal = mat3(viewMatrix) * worldNormal;
     texCoord = vTexCoord;
+
+    material.ambientProduct = ambientProduct;
+    material.diffuseProduct = diffuseProduct;
+    material.specularProduct = specularProduct;
+    material.shininess = materialShininess;
 }
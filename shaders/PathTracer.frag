@@ -0,0 +1,14 @@
+#version 150 core
+
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+in vec2 texCoord;
+
+out vec4 color;
+
+uniform sampler2D image;
+
+void main() {
+    color = vec4(texture(image, texCoord).rgb, 1.0);
+}
@@ -0,0 +1,13 @@
+#version 150 core
+
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+out vec2 texCoord;
+
+void main() {
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+
+    texCoord = vec2(position.x, 1.0 - position.y);
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
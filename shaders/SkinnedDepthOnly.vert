@@ -0,0 +1,25 @@
+#version 330 core
+
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+// Locations match the vertex array objects of GeometryPool.
+layout(location = 0) in vec3 vPosition;
+layout(location = 3) in ivec4 boneIDs;
+layout(location = 4) in vec4 weights;
+
+uniform mat4 modelMatrix;
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+
+const int MAX_BONES = 100;
+uniform mat4 bones[MAX_BONES];
+
+void main() {
+    mat4 boneTransform = bones[boneIDs[0]] * weights[0];
+    boneTransform += bones[boneIDs[1]] * weights[1];
+    boneTransform += bones[boneIDs[2]] * weights[2];
+    boneTransform += bones[boneIDs[3]] * weights[3];
+
+    gl_Position = projectionMatrix * viewMatrix * modelMatrix * boneTransform * vec4(vPosition, 1.0);
+}
@@ -0,0 +1,29 @@
+#version 430 core
+
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+layout(location = 0) in vec3 vPosition;
+layout(location = 5) in uint drawID;
+
+// Computed exactly as in StaticObject.vert, so that the shading pass can test against the pre-pass depth with GL_EQUAL.
+invariant gl_Position;
+
+struct DrawData {
+    mat4 modelMatrix;
+    vec4 ambientProduct;
+    vec4 diffuseProduct;
+    vec4 specularProduct;
+    vec4 shininess;
+};
+
+layout(std430, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData drawData[];
+};
+
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+
+void main() {
+    gl_Position = projectionMatrix * viewMatrix * drawData[drawID].modelMatrix * vec4(vPosition, 1.0);
+}
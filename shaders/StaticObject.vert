@@ -0,0 +1,59 @@
+#version 430 core
+
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+layout(location = 0) in vec3 vPosition;
+layout(location = 1) in vec3 vNormal;
+layout(location = 5) in uint drawID;
+
+invariant gl_Position;
+
+out vec3 worldPosition;
+out vec3 worldEye;
+out vec3 worldNormal;
+out vec2 texCoord;
+out vec3 viewPosition;
+out vec3 viewNormal;
+
+out Material {
+    flat vec4 ambientProduct;
+    flat vec4 diffuseProduct;
+    flat vec4 specularProduct;
+    flat float shininess;
+} material;
+
+struct DrawData {
+    mat4 modelMatrix;
+    vec4 ambientProduct;
+    vec4 diffuseProduct;
+    vec4 specularProduct;
+    vec4 shininess;
+};
+
+// One entry per batched object; drawID comes from the base instance of each indirect command.
+layout(std430, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData drawData[];
+};
+
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+
+void main() {
+    DrawData data = drawData[drawID];
+    mat3 modelMatrixMat3 = mat3(data.modelMatrix);
+
+    worldPosition = modelMatrixMat3 * vPosition;
+    worldNormal = modelMatrixMat3 * vNormal;
+    worldEye = worldPosition;
+    texCoord = vec2(0.0);
+    viewPosition = (viewMatrix * data.modelMatrix * vec4(vPosition, 1.0)).xyz;
+    viewNormal = mat3(viewMatrix) * worldNormal;
+
+    gl_Position = projectionMatrix * viewMatrix * data.modelMatrix * vec4(vPosition, 1.0);
+
+    material.ambientProduct = data.ambientProduct;
+    material.diffuseProduct = data.diffuseProduct;
+    material.specularProduct = data.specularProduct;
+    material.shininess = data.shininess.x;
+}
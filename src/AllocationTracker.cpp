@@ -0,0 +1,461 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "AllocationTracker.h"
+#include "Profiler.h"
+
+#include <ImGUI/imgui.h>
+
+#ifdef ALLOCATION_TRACKING
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#endif
+
+namespace model_viewer_3d {
+
+std::atomic<bool> AllocationTracker::enabled(false);
+std::atomic<bool> AllocationTracker::captureCallStacks(true);
+
+std::atomic<std::uint64_t> AllocationTracker::frameAllocations(0);
+std::atomic<std::uint64_t> AllocationTracker::frameBytes(0);
+std::atomic<std::uint64_t> AllocationTracker::totalAllocations(0);
+std::atomic<std::uint64_t> AllocationTracker::totalBytes(0);
+std::atomic<std::uint64_t> AllocationTracker::totalFrees(0);
+AllocationTracker::Counts AllocationTracker::latestFrame = {};
+AllocationTracker::Counts AllocationTracker::worstFrame = {};
+unsigned long AllocationTracker::steadyFrames = 0;
+
+thread_local AllocationTracker::Counts AllocationTracker::threadCounts = {};
+thread_local const char* AllocationTracker::currentScope = nullptr;
+thread_local bool AllocationTracker::recording = false;
+
+std::array<AllocationTracker::CallSite, allocationTrackerMaxCallSites> AllocationTracker::callSites;
+std::array<unsigned, allocationTrackerMaxCallSites> AllocationTracker::sortedCallSites;
+unsigned AllocationTracker::numCallSites = 0;
+unsigned AllocationTracker::numSortedCallSites = 0;
+std::atomic<unsigned long> AllocationTracker::droppedCallSites(0);
+std::atomic_flag AllocationTracker::callSitesLock = ATOMIC_FLAG_INIT;
+
+std::array<float, allocationTrackerHistoryFrames> AllocationTracker::history;
+unsigned AllocationTracker::historyOffset = 0;
+
+void AllocationTracker::EndFrame() {
+    if (!IsAvailable()) {
+        return;
+    }
+
+    latestFrame = { frameAllocations.exchange(0, std::memory_order_relaxed),
+                    frameBytes.exchange(0, std::memory_order_relaxed) };
+    if (latestFrame.allocations > worstFrame.allocations) {
+        worstFrame = latestFrame;
+    }
+    steadyFrames = latestFrame.allocations ? 0 : steadyFrames + 1;
+
+    history[historyOffset] = static_cast<float>(latestFrame.allocations);
+    historyOffset = (historyOffset + 1) % allocationTrackerHistoryFrames;
+
+    while (callSitesLock.test_and_set(std::memory_order_acquire)) {
+    }
+    numSortedCallSites = 0;
+    for (unsigned i = 0; i < allocationTrackerMaxCallSites; ++i) {
+        auto& callSite = callSites[i];
+        callSite.latest = callSite.frame;
+        callSite.total.allocations += callSite.frame.allocations;
+        callSite.total.bytes += callSite.frame.bytes;
+        callSite.frame = {};
+        if (callSite.latest.allocations) {
+            sortedCallSites[numSortedCallSites++] = i;
+        }
+    }
+    callSitesLock.clear(std::memory_order_release);
+
+    std::sort(sortedCallSites.begin(), sortedCallSites.begin() + numSortedCallSites, [](unsigned lhs, unsigned rhs) {
+        return callSites[lhs].latest.allocations > callSites[rhs].latest.allocations;
+    });
+
+    Profiler::SetCounter("Heap Allocations", static_cast<double>(latestFrame.allocations));
+    Profiler::SetCounter("Heap Allocated (KiB)", latestFrame.bytes / 1024.0);
+}
+
+void AllocationTracker::Reset() {
+    while (callSitesLock.test_and_set(std::memory_order_acquire)) {
+    }
+    for (auto& callSite : callSites) {
+        callSite = {};
+    }
+    numCallSites = 0;
+    numSortedCallSites = 0;
+    droppedCallSites = 0;
+    callSitesLock.clear(std::memory_order_release);
+
+    worstFrame = {};
+    steadyFrames = 0;
+    history.fill(0.f);
+}
+
+void AllocationTracker::DisplayControls() {
+    if (!ImGui::CollapsingHeader("Heap Allocations")) {
+        return;
+    }
+
+    if (!IsAvailable()) {
+        ImGui::TextWrapped("Allocation tracking is disabled. Configure with -DALLOCATION_TRACKING=ON to enable it.");
+        return;
+    }
+
+    const auto totals = GetTotalCounts();
+    const auto frees = totalFrees.load(std::memory_order_relaxed);
+    ImGui::Text("Last Frame: %llu allocations (%.2f KiB)", static_cast<unsigned long long>(latestFrame.allocations),
+                latestFrame.bytes / 1024.f);
+    ImGui::Text("Worst Frame: %llu allocations (%.2f KiB)", static_cast<unsigned long long>(worstFrame.allocations),
+                worstFrame.bytes / 1024.f);
+    ImGui::Text("Total: %llu allocations, %llu frees (%.2f MiB allocated)",
+                static_cast<unsigned long long>(totals.allocations), static_cast<unsigned long long>(frees),
+                totals.bytes / (1024.f * 1024.f));
+
+    const auto steadyColor = steadyFrames ? ImVec4(0.4f, 1.0f, 0.4f, 1.0f) : ImVec4(1.0f, 0.4f, 0.4f, 1.0f);
+    ImGui::TextColored(steadyColor, "Allocation-free for %lu frames", steadyFrames);
+
+    ImGui::PlotHistogram("##Allocation History", history.data(), static_cast<int>(history.size()),
+                         static_cast<int>(historyOffset), "Allocations per Frame", 0.f, FLT_MAX, ImVec2(0, 60));
+
+    auto trackCallSites = enabled.load();
+    if (ImGui::Checkbox("Track Call Sites" "##Allocations", &trackCallSites)) {
+        enabled = trackCallSites;
+    }
+    ImGui::SameLine();
+    auto capture = captureCallStacks.load();
+    if (ImGui::Checkbox("Capture Call Stacks" "##Allocations", &capture)) {
+        captureCallStacks = capture;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Reset" "##Allocations")) {
+        Reset();
+    }
+
+    DisplayCallSites();
+}
+
+bool AllocationTracker::IsAvailable() {
+#ifdef ALLOCATION_TRACKING
+    return true;
+#else
+    return false;
+#endif
+}
+
+AllocationTracker::Counts AllocationTracker::GetThreadCounts() {
+    return threadCounts;
+}
+
+AllocationTracker::Counts AllocationTracker::GetFrameCounts() {
+    return latestFrame;
+}
+
+AllocationTracker::Counts AllocationTracker::GetTotalCounts() {
+    return { totalAllocations.load(std::memory_order_relaxed), totalBytes.load(std::memory_order_relaxed) };
+}
+
+// Profiler scopes are entered even while the profiler is disabled, so allocations are always attributed to the
+// innermost enclosing scope.
+const char* AllocationTracker::EnterScope(const char* name) {
+    const auto* parentScope = currentScope;
+    currentScope = name;
+    return parentScope;
+}
+
+void AllocationTracker::LeaveScope(const char* parentScope) {
+    currentScope = parentScope;
+}
+
+void AllocationTracker::RecordAllocation(std::size_t size) {
+    ++threadCounts.allocations;
+    threadCounts.bytes += size;
+    frameAllocations.fetch_add(1, std::memory_order_relaxed);
+    frameBytes.fetch_add(size, std::memory_order_relaxed);
+    totalAllocations.fetch_add(1, std::memory_order_relaxed);
+    totalBytes.fetch_add(size, std::memory_order_relaxed);
+
+    // The unwinder may allocate the first time it runs, which must not recurse into the call site table.
+    if (!enabled.load(std::memory_order_relaxed) || recording) {
+        return;
+    }
+    recording = true;
+
+    void* stack[allocationTrackerStackDepth];
+    auto stackDepth = 0;
+#ifdef ALLOCATION_TRACKING
+    if (captureCallStacks.load(std::memory_order_relaxed)) {
+        stackDepth = backtrace(stack, static_cast<int>(allocationTrackerStackDepth));
+    }
+#endif
+
+    while (callSitesLock.test_and_set(std::memory_order_acquire)) {
+    }
+    auto* callSite = FindCallSite(stack, static_cast<unsigned>(std::max(stackDepth, 0)), currentScope);
+    if (callSite) {
+        ++callSite->frame.allocations;
+        callSite->frame.bytes += size;
+    }
+    callSitesLock.clear(std::memory_order_release);
+
+    recording = false;
+}
+
+void AllocationTracker::RecordFree() {
+    totalFrees.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Open addressing over a fixed table, since the tracker runs inside operator new and must never allocate itself.
+AllocationTracker::CallSite* AllocationTracker::FindCallSite(void* const* stack, unsigned stackDepth, const char* scope) {
+    auto hash = static_cast<std::uint64_t>(14695981039346656037ull);
+    const auto combine = [&hash](std::uintptr_t value) {
+        hash = (hash ^ value) * 1099511628211ull;
+    };
+    combine(reinterpret_cast<std::uintptr_t>(scope));
+    for (unsigned frame = 0; frame < stackDepth; ++frame) {
+        combine(reinterpret_cast<std::uintptr_t>(stack[frame]));
+    }
+    hash |= 1;
+
+    for (unsigned probe = 0; probe < allocationTrackerMaxCallSites; ++probe) {
+        auto& callSite = callSites[(hash + probe) % allocationTrackerMaxCallSites];
+        if (callSite.hash == hash && callSite.scope == scope && callSite.stackDepth == stackDepth &&
+            std::equal(stack, stack + stackDepth, callSite.stack)) {
+            return &callSite;
+        }
+
+        if (!callSite.hash) {
+            if (numCallSites + 1 >= allocationTrackerMaxCallSites) {
+                break;
+            }
+
+            std::copy(stack, stack + stackDepth, callSite.stack);
+            callSite.stackDepth = stackDepth;
+            callSite.scope = scope;
+            callSite.hash = hash;
+            ++numCallSites;
+            return &callSite;
+        }
+    }
+
+    droppedCallSites.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+// Names the first frame outside operator new and the standard library, which is where the allocation was requested.
+const char* AllocationTracker::Describe(CallSite& callSite) {
+    if (callSite.described) {
+        return callSite.description;
+    }
+
+    std::snprintf(callSite.description, allocationTrackerDescriptionLength, "%s",
+                  callSite.stackDepth ? "(standard library)" : "(call stacks disabled)");
+    for (unsigned frame = 0; frame < callSite.stackDepth; ++frame) {
+        char symbol[allocationTrackerDescriptionLength];
+        Symbolize(callSite.stack[frame], symbol, sizeof(symbol));
+        if (!IsAllocatorFrame(symbol)) {
+            std::snprintf(callSite.description, allocationTrackerDescriptionLength, "%s", symbol);
+            break;
+        }
+    }
+
+    callSite.described = true;
+    return callSite.description;
+}
+
+void AllocationTracker::Symbolize(void* address, char* buffer, std::size_t size) {
+#ifdef ALLOCATION_TRACKING
+    Dl_info info;
+    if (dladdr(address, &info) && info.dli_sname) {
+        auto status = 0;
+        auto* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::snprintf(buffer, size, "%s+0x%lx", status == 0 && demangled ? demangled : info.dli_sname,
+                      static_cast<unsigned long>(static_cast<char*>(address) - static_cast<char*>(info.dli_saddr)));
+        std::free(demangled);
+        return;
+    }
+#endif
+    std::snprintf(buffer, size, "%p", address);
+}
+
+bool AllocationTracker::IsAllocatorFrame(const char* symbol) {
+    const char* const allocatorPrefixes[] = { "operator new", "std::", "__gnu_cxx::", "AllocationTracker::",
+                                              "model_viewer_3d::AllocationTracker::" };
+
+    // Template instantiations are demangled with their return type first, e.g. "void std::vector<...>::...".
+    const auto* name = std::strchr(symbol, ' ');
+    const auto* arguments = std::strpbrk(symbol, "(<");
+    name = name && (!arguments || name < arguments) ? name + 1 : symbol;
+
+    for (const auto* prefix : allocatorPrefixes) {
+        if (!std::strncmp(symbol, prefix, std::strlen(prefix)) || !std::strncmp(name, prefix, std::strlen(prefix))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void AllocationTracker::DisplayCallSites() {
+    ImGui::Columns(4, "##Allocation Call Sites");
+    ImGui::Text("Call Site");
+    ImGui::NextColumn();
+    ImGui::Text("Scope");
+    ImGui::NextColumn();
+    ImGui::Text("Allocations");
+    ImGui::NextColumn();
+    ImGui::Text("KiB");
+    ImGui::NextColumn();
+    ImGui::Separator();
+
+    const auto numDisplayed = std::min(numSortedCallSites, allocationTrackerDisplayedCallSites);
+    for (unsigned i = 0; i < numDisplayed; ++i) {
+        auto& callSite = callSites[sortedCallSites[i]];
+        ImGui::Text("%s", Describe(callSite));
+        if (ImGui::IsItemHovered() && callSite.stackDepth) {
+            ImGui::BeginTooltip();
+            for (unsigned frame = 0; frame < callSite.stackDepth; ++frame) {
+                char symbol[allocationTrackerDescriptionLength];
+                Symbolize(callSite.stack[frame], symbol, sizeof(symbol));
+                ImGui::Text("%s", symbol);
+            }
+            ImGui::EndTooltip();
+        }
+        ImGui::NextColumn();
+        ImGui::Text("%s", callSite.scope ? callSite.scope : "-");
+        ImGui::NextColumn();
+        ImGui::Text("%llu", static_cast<unsigned long long>(callSite.latest.allocations));
+        ImGui::NextColumn();
+        ImGui::Text("%.2f", callSite.latest.bytes / 1024.f);
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+
+    if (numSortedCallSites > numDisplayed) {
+        ImGui::Text("%u more call sites", numSortedCallSites - numDisplayed);
+    }
+    if (droppedCallSites) {
+        ImGui::Text("%lu allocations not attributed (call site table full)", droppedCallSites.load());
+    }
+}
+
+} // namespace model_viewer_3d
+
+#ifdef ALLOCATION_TRACKING
+
+using model_viewer_3d::AllocationTracker;
+
+void* operator new(std::size_t size) {
+    auto* pointer = std::malloc(size ? size : 1);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    AllocationTracker::RecordAllocation(size);
+    return pointer;
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    auto* pointer = std::malloc(size ? size : 1);
+    if (pointer) {
+        AllocationTracker::RecordAllocation(size);
+    }
+    return pointer;
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+// Aligned allocations round the size up to a multiple of the alignment, as std::aligned_alloc requires.
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    const auto alignmentBytes = static_cast<std::size_t>(alignment);
+    const auto alignedSize = (std::max<std::size_t>(size, 1) + alignmentBytes - 1) / alignmentBytes * alignmentBytes;
+    auto* pointer = std::aligned_alloc(alignmentBytes, alignedSize);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    AllocationTracker::RecordAllocation(size);
+    return pointer;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size, alignment);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t& tag) noexcept {
+    return operator new(size, alignment, tag);
+}
+
+void operator delete(void* pointer) noexcept {
+    if (pointer) {
+        AllocationTracker::RecordFree();
+        std::free(pointer);
+    }
+}
+
+void operator delete[](void* pointer) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    operator delete(pointer);
+}
+
+// Memory from std::aligned_alloc is released with std::free as well.
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+    operator delete(pointer);
+}
+
+#endif
@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <cstddef>
+#include <cstring>
+
+#include "BoundingBoxOverlay.h"
+#include "Common.h"
+#include "GLState.h"
+#include "GPUProfiler.h"
+#include "GeometryPool.h"
+
+#define GLM_SWIZZLE
+#include <glm/gtc/type_ptr.hpp>
+#include <glGA/glGAHelper.h>
+
+namespace model_viewer_3d {
+
+const std::string boundingBoxOverlayShadersDirectory = std::string(rootDirectory) + "shaders/";
+
+std::atomic<unsigned> BoundingBoxOverlay::numBoxes(0);
+
+GLuint BoundingBoxOverlay::program = 0;
+GLuint BoundingBoxOverlay::vertexArray = 0;
+GLuint BoundingBoxOverlay::instanceBuffer = 0;
+GLsizeiptr BoundingBoxOverlay::instanceCapacity = 0;
+
+GLuint BoundingBoxOverlay::viewMatrixUniform;
+GLuint BoundingBoxOverlay::projectionMatrixUniform;
+
+std::vector<RenderPacket::BoundingBox> BoundingBoxOverlay::instances;
+unsigned BoundingBoxOverlay::geometryGeneration = 0;
+
+void BoundingBoxOverlay::Initialize() {
+    const auto vertexShader = boundingBoxOverlayShadersDirectory + "BoundingBox.vert";
+    const auto fragmentShader = boundingBoxOverlayShadersDirectory + "BoundingBox.frag";
+    program = LoadShaders(vertexShader.c_str(), fragmentShader.c_str());
+
+    SETUP_UNIFORM(viewMatrix);
+    SETUP_UNIFORM(projectionMatrix);
+
+    instanceCapacity = boundingBoxOverlayInitialCapacity;
+    glGenBuffers(1, &instanceBuffer);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(RenderPacket::BoundingBox), nullptr, GL_DYNAMIC_DRAW);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenVertexArrays(1, &vertexArray);
+    SetupVertexArray();
+}
+
+void BoundingBoxOverlay::CleanUp() {
+    GLState::DeleteVertexArrays(1, &vertexArray);
+    GLState::DeleteBuffers(1, &instanceBuffer);
+    glDeleteProgram(program);
+
+    instances.clear();
+    instanceCapacity = 0;
+    numBoxes = 0;
+}
+
+// Runs on the render thread after the scene, so that the boxes are depth tested against every object.
+void BoundingBoxOverlay::Draw(const RenderPacket& packet) {
+    numBoxes = static_cast<unsigned>(packet.boundingBoxes.size());
+    if (packet.boundingBoxes.empty()) {
+        return;
+    }
+
+    PROFILE_GPU_SCOPE("BoundingBoxOverlay::Draw");
+
+    if (geometryGeneration != GeometryPool::GetGeneration()) {
+        SetupVertexArray();
+    }
+    UploadInstances(packet);
+
+    GLState::UseProgram(program);
+    GLState::BindVertexArray(vertexArray);
+
+    glUniformMatrix4fv(viewMatrixUniform, 1, GL_FALSE, glm::value_ptr(packet.viewMatrix));
+    glUniformMatrix4fv(projectionMatrixUniform, 1, GL_FALSE, glm::value_ptr(packet.projectionMatrix));
+
+    const auto& edges = GeometryPool::GetGeometry(GeometryPool::GetUnitCube()).submeshes.front();
+    glDrawElementsInstancedBaseVertex(GL_LINES, static_cast<GLsizei>(edges.numIndices), GL_UNSIGNED_INT,
+                                      BUFFER_OFFSET(edges.firstIndex * sizeof(GLuint)),
+                                      static_cast<GLsizei>(packet.boundingBoxes.size()), edges.baseVertex);
+}
+
+// The cube comes from the position arena of the pool, whose buffers are replaced when it grows or is compacted.
+void BoundingBoxOverlay::SetupVertexArray() {
+    const auto stride = static_cast<GLsizei>(sizeof(RenderPacket::BoundingBox));
+
+    GLState::BindVertexArray(vertexArray);
+
+    GLState::BindBuffer(GL_ARRAY_BUFFER, GeometryPool::GetVertexBuffer(VertexFormat::Position));
+    glEnableVertexAttribArray(positionAttribute);
+    glVertexAttribPointer(positionAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), BUFFER_OFFSET(0));
+
+    GLState::BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    for (GLuint column = 0; column < 4; ++column) {
+        glEnableVertexAttribArray(boundingBoxTransformAttribute + column);
+        glVertexAttribPointer(boundingBoxTransformAttribute + column, 4, GL_FLOAT, GL_FALSE, stride,
+                              BUFFER_OFFSET(column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(boundingBoxTransformAttribute + column, 1);
+    }
+    glEnableVertexAttribArray(boundingBoxColorAttribute);
+    glVertexAttribPointer(boundingBoxColorAttribute, 4, GL_FLOAT, GL_FALSE, stride,
+                          BUFFER_OFFSET(offsetof(RenderPacket::BoundingBox, color)));
+    glVertexAttribDivisor(boundingBoxColorAttribute, 1);
+
+    GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, GeometryPool::GetIndexBuffer());
+
+    GLState::BindVertexArray(0);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
+
+    geometryGeneration = GeometryPool::GetGeneration();
+}
+
+// Nothing is sent while the boxes stay where they are, which is the common case of a still scene or camera motion.
+void BoundingBoxOverlay::UploadInstances(const RenderPacket& packet) {
+    const auto& boxes = packet.boundingBoxes;
+    const auto size = boxes.size() * sizeof(RenderPacket::BoundingBox);
+    if (instances.size() == boxes.size() && !std::memcmp(instances.data(), boxes.data(), size)) {
+        return;
+    }
+
+    instances.assign(boxes.begin(), boxes.end());
+
+    GLState::BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    if (static_cast<GLsizeiptr>(boxes.size()) > instanceCapacity) {
+        while (instanceCapacity < static_cast<GLsizeiptr>(boxes.size())) {
+            instanceCapacity *= 2;
+        }
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(RenderPacket::BoundingBox), nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, instances.data());
+}
+
+} // namespace model_viewer_3d
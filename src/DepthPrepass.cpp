@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include "Common.h"
+#include "DepthPrepass.h"
+#include "GLState.h"
+#include "GPUProfiler.h"
+#include "GeometryPool.h"
+#include "StaticBatch.h"
+
+#define GLM_SWIZZLE
+#include <glm/gtc/type_ptr.hpp>
+#include <glGA/glGAHelper.h>
+
+namespace model_viewer_3d {
+
+const std::string depthPrepassShadersDirectory = std::string(rootDirectory) + "shaders/";
+
+bool DepthPrepass::enabled = false;
+
+GLuint DepthPrepass::program = 0;
+
+GLuint DepthPrepass::modelMatrixUniform;
+GLuint DepthPrepass::viewMatrixUniform;
+GLuint DepthPrepass::projectionMatrixUniform;
+
+void DepthPrepass::Initialize() {
+    const auto vertexShader = depthPrepassShadersDirectory + "DepthOnly.vert";
+    const auto fragmentShader = depthPrepassShadersDirectory + "DepthOnly.frag";
+    program = LoadShaders(vertexShader.c_str(), fragmentShader.c_str());
+
+    SETUP_UNIFORM(modelMatrix);
+    SETUP_UNIFORM(viewMatrix);
+    SETUP_UNIFORM(projectionMatrix);
+}
+
+void DepthPrepass::CleanUp() {
+    glDeleteProgram(program);
+}
+
+// Runs on the render thread after StaticBatch::Update() and before anything in the scene is shaded.
+void DepthPrepass::Draw(const RenderPacket& packet) {
+    if (!packet.depthPrepass) {
+        return;
+    }
+
+    PROFILE_GPU_SCOPE("DepthPrepass::Draw");
+
+    GLState::ColorMask(GL_FALSE);
+    GLState::DepthFunc(GL_LESS);
+    GLState::DepthMask(GL_TRUE);
+    GLState::Disable(GL_CULL_FACE);
+    GLState::PolygonMode(GL_FILL);
+
+    StaticBatch::DrawDepth(packet.viewMatrix, packet.projectionMatrix);
+
+    GLState::UseProgram(program);
+    glUniformMatrix4fv(viewMatrixUniform, 1, GL_FALSE, glm::value_ptr(packet.viewMatrix));
+    glUniformMatrix4fv(projectionMatrixUniform, 1, GL_FALSE, glm::value_ptr(packet.projectionMatrix));
+
+    // In draw order, so that the items nearest to the camera reject most of what is behind them here as well.
+    for (const auto index : packet.drawOrder) {
+        const auto& item = packet.items[index];
+        if (!item.depthPrepass || item.batched) {
+            continue;
+        }
+
+        const auto& geometry = GeometryPool::GetGeometry(item.geometry);
+        GLState::BindVertexArray(GeometryPool::GetPositionOnlyVertexArray(geometry.format));
+        glUniformMatrix4fv(modelMatrixUniform, 1, GL_FALSE, glm::value_ptr(item.modelMatrix));
+
+        for (const auto& submesh : geometry.submeshes) {
+            glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(submesh.numIndices), GL_UNSIGNED_INT,
+                                     BUFFER_OFFSET(submesh.firstIndex * sizeof(GLuint)), submesh.baseVertex);
+        }
+    }
+
+    GLState::ColorMask(GL_TRUE);
+}
+
+} // namespace model_viewer_3d
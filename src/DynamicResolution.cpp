@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "Common.h"
+#include "DynamicResolution.h"
+#include "GLState.h"
+#include "GPUProfiler.h"
+
+#include <ImGUI/imgui.h>
+
+namespace model_viewer_3d {
+
+// The scale is left alone while the frame time is between these fractions of the budget, and aims for the middle.
+constexpr float dynamicResolutionLowerBound = .8f;
+constexpr float dynamicResolutionTarget = .9f;
+constexpr float dynamicResolutionMaxStep = .1f;
+
+bool DynamicResolution::enabled = true;
+float DynamicResolution::frameBudget = 16.f;
+float DynamicResolution::minScale = .5f;
+float DynamicResolution::scale = 1.f;
+
+GLuint DynamicResolution::framebuffer = 0;
+GLuint DynamicResolution::colorRenderbuffer = 0;
+GLuint DynamicResolution::depthRenderbuffer = 0;
+
+bool DynamicResolution::consuming = false;
+unsigned long DynamicResolution::resultsSequence = 0;
+unsigned DynamicResolution::cooldown = 0;
+
+// The target is allocated at the window size once, and the scene is drawn into its lower left corner, so that changing
+// the scale never reallocates anything.
+void DynamicResolution::Initialize() {
+    const auto width = static_cast<GLsizei>(windowWidth);
+    const auto height = static_cast<GLsizei>(windowHeight);
+
+    glGenRenderbuffers(1, &colorRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &depthRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    GLState::BindFramebuffer(framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRenderbuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+    const auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    GLState::BindFramebuffer(0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::string("The dynamic resolution framebuffer is incomplete");
+    }
+
+    scale = 1.f;
+    cooldown = 0;
+}
+
+void DynamicResolution::CleanUp() {
+    GLState::DeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &colorRenderbuffer);
+    glDeleteRenderbuffers(1, &depthRenderbuffer);
+
+    if (consuming) {
+        GPUProfiler::RemoveFrameTimeConsumer();
+        consuming = false;
+    }
+}
+
+void DynamicResolution::Prepare(RenderPacket& packet) {
+    if (enabled != consuming) {
+        enabled ? GPUProfiler::AddFrameTimeConsumer() : GPUProfiler::RemoveFrameTimeConsumer();
+        consuming = enabled;
+    }
+
+    if (!enabled || !GPUProfiler::supported) {
+        scale = 1.f;
+    } else if (resultsSequence != GPUProfiler::GetResultsSequence()) {
+        resultsSequence = GPUProfiler::GetResultsSequence();
+        if (cooldown) {
+            --cooldown;
+        } else {
+            Adjust(GPUProfiler::GetFrameTime());
+        }
+    }
+
+    packet.renderWidth = std::max(1, static_cast<int>(std::lround(windowWidth * scale)));
+    packet.renderHeight = std::max(1, static_cast<int>(std::lround(windowHeight * scale)));
+}
+
+void DynamicResolution::Begin(const RenderPacket& packet) {
+    if (IsNative(packet)) {
+        GLState::BindFramebuffer(0);
+        GLState::Viewport(0, 0, static_cast<GLsizei>(windowWidth), static_cast<GLsizei>(windowHeight));
+        return;
+    }
+
+    GLState::BindFramebuffer(framebuffer);
+    GLState::Viewport(0, 0, packet.renderWidth, packet.renderHeight);
+}
+
+// A bilinear blit; the scissor test and the colour mask would clip it, so both are reset first.
+void DynamicResolution::Resolve(const RenderPacket& packet) {
+    if (IsNative(packet)) {
+        return;
+    }
+
+    PROFILE_GPU_SCOPE("DynamicResolution::Resolve");
+
+    GLState::Disable(GL_SCISSOR_TEST);
+    GLState::ColorMask(GL_TRUE);
+    GLState::BindFramebuffer(0);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBlitFramebuffer(0, 0, packet.renderWidth, packet.renderHeight, 0, 0, static_cast<GLint>(windowWidth),
+                      static_cast<GLint>(windowHeight), GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    GLState::Viewport(0, 0, static_cast<GLsizei>(windowWidth), static_cast<GLsizei>(windowHeight));
+}
+
+void DynamicResolution::DisplayControls() {
+    ImGui::Text("Resolution Scale: %.2f (%ldx%ld), Budget: %.1f ms", scale, std::lround(windowWidth * scale),
+                std::lround(windowHeight * scale), frameBudget);
+
+    if (ImGui::CollapsingHeader("Dynamic Resolution")) {
+        ImGui::Checkbox("Enabled" "##Dynamic Resolution", &enabled);
+        ImGui::SliderFloat("Frame Budget (ms)", &frameBudget, 4.f, 50.f);
+        ImGui::SliderFloat("Minimum Scale", &minScale, .25f, 1.f);
+        if (!GPUProfiler::supported) {
+            ImGui::Text("Dynamic resolution requires GPU timer queries.");
+        }
+    }
+}
+
+// The GPU time grows roughly with the number of pixels shaded, that is with the square of the scale. Once changed, the
+// scale is held until the frames drawn at it have been read back.
+void DynamicResolution::Adjust(float frameTime) {
+    if (frameTime <= 0.f || (frameTime <= frameBudget && frameTime >= frameBudget * dynamicResolutionLowerBound)) {
+        return;
+    }
+
+    const auto target = scale * std::sqrt(frameBudget * dynamicResolutionTarget / frameTime);
+    const auto newScale = std::min(std::max(std::min(std::max(target, scale - dynamicResolutionMaxStep),
+                                                     scale + dynamicResolutionMaxStep),
+                                            minScale),
+                                   1.f);
+    if (newScale != scale) {
+        scale = newScale;
+        cooldown = gpuProfilerFrameLatency;
+    }
+}
+
+bool DynamicResolution::IsNative(const RenderPacket& packet) {
+    return packet.renderWidth == static_cast<int>(windowWidth) && packet.renderHeight == static_cast<int>(windowHeight);
+}
+
+} // namespace model_viewer_3d
@@ -11,7 +11,7 @@
 
 #define IMVEC4_POINTER(x) (reinterpret_cast<float *>(&(x)))
 
-namespace 3d_model_viewer {
+namespace model_viewer_3d {
 
 unsigned long Environment::numObjects = 0;
 
@@ -48,6 +48,7 @@ void Environment::DisplayControls() {
         }
         if (ImGui::SliderFloat("FOV (°)", &camera.fieldOfViewDegrees, 1.f, 179.f)) {
             camera.fieldOfView = glm::radians(camera.fieldOfViewDegrees);
+            camera.previousFieldOfViewDegrees = camera.fieldOfViewDegrees;
         }
         ImGui::SliderFloat("Aspect Ratio", &camera.aspectRatio, 1.f, 1.999f);
         if (ImGui::SliderFloat("Near Clipping", &camera.nearClippingPlane, 0.1f, 100.f)) {
@@ -68,21 +69,11 @@ void Environment::DisplayControls() {
             light.LoadDefaultValues();
         }
         ImGui::Indent(15);
-        if (ImGui::DragFloat3("XYZ" "##Light", glm::value_ptr(light.position), .1f, -100.f, 100.f)) {
-            light.changed = numObjects;
-        }
-        if (ImGui::ColorEdit3("Ambient Color" "##Light", IMVEC4_POINTER(light.ambientColor))) {
-            light.changed = numObjects;
-        }
-        if (ImGui::ColorEdit3("Diffuse Color" "##Light", IMVEC4_POINTER(light.diffuseColor))) {
-            light.changed = numObjects;
-        }
-        if (ImGui::ColorEdit3("Specular Color" "##Light", IMVEC4_POINTER(light.specularColor))) {
-            light.changed = numObjects;
-        }
-        if (ImGui::SliderFloat("Intensity", &light.intensity, 0.f, 150.f)) {
-            light.changed = numObjects;
-        }
+        ImGui::DragFloat3("XYZ" "##Light", glm::value_ptr(light.position), .1f, -100.f, 100.f);
+        ImGui::ColorEdit3("Ambient Color" "##Light", IMVEC4_POINTER(light.ambientColor));
+        ImGui::ColorEdit3("Diffuse Color" "##Light", IMVEC4_POINTER(light.diffuseColor));
+        ImGui::ColorEdit3("Specular Color" "##Light", IMVEC4_POINTER(light.specularColor));
+        ImGui::SliderFloat("Intensity", &light.intensity, 0.f, 150.f);
         ImGui::Unindent(15);
         ImGui::Spacing();
     }
@@ -109,19 +100,21 @@ void Environment::LoadDefaultValues() {
     light.LoadDefaultValues();
 }
 
-void Environment::ForceUpdate() {
-    camera.changed = numObjects;
-    light.changed = numObjects;
-}
-
-Environment::Camera::Camera() : position(glm::vec3(1.f)) {}
+Environment::Camera::Camera() : position(glm::vec3(1.f)), accumulatedTime(0.f), heldKeys(0) {}
 
 void Environment::Camera::Update(Time& currentTime) {
     currentFrame = currentTime;
     deltaTime = Utilities::DurationToFloat(currentFrame - lastFrame);
     lastFrame = currentFrame;
-    speed = 20 * speedFactor * deltaTime;
-    zoomSpeed = zoomSpeedFactor * speed;
+
+    // Held keys are integrated in fixed steps, so camera motion depends neither on the frame rate nor on the key
+    // repeat rate, and rendering is interpolated between the last two steps.
+    accumulatedTime = std::min(accumulatedTime + deltaTime, cameraMaxAccumulatedTime);
+    while (accumulatedTime >= cameraUpdateStep) {
+        Step(cameraUpdateStep);
+        accumulatedTime -= cameraUpdateStep;
+    }
+    Interpolate(accumulatedTime / cameraUpdateStep);
 
     if (focusOnOrigin) {
         center = origin;
@@ -133,7 +126,7 @@ void Environment::Camera::Update(Time& currentTime) {
             const auto target = transform * glm::vec4(boundingBox.center, 1.f);
             center = (target / target.w).xyz();
 
-            const auto boundingBoxSize = transform * vec4(boundingBox.size, 1.f);
+            const auto boundingBoxSize = transform * glm::vec4(boundingBox.size, 1.f);
             const auto boundingBoxSizeNormalized = (boundingBoxSize / boundingBoxSize.w).xyz();
             const auto maxBoundingBoxSide = std::max({boundingBoxSizeNormalized.x, boundingBoxSizeNormalized.y, boundingBoxSizeNormalized.z});
             distance = (3.f * maxBoundingBoxSide);
@@ -146,8 +139,58 @@ void Environment::Camera::Update(Time& currentTime) {
     position.x = distance * sinPhi * cosTheta;
     position.y = distance * cosPhi;
     position.z = distance * sinPhi * sinTheta;
+}
+
+void Environment::Camera::Step(float timeStep) {
+    previousThetaInDegrees = thetaInDegrees;
+    previousPhiInDegrees = phiInDegrees;
+    previousFieldOfViewDegrees = fieldOfViewDegrees;
+
+    speed = 20 * speedFactor * timeStep;
+    zoomSpeed = zoomSpeedFactor * speed;
+
+    if (heldKeys & HeldKeyUp) {
+        phiInDegrees = std::max(phiInDegrees - speed, 15.f);
+    }
+    if (heldKeys & HeldKeyDown) {
+        phiInDegrees = std::min(phiInDegrees + speed, 165.f);
+    }
+    if (heldKeys & HeldKeyLeft) {
+        thetaInDegrees += speed;
+        if (thetaInDegrees > 179.f) {
+            thetaInDegrees = -179.f;
+        }
+    }
+    if (heldKeys & HeldKeyRight) {
+        thetaInDegrees -= speed;
+        if (thetaInDegrees < -179.f) {
+            thetaInDegrees = 179.f;
+        }
+    }
+    if (heldKeys & HeldKeyZoomIn) {
+        fieldOfViewDegrees = std::max(fieldOfViewDegrees - zoomSpeed, 1.f);
+    }
+    if (heldKeys & HeldKeyZoomOut) {
+        fieldOfViewDegrees = std::min(fieldOfViewDegrees + zoomSpeed, 179.f);
+    }
+}
 
-    changed = numObjects;
+void Environment::Camera::Interpolate(float alpha) {
+    // Do not sweep through the whole circle when the horizontal angle wraps around.
+    const auto thetaDelta = thetaInDegrees - previousThetaInDegrees;
+    const auto renderedThetaInDegrees = std::abs(thetaDelta) < 180.f ? previousThetaInDegrees + alpha * thetaDelta
+                                                                      : thetaInDegrees;
+    const auto renderedPhiInDegrees = previousPhiInDegrees + alpha * (phiInDegrees - previousPhiInDegrees);
+    const auto renderedFieldOfViewDegrees = previousFieldOfViewDegrees + alpha * (fieldOfViewDegrees - previousFieldOfViewDegrees);
+
+    phi = glm::radians(renderedPhiInDegrees);
+    theta = glm::radians(renderedThetaInDegrees);
+    fieldOfView = glm::radians(renderedFieldOfViewDegrees);
+
+    sinPhi = sin(phi);
+    cosPhi = cos(phi);
+    sinTheta = sin(theta);
+    cosTheta = cos(theta);
 }
 
 void Environment::Camera::ProcessEvent(SDL_Event* event) {
@@ -155,6 +198,9 @@ void Environment::Camera::ProcessEvent(SDL_Event* event) {
         case SDL_KEYDOWN:
             ProcessKeyboardEvent(event);
             break;
+        case SDL_KEYUP:
+            heldKeys &= ~GetHeldKey(event->key.keysym.sym);
+            break;
         case SDL_MOUSEWHEEL:
             ProcessMouseWheelEvent(event);
             break;
@@ -164,49 +210,9 @@ void Environment::Camera::ProcessEvent(SDL_Event* event) {
 }
 
 void Environment::Camera::ProcessKeyboardEvent(SDL_Event* event) {
+    heldKeys |= GetHeldKey(event->key.keysym.sym);
+
     switch (event->key.keysym.sym) {
-        case SDLK_UP:
-            phiInDegrees -= speed;
-            if (phiInDegrees < 15.f) {
-                phiInDegrees = 15.f;
-            }
-            UpdateAngleInformation();
-            break;
-        case SDLK_DOWN:
-            phiInDegrees += speed;
-            if (phiInDegrees > 165.f) {
-                phiInDegrees = 165.f;
-            }
-            UpdateAngleInformation();
-            break;
-        case SDLK_LEFT:
-            thetaInDegrees += speed;
-            if (thetaInDegrees > 179.f) {
-                thetaInDegrees = -179.f;
-            }
-            UpdateAngleInformation();
-            break;
-        case SDLK_RIGHT:
-            thetaInDegrees -= speed;
-            if (thetaInDegrees < -179.f) {
-                thetaInDegrees = 179.f;
-            }
-            UpdateAngleInformation();
-            break;
-        case SDLK_l:
-            fieldOfViewDegrees += zoomSpeed;
-            if (fieldOfViewDegrees > 179.f) {
-                fieldOfViewDegrees = 179.f;
-            }
-            fieldOfView = glm::radians(fieldOfViewDegrees);
-            break;
-        case SDLK_k:
-            fieldOfViewDegrees -= zoomSpeed;
-            if (fieldOfViewDegrees < 1.f) {
-                fieldOfViewDegrees = 1.f;
-            }
-            fieldOfView = glm::radians(fieldOfViewDegrees);
-            break;
         case SDLK_f:
             focusOnOrigin = true;
             break;
@@ -219,34 +225,60 @@ void Environment::Camera::ProcessKeyboardEvent(SDL_Event* event) {
 }
 
 void Environment::Camera::ProcessMouseWheelEvent(SDL_Event* event) {
+    // Each wheel notch zooms by what holding a zoom key does over one 60 Hz frame.
+    auto wheelZoom = zoomSpeedFactor * 20 * speedFactor * cameraWheelStep;
     if (event->wheel.direction == SDL_MOUSEWHEEL_FLIPPED) {
-        zoomSpeed *= -1.f;
+        wheelZoom *= -1.f;
     }
 
+    auto zoomed = false;
     switch (event->wheel.y) {
         case 1:
-            fieldOfViewDegrees += zoomSpeed;
-            changed = numObjects;
+            fieldOfViewDegrees += wheelZoom;
+            zoomed = true;
             break;
         case -1:
-            fieldOfViewDegrees -= zoomSpeed;
-            changed = numObjects;
+            fieldOfViewDegrees -= wheelZoom;
+            zoomed = true;
             break;
         default:
             break;
     }
 
-    if (changed) {
+    if (zoomed) {
         if (fieldOfViewDegrees < 1.f) {
             fieldOfViewDegrees = 1.f;
         } else if (fieldOfViewDegrees > 179.f) {
             fieldOfViewDegrees = 179.f;
         }
         fieldOfView = glm::radians(fieldOfViewDegrees);
+        previousFieldOfViewDegrees = fieldOfViewDegrees;
+    }
+}
+
+unsigned Environment::Camera::GetHeldKey(SDL_Keycode key) {
+    switch (key) {
+        case SDLK_UP:
+            return HeldKeyUp;
+        case SDLK_DOWN:
+            return HeldKeyDown;
+        case SDLK_LEFT:
+            return HeldKeyLeft;
+        case SDLK_RIGHT:
+            return HeldKeyRight;
+        case SDLK_k:
+            return HeldKeyZoomIn;
+        case SDLK_l:
+            return HeldKeyZoomOut;
+        default:
+            return 0;
     }
 }
 
 void Environment::Camera::UpdateAngleInformation() {
+    previousThetaInDegrees = thetaInDegrees;
+    previousPhiInDegrees = phiInDegrees;
+
     phi = glm::radians(phiInDegrees);
     theta = glm::radians(thetaInDegrees);
 
@@ -269,14 +301,13 @@ void Environment::Camera::LoadDefaultValues() {
 
     fieldOfViewDegrees = 45.f;
     fieldOfView = glm::radians(fieldOfViewDegrees);
+    previousFieldOfViewDegrees = fieldOfViewDegrees;
     aspectRatio = windowWidth / windowHeight;
     nearClippingPlane = 0.1f;
     farClippingPlane = 10000.f;
 
     origin = glm::vec3(0.f);
     focusOnOrigin = false;
-
-    changed = numObjects;
 }
 
 void Environment::Light::LoadDefaultValues() {
@@ -285,8 +316,6 @@ void Environment::Light::LoadDefaultValues() {
     diffuseColor = ImColor(255, 255, 255, 255);
     specularColor = ImColor(255, 255, 255, 255);
     intensity = 50.f;
-
-    changed = numObjects;
 }
 
-} // namespace 3d_model_viewer
+} // namespace model_viewer_3d
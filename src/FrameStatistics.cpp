@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <algorithm>
+#include <cfloat>
+#include <csignal>
+#include <ctime>
+#include <fstream>
+#include <vector>
+
+#include "FrameStatistics.h"
+#include "GUI.h"
+
+#include <ImGUI/imgui.h>
+
+namespace model_viewer_3d {
+
+float FrameStatistics::targetFrameTime = frameStatisticsTargetTime;
+
+std::array<FrameStatistics::Sample, frameStatisticsWindow> FrameStatistics::samples;
+unsigned FrameStatistics::numSamples = 0;
+unsigned FrameStatistics::nextSample = 0;
+unsigned long FrameStatistics::totalFrames = 0;
+
+FrameStatistics::Summary FrameStatistics::summary = {};
+std::array<float, frameStatisticsHistogramBuckets> FrameStatistics::histogram = {};
+bool FrameStatistics::dirty = false;
+
+std::string FrameStatistics::outputPath;
+std::string FrameStatistics::lastOutputPath;
+std::atomic<bool> FrameStatistics::dumpRequested(false);
+
+void FrameStatistics::Initialize(const std::string& outputPath) {
+    FrameStatistics::outputPath = outputPath;
+    Reset();
+
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, HandleSignal);
+#endif
+}
+
+void FrameStatistics::CleanUp() {
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, SIG_DFL);
+#endif
+
+    if (!outputPath.empty()) {
+        Dump(outputPath);
+    }
+}
+
+void FrameStatistics::AddFrame(float frameTime, float workTime) {
+    samples[nextSample] = {frameTime, workTime};
+    nextSample = (nextSample + 1) % frameStatisticsWindow;
+    numSamples = std::min(numSamples + 1, frameStatisticsWindow);
+    ++totalFrames;
+    dirty = true;
+
+    if (dumpRequested.exchange(false)) {
+        Dump(outputPath.empty() ? GetDefaultOutputPath() + ".json" : outputPath);
+    }
+}
+
+void FrameStatistics::Reset() {
+    numSamples = 0;
+    nextSample = 0;
+    totalFrames = 0;
+    dirty = true;
+}
+
+void FrameStatistics::DisplayControls() {
+    if (ImGui::CollapsingHeader("Frame Statistics")) {
+        const auto& statistics = GetSummary();
+
+        ImGui::Text("Frames: %u (%lu total)", statistics.frames, totalFrames);
+        ImGui::Text("Average: %.3f ms (work: %.3f ms)", statistics.average, statistics.averageWork);
+        ImGui::Text("p50: %.3f ms  p95: %.3f ms  p99: %.3f ms", statistics.p50, statistics.p95, statistics.p99);
+        ImGui::Text("Worst: %.3f ms", statistics.worst);
+        ImGui::Text("Missed Deadlines: %u (target: %.2f ms)", statistics.missedDeadlines, targetFrameTime);
+
+        const auto p99Color = statistics.p99 <= targetFrameTime ? ImVec4(0.4f, 1.0f, 0.4f, 1.0f)
+                                                                : ImVec4(1.0f, 0.4f, 0.4f, 1.0f);
+        ImGui::TextColored(p99Color, statistics.p99 <= targetFrameTime ? "p99 within budget" : "p99 over budget");
+
+        ImGui::PlotHistogram("##Frame Time Histogram", histogram.data(), static_cast<int>(histogram.size()), 0,
+                             "Frame Time (1 ms buckets)", 0.0f, FLT_MAX, ImVec2(0, 60));
+
+        if (ImGui::Button("Reset" "##Frame Statistics")) {
+            Reset();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Export CSV")) {
+            Dump(GetDefaultOutputPath() + ".csv");
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Export JSON")) {
+            Dump(GetDefaultOutputPath() + ".json");
+        }
+
+        if (!lastOutputPath.empty()) {
+            ImGui::TextWrapped("Last export: %s", lastOutputPath.c_str());
+        }
+    }
+}
+
+FrameStatistics::Summary FrameStatistics::GetSummary() {
+    if (dirty) {
+        Update();
+    }
+
+    return summary;
+}
+
+bool FrameStatistics::Dump(const std::string& path) {
+    const auto extension = path.size() >= 4 ? path.substr(path.size() - 4) : std::string();
+    const auto written = extension == ".csv" ? WriteCSV(path) : WriteJSON(path);
+    if (written) {
+        lastOutputPath = path;
+    } else {
+        GUI::DisplayErrorMessage("Could not write frame statistics file \"" + path + "\"!");
+    }
+
+    return written;
+}
+
+void FrameStatistics::Update() {
+    static std::vector<float> frameTimes;
+
+    summary = {};
+    histogram.fill(0.0f);
+    dirty = false;
+
+    if (!numSamples) {
+        return;
+    }
+
+    frameTimes.resize(numSamples);
+    auto totalFrameTime = 0.0;
+    auto totalWorkTime = 0.0;
+    for (unsigned i = 0; i < numSamples; ++i) {
+        const auto& sample = samples[i];
+        frameTimes[i] = sample.frameTime;
+        totalFrameTime += sample.frameTime;
+        totalWorkTime += sample.workTime;
+
+        // A frame that took longer than one and a half refresh intervals was presented at least one vsync late.
+        if (sample.frameTime > targetFrameTime * 1.5f) {
+            ++summary.missedDeadlines;
+        }
+
+        const auto bucket = static_cast<unsigned>(sample.frameTime / frameStatisticsBucketWidth);
+        histogram[std::min(bucket, frameStatisticsHistogramBuckets - 1)] += 1.0f;
+    }
+
+    const auto percentile = [](float fraction) {
+        const auto rank = static_cast<unsigned>(fraction * (frameTimes.size() - 1) + 0.5f);
+        std::nth_element(frameTimes.begin(), frameTimes.begin() + rank, frameTimes.end());
+        return frameTimes[rank];
+    };
+
+    summary.frames = numSamples;
+    summary.average = static_cast<float>(totalFrameTime / numSamples);
+    summary.averageWork = static_cast<float>(totalWorkTime / numSamples);
+    summary.p50 = percentile(0.50f);
+    summary.p95 = percentile(0.95f);
+    summary.p99 = percentile(0.99f);
+    summary.worst = *std::max_element(frameTimes.begin(), frameTimes.end());
+}
+
+void FrameStatistics::HandleSignal(int) {
+    dumpRequested = true;
+}
+
+bool FrameStatistics::WriteCSV(const std::string& path) {
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    const auto& statistics = GetSummary();
+    file << "frames,average_ms,p50_ms,p95_ms,p99_ms,worst_ms,average_work_ms,missed_deadlines,target_ms\n"
+         << statistics.frames << ',' << statistics.average << ',' << statistics.p50 << ',' << statistics.p95 << ','
+         << statistics.p99 << ',' << statistics.worst << ',' << statistics.averageWork << ','
+         << statistics.missedDeadlines << ',' << targetFrameTime << '\n';
+
+    return static_cast<bool>(file);
+}
+
+bool FrameStatistics::WriteJSON(const std::string& path) {
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    const auto& statistics = GetSummary();
+    file << "{\n"
+         << "  \"frames\": " << statistics.frames << ",\n"
+         << "  \"total_frames\": " << totalFrames << ",\n"
+         << "  \"average_ms\": " << statistics.average << ",\n"
+         << "  \"p50_ms\": " << statistics.p50 << ",\n"
+         << "  \"p95_ms\": " << statistics.p95 << ",\n"
+         << "  \"p99_ms\": " << statistics.p99 << ",\n"
+         << "  \"worst_ms\": " << statistics.worst << ",\n"
+         << "  \"average_work_ms\": " << statistics.averageWork << ",\n"
+         << "  \"missed_deadlines\": " << statistics.missedDeadlines << ",\n"
+         << "  \"target_ms\": " << targetFrameTime << ",\n"
+         << "  \"histogram_bucket_ms\": " << frameStatisticsBucketWidth << ",\n"
+         << "  \"histogram\": [";
+    for (unsigned i = 0; i < histogram.size(); ++i) {
+        file << (i ? ", " : "") << static_cast<unsigned>(histogram[i]);
+    }
+    file << "]\n}\n";
+
+    return static_cast<bool>(file);
+}
+
+std::string FrameStatistics::GetDefaultOutputPath() {
+    char timestamp[32];
+    const auto now = std::time(nullptr);
+    std::strftime(timestamp, sizeof(timestamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+    return std::string("frame-statistics-") + timestamp;
+}
+
+} // namespace model_viewer_3d
@@ -0,0 +1,342 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include "GLState.h"
+
+#include <ImGUI/imgui.h>
+
+namespace model_viewer_3d {
+
+// Never a valid name or enum value, so the first call of every kind after an invalidation goes through.
+constexpr GLuint unknownState = ~0u;
+
+GLuint GLState::program = unknownState;
+GLuint GLState::vertexArray = unknownState;
+std::array<GLuint, GLState::BufferTargetCount> GLState::buffers;
+std::array<std::array<GLuint, glStateMaxIndexedBuffers>, 2> GLState::indexedBuffers;
+GLuint GLState::activeTextureUnit = unknownState;
+std::array<std::array<GLuint, GLState::TextureTargetCount>, glStateMaxTextureUnits> GLState::textures;
+std::array<GLuint, GLState::CapabilityCount> GLState::capabilities;
+GLuint GLState::framebuffer = unknownState;
+GLuint GLState::polygonMode = unknownState;
+std::array<GLint, 4> GLState::viewport;
+GLuint GLState::colorMask = unknownState;
+GLuint GLState::depthFunction = unknownState;
+GLuint GLState::depthMask = unknownState;
+
+std::array<unsigned, GLState::CategoryCount> GLState::issued;
+std::array<unsigned, GLState::CategoryCount> GLState::skipped;
+std::array<std::atomic<unsigned>, GLState::CategoryCount> GLState::issuedLastFrame;
+std::array<std::atomic<unsigned>, GLState::CategoryCount> GLState::skippedLastFrame;
+
+void GLState::Initialize() {
+    issued.fill(0);
+    skipped.fill(0);
+    Invalidate();
+}
+
+// Runs on the render thread before anything is drawn. Whatever happened between frames, such as glGA loading textures
+// or ImGui creating its objects, is forgotten, so each frame starts from a known state.
+void GLState::BeginFrame() {
+    for (unsigned i = 0; i < CategoryCount; ++i) {
+        issuedLastFrame[i] = issued[i];
+        skippedLastFrame[i] = skipped[i];
+        issued[i] = 0;
+        skipped[i] = 0;
+    }
+
+    Invalidate();
+}
+
+void GLState::Invalidate() {
+    program = unknownState;
+    vertexArray = unknownState;
+    buffers.fill(unknownState);
+    for (auto& bindings : indexedBuffers) {
+        bindings.fill(unknownState);
+    }
+    InvalidateTextures();
+    capabilities.fill(unknownState);
+    framebuffer = unknownState;
+    polygonMode = unknownState;
+    viewport.fill(-1);
+    colorMask = unknownState;
+    depthFunction = unknownState;
+    depthMask = unknownState;
+}
+
+void GLState::InvalidateTextures() {
+    activeTextureUnit = unknownState;
+    for (auto& unit : textures) {
+        unit.fill(unknownState);
+    }
+}
+
+void GLState::UseProgram(GLuint program) {
+    if (Changed(GLState::program, program, CategoryProgram)) {
+        glUseProgram(program);
+    }
+}
+
+// The element array binding belongs to the vertex array object, so it is unknown again once another one is bound.
+void GLState::BindVertexArray(GLuint vertexArray) {
+    if (Changed(GLState::vertexArray, vertexArray, CategoryVertexArray)) {
+        glBindVertexArray(vertexArray);
+        buffers[BufferTargetElementArray] = unknownState;
+    }
+}
+
+void GLState::BindBuffer(GLenum target, GLuint buffer) {
+    const auto index = GetBufferTarget(target);
+    if (index < 0) {
+        ++issued[CategoryBuffer];
+        glBindBuffer(target, buffer);
+    } else if (Changed(buffers[index], buffer, CategoryBuffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+// Binding to an indexed binding point also binds the buffer to the generic binding point of the target.
+void GLState::BindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    const auto bufferTarget = GetBufferTarget(target);
+    if ((bufferTarget != BufferTargetShaderStorage && bufferTarget != BufferTargetUniform) ||
+        index >= glStateMaxIndexedBuffers) {
+        ++issued[CategoryBuffer];
+        glBindBufferBase(target, index, buffer);
+        if (bufferTarget >= 0) {
+            buffers[bufferTarget] = buffer;
+        }
+        return;
+    }
+
+    auto& binding = indexedBuffers[bufferTarget == BufferTargetShaderStorage ? 0 : 1][index];
+    if (Changed(binding, buffer, CategoryBuffer)) {
+        glBindBufferBase(target, index, buffer);
+        buffers[bufferTarget] = buffer;
+    }
+}
+
+void GLState::BindTexture(GLuint unit, GLenum target, GLuint texture) {
+    if (Changed(activeTextureUnit, unit, CategoryTexture)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    const auto index = GetTextureTarget(target);
+    if (index < 0 || unit >= glStateMaxTextureUnits) {
+        ++issued[CategoryTexture];
+        glBindTexture(target, texture);
+    } else if (Changed(textures[unit][index], texture, CategoryTexture)) {
+        glBindTexture(target, texture);
+    }
+}
+
+void GLState::BindFramebuffer(GLuint framebuffer) {
+    if (Changed(GLState::framebuffer, framebuffer, CategoryFramebuffer)) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+}
+
+void GLState::Enable(GLenum capability) {
+    SetCapability(capability, true);
+}
+
+void GLState::Disable(GLenum capability) {
+    SetCapability(capability, false);
+}
+
+void GLState::PolygonMode(GLenum mode) {
+    if (Changed(polygonMode, mode, CategoryRaster)) {
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+    }
+}
+
+void GLState::Viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    const std::array<GLint, 4> value = { x, y, width, height };
+    if (viewport == value) {
+        ++skipped[CategoryRaster];
+        return;
+    }
+
+    viewport = value;
+    ++issued[CategoryRaster];
+    glViewport(x, y, width, height);
+}
+
+void GLState::ColorMask(GLboolean mask) {
+    if (Changed(colorMask, mask, CategoryRaster)) {
+        glColorMask(mask, mask, mask, mask);
+    }
+}
+
+void GLState::DepthFunc(GLenum function) {
+    if (Changed(depthFunction, function, CategoryDepth)) {
+        glDepthFunc(function);
+    }
+}
+
+void GLState::DepthMask(GLboolean mask) {
+    if (Changed(depthMask, mask, CategoryDepth)) {
+        glDepthMask(mask);
+    }
+}
+
+void GLState::DeleteBuffers(GLsizei count, const GLuint* buffers) {
+    for (GLsizei i = 0; i < count; ++i) {
+        for (auto& binding : GLState::buffers) {
+            if (binding == buffers[i]) {
+                binding = 0;
+            }
+        }
+        for (auto& bindings : indexedBuffers) {
+            for (auto& binding : bindings) {
+                if (binding == buffers[i]) {
+                    binding = 0;
+                }
+            }
+        }
+    }
+    glDeleteBuffers(count, buffers);
+}
+
+void GLState::DeleteVertexArrays(GLsizei count, const GLuint* vertexArrays) {
+    for (GLsizei i = 0; i < count; ++i) {
+        if (vertexArray == vertexArrays[i]) {
+            vertexArray = 0;
+            buffers[BufferTargetElementArray] = unknownState;
+        }
+    }
+    glDeleteVertexArrays(count, vertexArrays);
+}
+
+void GLState::DeleteTextures(GLsizei count, const GLuint* textures) {
+    for (GLsizei i = 0; i < count; ++i) {
+        for (auto& unit : GLState::textures) {
+            for (auto& binding : unit) {
+                if (binding == textures[i]) {
+                    binding = 0;
+                }
+            }
+        }
+    }
+    glDeleteTextures(count, textures);
+}
+
+void GLState::DeleteFramebuffers(GLsizei count, const GLuint* framebuffers) {
+    for (GLsizei i = 0; i < count; ++i) {
+        if (framebuffer == framebuffers[i]) {
+            framebuffer = 0;
+        }
+    }
+    glDeleteFramebuffers(count, framebuffers);
+}
+
+void GLState::DisplayControls() {
+    if (ImGui::CollapsingHeader("State Changes")) {
+        const char* categoryNames[] = { "Program", "Vertex Array", "Buffer", "Texture", "Capability", "Raster", "Depth", "Framebuffer" };
+
+        unsigned totalIssued = 0;
+        unsigned totalSkipped = 0;
+        for (unsigned i = 0; i < CategoryCount; ++i) {
+            totalIssued += issuedLastFrame[i];
+            totalSkipped += skippedLastFrame[i];
+        }
+        ImGui::Text("Last Frame: %u issued, %u skipped", totalIssued, totalSkipped);
+
+        ImGui::Columns(3, "##State Changes");
+        ImGui::Text("State");
+        ImGui::NextColumn();
+        ImGui::Text("Issued");
+        ImGui::NextColumn();
+        ImGui::Text("Skipped");
+        ImGui::NextColumn();
+        ImGui::Separator();
+
+        for (unsigned i = 0; i < CategoryCount; ++i) {
+            ImGui::Text("%s", categoryNames[i]);
+            ImGui::NextColumn();
+            ImGui::Text("%u", issuedLastFrame[i].load());
+            ImGui::NextColumn();
+            ImGui::Text("%u", skippedLastFrame[i].load());
+            ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+    }
+}
+
+bool GLState::Changed(GLuint& cached, GLuint value, Category category) {
+    if (cached == value) {
+        ++skipped[category];
+        return false;
+    }
+
+    cached = value;
+    ++issued[category];
+    return true;
+}
+
+int GLState::GetBufferTarget(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER:
+            return BufferTargetArray;
+        case GL_ELEMENT_ARRAY_BUFFER:
+            return BufferTargetElementArray;
+        case GL_COPY_READ_BUFFER:
+            return BufferTargetCopyRead;
+        case GL_COPY_WRITE_BUFFER:
+            return BufferTargetCopyWrite;
+        case GL_DRAW_INDIRECT_BUFFER:
+            return BufferTargetDrawIndirect;
+        case GL_SHADER_STORAGE_BUFFER:
+            return BufferTargetShaderStorage;
+        case GL_UNIFORM_BUFFER:
+            return BufferTargetUniform;
+        default:
+            return -1;
+    }
+}
+
+int GLState::GetTextureTarget(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D:
+            return TextureTarget2D;
+        case GL_TEXTURE_2D_ARRAY:
+            return TextureTarget2DArray;
+        default:
+            return -1;
+    }
+}
+
+int GLState::GetCapability(GLenum capability) {
+    switch (capability) {
+        case GL_DEPTH_TEST:
+            return CapabilityDepthTest;
+        case GL_CULL_FACE:
+            return CapabilityCullFace;
+        case GL_BLEND:
+            return CapabilityBlend;
+        case GL_SCISSOR_TEST:
+            return CapabilityScissorTest;
+        case GL_POLYGON_OFFSET_FILL:
+            return CapabilityPolygonOffsetFill;
+        default:
+            return -1;
+    }
+}
+
+void GLState::SetCapability(GLenum capability, bool enabled) {
+    const auto index = GetCapability(capability);
+    if (index >= 0 && !Changed(capabilities[index], enabled ? 1 : 0, CategoryCapability)) {
+        return;
+    }
+    if (index < 0) {
+        ++issued[CategoryCapability];
+    }
+
+    if (enabled) {
+        glEnable(capability);
+    } else {
+        glDisable(capability);
+    }
+}
+
+} // namespace model_viewer_3d
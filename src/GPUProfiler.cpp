@@ -0,0 +1,213 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include "GPUProfiler.h"
+
+namespace model_viewer_3d {
+
+constexpr auto queriesPerFrame = 2 * gpuProfilerMaxScopes + 2;
+
+std::atomic<bool> GPUProfiler::enabled(false);
+std::atomic<bool> GPUProfiler::frameTimeEnabled(false);
+bool GPUProfiler::supported = false;
+unsigned long GPUProfiler::framesDropped = 0;
+unsigned GPUProfiler::scopesDropped = 0;
+
+std::array<GPUProfiler::Frame, gpuProfilerFrameLatency> GPUProfiler::frames;
+std::vector<GLuint> GPUProfiler::queries;
+unsigned GPUProfiler::currentFrame = 0;
+unsigned GPUProfiler::numConsumers = 0;
+unsigned GPUProfiler::numFrameTimeConsumers = 0;
+
+std::vector<Profiler::ScopeTotal> GPUProfiler::latestTotals;
+float GPUProfiler::latestFrameTime = 0.f;
+std::vector<GPUProfiler::Timestamp> GPUProfiler::latestScopes;
+unsigned long GPUProfiler::resultsSequence = 0;
+
+std::vector<Profiler::ScopeTotal> GPUProfiler::readBackTotals;
+float GPUProfiler::readBackFrameTime = 0.f;
+std::vector<GPUProfiler::Timestamp> GPUProfiler::readBackScopes;
+unsigned long GPUProfiler::readBackFramesDropped = 0;
+unsigned GPUProfiler::readBackScopesDropped = 0;
+bool GPUProfiler::readBackPending = false;
+
+GPUProfiler::Scope::Scope(const char* name) : scopeIndex(-1) {
+    auto& frame = frames[currentFrame];
+    if (!frame.scopesRecorded) {
+        return;
+    }
+    if (frame.numScopes >= gpuProfilerMaxScopes) {
+        ++frame.numScopesDropped;
+        return;
+    }
+
+    scopeIndex = static_cast<int>(frame.numScopes++);
+    auto& scope = frame.scopes[scopeIndex];
+    scope.name = name;
+    glQueryCounter(scope.beginQuery, GL_TIMESTAMP);
+}
+
+GPUProfiler::Scope::~Scope() {
+    if (scopeIndex >= 0) {
+        glQueryCounter(frames[currentFrame].scopes[scopeIndex].endQuery, GL_TIMESTAMP);
+    }
+}
+
+void GPUProfiler::Initialize() {
+    supported = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    if (!supported) {
+        return;
+    }
+
+    queries.resize(gpuProfilerFrameLatency * queriesPerFrame);
+    glGenQueries(static_cast<GLsizei>(queries.size()), queries.data());
+
+    for (unsigned i = 0; i < gpuProfilerFrameLatency; ++i) {
+        auto& frame = frames[i];
+        const auto* frameQueries = queries.data() + i * queriesPerFrame;
+
+        for (unsigned scope = 0; scope < gpuProfilerMaxScopes; ++scope) {
+            frame.scopes[scope].beginQuery = frameQueries[2 * scope];
+            frame.scopes[scope].endQuery = frameQueries[2 * scope + 1];
+        }
+        frame.frameBeginQuery = frameQueries[queriesPerFrame - 2];
+        frame.frameEndQuery = frameQueries[queriesPerFrame - 1];
+        frame.numScopes = 0;
+        frame.numScopesDropped = 0;
+        frame.recorded = false;
+        frame.scopesRecorded = false;
+    }
+}
+
+void GPUProfiler::CleanUp() {
+    if (!queries.empty()) {
+        glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+        queries.clear();
+    }
+}
+
+void GPUProfiler::BeginFrame() {
+    currentFrame = (currentFrame + 1) % gpuProfilerFrameLatency;
+    auto& frame = frames[currentFrame];
+
+    if (frame.recorded) {
+        ReadBack(frame);
+    }
+
+    frame.numScopes = 0;
+    frame.numScopesDropped = 0;
+    frame.recorded = (enabled || frameTimeEnabled) && supported;
+    frame.scopesRecorded = enabled && supported;
+    if (frame.recorded) {
+        glQueryCounter(frame.frameBeginQuery, GL_TIMESTAMP);
+    }
+}
+
+void GPUProfiler::EndFrame() {
+    const auto& frame = frames[currentFrame];
+    if (frame.recorded) {
+        glQueryCounter(frame.frameEndQuery, GL_TIMESTAMP);
+    }
+}
+
+// Frames are recorded and read back on the render thread, while the results are read on the main thread. They are
+// handed over here, at a point where the render thread is known to be idle.
+void GPUProfiler::Publish() {
+    framesDropped = readBackFramesDropped;
+    if (!readBackPending) {
+        return;
+    }
+
+    latestFrameTime = readBackFrameTime;
+    scopesDropped = readBackScopesDropped;
+    latestTotals.swap(readBackTotals);
+    latestScopes.swap(readBackScopes);
+    readBackPending = false;
+    ++resultsSequence;
+}
+
+void GPUProfiler::AddConsumer() {
+    ++numConsumers;
+    enabled = true;
+}
+
+void GPUProfiler::RemoveConsumer() {
+    if (numConsumers) {
+        --numConsumers;
+    }
+    enabled = numConsumers > 0;
+}
+
+void GPUProfiler::AddFrameTimeConsumer() {
+    ++numFrameTimeConsumers;
+    frameTimeEnabled = true;
+}
+
+void GPUProfiler::RemoveFrameTimeConsumer() {
+    if (numFrameTimeConsumers) {
+        --numFrameTimeConsumers;
+    }
+    frameTimeEnabled = numFrameTimeConsumers > 0;
+}
+
+float GPUProfiler::GetScopeTime(const char* name) {
+    const auto* total = Profiler::FindScopeTotal(latestTotals, name);
+    return total ? total->milliseconds : 0.f;
+}
+
+float GPUProfiler::GetFrameTime() {
+    return latestFrameTime;
+}
+
+const std::vector<Profiler::ScopeTotal>& GPUProfiler::GetScopeTotals() {
+    return latestTotals;
+}
+
+const std::vector<GPUProfiler::Timestamp>& GPUProfiler::GetLatestScopes() {
+    return latestScopes;
+}
+
+unsigned long GPUProfiler::GetResultsSequence() {
+    return resultsSequence;
+}
+
+std::int64_t GPUProfiler::GetTimestamp() {
+    GLint64 timestamp = 0;
+    if (supported) {
+        glGetInteger64v(GL_TIMESTAMP, &timestamp);
+    }
+    return timestamp;
+}
+
+void GPUProfiler::ReadBack(Frame& frame) {
+    // Results older than the frame latency that are still pending are dropped instead of stalling.
+    GLint available = 0;
+    glGetQueryObjectiv(frame.frameEndQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        ++readBackFramesDropped;
+        return;
+    }
+
+    GLuint64 begin = 0;
+    GLuint64 end = 0;
+    glGetQueryObjectui64v(frame.frameBeginQuery, GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(frame.frameEndQuery, GL_QUERY_RESULT, &end);
+    readBackFrameTime = (end - begin) / 1e6f;
+
+    readBackScopes.clear();
+    readBackScopes.push_back({"Frame", begin, end});
+
+    readBackTotals.clear();
+    for (unsigned i = 0; i < frame.numScopes; ++i) {
+        const auto& scope = frame.scopes[i];
+        glGetQueryObjectui64v(scope.beginQuery, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(scope.endQuery, GL_QUERY_RESULT, &end);
+        readBackScopes.push_back({scope.name, begin, end});
+        readBackTotals.push_back({scope.name, end > begin ? (end - begin) / 1e6f : 0.f, 1});
+    }
+    Profiler::MergeScopeTotals(readBackTotals);
+    readBackScopesDropped = frame.numScopesDropped;
+    readBackPending = true;
+}
+
+} // namespace model_viewer_3d
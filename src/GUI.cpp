@@ -1,11 +1,35 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright (c) 2017 Vangelis Tsiatsianas
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <exception>
 #include <iostream>
 
+#include "AllocationTracker.h"
+#include "BoundingBoxOverlay.h"
 #include "Common.h"
+#include "DepthPrepass.h"
+#include "DynamicResolution.h"
 #include "Environment.h"
+#include "FrameStatistics.h"
+#include "GLState.h"
+#include "GPUProfiler.h"
+#include "GeometryPool.h"
 #include "GUI.h"
+#include "InputRecorder.h"
+#include "JobSystem.h"
+#include "LightClusters.h"
+#include "ModelImporter.h"
+#include "PathTracer.h"
+#include "Profiler.h"
+#include "RenderQueue.h"
+#include "RenderThread.h"
+#include "SceneGenerator.h"
+#include "ShadowMap.h"
+#include "StaticBatch.h"
+#include "TraceCapture.h"
 #include "Utilities.h"
 
 #include <fonts/IconsFontAwesome.h>
@@ -13,17 +37,22 @@
 #include <ImGUI/imgui.h>
 #include <ImGUI/imgui_impl_sdl_glew.h>
 
-namespace 3d_model_viewer {
+namespace model_viewer_3d {
 
 std::string fontsDirectory = std::string(rootDirectory) + "/res/fonts/";
 std::string playPauseButtonLabel = ICON_FA_PLAY;
 std::vector<const char *> acceptedFileTypes = { "*.fbx", "*.dae", "*.obj", "*.3ds", "*.blend", "*.md5mesh", "*.md5anim" };
 constexpr auto loadedModelsListHeightInItems = 6;
+constexpr auto queuedModelsLoadBudget = std::chrono::milliseconds(8);
+const ImVec4 pinnedModelColor = ImVec4(1.0f, 0.84f, 0.3f, 1.0f);
+const char* timedPasses[] = { "Scene", "DepthPrepass::Draw", "StaticBatch::Draw", "ShadowMap::Draw", "BoundingBoxOverlay::Draw", "DynamicResolution::Resolve", "PathTracer::Display", "ImGui::Render" };
 
 ImFont* fontAwesome = nullptr;
 
 bool GUI::showHelp = true;
 bool GUI::showMetrics = false;
+int GUI::modelTimingsSortColumn = 2;
+bool GUI::modelTimingsSortDescending = true;
 
 ImVec4 GUI::backgroundColor;
 
@@ -32,9 +61,31 @@ SDL_GLContext GUI::glContext = nullptr;
 Mix_Music* GUI::Audio::audioFile = nullptr;
 
 int GUI::selectedModelIndex;
-auto GUI::loadedModels = std::vector<PolygonMesh>();
-auto GUI::displayFunctions = std::vector<DisplayFunction>();
-auto GUI::internalDisplayFunctions = std::vector<DisplayFunction>();
+std::vector<PolygonMesh> GUI::loadedModels;
+std::vector<unsigned> GUI::filteredModels;
+std::thread GUI::fileDialogThread;
+std::atomic<bool> GUI::fileDialogOpen(false);
+std::mutex GUI::queuedModelsMutex;
+std::deque<std::string> GUI::queuedModels;
+std::atomic<unsigned> GUI::numQueuedModels(0);
+std::deque<std::shared_ptr<GUI::PendingImport>> GUI::pendingImports;
+std::shared_ptr<GUI::PendingScene> GUI::pendingScene;
+std::atomic<bool> GUI::closing(false);
+std::vector<std::string> GUI::importErrors;
+char GUI::modelFilter[modelFilterLength] = "";
+bool GUI::showPinnedModelsOnly = false;
+bool GUI::modelListChanged = true;
+std::vector<DisplayFunction> GUI::displayFunctions;
+std::vector<DisplayFunction> GUI::internalDisplayFunctions;
+
+static bool IsAcceptedFileType(const std::filesystem::path& path) {
+    auto extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    return std::any_of(acceptedFileTypes.begin(), acceptedFileTypes.end(), [&extension](const char* fileType) {
+        return extension == fileType + 1;
+    });
+}
 
 bool GUI::Initialize() {
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_AUDIO) != 0) {
@@ -51,7 +102,7 @@ bool GUI::Initialize() {
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
 
     SDL_DisplayMode current = SDL_DisplayMode();
     SDL_GetCurrentDisplayMode(0, &current);
@@ -63,6 +114,11 @@ bool GUI::Initialize() {
     }
 
     glContext = SDL_GL_CreateContext(window);
+    if (glContext == nullptr) {
+        // Some drivers, such as the ones on macOS, stop at OpenGL 4.1, in which case static geometry is not batched.
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+        glContext = SDL_GL_CreateContext(window);
+    }
     if (glContext == nullptr) {
         DisplayErrorMessage("Could not create OpenGL context! SDL error: " + std::string(SDL_GetError()));
         return false;
@@ -103,21 +159,67 @@ bool GUI::Initialize() {
     io.Fonts->Build();
 
     InstallInternalDisplayFunction(DisplayHelp);
+    InstallInternalDisplayFunction(DisplayImportErrors);
     InstallInternalDisplayFunction(DisplayMetrics);
+    InstallInternalDisplayFunction(Profiler::Display);
     InstallInternalDisplayFunction(DisplayWindowControls);
+    InstallInternalDisplayFunction(DisplayRenderingControls);
+    InstallInternalDisplayFunction(PathTracer::DisplayControls);
     InstallInternalDisplayFunction(DisplayModelControls);
 
+    Profiler::SetThreadName("Main Thread");
+    JobSystem::Initialize();
+    PathTracer::Initialize();
+    GLState::Initialize();
+    GPUProfiler::Initialize();
+    GeometryPool::Initialize();
+    StaticBatch::Initialize();
+    DepthPrepass::Initialize();
+    LightClusters::Initialize();
+    ShadowMap::Initialize();
+    BoundingBoxOverlay::Initialize();
+    DynamicResolution::Initialize();
+
     Environment::Initialize();
     InstallDisplayFunction(Environment::DisplayControls);
+    InstallDisplayFunction(LightClusters::DisplayControls);
+    InstallDisplayFunction(DisplaySceneGenerator);
+
+    InputRecorder::SetLoadModelHandler([](const std::string& path) { LoadModel(path); });
+
+    // An empty frame creates the ImGui device objects while the context is still current on this thread.
+    ImGui_Impl_NewFrame(window);
+    ImGui::Render();
+    RenderThread::Initialize(window, glContext);
 
     return true;
 }
 
 void GUI::ProcessEvent(SDL_Event* event) {
+    InputRecorder::RecordEvent(*event);
     ImGui_Impl_ProcessEvent(event);
 
+    // Closing the window has to work even while a replay drops all other live input.
+    if (event->type == SDL_QUIT) {
+        GUI::Close();
+        std::exit(EXIT_SUCCESS);
+    }
+
+    if (event->type == SDL_DROPFILE) {
+        QueueDroppedPath(event->drop.file);
+        SDL_free(event->drop.file);
+        return;
+    }
+
+    // Keystrokes typed into a text field belong to ImGui alone, so none of them reaches the hotkeys or the scene. Key
+    // releases still go through, so that a key held before the field took focus does not stay held.
+    const auto keyboardEvent = event->type == SDL_KEYDOWN || event->type == SDL_TEXTINPUT;
+    if (keyboardEvent && ImGui::GetIO().WantCaptureKeyboard) {
+        return;
+    }
+
     if (event->type == SDL_KEYDOWN) {
-        if (event->key.keysym.sym == SDLK_ESCAPE || event->type == SDL_QUIT) {
+        if (event->key.keysym.sym == SDLK_ESCAPE) {
             GUI::Close();
             std::exit(EXIT_SUCCESS);
         }
@@ -127,7 +229,13 @@ void GUI::ProcessEvent(SDL_Event* event) {
                 showHelp = !showHelp;
                 break;
             case SDLK_m:
-                showMetrics = !showMetrics;
+                ToggleMetrics();
+                break;
+            case SDLK_c:
+                TraceCapture::Start(TraceCapture::numFramesToCapture);
+                break;
+            case SDLK_p:
+                Profiler::Toggle();
                 break;
             case SDLK_o:
                 LoadModel();
@@ -142,6 +250,9 @@ void GUI::ProcessEvent(SDL_Event* event) {
             case SDLK_r:
                 LoadDefaultValues();
                 break;
+            case SDLK_t:
+                PathTracer::Toggle();
+                break;
             default:
                 break;
         }
@@ -154,13 +265,47 @@ void GUI::ProcessEvent(SDL_Event* event) {
     }
 }
 
+// The dialog runs on its own thread, so that the frame loop keeps going while it is open; the chosen files are
+// queued and loaded by LoadQueuedModels().
 void GUI::LoadModel() {
-    auto path = tinyfd_openFileDialog("", (rootDirectory + std::string("/res/models/")).c_str(),
-                                      acceptedFileTypes.size(), acceptedFileTypes.data(), nullptr, 0);
-    if (!path) {
+    // During replay the chosen file arrives as a recorded load action instead of through the dialog.
+    if (InputRecorder::IsReplaying() || fileDialogOpen) {
         return;
     }
 
+    if (fileDialogThread.joinable()) {
+        fileDialogThread.join();
+    }
+
+    fileDialogOpen = true;
+    fileDialogThread = std::thread([] {
+        const auto defaultPath = rootDirectory + std::string("/res/models/");
+        const auto* paths = tinyfd_openFileDialog("", defaultPath.c_str(), acceptedFileTypes.size(),
+                                                  acceptedFileTypes.data(), nullptr, 1);
+        // After Close() the thread is detached, so it must not queue paths into state that is being destroyed.
+        if (paths && !closing) {
+            // Multiple selections are separated by '|'.
+            const auto* pathsEnd = paths + std::strlen(paths);
+            for (auto* begin = paths; begin < pathsEnd;) {
+                const auto* end = std::find(begin, pathsEnd, '|');
+                if (end != begin) {
+                    QueueModel(std::string(begin, end));
+                }
+                begin = end + 1;
+            }
+        }
+
+        fileDialogOpen = false;
+    });
+}
+
+// Without an imported mesh, the file is imported by PolygonMesh::Initialize() on the render thread, which is how
+// replayed load actions stay in step with the recording.
+void GUI::LoadModel(const std::string& path, std::unique_ptr<ImportedMesh> importedMesh) {
+    PROFILE_SCOPE("GUI::LoadModel");
+
+    InputRecorder::RecordLoadModel(path);
+
     unsigned long id = 0;
     for (auto model = loadedModels.rbegin(); model != loadedModels.rend(); ++model) {
         if (model->name == Utilities::GetFilenameFromPath(path)) {
@@ -170,32 +315,128 @@ void GUI::LoadModel() {
     }
 
     try {
+        // Packets in flight point into loadedModels, which may be reallocated.
+        RenderThread::WaitForIdle();
         Environment::numObjects = loadedModels.size() + 1;
         loadedModels.emplace_back(PolygonMesh(path, id));
     } catch (const std::string& errorMessage) {
-        GUI::DisplayErrorMessage(errorMessage);
+        ReportImportError(errorMessage);
         Environment::numObjects = loadedModels.size();
         return;
     }
 
     auto* polygonMesh = &loadedModels.back();
-    polygonMesh->Initialize();
+    polygonMesh->importedMesh = std::move(importedMesh);
+    try {
+        RenderThread::Execute([polygonMesh] { polygonMesh->Initialize(); });
+    } catch (const std::string& errorMessage) {
+        ReportImportError(errorMessage);
+        loadedModels.pop_back();
+        Environment::numObjects = loadedModels.size();
+        return;
+    }
 
-    if (selectedModelIndex > -1) {
-        GetSelectedModel()->Deselect();
+    modelListChanged = true;
+    SelectModel(static_cast<int>(loadedModels.size()) - 1);
+}
+
+void GUI::QueueModel(const std::string& path) {
+    std::lock_guard<std::mutex> lock(queuedModelsMutex);
+    queuedModels.push_back(path);
+    ++numQueuedModels;
+}
+
+// Directories are imported recursively, skipping the files that the loader does not accept. The walk runs on a worker,
+// since a large tree takes a while to list.
+void GUI::QueueDroppedPath(const std::string& path) {
+    auto error = std::error_code();
+    if (!std::filesystem::is_directory(path, error)) {
+        QueueModel(path);
+        return;
     }
-    selectedModelIndex = static_cast<int>(loadedModels.size()) - 1;
-    GetSelectedModel()->Select();
 
-    Environment::camera.focusOnOrigin = false;
+    JobSystem::Schedule("GUI::QueueDirectory", [path] {
+        auto paths = std::vector<std::string>();
+        auto error = std::error_code();
+        const auto options = std::filesystem::directory_options::skip_permission_denied;
+        for (auto entry = std::filesystem::recursive_directory_iterator(path, options, error);
+             !closing && !error && entry != std::filesystem::recursive_directory_iterator(); entry.increment(error)) {
+            if (entry->is_regular_file(error) && IsAcceptedFileType(entry->path())) {
+                paths.push_back(entry->path().string());
+            }
+        }
+
+        std::sort(paths.begin(), paths.end());
+        for (const auto& modelPath : paths) {
+            QueueModel(modelPath);
+        }
+    }, JobPriority::Background);
+}
+
+// Every queued model is imported on a worker. Finished imports are added to the scene and uploaded here, at the start
+// of the frame, in the order they were queued, until the frame's budget for uploads runs out.
+void GUI::LoadQueuedModels() {
+    if (!numQueuedModels) {
+        return;
+    }
+
+    auto paths = std::deque<std::string>();
+    {
+        std::lock_guard<std::mutex> lock(queuedModelsMutex);
+        paths.swap(queuedModels);
+    }
+
+    for (auto& path : paths) {
+        auto pendingImport = std::make_shared<PendingImport>();
+        pendingImport->path = std::move(path);
+        pendingImport->job = JobSystem::Schedule("ModelImporter::Import", [pendingImport] {
+            if (closing) {
+                return;
+            }
+
+            try {
+                PolygonMesh::ValidatePath(pendingImport->path);
+                pendingImport->importedMesh = ModelImporter::Import(pendingImport->path);
+            } catch (const std::string& errorMessage) {
+                pendingImport->errorMessage = errorMessage;
+            } catch (const std::exception& exception) {
+                pendingImport->errorMessage = "Could not import \"" + pendingImport->path + "\": " + exception.what();
+            } catch (...) {
+                pendingImport->errorMessage = "Could not import \"" + pendingImport->path + "\".";
+            }
+        }, JobPriority::Background);
+        pendingImports.push_back(std::move(pendingImport));
+    }
+
+    const auto start = Utilities::GetCurrentTime();
+    while (!pendingImports.empty() && JobSystem::IsFinished(pendingImports.front()->job) &&
+           Utilities::GetCurrentTime() - start < queuedModelsLoadBudget) {
+        const auto pendingImport = std::move(pendingImports.front());
+        pendingImports.pop_front();
+        --numQueuedModels;
+
+        if (!pendingImport->errorMessage.empty()) {
+            ReportImportError(pendingImport->errorMessage);
+        } else {
+            LoadModel(pendingImport->path, std::move(pendingImport->importedMesh));
+        }
+    }
+}
+
+// Failed imports are listed in one window rather than a message box each, which would stall the frame loop once per
+// file of a batch.
+void GUI::ReportImportError(const std::string& errorMessage) {
+    importErrors.push_back(errorMessage);
+    std::cerr << errorMessage << std::endl;
 }
 
 void GUI::UnloadSelectedModel() {
     if (!loadedModels.empty() && selectedModelIndex < loadedModels.size()) {
         auto selectedModel = GetSelectedModel();
         selectedModel->Deselect();
-        selectedModel->CleanUp();
+        RenderThread::Execute([selectedModel] { selectedModel->CleanUp(); });
         loadedModels.erase(loadedModels.begin() + selectedModelIndex);
+        ShadowMap::Invalidate();
 
         --selectedModelIndex;
         auto newSelectedModel = GetSelectedModel();
@@ -207,9 +448,56 @@ void GUI::UnloadSelectedModel() {
         if (!Environment::numObjects) {
             Environment::camera.focusOnOrigin = true;
         }
+
+        modelListChanged = true;
     }
 }
 
+void GUI::SelectModel(int index) {
+    auto* oldSelectedModel = GetSelectedModel();
+    if (oldSelectedModel) {
+        oldSelectedModel->Deselect();
+    }
+
+    selectedModelIndex = index;
+    auto* selectedModel = GetSelectedModel();
+    assert(selectedModel);
+    selectedModel->Select();
+
+    Environment::camera.focusOnOrigin = false;
+}
+
+void GUI::TogglePinned(PolygonMesh& model) {
+    model.pinned = !model.pinned;
+    if (showPinnedModelsOnly) {
+        modelListChanged = true;
+    }
+}
+
+// Rebuilt only when the models, the search text or the filter change, so that the list itself never walks every model.
+void GUI::UpdateModelFilter() {
+    const auto filterLength = std::strlen(modelFilter);
+    const auto caseInsensitiveEqual = [](char lhs, char rhs) {
+        return std::tolower(static_cast<unsigned char>(lhs)) == std::tolower(static_cast<unsigned char>(rhs));
+    };
+
+    filteredModels.clear();
+    for (unsigned i = 0; i < loadedModels.size(); ++i) {
+        const auto& model = loadedModels[i];
+        if (showPinnedModelsOnly && !model.pinned) {
+            continue;
+        }
+
+        const auto* name = model.formattedNameCString.get();
+        const auto* nameEnd = name + model.formattedName.length();
+        if (!filterLength || std::search(name, nameEnd, modelFilter, modelFilter + filterLength, caseInsensitiveEqual) != nameEnd) {
+            filteredModels.push_back(i);
+        }
+    }
+
+    modelListChanged = false;
+}
+
 void GUI::InstallDisplayFunction(DisplayFunction displayFunction) {
     displayFunctions.push_back(displayFunction);
 }
@@ -219,7 +507,7 @@ void GUI::InstallInternalDisplayFunction(DisplayFunction displayFunction) {
 }
 
 void GUI::DisplayWindowControls() {
-    ImGui::SetNextWindowSize(ImVec2(400, windowHeight - 220), ImGuiSetCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(400, windowHeight - 260), ImGuiSetCond_FirstUseEver);
     ImGui::SetNextWindowPos(ImVec2(10, 10));
 
     ImGui::Begin("Options");
@@ -237,6 +525,34 @@ void GUI::DisplayWindowControls() {
     ImGui::End();
 }
 
+void GUI::DisplayRenderingControls() {
+    ImGui::Begin("Options");
+
+    if (ImGui::CollapsingHeader("Rendering")) {
+        ImGui::Indent(15);
+        if (StaticBatch::supported) {
+            ImGui::Checkbox("Batch Static Geometry", &StaticBatch::enabled);
+            ImGui::Text("Batched Objects: %u (%u draw commands)", StaticBatch::numObjects.load(),
+                        StaticBatch::numCommands.load());
+            ImGui::Text("Command Rebuilds: %u", StaticBatch::numRebuilds.load());
+        } else {
+            ImGui::Text("Batching static geometry requires OpenGL 4.3.");
+        }
+        ImGui::Checkbox("Sort Draws by State and Depth", &RenderQueue::enabled);
+        ImGui::Checkbox("Depth Pre-Pass", &DepthPrepass::enabled);
+        ImGui::Checkbox("Shadows", &ShadowMap::enabled);
+        if (ShadowMap::enabled) {
+            ImGui::Text("Shadow Map Updates: %u static (last %.1f%%), %u dynamic", ShadowMap::numStaticUpdates,
+                        ShadowMap::staticUpdateCoverage * 100.f, ShadowMap::numDynamicUpdates);
+        }
+        ImGui::Text("Bounding Boxes: %u (1 draw call)", BoundingBoxOverlay::numBoxes.load());
+        ImGui::Unindent(15);
+        ImGui::Spacing();
+    }
+
+    ImGui::End();
+}
+
 void GUI::DisplayAudioControls() {
     ImGui::Begin("Options");
 
@@ -272,9 +588,55 @@ void GUI::DisplayAudioControls() {
     ImGui::End();
 }
 
+// The meshes are generated on a worker, and LoadGeneratedScene() makes objects of them once they are ready. Requests made
+// while a scene is being generated are ignored.
+void GUI::DisplaySceneGenerator() {
+    if (!SceneGenerator::DisplayControls() || pendingScene) {
+        return;
+    }
+
+    const auto settings = SceneGenerator::settings;
+    const auto scene = std::make_shared<PendingScene>();
+    scene->job = JobSystem::Schedule("SceneGenerator::GenerateMeshes", [scene, settings] {
+        if (closing) {
+            return;
+        }
+
+        try {
+            scene->scene = SceneGenerator::GenerateMeshes(settings);
+        } catch (const std::exception& exception) {
+            scene->errorMessage = std::string("Could not generate the scene: ") + exception.what();
+        }
+    }, JobPriority::Background);
+    pendingScene = scene;
+}
+
+void GUI::LoadGeneratedScene() {
+    if (!pendingScene || !JobSystem::IsFinished(pendingScene->job)) {
+        return;
+    }
+
+    const auto scene = std::move(pendingScene);
+    pendingScene = nullptr;
+    if (!scene->errorMessage.empty()) {
+        DisplayErrorMessage(scene->errorMessage);
+        return;
+    }
+
+    if (selectedModelIndex > -1) {
+        GetSelectedModel()->Deselect();
+        selectedModelIndex = -1;
+    }
+
+    // Only the upload has to happen on the render thread.
+    RenderThread::Execute([&scene] { SceneGenerator::Instantiate(scene->scene, loadedModels); });
+    ShadowMap::Invalidate();
+    modelListChanged = true;
+}
+
 void GUI::DisplayModelControls() {
-    ImGui::SetNextWindowSize(ImVec2(400, 190), ImGuiSetCond_FirstUseEver);
-    ImGui::SetNextWindowPos(ImVec2(10, windowHeight - 200));
+    ImGui::SetNextWindowSize(ImVec2(400, 230), ImGuiSetCond_FirstUseEver);
+    ImGui::SetNextWindowPos(ImVec2(10, windowHeight - 240));
 
     ImGui::Begin("Loaded Models");
 
@@ -289,34 +651,55 @@ void GUI::DisplayModelControls() {
             selectedModelIndex = static_cast<unsigned>(loadedModels.size() - 1);
         }
     }
+    ImGui::SameLine(0.0f, 10.0f);
+    auto* selectedModel = GetSelectedModel();
+    if (ImGui::Button(selectedModel && selectedModel->pinned ? "Unpin" : "Pin") && selectedModel) {
+        TogglePinned(*selectedModel);
+    }
     ImGui::Spacing();
 
-    auto numLoadedModels = static_cast<int>(loadedModels.size());
-    if (ImGui::ListBoxHeader("", numLoadedModels, loadedModelsListHeightInItems)) {
-        for (unsigned i = 0; i < numLoadedModels; ++i) {
-            const auto isSelectedModel = (i == selectedModelIndex);
-            const auto& loadedModel = loadedModels[i];
-            const char* itemText = loadedModel.id != "0" ? (loadedModel.name + " " + loadedModel.id).c_str()
-                                                         : (loadedModel.name).c_str();
-
-            ImGui::PushID(i);
-            if (ImGui::Selectable(itemText, isSelectedModel)) {
-                auto oldSelectedModel = GetSelectedModel();
-                if (oldSelectedModel) {
-                    oldSelectedModel->Deselect();
-                }
+    if (ImGui::InputText("Search" "##Loaded Models", modelFilter, modelFilterLength)) {
+        modelListChanged = true;
+    }
+    ImGui::SameLine(0.0f, 10.0f);
+    if (ImGui::Checkbox("Pinned Only" "##Loaded Models", &showPinnedModelsOnly)) {
+        modelListChanged = true;
+    }
 
-                selectedModelIndex = i;
-                auto selectedModel = GetSelectedModel();
-                assert(selectedModel);
-                selectedModel->Select();
+    if (modelListChanged) {
+        UpdateModelFilter();
+    }
 
-                if (Environment::camera.focusOnOrigin) {
-                    Environment::camera.focusOnOrigin = false;
-                }
+    const auto numFilteredModels = static_cast<int>(filteredModels.size());
+    ImGui::Text("Showing %d of %u models (right click to pin)", numFilteredModels, static_cast<unsigned>(loadedModels.size()));
+    if (numQueuedModels) {
+        ImGui::SameLine(0.0f, 10.0f);
+        ImGui::Text("(%u queued)", numQueuedModels.load());
+    }
+
+    if (ImGui::ListBoxHeader("##Loaded Models List", numFilteredModels, loadedModelsListHeightInItems)) {
+        // Only the rows scrolled into view are submitted; the clipper reserves the space of the others.
+        ImGuiListClipper clipper(numFilteredModels, ImGui::GetTextLineHeightWithSpacing());
+        for (auto row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+            const auto i = filteredModels[row];
+            auto& loadedModel = loadedModels[i];
+
+            ImGui::PushID(static_cast<int>(i));
+            if (loadedModel.pinned) {
+                ImGui::PushStyleColor(ImGuiCol_Text, pinnedModelColor);
+            }
+            if (ImGui::Selectable(loadedModel.formattedNameCString.get(), static_cast<int>(i) == selectedModelIndex)) {
+                SelectModel(static_cast<int>(i));
+            }
+            if (loadedModel.pinned) {
+                ImGui::PopStyleColor();
+            }
+            if (ImGui::IsItemClicked(1)) {
+                TogglePinned(loadedModel);
             }
             ImGui::PopID();
         }
+        clipper.End();
         ImGui::ListBoxFooter();
     }
 
@@ -327,20 +710,133 @@ void GUI::DisplayMetrics() {
     if (showMetrics) {
         ImGui::SetNextWindowPos(ImVec2(windowWidth - 415, windowHeight - 224), ImGuiSetCond_FirstUseEver);
         ImGui::ShowMetricsWindow();
+
+        DisplayFrameTimings();
+    }
+}
+
+void GUI::DisplayFrameTimings() {
+    static std::vector<std::pair<float, float>> modelTimings;
+    static std::vector<unsigned> modelOrder;
+
+    ImGui::SetNextWindowSize(ImVec2(420, 300), ImGuiSetCond_FirstUseEver);
+    ImGui::SetNextWindowPos(ImVec2(windowWidth - 845, windowHeight - 310), ImGuiSetCond_FirstUseEver);
+
+    ImGui::Begin("Frame Timings");
+
+    if (!GPUProfiler::supported) {
+        ImGui::Text("GPU timer queries are not supported.");
+    }
+    ImGui::Text("GPU Frame: %.3f ms (%lu results dropped)", GPUProfiler::GetFrameTime(), GPUProfiler::framesDropped);
+    if (GPUProfiler::scopesDropped) {
+        ImGui::TextColored(ImVec4(1.f, .6f, 0.f, 1.f), "%u GPU scopes over the limit of %u were not timed",
+                           GPUProfiler::scopesDropped, gpuProfilerMaxScopes);
+    }
+    DynamicResolution::DisplayControls();
+    ImGui::Spacing();
+
+    if (ImGui::CollapsingHeader("Passes")) {
+        ImGui::Columns(3, "##Pass Timings");
+        ImGui::Text("Pass");
+        ImGui::NextColumn();
+        ImGui::Text("CPU (ms)");
+        ImGui::NextColumn();
+        ImGui::Text("GPU (ms)");
+        ImGui::NextColumn();
+        ImGui::Separator();
+
+        for (const auto* pass : timedPasses) {
+            ImGui::Text("%s", pass);
+            ImGui::NextColumn();
+            ImGui::Text("%.3f", Profiler::GetScopeTime(pass));
+            ImGui::NextColumn();
+            ImGui::Text("%.3f", GPUProfiler::GetScopeTime(pass));
+            ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+    }
+
+    if (ImGui::CollapsingHeader("Models")) {
+        const auto numLoadedModels = static_cast<unsigned>(loadedModels.size());
+        modelTimings.resize(numLoadedModels);
+        modelOrder.resize(numLoadedModels);
+        for (unsigned i = 0; i < numLoadedModels; ++i) {
+            modelTimings[i].first = Profiler::GetScopeTime(loadedModels[i].displayScopeName);
+            modelTimings[i].second = GPUProfiler::GetScopeTime(loadedModels[i].displayScopeName);
+            modelOrder[i] = i;
+        }
+
+        std::sort(modelOrder.begin(), modelOrder.end(), [](unsigned lhs, unsigned rhs) {
+            if (modelTimingsSortColumn == 0) {
+                const auto order = std::strcmp(loadedModels[lhs].formattedNameCString.get(),
+                                               loadedModels[rhs].formattedNameCString.get());
+                return modelTimingsSortDescending ? order > 0 : order < 0;
+            }
+
+            const auto lhsTime = modelTimingsSortColumn == 1 ? modelTimings[lhs].first : modelTimings[lhs].second;
+            const auto rhsTime = modelTimingsSortColumn == 1 ? modelTimings[rhs].first : modelTimings[rhs].second;
+            return modelTimingsSortDescending ? lhsTime > rhsTime : lhsTime < rhsTime;
+        });
+
+        const char* columnTitles[] = { "Model", "CPU (ms)", "GPU (ms)" };
+        ImGui::Columns(3, "##Model Timings");
+        for (int column = 0; column < 3; ++column) {
+            if (ImGui::Selectable(columnTitles[column], modelTimingsSortColumn == column)) {
+                modelTimingsSortDescending = modelTimingsSortColumn == column ? !modelTimingsSortDescending : true;
+                modelTimingsSortColumn = column;
+            }
+            ImGui::NextColumn();
+        }
+        ImGui::Separator();
+
+        for (const auto i : modelOrder) {
+            ImGui::Text("%s", loadedModels[i].formattedNameCString.get());
+            ImGui::NextColumn();
+            ImGui::Text("%.3f", modelTimings[i].first);
+            ImGui::NextColumn();
+            ImGui::Text("%.3f", modelTimings[i].second);
+            ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+    }
+
+    FrameStatistics::DisplayControls();
+    JobSystem::DisplayControls();
+    GeometryPool::DisplayControls();
+    GLState::DisplayControls();
+    AllocationTracker::DisplayControls();
+    TraceCapture::DisplayControls();
+
+    ImGui::End();
+}
+
+void GUI::ToggleMetrics() {
+    showMetrics = !showMetrics;
+
+    if (showMetrics) {
+        Profiler::AddConsumer();
+        GPUProfiler::AddConsumer();
+    } else {
+        Profiler::RemoveConsumer();
+        GPUProfiler::RemoveConsumer();
     }
 }
 
 void GUI::DisplayHelp() {
     if (showHelp) {
-        ImGui::SetNextWindowSize(ImVec2(260, 294), ImGuiSetCond_FirstUseEver);
+        ImGui::SetNextWindowSize(ImVec2(260, 312), ImGuiSetCond_FirstUseEver);
         ImGui::SetNextWindowPos(ImVec2(windowWidth - 270, 10), ImGuiSetCond_FirstUseEver);
 
         ImGui::Begin("Help");
 
         ImGui::Text("H: Show/Hide Help"
                     "\nM: Show/Hide Metrics"
+                    "\nP: Show/Hide Profiler"
+                    "\nC: Capture Trace"
                     "\nR: Reset Defaults"
-                    "\n\nO: Add Model"
+                    "\nT: Toggle Reference Renderer"
+                    "\n\nO: Add Models"
+                    "\nDrop Files/Folders: Add Models"
                     "\nBackspace/Delete: Remove Model"
                     "\n\nW: Toggle Wireframe"
                     "\nB: Toggle Bounding Boxes"
@@ -355,6 +851,29 @@ void GUI::DisplayHelp() {
     }
 }
 
+void GUI::DisplayImportErrors() {
+    if (importErrors.empty()) {
+        return;
+    }
+
+    ImGui::SetNextWindowSize(ImVec2(480, 200), ImGuiSetCond_FirstUseEver);
+    ImGui::SetNextWindowPos(ImVec2(windowWidth / 2 - 240, 10), ImGuiSetCond_FirstUseEver);
+
+    auto open = true;
+    ImGui::Begin("Import Errors", &open);
+    ImGui::Text("%u models could not be imported.", static_cast<unsigned>(importErrors.size()));
+    if (ImGui::ListBoxHeader("##Import Errors List", ImVec2(-1, -ImGui::GetTextLineHeightWithSpacing() * 2))) {
+        for (const auto& importError : importErrors) {
+            ImGui::TextWrapped("%s", importError.c_str());
+        }
+        ImGui::ListBoxFooter();
+    }
+    if (ImGui::Button("Dismiss" "##Import Errors") || !open) {
+        importErrors.clear();
+    }
+    ImGui::End();
+}
+
 void GUI::LoadDefaultValues() {
     backgroundColor = ImColor(64, 64, 64, 255);
     selectedModelIndex = -1;
@@ -374,10 +893,14 @@ void GUI::DisplayErrorMessage(const std::string& errorMessage) {
 }
 
 void GUI::Display() {
-    ImGui_Impl_NewFrame(window);
+    PROFILE_SCOPE("GUI::Display");
+
+    JobSystem::RunMainThreadJobs();
+    LoadQueuedModels();
+    LoadGeneratedScene();
 
-    glClearColor(backgroundColor.x, backgroundColor.y, backgroundColor.z, backgroundColor.w);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    auto& packet = RenderThread::BeginPacket();
+    ImGui_Impl_NewFrame(window);
 
     ImGui::Begin("Options");
 
@@ -399,25 +922,65 @@ void GUI::Display() {
         }
     }
 
+    Profiler::SetCounter("Loaded Models", static_cast<double>(loadedModels.size()));
+    Profiler::SetCounter("GPU Frame (ms)", GPUProfiler::GetFrameTime());
+    Profiler::SetCounter("Resolution Scale", DynamicResolution::scale);
+
     if (!loadedModels.empty()) {
         ImGui::Text("Loaded Models");
         ImGui::Spacing();
 
+        // Control panels are only emitted for the selected model and the pinned ones.
+        auto* selectedModel = GetSelectedModel();
+        if (selectedModel) {
+            selectedModel->DisplayControls();
+        } else {
+            ImGui::TextWrapped("Select a model in the Loaded Models list to edit it.");
+        }
+
         for (auto &model : loadedModels) {
-            model.DisplayControls();
-            model.Display();
+            if (model.pinned && &model != selectedModel) {
+                model.DisplayControls();
+            }
+            if (!PathTracer::enabled) {
+                model.Prepare(packet);
+            }
         }
     }
 
     ImGui::End();
 
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    PathTracer::Update(loadedModels, backgroundColor);
+    packet.pathTracing = PathTracer::enabled;
+    packet.backgroundColor = backgroundColor;
 
     ImGui::Render();
-    SDL_GL_SwapWindow(window);
+    RenderThread::Submit();
 }
 
 void GUI::Close() {
+    // Pending imports are dropped rather than added to a scene that is going away.
+    closing = true;
+
+    // An open dialog cannot be cancelled, so the viewer exits without waiting for it to be dismissed. The dialog thread
+    // sees closing and drops whatever was chosen.
+    if (fileDialogThread.joinable()) {
+        fileDialogOpen ? fileDialogThread.detach() : fileDialogThread.join();
+    }
+
+    JobSystem::CleanUp();
+    RenderThread::CleanUp();
+    InputRecorder::CleanUp();
+    FrameStatistics::CleanUp();
+    GPUProfiler::CleanUp();
+    DynamicResolution::CleanUp();
+    BoundingBoxOverlay::CleanUp();
+    ShadowMap::CleanUp();
+    LightClusters::CleanUp();
+    DepthPrepass::CleanUp();
+    StaticBatch::CleanUp();
+    GeometryPool::CleanUp();
+    PathTracer::CleanUp();
     Audio::CleanUp();
     ImGui_Impl_Shutdown();
     SDL_GL_DeleteContext(glContext);
@@ -480,4 +1043,4 @@ void GUI::Audio::CleanUp() {
     displayFunctions.clear();
 }
 
-} // namespace 3d_model_viewer
+} // namespace model_viewer_3d
@@ -0,0 +1,499 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+
+#include "GLState.h"
+#include "GeometryPool.h"
+#include "Profiler.h"
+
+#include <glGA/glGAHelper.h>
+#include <ImGUI/imgui.h>
+
+namespace model_viewer_3d {
+
+std::array<GeometryPool::Arena, numVertexFormats> GeometryPool::vertexArenas;
+GeometryPool::Arena GeometryPool::indexArena;
+std::array<GLuint, numVertexFormats> GeometryPool::vertexArrays;
+std::array<GLuint, numVertexFormats> GeometryPool::positionOnlyVertexArrays;
+GLuint GeometryPool::drawIDBuffer = 0;
+GLsizeiptr GeometryPool::drawIDCapacity = 0;
+
+std::vector<GeometryPool::Geometry> GeometryPool::geometries;
+std::vector<int> GeometryPool::freeGeometries;
+unsigned GeometryPool::generation = 0;
+int GeometryPool::unitCube = -1;
+
+std::array<GeometryPool::ArenaStatistics, numVertexFormats + 1> GeometryPool::statistics;
+std::atomic<unsigned> GeometryPool::numAllocations(0);
+std::atomic<unsigned> GeometryPool::numDefragmentations(0);
+std::atomic<bool> GeometryPool::defragmentRequested(false);
+
+static GLsizeiptr GetVertexSize(VertexFormat format) {
+    switch (format) {
+        case VertexFormat::Position:
+            return sizeof(glm::vec3);
+        case VertexFormat::PositionNormal:
+            return sizeof(PositionNormalVertex);
+        case VertexFormat::PositionNormalTexCoord:
+            return sizeof(PositionNormalTexCoordVertex);
+        case VertexFormat::Skinned:
+            return sizeof(SkinnedVertex);
+    }
+    return 0;
+}
+
+static std::vector<GLuint> MakeDrawIDs(GLsizeiptr count) {
+    std::vector<GLuint> drawIDs(static_cast<std::size_t>(count));
+    std::iota(drawIDs.begin(), drawIDs.end(), 0u);
+    return drawIDs;
+}
+
+void GeometryPool::Initialize() {
+    const char* arenaNames[] = { "Position", "Position + Normal", "Position + Normal + UV", "Skinned" };
+
+    for (unsigned i = 0; i < numVertexFormats; ++i) {
+        auto& arena = vertexArenas[i];
+        arena.name = arenaNames[i];
+        arena.elementSize = GetVertexSize(static_cast<VertexFormat>(i));
+        arena.buffer = 0;
+        arena.capacity = 0;
+        arena.freeRanges.clear();
+        Grow(arena, geometryPoolInitialVertexCapacity);
+    }
+
+    indexArena.name = "Indices";
+    indexArena.elementSize = sizeof(GLuint);
+    indexArena.buffer = 0;
+    indexArena.capacity = 0;
+    indexArena.freeRanges.clear();
+    Grow(indexArena, geometryPoolInitialIndexCapacity);
+
+    drawIDCapacity = 0;
+    glGenBuffers(1, &drawIDBuffer);
+    ReserveDrawIDs(geometryPoolInitialDrawIDCapacity);
+
+    glGenVertexArrays(static_cast<GLsizei>(vertexArrays.size()), vertexArrays.data());
+    glGenVertexArrays(static_cast<GLsizei>(positionOnlyVertexArrays.size()), positionOnlyVertexArrays.data());
+    for (unsigned i = 0; i < numVertexFormats; ++i) {
+        SetupVertexArray(static_cast<VertexFormat>(i));
+    }
+
+    const glm::vec3 cubeVertices[] = {
+        {-0.5f, -0.5f,  0.5f}, {-0.5f,  0.5f,  0.5f}, { 0.5f,  0.5f,  0.5f}, { 0.5f, -0.5f,  0.5f},
+        {-0.5f, -0.5f, -0.5f}, {-0.5f,  0.5f, -0.5f}, { 0.5f,  0.5f, -0.5f}, { 0.5f, -0.5f, -0.5f}
+    };
+    const std::vector<GLuint> cubeIndices = {
+        0, 1, 1, 2, 2, 3, 3, 0,
+        4, 5, 5, 6, 6, 7, 7, 4,
+        0, 4, 1, 5, 2, 6, 3, 7
+    };
+    unitCube = Allocate(VertexFormat::Position, cubeVertices, 8, cubeIndices,
+                        {{static_cast<GLuint>(cubeIndices.size()), 0, 0}});
+}
+
+void GeometryPool::CleanUp() {
+    GLState::DeleteVertexArrays(static_cast<GLsizei>(vertexArrays.size()), vertexArrays.data());
+    GLState::DeleteVertexArrays(static_cast<GLsizei>(positionOnlyVertexArrays.size()), positionOnlyVertexArrays.data());
+    for (auto& arena : vertexArenas) {
+        GLState::DeleteBuffers(1, &arena.buffer);
+        arena.freeRanges.clear();
+    }
+    GLState::DeleteBuffers(1, &indexArena.buffer);
+    indexArena.freeRanges.clear();
+    GLState::DeleteBuffers(1, &drawIDBuffer);
+
+    geometries.clear();
+    freeGeometries.clear();
+    unitCube = -1;
+    numAllocations = 0;
+    ++generation;
+}
+
+// Runs on the render thread once per frame, before anything is drawn.
+void GeometryPool::Update() {
+    auto compacted = false;
+
+    const auto forced = defragmentRequested.exchange(false);
+    for (unsigned i = 0; i < numVertexFormats; ++i) {
+        if (forced || IsFragmented(vertexArenas[i])) {
+            Compact(vertexArenas[i], &Geometry::vertices, static_cast<int>(i));
+            compacted = true;
+        }
+    }
+    if (forced || IsFragmented(indexArena)) {
+        Compact(indexArena, &Geometry::indices, -1);
+        compacted = true;
+    }
+
+    if (compacted) {
+        ++numDefragmentations;
+        PublishStatistics();
+    }
+}
+
+int GeometryPool::Allocate(VertexFormat format, const void* vertices, std::size_t numVertices,
+                           const std::vector<GLuint>& indices, const std::vector<Submesh>& submeshes) {
+    PROFILE_SCOPE("GeometryPool::Allocate");
+
+    auto& vertexArena = vertexArenas[static_cast<unsigned>(format)];
+
+    Geometry geometry;
+    geometry.format = format;
+    geometry.allocated = true;
+
+    auto grown = AllocateRange(vertexArena, static_cast<GLsizeiptr>(numVertices), geometry.vertices);
+    grown = AllocateRange(indexArena, static_cast<GLsizeiptr>(indices.size()), geometry.indices) || grown;
+
+    // Growing replaces the buffer objects, which the vertex array objects have to be pointed at again.
+    if (grown) {
+        for (unsigned i = 0; i < numVertexFormats; ++i) {
+            SetupVertexArray(static_cast<VertexFormat>(i));
+        }
+    }
+
+    GLState::BindBuffer(GL_ARRAY_BUFFER, vertexArena.buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, geometry.vertices.offset * vertexArena.elementSize,
+                    static_cast<GLsizeiptr>(numVertices) * vertexArena.elementSize, vertices);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, indexArena.buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, geometry.indices.offset * indexArena.elementSize,
+                    static_cast<GLsizeiptr>(indices.size()) * indexArena.elementSize, indices.data());
+    GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
+
+    for (const auto& submesh : submeshes) {
+        geometry.submeshes.push_back({submesh.numIndices,
+                                      static_cast<GLuint>(geometry.indices.offset + submesh.firstIndex),
+                                      static_cast<GLint>(geometry.vertices.offset + submesh.baseVertex)});
+    }
+
+    auto index = static_cast<int>(geometries.size());
+    if (!freeGeometries.empty()) {
+        index = freeGeometries.back();
+        freeGeometries.pop_back();
+        geometries[index] = std::move(geometry);
+    } else {
+        geometries.push_back(std::move(geometry));
+    }
+
+    ++generation;
+    ++numAllocations;
+    PublishStatistics();
+    return index;
+}
+
+void GeometryPool::Free(int index) {
+    if (!IsAllocated(index)) {
+        return;
+    }
+
+    auto& geometry = geometries[index];
+    FreeRange(vertexArenas[static_cast<unsigned>(geometry.format)], geometry.vertices);
+    FreeRange(indexArena, geometry.indices);
+    geometry.submeshes.clear();
+    geometry.allocated = false;
+    freeGeometries.push_back(index);
+
+    ++generation;
+    --numAllocations;
+    PublishStatistics();
+}
+
+bool GeometryPool::IsAllocated(int geometry) {
+    return geometry >= 0 && static_cast<std::size_t>(geometry) < geometries.size() && geometries[geometry].allocated;
+}
+
+const GeometryPool::Geometry& GeometryPool::GetGeometry(int geometry) {
+    return geometries[geometry];
+}
+
+GLuint GeometryPool::GetVertexArray(VertexFormat format) {
+    return vertexArrays[static_cast<unsigned>(format)];
+}
+
+GLuint GeometryPool::GetPositionOnlyVertexArray(VertexFormat format) {
+    return positionOnlyVertexArrays[static_cast<unsigned>(format)];
+}
+
+// Growing or compacting an arena replaces its buffer, so these must be fetched again whenever the generation changes.
+GLuint GeometryPool::GetVertexBuffer(VertexFormat format) {
+    return vertexArenas[static_cast<unsigned>(format)].buffer;
+}
+
+GLuint GeometryPool::GetIndexBuffer() {
+    return indexArena.buffer;
+}
+
+int GeometryPool::GetUnitCube() {
+    return unitCube;
+}
+
+// Changes whenever geometry is allocated, freed or moved, which invalidates any offsets cached from GetGeometry().
+unsigned GeometryPool::GetGeneration() {
+    return generation;
+}
+
+// The draw ID attribute of every vertex array reads one value per instance from this buffer, offset by the base
+// instance of the draw, so that multi-draw commands can tell their per-draw data apart.
+void GeometryPool::ReserveDrawIDs(GLsizeiptr count) {
+    if (count <= drawIDCapacity) {
+        return;
+    }
+
+    drawIDCapacity = std::max(drawIDCapacity, geometryPoolInitialDrawIDCapacity);
+    while (drawIDCapacity < count) {
+        drawIDCapacity *= 2;
+    }
+
+    const auto drawIDs = MakeDrawIDs(drawIDCapacity);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, drawIDBuffer);
+    glBufferData(GL_ARRAY_BUFFER, drawIDCapacity * sizeof(GLuint), drawIDs.data(), GL_STATIC_DRAW);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryPool::DisplayControls() {
+    if (ImGui::CollapsingHeader("Geometry Memory")) {
+        ImGui::Text("Allocations: %u (%u defragmentations)", numAllocations.load(), numDefragmentations.load());
+        if (ImGui::Button("Defragment")) {
+            defragmentRequested = true;
+        }
+
+        ImGui::Columns(4, "##Geometry Arenas");
+        ImGui::Text("Arena");
+        ImGui::NextColumn();
+        ImGui::Text("Used (MB)");
+        ImGui::NextColumn();
+        ImGui::Text("Capacity (MB)");
+        ImGui::NextColumn();
+        ImGui::Text("Holes");
+        ImGui::NextColumn();
+        ImGui::Separator();
+
+        for (unsigned i = 0; i <= numVertexFormats; ++i) {
+            const auto& arenaStatistics = statistics[i];
+            ImGui::Text("%s", i < numVertexFormats ? vertexArenas[i].name : indexArena.name);
+            ImGui::NextColumn();
+            ImGui::Text("%.2f", arenaStatistics.used / (1024.f * 1024.f));
+            ImGui::NextColumn();
+            ImGui::Text("%.2f", arenaStatistics.capacity / (1024.f * 1024.f));
+            ImGui::NextColumn();
+            ImGui::Text("%u", arenaStatistics.numFreeRanges.load());
+            ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+    }
+}
+
+// First fit. When nothing fits, the arena doubles until the range can be taken from its end; returns whether it grew.
+// Empty ranges take nothing: in a full arena no free range would be found for them, and growing by nothing never adds
+// one. FreeRange() ignores them in turn.
+bool GeometryPool::AllocateRange(Arena& arena, GLsizeiptr size, Range& range) {
+    if (!size) {
+        range = {0, 0};
+        return false;
+    }
+
+    auto grown = false;
+    while (true) {
+        for (auto it = arena.freeRanges.begin(); it != arena.freeRanges.end(); ++it) {
+            if (it->size >= size) {
+                range = {it->offset, size};
+                it->offset += size;
+                it->size -= size;
+                if (!it->size) {
+                    arena.freeRanges.erase(it);
+                }
+                return grown;
+            }
+        }
+
+        auto capacity = arena.capacity;
+        while (capacity - arena.capacity < size) {
+            capacity *= 2;
+        }
+        Grow(arena, capacity);
+        grown = true;
+    }
+}
+
+// The free list is kept sorted by offset, so that neighbouring ranges can be merged back together.
+void GeometryPool::FreeRange(Arena& arena, const Range& range) {
+    if (!range.size) {
+        return;
+    }
+
+    auto& freeRanges = arena.freeRanges;
+    auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), range,
+                                 [](const Range& a, const Range& b) { return a.offset < b.offset; });
+    next = freeRanges.insert(next, range);
+
+    if (next + 1 != freeRanges.end() && next->offset + next->size == (next + 1)->offset) {
+        next->size += (next + 1)->size;
+        freeRanges.erase(next + 1);
+    }
+    if (next != freeRanges.begin() && (next - 1)->offset + (next - 1)->size == next->offset) {
+        (next - 1)->size += next->size;
+        freeRanges.erase(next);
+    }
+}
+
+void GeometryPool::Grow(Arena& arena, GLsizeiptr capacity) {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    GLState::BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, capacity * arena.elementSize, nullptr, GL_STATIC_DRAW);
+
+    if (arena.buffer) {
+        GLState::BindBuffer(GL_COPY_READ_BUFFER, arena.buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, arena.capacity * arena.elementSize);
+        GLState::BindBuffer(GL_COPY_READ_BUFFER, 0);
+        GLState::DeleteBuffers(1, &arena.buffer);
+    }
+    GLState::BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    const auto oldCapacity = arena.capacity;
+    arena.buffer = buffer;
+    arena.capacity = capacity;
+    FreeRange(arena, {oldCapacity, capacity - oldCapacity});
+}
+
+// An arena is compacted once the holes in front of its last free range add up to more than a quarter of it.
+bool GeometryPool::IsFragmented(const Arena& arena) {
+    if (arena.freeRanges.size() < 2) {
+        return false;
+    }
+
+    GLsizeiptr holes = 0;
+    for (std::size_t i = 0; i + 1 < arena.freeRanges.size(); ++i) {
+        holes += arena.freeRanges[i].size;
+    }
+    return holes * 4 > arena.capacity;
+}
+
+// Moves every live range of the arena to the front of a new buffer in offset order. A format of -1 selects every
+// geometry, which is how the shared index arena is compacted.
+void GeometryPool::Compact(Arena& arena, Range Geometry::*member, int format) {
+    PROFILE_SCOPE("GeometryPool::Compact");
+
+    std::vector<Geometry*> live;
+    for (auto& geometry : geometries) {
+        if (geometry.allocated && (format < 0 || static_cast<int>(geometry.format) == format)) {
+            live.push_back(&geometry);
+        }
+    }
+    std::sort(live.begin(), live.end(),
+              [member](const Geometry* a, const Geometry* b) { return (a->*member).offset < (b->*member).offset; });
+
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    GLState::BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, arena.capacity * arena.elementSize, nullptr, GL_STATIC_DRAW);
+    GLState::BindBuffer(GL_COPY_READ_BUFFER, arena.buffer);
+
+    GLsizeiptr offset = 0;
+    for (auto* geometry : live) {
+        auto& range = geometry->*member;
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range.offset * arena.elementSize,
+                            offset * arena.elementSize, range.size * arena.elementSize);
+
+        const auto delta = offset - range.offset;
+        for (auto& submesh : geometry->submeshes) {
+            if (member == &Geometry::indices) {
+                submesh.firstIndex = static_cast<GLuint>(submesh.firstIndex + delta);
+            } else {
+                submesh.baseVertex = static_cast<GLint>(submesh.baseVertex + delta);
+            }
+        }
+
+        range.offset = offset;
+        offset += range.size;
+    }
+
+    GLState::BindBuffer(GL_COPY_READ_BUFFER, 0);
+    GLState::BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    GLState::DeleteBuffers(1, &arena.buffer);
+
+    arena.buffer = buffer;
+    arena.freeRanges.clear();
+    if (offset < arena.capacity) {
+        arena.freeRanges.push_back({offset, arena.capacity - offset});
+    }
+
+    for (unsigned i = 0; i < numVertexFormats; ++i) {
+        SetupVertexArray(static_cast<VertexFormat>(i));
+    }
+    ++generation;
+}
+
+void GeometryPool::SetupVertexArray(VertexFormat format) {
+    const auto& arena = vertexArenas[static_cast<unsigned>(format)];
+    const auto stride = static_cast<GLsizei>(arena.elementSize);
+
+    GLState::BindVertexArray(vertexArrays[static_cast<unsigned>(format)]);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, arena.buffer);
+
+    glEnableVertexAttribArray(positionAttribute);
+    glVertexAttribPointer(positionAttribute, 3, GL_FLOAT, GL_FALSE, stride, BUFFER_OFFSET(0));
+
+    if (format != VertexFormat::Position) {
+        glEnableVertexAttribArray(normalAttribute);
+        glVertexAttribPointer(normalAttribute, 3, GL_FLOAT, GL_FALSE, stride,
+                              BUFFER_OFFSET(offsetof(PositionNormalVertex, normal)));
+    }
+
+    if (format == VertexFormat::PositionNormalTexCoord || format == VertexFormat::Skinned) {
+        glEnableVertexAttribArray(texCoordAttribute);
+        glVertexAttribPointer(texCoordAttribute, 2, GL_FLOAT, GL_FALSE, stride,
+                              BUFFER_OFFSET(offsetof(PositionNormalTexCoordVertex, texCoord)));
+    }
+
+    if (format == VertexFormat::Skinned) {
+        glEnableVertexAttribArray(boneIDsAttribute);
+        glVertexAttribIPointer(boneIDsAttribute, 4, GL_INT, stride, BUFFER_OFFSET(offsetof(SkinnedVertex, boneIDs)));
+        glEnableVertexAttribArray(weightsAttribute);
+        glVertexAttribPointer(weightsAttribute, 4, GL_FLOAT, GL_FALSE, stride,
+                              BUFFER_OFFSET(offsetof(SkinnedVertex, weights)));
+    }
+
+    GLState::BindBuffer(GL_ARRAY_BUFFER, drawIDBuffer);
+    glEnableVertexAttribArray(drawIDAttribute);
+    glVertexAttribIPointer(drawIDAttribute, 1, GL_UNSIGNED_INT, 0, BUFFER_OFFSET(0));
+    glVertexAttribDivisor(drawIDAttribute, 1);
+
+    GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexArena.buffer);
+
+    // The same arena with every attribute but the position left disabled, so that depth-only passes fetch less.
+    GLState::BindVertexArray(positionOnlyVertexArrays[static_cast<unsigned>(format)]);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, arena.buffer);
+    glEnableVertexAttribArray(positionAttribute);
+    glVertexAttribPointer(positionAttribute, 3, GL_FLOAT, GL_FALSE, stride, BUFFER_OFFSET(0));
+
+    GLState::BindBuffer(GL_ARRAY_BUFFER, drawIDBuffer);
+    glEnableVertexAttribArray(drawIDAttribute);
+    glVertexAttribIPointer(drawIDAttribute, 1, GL_UNSIGNED_INT, 0, BUFFER_OFFSET(0));
+    glVertexAttribDivisor(drawIDAttribute, 1);
+
+    GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexArena.buffer);
+
+    GLState::BindVertexArray(0);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryPool::PublishStatistics() {
+    for (unsigned i = 0; i <= numVertexFormats; ++i) {
+        const auto& arena = i < numVertexFormats ? vertexArenas[i] : indexArena;
+
+        GLsizeiptr unused = 0;
+        for (const auto& range : arena.freeRanges) {
+            unused += range.size;
+        }
+
+        auto& arenaStatistics = statistics[i];
+        arenaStatistics.capacity = static_cast<std::uint64_t>(arena.capacity * arena.elementSize);
+        arenaStatistics.used = static_cast<std::uint64_t>((arena.capacity - unused) * arena.elementSize);
+        arenaStatistics.numFreeRanges = static_cast<unsigned>(arena.freeRanges.size());
+    }
+}
+
+} // namespace model_viewer_3d
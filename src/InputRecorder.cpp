@@ -0,0 +1,226 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <cstring>
+
+#include "GUI.h"
+#include "InputRecorder.h"
+
+namespace model_viewer_3d {
+
+Time InputRecorder::frameTime = Utilities::GetCurrentTime();
+Time InputRecorder::lastRealFrameTime = frameTime;
+
+std::ofstream InputRecorder::recording;
+bool InputRecorder::recordingStarted = false;
+
+std::vector<InputRecorder::Frame> InputRecorder::replayFrames;
+std::size_t InputRecorder::replayFrame = 0;
+std::size_t InputRecorder::replayAction = 0;
+bool InputRecorder::replaying = false;
+bool InputRecorder::replayStarted = false;
+
+LoadModelHandler InputRecorder::loadModelHandler;
+
+template <typename T>
+static void WriteValue(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+static bool ReadValue(std::ifstream& file, T& value) {
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+bool InputRecorder::StartRecording(const std::string& path) {
+    if (replaying) {
+        return false;
+    }
+
+    recording.open(path, std::ios::binary | std::ios::trunc);
+    if (!recording) {
+        GUI::DisplayErrorMessage("Could not create input recording \"" + path + "\"!");
+        return false;
+    }
+
+    recording.write(inputRecordingMagic, sizeof(inputRecordingMagic));
+    WriteValue(recording, inputRecordingVersion);
+    WriteValue(recording, static_cast<std::uint32_t>(sizeof(SDL_Event)));
+
+    recordingStarted = false;
+    return true;
+}
+
+bool InputRecorder::StartReplay(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        GUI::DisplayErrorMessage("Could not open input recording \"" + path + "\"!");
+        return false;
+    }
+
+    char magic[sizeof(inputRecordingMagic)];
+    std::uint32_t version = 0;
+    std::uint32_t eventSize = 0;
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, inputRecordingMagic, sizeof(magic)) ||
+        !ReadValue(file, version) || version != inputRecordingVersion ||
+        !ReadValue(file, eventSize) || eventSize != sizeof(SDL_Event)) {
+        GUI::DisplayErrorMessage("\"" + path + "\" is not a compatible input recording!");
+        return false;
+    }
+
+    replayFrames.clear();
+
+    auto type = RecordType::Frame;
+    while (ReadValue(file, type)) {
+        if (type == RecordType::Frame) {
+            replayFrames.emplace_back();
+            if (!ReadValue(file, replayFrames.back().deltaTime)) {
+                break;
+            }
+            continue;
+        }
+
+        if (replayFrames.empty()) {
+            break;
+        }
+
+        auto action = Action();
+        action.type = type;
+        if (type == RecordType::Event) {
+            if (!ReadValue(file, action.event)) {
+                break;
+            }
+        } else if (type == RecordType::LoadModel) {
+            std::uint32_t length = 0;
+            if (!ReadValue(file, length)) {
+                break;
+            }
+            action.path.resize(length);
+            if (!file.read(&action.path[0], length)) {
+                break;
+            }
+        } else {
+            GUI::DisplayErrorMessage("\"" + path + "\" contains an unknown record type!");
+            break;
+        }
+        replayFrames.back().actions.push_back(std::move(action));
+    }
+
+    replayFrame = 0;
+    replayAction = 0;
+    replaying = true;
+    replayStarted = false;
+    frameTime = Utilities::GetCurrentTime();
+    return true;
+}
+
+void InputRecorder::CleanUp() {
+    if (recording.is_open()) {
+        recording.close();
+    }
+    replaying = false;
+    replayFrames.clear();
+}
+
+void InputRecorder::BeginFrame() {
+    const auto now = Utilities::GetCurrentTime();
+
+    if (replaying) {
+        if (replayStarted) {
+            ++replayFrame;
+        }
+        replayStarted = true;
+        replayAction = 0;
+
+        if (replayFrame < replayFrames.size()) {
+            frameTime += std::chrono::nanoseconds(replayFrames[replayFrame].deltaTime);
+        }
+        return;
+    }
+
+    if (recording.is_open()) {
+        const auto deltaTime = recordingStarted ? std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastRealFrameTime).count()
+                                                : 0;
+        recordingStarted = true;
+
+        WriteValue(recording, RecordType::Frame);
+        WriteValue(recording, static_cast<std::int64_t>(deltaTime));
+    }
+
+    lastRealFrameTime = now;
+    frameTime = now;
+}
+
+bool InputRecorder::PollEvent(SDL_Event* event) {
+    if (!replaying) {
+        return SDL_PollEvent(event);
+    }
+
+    // Live input is dropped during replay, except for requests to close the window.
+    while (SDL_PollEvent(event)) {
+        if (event->type == SDL_QUIT) {
+            return true;
+        }
+    }
+
+    while (replayFrame < replayFrames.size()) {
+        const auto& actions = replayFrames[replayFrame].actions;
+        if (replayAction >= actions.size()) {
+            return false;
+        }
+
+        const auto& action = actions[replayAction++];
+        if (action.type == RecordType::Event) {
+            *event = action.event;
+            return true;
+        }
+
+        if (action.type == RecordType::LoadModel && loadModelHandler) {
+            loadModelHandler(action.path);
+        }
+    }
+
+    return false;
+}
+
+void InputRecorder::RecordEvent(const SDL_Event& event) {
+    // Dropped files carry a pointer; the resulting model loads are recorded as actions instead.
+    if (!recording.is_open() || !recordingStarted || event.type == SDL_DROPFILE) {
+        return;
+    }
+
+    WriteValue(recording, RecordType::Event);
+    WriteValue(recording, event);
+}
+
+void InputRecorder::RecordLoadModel(const std::string& path) {
+    if (!recording.is_open() || !recordingStarted) {
+        return;
+    }
+
+    WriteValue(recording, RecordType::LoadModel);
+    WriteValue(recording, static_cast<std::uint32_t>(path.size()));
+    recording.write(path.data(), path.size());
+}
+
+void InputRecorder::SetLoadModelHandler(LoadModelHandler handler) {
+    loadModelHandler = std::move(handler);
+}
+
+const Time& InputRecorder::GetFrameTime() {
+    return frameTime;
+}
+
+bool InputRecorder::IsRecording() {
+    return recording.is_open();
+}
+
+bool InputRecorder::IsReplaying() {
+    return replaying;
+}
+
+bool InputRecorder::ReplayFinished() {
+    return replaying && replayFrame >= replayFrames.size();
+}
+
+} // namespace model_viewer_3d
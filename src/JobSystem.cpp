@@ -0,0 +1,502 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <exception>
+#include <string>
+
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <ImGUI/imgui.h>
+
+namespace model_viewer_3d {
+
+static_assert((jobSystemMaxJobs & (jobSystemMaxJobs - 1)) == 0, "The job queues wrap around a power of two.");
+
+std::unique_ptr<JobSystem::Job[]> JobSystem::jobs;
+std::vector<unsigned> JobSystem::freeJobs;
+std::mutex JobSystem::freeJobsMutex;
+std::mutex JobSystem::dependencyMutex;
+
+std::unique_ptr<JobSystem::Worker[]> JobSystem::workers;
+std::vector<std::thread> JobSystem::threads;
+unsigned JobSystem::numWorkers = 0;
+thread_local int JobSystem::workerIndex = -1;
+std::atomic<unsigned> JobSystem::nextWorker(0);
+
+JobSystem::Lanes JobSystem::mainThreadLanes;
+std::thread::id JobSystem::mainThreadId;
+
+std::mutex JobSystem::sleepMutex;
+std::condition_variable JobSystem::workAvailable;
+std::atomic<unsigned> JobSystem::numQueuedJobs(0);
+std::atomic<unsigned> JobSystem::numMainThreadJobs(0);
+std::atomic<unsigned> JobSystem::peakQueuedJobs(0);
+std::atomic<unsigned> JobSystem::numRunningWorkers(0);
+std::atomic<bool> JobSystem::stopping(false);
+
+std::uint64_t JobSystem::lastFrameEnd = 0;
+std::array<float, jobSystemHistoryFrames> JobSystem::queueDepthHistory = {};
+unsigned JobSystem::historyIndex = 0;
+unsigned JobSystem::jobsPerFrame = 0;
+unsigned JobSystem::stealsPerFrame = 0;
+
+bool JobSystem::Queue::PopBack(unsigned& index) {
+    if (head == tail) {
+        return false;
+    }
+
+    index = jobs[--tail % jobSystemMaxJobs];
+    return true;
+}
+
+bool JobSystem::Queue::PopFront(unsigned& index) {
+    if (head == tail) {
+        return false;
+    }
+
+    index = jobs[head++ % jobSystemMaxJobs];
+    return true;
+}
+
+void JobSystem::Queue::PushBack(unsigned index) {
+    jobs[tail++ % jobSystemMaxJobs] = index;
+}
+
+void JobSystem::Initialize(unsigned numWorkers) {
+    if (!numWorkers) {
+        numWorkers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    }
+    JobSystem::numWorkers = numWorkers;
+
+    jobs.reset(new Job[jobSystemMaxJobs]);
+    freeJobs.clear();
+    freeJobs.reserve(jobSystemMaxJobs);
+    for (auto i = jobSystemMaxJobs; i-- > 0;) {
+        jobs[i].generation = 0;
+        jobs[i].pendingDependencies = 0;
+        freeJobs.push_back(i);
+    }
+
+    for (auto& queue : mainThreadLanes.queues) {
+        queue.head = queue.tail = 0;
+    }
+
+    workers.reset(new Worker[numWorkers]);
+    for (unsigned i = 0; i < numWorkers; ++i) {
+        auto& worker = workers[i];
+        for (auto& queue : worker.lanes.queues) {
+            queue.head = queue.tail = 0;
+        }
+        worker.busyTime = 0;
+        worker.jobsExecuted = 0;
+        worker.jobsStolen = 0;
+        worker.threadName = Profiler::Intern("Job Worker " + std::to_string(i + 1));
+        worker.lastBusyTime = 0;
+        worker.utilisation.fill(0.f);
+    }
+
+    mainThreadId = std::this_thread::get_id();
+    numQueuedJobs = 0;
+    numMainThreadJobs = 0;
+    peakQueuedJobs = 0;
+    numRunningWorkers = numWorkers;
+    stopping = false;
+
+    lastFrameEnd = Profiler::Now();
+    queueDepthHistory.fill(0.f);
+    historyIndex = 0;
+
+    for (unsigned i = 0; i < numWorkers; ++i) {
+        threads.emplace_back(WorkerLoop, i);
+    }
+}
+
+void JobSystem::CleanUp() {
+    if (!jobs) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+
+    // Workers drain their queues before exiting, and the jobs they run may still wait on main thread jobs.
+    while (numRunningWorkers) {
+        RunMainThreadJobs();
+        std::this_thread::yield();
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+
+    while (numMainThreadJobs) {
+        RunMainThreadJobs();
+    }
+
+    workers.reset();
+    numWorkers = 0;
+    jobs.reset();
+    freeJobs.clear();
+}
+
+// Without a running job system, the function runs inline and the returned handle is already finished.
+JobSystem::Handle JobSystem::Schedule(const char* name, std::function<void()> function, JobPriority priority,
+                                      JobAffinity affinity, std::initializer_list<Handle> dependencies) {
+    if (!jobs) {
+        function();
+        return {jobSystemMaxJobs, 0};
+    }
+
+    const auto index = AllocateJob();
+    auto& job = jobs[index];
+    job.name = name;
+    job.function = std::move(function);
+    job.priority = priority;
+    job.affinity = affinity;
+
+    // The extra dependency keeps the job from being queued by a finishing dependency before all are registered.
+    job.pendingDependencies = 1;
+    const auto handle = Handle{index, job.generation.load()};
+
+    if (dependencies.size()) {
+        std::lock_guard<std::mutex> lock(dependencyMutex);
+        for (const auto& dependency : dependencies) {
+            if (!IsFinished(dependency)) {
+                jobs[dependency.index].continuations.push_back(index);
+                ++job.pendingDependencies;
+            }
+        }
+    }
+
+    if (--job.pendingDependencies == 0) {
+        Enqueue(index);
+    }
+
+    return handle;
+}
+
+void JobSystem::Wait(Handle handle) {
+    while (!IsFinished(handle)) {
+        if (!HelpOnce()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool JobSystem::IsFinished(Handle handle) {
+    return !jobs || handle.index >= jobSystemMaxJobs || jobs[handle.index].generation != handle.generation;
+}
+
+// Splits [0, count) into ranges of grainSize and returns once all of them ran. The calling thread takes the first
+// range and then helps with the rest.
+void JobSystem::ParallelFor(const char* name, unsigned count, unsigned grainSize, const ParallelForFunction& function,
+                            JobPriority priority) {
+    grainSize = std::max(grainSize, 1u);
+    if (!jobs || count <= grainSize) {
+        if (count) {
+            function(0, count);
+        }
+        return;
+    }
+
+    struct Range {
+        const ParallelForFunction* function;
+        unsigned count;
+        unsigned grainSize;
+        std::atomic<unsigned> remaining;
+    };
+
+    Range range;
+    range.function = &function;
+    range.count = count;
+    range.grainSize = grainSize;
+
+    const auto numChunks = (count + grainSize - 1) / grainSize;
+    range.remaining = numChunks;
+
+    auto* rangePointer = &range;
+    for (unsigned chunk = 1; chunk < numChunks; ++chunk) {
+        Schedule(name, [rangePointer, chunk] {
+            const auto begin = chunk * rangePointer->grainSize;
+            (*rangePointer->function)(begin, std::min(begin + rangePointer->grainSize, rangePointer->count));
+            --rangePointer->remaining;
+        }, priority);
+    }
+
+    {
+        PROFILE_SCOPE(name);
+        function(0, grainSize);
+        --range.remaining;
+    }
+
+    while (range.remaining) {
+        if (!HelpOnce()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// Runs the main thread jobs queued so far; jobs they schedule with the same affinity run on the next call.
+void JobSystem::RunMainThreadJobs() {
+    if (!jobs || !numMainThreadJobs) {
+        return;
+    }
+
+    PROFILE_SCOPE("JobSystem::RunMainThreadJobs");
+
+    for (auto budget = numMainThreadJobs.load(); budget; --budget) {
+        auto index = 0u;
+        auto found = false;
+        {
+            std::lock_guard<std::mutex> lock(mainThreadLanes.mutex);
+            for (auto& queue : mainThreadLanes.queues) {
+                if (queue.PopFront(index)) {
+                    found = true;
+                    break;
+                }
+            }
+        }
+
+        if (!found) {
+            break;
+        }
+
+        --numMainThreadJobs;
+        RunJob(index);
+    }
+}
+
+void JobSystem::EndFrame() {
+    if (!jobs) {
+        return;
+    }
+
+    const auto now = Profiler::Now();
+    const auto frameTime = static_cast<float>(now - lastFrameEnd);
+    lastFrameEnd = now;
+
+    auto totalUtilisation = 0.f;
+    jobsPerFrame = 0;
+    stealsPerFrame = 0;
+    for (unsigned i = 0; i < numWorkers; ++i) {
+        auto& worker = workers[i];
+        const auto busyTime = worker.busyTime.load();
+        const auto utilisation = frameTime > 0.f ? std::min(static_cast<float>(busyTime - worker.lastBusyTime) / frameTime, 1.f) : 0.f;
+        worker.lastBusyTime = busyTime;
+        worker.utilisation[historyIndex] = utilisation * 100.f;
+        totalUtilisation += utilisation;
+
+        jobsPerFrame += worker.jobsExecuted.exchange(0);
+        stealsPerFrame += worker.jobsStolen.exchange(0);
+    }
+
+    const auto queueDepth = peakQueuedJobs.exchange(numQueuedJobs + numMainThreadJobs);
+    queueDepthHistory[historyIndex] = static_cast<float>(queueDepth);
+    historyIndex = (historyIndex + 1) % jobSystemHistoryFrames;
+
+    Profiler::SetCounter("Job Queue Depth", queueDepth);
+    Profiler::SetCounter("Worker Utilisation (%)", numWorkers ? totalUtilisation / numWorkers * 100.f : 0.f);
+}
+
+void JobSystem::DisplayControls() {
+    if (ImGui::CollapsingHeader("Jobs")) {
+        const auto latest = (historyIndex + jobSystemHistoryFrames - 1) % jobSystemHistoryFrames;
+
+        ImGui::Text("Workers: %u", numWorkers);
+        ImGui::Text("Jobs: %u per frame (%u stolen)", jobsPerFrame, stealsPerFrame);
+        ImGui::Text("Peak Queue Depth: %.0f", queueDepthHistory[latest]);
+        ImGui::PlotLines("##Job Queue Depth", queueDepthHistory.data(), static_cast<int>(jobSystemHistoryFrames),
+                         static_cast<int>(historyIndex), "Queue Depth", 0.0f, FLT_MAX, ImVec2(0, 40));
+
+        char overlay[16];
+        for (unsigned i = 0; i < numWorkers; ++i) {
+            const auto utilisation = workers[i].utilisation[latest];
+            std::snprintf(overlay, sizeof(overlay), "%.0f%%", utilisation);
+            ImGui::Text("%s", workers[i].threadName);
+            ImGui::SameLine(120.0f);
+            ImGui::ProgressBar(utilisation / 100.f, ImVec2(-1.0f, 0.0f), overlay);
+        }
+    }
+}
+
+unsigned JobSystem::GetNumWorkers() {
+    return numWorkers;
+}
+
+void JobSystem::WorkerLoop(unsigned index) {
+    workerIndex = static_cast<int>(index);
+    auto& worker = workers[index];
+    Profiler::SetThreadName(worker.threadName);
+
+    while (true) {
+        auto job = 0u;
+        if (FindJob(job)) {
+            const auto begin = Profiler::Now();
+            RunJob(job);
+            worker.busyTime += Profiler::Now() - begin;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        workAvailable.wait(lock, [] { return stopping || numQueuedJobs; });
+        if (stopping && !numQueuedJobs) {
+            break;
+        }
+    }
+
+    --numRunningWorkers;
+}
+
+// Takes a free slot, running queued jobs while the pool is exhausted.
+unsigned JobSystem::AllocateJob() {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(freeJobsMutex);
+            if (!freeJobs.empty()) {
+                const auto index = freeJobs.back();
+                freeJobs.pop_back();
+                return index;
+            }
+        }
+
+        if (!HelpOnce()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::Enqueue(unsigned index) {
+    const auto& job = jobs[index];
+    const auto priority = static_cast<unsigned>(job.priority);
+
+    if (job.affinity == JobAffinity::MainThread) {
+        std::lock_guard<std::mutex> lock(mainThreadLanes.mutex);
+        mainThreadLanes.queues[priority].PushBack(index);
+        ++numMainThreadJobs;
+        return;
+    }
+
+    // Counted before it is pushed, so that a thief never takes the count below zero.
+    const auto queueDepth = ++numQueuedJobs + numMainThreadJobs;
+    auto peak = peakQueuedJobs.load();
+    while (queueDepth > peak && !peakQueuedJobs.compare_exchange_weak(peak, queueDepth)) {
+    }
+
+    const auto target = workerIndex >= 0 ? static_cast<unsigned>(workerIndex) : nextWorker++ % numWorkers;
+    {
+        std::lock_guard<std::mutex> lock(workers[target].lanes.mutex);
+        workers[target].lanes.queues[priority].PushBack(index);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    workAvailable.notify_one();
+}
+
+// Looks for the highest priority job: main thread jobs when called from the main thread, then the newest job of the
+// calling worker, then the oldest job of any other worker.
+bool JobSystem::FindJob(unsigned& index) {
+    const auto self = workerIndex;
+    const auto onMainThread = std::this_thread::get_id() == mainThreadId;
+
+    for (unsigned priority = 0; priority < jobSystemNumPriorities; ++priority) {
+        if (onMainThread && numMainThreadJobs) {
+            std::lock_guard<std::mutex> lock(mainThreadLanes.mutex);
+            if (mainThreadLanes.queues[priority].PopFront(index)) {
+                --numMainThreadJobs;
+                return true;
+            }
+        }
+
+        if (!numQueuedJobs) {
+            continue;
+        }
+
+        if (self >= 0) {
+            auto& worker = workers[self];
+            std::lock_guard<std::mutex> lock(worker.lanes.mutex);
+            if (worker.lanes.queues[priority].PopBack(index)) {
+                --numQueuedJobs;
+                ++worker.jobsExecuted;
+                return true;
+            }
+        }
+
+        for (unsigned i = 0; i < numWorkers; ++i) {
+            const auto victim = (static_cast<unsigned>(self + 1) + i) % numWorkers;
+            if (static_cast<int>(victim) == self) {
+                continue;
+            }
+
+            auto& lanes = workers[victim].lanes;
+            std::lock_guard<std::mutex> lock(lanes.mutex);
+            if (lanes.queues[priority].PopFront(index)) {
+                --numQueuedJobs;
+                if (self >= 0) {
+                    ++workers[self].jobsExecuted;
+                    ++workers[self].jobsStolen;
+                }
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// An exception escaping a worker would terminate the viewer and leave the job unfinished for anyone waiting on it, so
+// jobs are expected to report their own errors and anything that still escapes is logged and swallowed here.
+void JobSystem::RunJob(unsigned index) {
+    auto& job = jobs[index];
+    try {
+        PROFILE_SCOPE(job.name);
+        job.function();
+    } catch (const std::string& errorMessage) {
+        std::fprintf(stderr, "Job \"%s\" failed: %s\n", job.name, errorMessage.c_str());
+    } catch (const std::exception& exception) {
+        std::fprintf(stderr, "Job \"%s\" failed: %s\n", job.name, exception.what());
+    } catch (...) {
+        std::fprintf(stderr, "Job \"%s\" failed with an unknown exception.\n", job.name);
+    }
+    job.function = nullptr;
+
+    FinishJob(index);
+}
+
+void JobSystem::FinishJob(unsigned index) {
+    auto& job = jobs[index];
+    {
+        std::lock_guard<std::mutex> lock(dependencyMutex);
+        ++job.generation;
+        for (const auto continuation : job.continuations) {
+            if (--jobs[continuation].pendingDependencies == 0) {
+                Enqueue(continuation);
+            }
+        }
+        job.continuations.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(freeJobsMutex);
+    freeJobs.push_back(index);
+}
+
+bool JobSystem::HelpOnce() {
+    auto index = 0u;
+    if (!FindJob(index)) {
+        return false;
+    }
+
+    RunJob(index);
+    return true;
+}
+
+} // namespace model_viewer_3d
@@ -0,0 +1,414 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "Common.h"
+#include "Environment.h"
+#include "GLState.h"
+#include "JobSystem.h"
+#include "LightClusters.h"
+#include "Profiler.h"
+
+#include <ImGUI/imgui.h>
+
+namespace model_viewer_3d {
+
+constexpr GLsizeiptr lightClustersInitialLights = 256;
+constexpr GLsizeiptr lightClustersInitialIndices = 4096;
+constexpr float maxSpotAngle = 89.f;
+
+bool LightClusters::supported = false;
+bool LightClusters::enabled = true;
+
+LightClusters::Settings LightClusters::settings;
+std::vector<LightClusters::LocalLight> LightClusters::lights;
+
+GLuint LightClusters::lightBuffer = 0;
+GLuint LightClusters::clusterBuffer = 0;
+GLuint LightClusters::indexBuffer = 0;
+GLsizeiptr LightClusters::lightCapacity = 0;
+GLsizeiptr LightClusters::indexCapacity = 0;
+
+float LightClusters::gridNearPlane = 0.f;
+float LightClusters::gridFarPlane = 0.f;
+float LightClusters::gridXScale = 0.f;
+float LightClusters::gridYScale = 0.f;
+float LightClusters::sliceScale = 0.f;
+float LightClusters::sliceBias = 0.f;
+std::vector<LightClusters::ClusterBounds> LightClusters::clusterBounds;
+
+std::vector<LightClusters::VisibleLight> LightClusters::visibleLights;
+std::array<std::vector<std::uint32_t>, lightClustersZ> LightClusters::sliceCandidates;
+std::array<std::vector<std::uint32_t>, lightClustersZ> LightClusters::sliceIndices;
+
+unsigned LightClusters::numVisibleLights = 0;
+unsigned LightClusters::numLightIndices = 0;
+unsigned LightClusters::maxLightsPerCluster = 0;
+
+void LightClusters::Initialize() {
+    supported = GLEW_VERSION_4_3;
+    if (!supported) {
+        return;
+    }
+
+    lightCapacity = lightClustersInitialLights;
+    indexCapacity = lightClustersInitialIndices;
+
+    glGenBuffers(1, &lightBuffer);
+    GLState::BindBuffer(GL_SHADER_STORAGE_BUFFER, lightBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GridHeader) + lightCapacity * sizeof(RenderPacket::Light), nullptr,
+                 GL_DYNAMIC_DRAW);
+
+    glGenBuffers(1, &clusterBuffer);
+    GLState::BindBuffer(GL_SHADER_STORAGE_BUFFER, clusterBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, lightClustersCount * sizeof(glm::uvec2), nullptr, GL_DYNAMIC_DRAW);
+
+    glGenBuffers(1, &indexBuffer);
+    GLState::BindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, indexCapacity * sizeof(std::uint32_t), nullptr, GL_DYNAMIC_DRAW);
+
+    GLState::BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void LightClusters::CleanUp() {
+    if (!supported) {
+        return;
+    }
+
+    const GLuint buffers[] = { lightBuffer, clusterBuffer, indexBuffer };
+    GLState::DeleteBuffers(3, buffers);
+
+    lightCapacity = 0;
+    indexCapacity = 0;
+    gridNearPlane = 0.f;
+    clusterBounds.clear();
+    visibleLights.clear();
+    supported = false;
+}
+
+// Scatters the lights over a square around the origin, which is where SceneGenerator lays out its objects.
+void LightClusters::Generate(const Settings& settings) {
+    PROFILE_SCOPE("LightClusters::Generate");
+
+    const auto numPointLights = std::max(0, std::min(settings.numPointLights, maxLocalLights));
+    const auto numSpotLights = std::max(0, std::min(settings.numSpotLights, maxLocalLights - numPointLights));
+
+    std::mt19937 generator(static_cast<unsigned>(settings.seed));
+    std::uniform_real_distribution<float> horizontal(-settings.spread, settings.spread);
+    std::uniform_real_distribution<float> vertical(.25f, std::max(settings.height, .25f));
+    std::uniform_real_distribution<float> channel(.25f, 1.f);
+    std::uniform_real_distribution<float> tilt(0.f, glm::radians(30.f));
+    std::uniform_real_distribution<float> azimuth(0.f, glm::radians(360.f));
+
+    lights.clear();
+    lights.reserve(static_cast<std::size_t>(numPointLights + numSpotLights));
+    for (int i = 0; i < numPointLights + numSpotLights; ++i) {
+        LocalLight light;
+        light.position = glm::vec3(horizontal(generator), vertical(generator), horizontal(generator));
+        light.color = glm::vec3(channel(generator), channel(generator), channel(generator));
+        light.intensity = settings.intensity;
+        light.range = settings.range;
+
+        // Spot lights point down, tilted a little to a random side.
+        light.spot = i >= numPointLights;
+        const auto angle = tilt(generator);
+        const auto side = azimuth(generator);
+        light.direction = glm::vec3(std::sin(angle) * std::cos(side), -std::cos(angle), std::sin(angle) * std::sin(side));
+        light.innerAngle = 20.f;
+        light.outerAngle = 30.f;
+
+        lights.push_back(light);
+    }
+}
+
+void LightClusters::Assign(RenderPacket& packet) {
+    packet.lightGridSize = glm::uvec4(lightClustersX, lightClustersY, lightClustersZ, 0);
+    numVisibleLights = 0;
+    numLightIndices = 0;
+    maxLightsPerCluster = 0;
+
+    if (!supported || !enabled || lights.empty()) {
+        return;
+    }
+
+    PROFILE_SCOPE("LightClusters::Assign");
+
+    const auto& camera = Environment::camera;
+    const auto nearPlane = std::max(camera.nearClippingPlane, .001f);
+    const auto farPlane = std::max(camera.farClippingPlane, nearPlane * 1.001f);
+    const auto xScale = packet.projectionMatrix[0][0];
+    const auto yScale = packet.projectionMatrix[1][1];
+
+    UpdateGrid(nearPlane, farPlane, xScale, yScale);
+    // The tiles follow gl_FragCoord, so they span the size the scene is drawn at rather than the window.
+    packet.lightGridParameters = glm::vec4(lightClustersX / static_cast<float>(packet.renderWidth),
+                                           lightClustersY / static_cast<float>(packet.renderHeight), sliceScale, sliceBias);
+
+    CullLights(packet, packet.viewMatrix, xScale, yScale);
+    numVisibleLights = static_cast<unsigned>(visibleLights.size());
+    packet.lightGridSize.w = numVisibleLights;
+    if (visibleLights.empty()) {
+        return;
+    }
+
+    // Every slice is assigned on its own and only writes its own froxels, so no job waits on another.
+    packet.lightClusters.resize(lightClustersCount);
+    JobSystem::ParallelFor("LightClusters::AssignSlice", lightClustersZ, 1, [&packet](unsigned begin, unsigned end) {
+        for (auto slice = begin; slice < end; ++slice) {
+            AssignSlice(slice, packet);
+        }
+    });
+
+    // The index lists of the slices are laid out one after the other, which moves the ranges of the later slices.
+    constexpr auto clustersPerSlice = lightClustersX * lightClustersY;
+    for (unsigned slice = 0; slice < lightClustersZ; ++slice) {
+        const auto base = static_cast<std::uint32_t>(packet.lightIndices.size());
+        for (auto cluster = slice * clustersPerSlice; cluster < (slice + 1) * clustersPerSlice; ++cluster) {
+            packet.lightClusters[cluster].x += base;
+            maxLightsPerCluster = std::max(maxLightsPerCluster, packet.lightClusters[cluster].y);
+        }
+        packet.lightIndices.insert(packet.lightIndices.end(), sliceIndices[slice].begin(), sliceIndices[slice].end());
+    }
+    numLightIndices = static_cast<unsigned>(packet.lightIndices.size());
+}
+
+void LightClusters::Upload(const RenderPacket& packet) {
+    if (!supported) {
+        return;
+    }
+
+    PROFILE_SCOPE("LightClusters::Upload");
+
+    const auto numLights = static_cast<GLsizeiptr>(packet.localLights.size());
+    const auto numIndices = static_cast<GLsizeiptr>(packet.lightIndices.size());
+    const GridHeader header = { packet.lightGridSize, packet.lightGridParameters };
+
+    GLState::BindBuffer(GL_SHADER_STORAGE_BUFFER, lightBuffer);
+    if (numLights > lightCapacity) {
+        while (lightCapacity < numLights) {
+            lightCapacity *= 2;
+        }
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GridHeader) + lightCapacity * sizeof(RenderPacket::Light), nullptr,
+                     GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GridHeader), &header);
+
+    // Without lights, the shader never looks past the header.
+    if (numLights) {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(GridHeader), numLights * sizeof(RenderPacket::Light),
+                        packet.localLights.data());
+
+        GLState::BindBuffer(GL_SHADER_STORAGE_BUFFER, clusterBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, lightClustersCount * sizeof(glm::uvec2), packet.lightClusters.data());
+
+        GLState::BindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+        if (numIndices > indexCapacity) {
+            while (indexCapacity < numIndices) {
+                indexCapacity *= 2;
+            }
+            glBufferData(GL_SHADER_STORAGE_BUFFER, indexCapacity * sizeof(std::uint32_t), nullptr, GL_DYNAMIC_DRAW);
+        }
+        if (numIndices) {
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, numIndices * sizeof(std::uint32_t), packet.lightIndices.data());
+        }
+    }
+
+    GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, lightBuffer);
+    GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, clusterBuffer);
+    GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, indexBuffer);
+}
+
+void LightClusters::DisplayControls() {
+    ImGui::Begin("Options");
+
+    if (ImGui::CollapsingHeader("Local Lights")) {
+        ImGui::Indent(15);
+        if (supported) {
+            ImGui::Checkbox("Enabled" "##Local Lights", &enabled);
+            ImGui::InputInt("Point Lights" "##Local Lights", &settings.numPointLights, 64, 1024);
+            ImGui::InputInt("Spot Lights" "##Local Lights", &settings.numSpotLights, 64, 1024);
+            ImGui::SliderFloat("Range" "##Local Lights", &settings.range, .1f, 50.f);
+            ImGui::SliderFloat("Intensity" "##Local Lights", &settings.intensity, 0.f, 10.f);
+            ImGui::SliderFloat("Spread" "##Local Lights", &settings.spread, 1.f, 500.f);
+            ImGui::SliderFloat("Height" "##Local Lights", &settings.height, .25f, 50.f);
+            ImGui::InputInt("Seed" "##Local Lights", &settings.seed);
+
+            settings.numPointLights = std::max(0, std::min(settings.numPointLights, maxLocalLights));
+            settings.numSpotLights = std::max(0, std::min(settings.numSpotLights, maxLocalLights - settings.numPointLights));
+
+            if (ImGui::Button("Generate" "##Local Lights")) {
+                Generate(settings);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Clear" "##Local Lights")) {
+                lights.clear();
+            }
+
+            ImGui::Text("Lights: %u (%u visible)", static_cast<unsigned>(lights.size()), numVisibleLights);
+            ImGui::Text("Clusters: %u x %u x %u", lightClustersX, lightClustersY, lightClustersZ);
+            ImGui::Text("Lights per Cluster: %.2f average, %u max",
+                        static_cast<double>(numLightIndices) / lightClustersCount, maxLightsPerCluster);
+        } else {
+            ImGui::Text("Clustered lighting requires OpenGL 4.3.");
+        }
+        ImGui::Unindent(15);
+        ImGui::Spacing();
+    }
+
+    ImGui::End();
+}
+
+// The view-space bounds of the froxels only depend on the projection, so they are kept until it changes.
+void LightClusters::UpdateGrid(float nearPlane, float farPlane, float xScale, float yScale) {
+    if (nearPlane == gridNearPlane && farPlane == gridFarPlane && xScale == gridXScale && yScale == gridYScale) {
+        return;
+    }
+
+    gridNearPlane = nearPlane;
+    gridFarPlane = farPlane;
+    gridXScale = xScale;
+    gridYScale = yScale;
+
+    const auto logDepthRange = std::log(farPlane / nearPlane);
+    sliceScale = lightClustersZ / logDepthRange;
+    sliceBias = -std::log(nearPlane) * sliceScale;
+
+    clusterBounds.resize(lightClustersCount);
+    for (unsigned z = 0; z < lightClustersZ; ++z) {
+        const auto sliceNear = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(z) / lightClustersZ);
+        const auto sliceFar = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(z + 1) / lightClustersZ);
+
+        for (unsigned y = 0; y < lightClustersY; ++y) {
+            const auto bottom = (-1.f + 2.f * y / lightClustersY) / yScale;
+            const auto top = (-1.f + 2.f * (y + 1) / lightClustersY) / yScale;
+
+            for (unsigned x = 0; x < lightClustersX; ++x) {
+                const auto left = (-1.f + 2.f * x / lightClustersX) / xScale;
+                const auto right = (-1.f + 2.f * (x + 1) / lightClustersX) / xScale;
+
+                auto& bounds = clusterBounds[(z * lightClustersY + y) * lightClustersX + x];
+                bounds.min = glm::vec3(std::min(left * sliceNear, left * sliceFar), std::min(bottom * sliceNear, bottom * sliceFar),
+                                       -sliceFar);
+                bounds.max = glm::vec3(std::max(right * sliceNear, right * sliceFar), std::max(top * sliceNear, top * sliceFar),
+                                       -sliceNear);
+                bounds.sphere = glm::vec4(.5f * (bounds.min + bounds.max), .5f * glm::length(bounds.max - bounds.min));
+            }
+        }
+    }
+}
+
+// Transforms the lights into view space, drops the ones outside the frustum and finds the froxels that the bounding
+// sphere of each of the rest can touch.
+void LightClusters::CullLights(RenderPacket& packet, const glm::mat4& viewMatrix, float xScale, float yScale) {
+    visibleLights.clear();
+
+    for (const auto& light : lights) {
+        const auto position = (viewMatrix * glm::vec4(light.position, 1.f)).xyz();
+        const auto minDepth = -position.z - light.range;
+        const auto maxDepth = -position.z + light.range;
+        if (maxDepth < gridNearPlane || minDepth > gridFarPlane) {
+            continue;
+        }
+
+        // The extremes of x / depth over the box around the sphere bound its projection, unless it reaches behind the
+        // near plane, in which case it may cover the whole screen.
+        auto left = -1.f, right = 1.f, bottom = -1.f, top = 1.f;
+        if (minDepth > gridNearPlane) {
+            left = xScale * (position.x - light.range) / (position.x - light.range >= 0.f ? maxDepth : minDepth);
+            right = xScale * (position.x + light.range) / (position.x + light.range >= 0.f ? minDepth : maxDepth);
+            bottom = yScale * (position.y - light.range) / (position.y - light.range >= 0.f ? maxDepth : minDepth);
+            top = yScale * (position.y + light.range) / (position.y + light.range >= 0.f ? minDepth : maxDepth);
+            if (left > 1.f || right < -1.f || bottom > 1.f || top < -1.f) {
+                continue;
+            }
+        }
+
+        VisibleLight visible;
+        visible.position = position;
+        visible.range = light.range;
+        visible.spot = light.spot;
+        visible.minCluster = glm::uvec3(GetTile(left, lightClustersX), GetTile(bottom, lightClustersY), GetSlice(minDepth));
+        visible.maxCluster = glm::uvec3(GetTile(right, lightClustersX), GetTile(top, lightClustersY), GetSlice(maxDepth));
+
+        // Point lights get a cone wide enough to let every direction through.
+        auto cosInnerAngle = -1.f;
+        visible.cosOuterAngle = -2.f;
+        visible.sinOuterAngle = 0.f;
+        visible.direction = glm::vec3(0.f, 0.f, -1.f);
+        if (light.spot) {
+            const auto outerAngle = glm::radians(std::max(1.f, std::min(light.outerAngle, maxSpotAngle)));
+            visible.direction = glm::normalize(glm::mat3(viewMatrix) * light.direction);
+            visible.cosOuterAngle = std::cos(outerAngle);
+            visible.sinOuterAngle = std::sin(outerAngle);
+            cosInnerAngle = std::max(std::cos(glm::radians(light.innerAngle)), visible.cosOuterAngle + .001f);
+        }
+
+        visibleLights.push_back(visible);
+        packet.localLights.push_back({ glm::vec4(position, light.range), glm::vec4(visible.direction, visible.cosOuterAngle),
+                                       glm::vec4(light.color * light.intensity, cosInnerAngle) });
+    }
+}
+
+// Runs on the job system. The lights are tested against the box of every froxel of the slice their bounds overlap,
+// and spot lights also against the bounding sphere of the froxel, so that a cone does not fill its whole sphere.
+void LightClusters::AssignSlice(unsigned slice, RenderPacket& packet) {
+    auto& candidates = sliceCandidates[slice];
+    candidates.clear();
+    for (std::uint32_t i = 0; i < visibleLights.size(); ++i) {
+        if (visibleLights[i].minCluster.z <= slice && slice <= visibleLights[i].maxCluster.z) {
+            candidates.push_back(i);
+        }
+    }
+
+    auto& indices = sliceIndices[slice];
+    indices.clear();
+    for (unsigned y = 0; y < lightClustersY; ++y) {
+        for (unsigned x = 0; x < lightClustersX; ++x) {
+            const auto cluster = (slice * lightClustersY + y) * lightClustersX + x;
+            const auto& bounds = clusterBounds[cluster];
+            const auto offset = static_cast<std::uint32_t>(indices.size());
+
+            for (const auto i : candidates) {
+                const auto& light = visibleLights[i];
+                if (x < light.minCluster.x || x > light.maxCluster.x || y < light.minCluster.y || y > light.maxCluster.y) {
+                    continue;
+                }
+
+                const auto toBox = glm::clamp(light.position, bounds.min, bounds.max) - light.position;
+                if (glm::dot(toBox, toBox) > light.range * light.range) {
+                    continue;
+                }
+
+                if (light.spot) {
+                    const auto toCluster = glm::vec3(bounds.sphere) - light.position;
+                    const auto along = glm::dot(toCluster, light.direction);
+                    const auto across = std::sqrt(std::max(glm::dot(toCluster, toCluster) - along * along, 0.f));
+                    if (light.cosOuterAngle * across - light.sinOuterAngle * along > bounds.sphere.w ||
+                        along > bounds.sphere.w + light.range || along < -bounds.sphere.w) {
+                        continue;
+                    }
+                }
+
+                indices.push_back(i);
+            }
+
+            packet.lightClusters[cluster] = glm::uvec2(offset, static_cast<std::uint32_t>(indices.size()) - offset);
+        }
+    }
+}
+
+// Must match the slice that Object.frag computes from the depth of each fragment.
+unsigned LightClusters::GetSlice(float depth) {
+    const auto slice = std::floor(std::log(std::max(depth, gridNearPlane)) * sliceScale + sliceBias);
+    return static_cast<unsigned>(std::max(0.f, std::min(slice, static_cast<float>(lightClustersZ - 1))));
+}
+
+unsigned LightClusters::GetTile(float ndc, unsigned numTiles) {
+    const auto tile = std::floor((ndc * .5f + .5f) * numTiles);
+    return static_cast<unsigned>(std::max(0.f, std::min(tile, static_cast<float>(numTiles - 1))));
+}
+
+} // namespace model_viewer_3d
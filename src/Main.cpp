@@ -1,47 +1,137 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright (c) 2017 Vangelis Tsiatsianas
 
+#include <chrono>
+#include <cstdlib>
 #include <functional>
+#include <iostream>
+#include <string>
 #include <vector>
 
+#include "AllocationTracker.h"
 #include "Common.h"
 #include "Environment.h"
+#include "FrameStatistics.h"
 #include "GUI.h"
+#include "InputRecorder.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "RenderThread.h"
+#include "TraceCapture.h"
 #include "Utilities.h"
 
-using namespace 3d_model_viewer;
+using namespace model_viewer_3d;
+using namespace std::chrono_literals;
 
 const auto mediaDirectory = std::string(rootDirectory) + "res/media/";
 constexpr auto maxLoopTime = 16ms;
 
 auto& camera = Environment::camera;
 
-int main() {
+int main(int argc, char* argv[]) {
+    auto captureFrames = 0;
+    auto captureOutputPath = std::string();
+    auto frameStatisticsPath = std::string();
+    auto recordPath = std::string();
+    auto replayPath = std::string();
+
+    for (int i = 1; i < argc; ++i) {
+        const auto argument = std::string(argv[i]);
+        if (argument == "--no-render-thread") {
+            RenderThread::enabled = false;
+            continue;
+        }
+
+        if (i + 1 == argc) {
+            std::cerr << "Missing value for argument \"" << argument << "\"!" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        const auto value = std::string(argv[++i]);
+        if (argument == "--capture-frames") {
+            captureFrames = std::atoi(value.c_str());
+        } else if (argument == "--capture-output") {
+            captureOutputPath = value;
+        } else if (argument == "--frame-stats") {
+            frameStatisticsPath = value;
+        } else if (argument == "--record") {
+            recordPath = value;
+        } else if (argument == "--replay") {
+            replayPath = value;
+        } else {
+            std::cerr << "Unknown argument \"" << argument << "\"!" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
     if (!GUI::Initialize()) {
         GUI::DisplayErrorMessage("Initialization failed!");
         std::exit(EXIT_FAILURE);
     }
 
+    FrameStatistics::Initialize(frameStatisticsPath);
+
+    // A replay or recording that was asked for but cannot run fails the run, so that scripts notice.
+    auto inputRecorderStarted = true;
+    if (!replayPath.empty()) {
+        inputRecorderStarted = InputRecorder::StartReplay(replayPath);
+    } else if (!recordPath.empty()) {
+        inputRecorderStarted = InputRecorder::StartRecording(recordPath);
+    }
+    if (!inputRecorderStarted) {
+        GUI::Close();
+        return EXIT_FAILURE;
+    }
+
+    if (captureFrames > 0) {
+        TraceCapture::Start(captureFrames, captureOutputPath);
+    }
+
     const auto audioFilePath = mediaDirectory + audioFileName;
     GUI::Audio::LoadAudioFile(audioFilePath);
 
     auto event = SDL_Event();
 
     while (true) {
+        Profiler::BeginFrame();
+        InputRecorder::BeginFrame();
+
+        if (InputRecorder::ReplayFinished()) {
+            GUI::Close();
+            return EXIT_SUCCESS;
+        }
+
         auto loopStart = Utilities::GetCurrentTime();
-        camera.Update(loopStart);
+        {
+            PROFILE_SCOPE("Event Processing");
+            while (InputRecorder::PollEvent(&event)) {
+                GUI::ProcessEvent(&event);
+            }
+        }
 
-        while (SDL_PollEvent(&event)) {
-            GUI::ProcessEvent(&event);
+        // Runs after event processing so that keys pressed this frame are already held during the update.
+        {
+            PROFILE_SCOPE("Camera::Update");
+            auto frameTime = InputRecorder::GetFrameTime();
+            camera.Update(frameTime);
         }
 
         GUI::Display();
 
+        AllocationTracker::EndFrame();
+        JobSystem::EndFrame();
+        Profiler::EndFrame();
+        TraceCapture::EndFrame();
+
         // Maintain 60 FPS (on average) without keeping the CPU always busy.
         auto loopEnd = Utilities::GetCurrentTime();
         auto loopDuration = loopEnd - loopStart;
         if (loopDuration < maxLoopTime) {
             Utilities::SleepFor(maxLoopTime - loopDuration);
         }
+
+        const auto frameDuration = Utilities::GetCurrentTime() - loopStart;
+        FrameStatistics::AddFrame(std::chrono::duration<float, std::milli>(frameDuration).count(),
+                                  std::chrono::duration<float, std::milli>(loopDuration).count());
     }
 }
@@ -0,0 +1,272 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+#include "ModelImporter.h"
+#include "Profiler.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <SOIL2/SOIL2.h>
+
+namespace model_viewer_3d {
+
+// The same post-processing as glGA's RigMesh, plus a bound on the bones per vertex that the vertex format holds. Points
+// and lines survive triangulation, so they are split off and removed, since only triangles are drawn.
+constexpr unsigned modelImporterFlags = aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_GenSmoothNormals |
+                                        aiProcess_FlipUVs | aiProcess_LimitBoneWeights;
+constexpr float modelImporterDefaultTicksPerSecond = 25.f;
+
+static glm::mat4 ToMat4(const aiMatrix4x4& matrix) {
+    return glm::transpose(glm::make_mat4(&matrix.a1));
+}
+
+static ImportedMesh::Channel ToChannel(const aiNodeAnim& nodeAnimation) {
+    ImportedMesh::Channel channel;
+    for (unsigned i = 0; i < nodeAnimation.mNumPositionKeys; ++i) {
+        const auto& key = nodeAnimation.mPositionKeys[i];
+        channel.positionTimes.push_back(static_cast<float>(key.mTime));
+        channel.positions.emplace_back(key.mValue.x, key.mValue.y, key.mValue.z);
+    }
+    for (unsigned i = 0; i < nodeAnimation.mNumRotationKeys; ++i) {
+        const auto& key = nodeAnimation.mRotationKeys[i];
+        channel.rotationTimes.push_back(static_cast<float>(key.mTime));
+        channel.rotations.emplace_back(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z);
+    }
+    for (unsigned i = 0; i < nodeAnimation.mNumScalingKeys; ++i) {
+        const auto& key = nodeAnimation.mScalingKeys[i];
+        channel.scalingTimes.push_back(static_cast<float>(key.mTime));
+        channel.scalings.emplace_back(key.mValue.x, key.mValue.y, key.mValue.z);
+    }
+    return channel;
+}
+
+// Finds the pair of keys around the time and how far between them it lies.
+static std::size_t FindKey(const std::vector<float>& times, float time, float& factor) {
+    if (times.size() < 2 || time <= times.front()) {
+        factor = 0.f;
+        return 0;
+    }
+
+    const auto next = std::min(static_cast<std::size_t>(std::upper_bound(times.begin(), times.end(), time) - times.begin()),
+                               times.size() - 1);
+    const auto key = next - 1;
+    const auto delta = times[next] - times[key];
+    factor = delta > 0.f ? std::min(std::max((time - times[key]) / delta, 0.f), 1.f) : 0.f;
+    return key;
+}
+
+template <typename Value, typename Mix>
+static Value Interpolate(const std::vector<float>& times, const std::vector<Value>& values, float time, Mix mix) {
+    auto factor = 0.f;
+    const auto key = FindKey(times, time, factor);
+    return key + 1 < values.size() ? mix(values[key], values[key + 1], factor) : values[key];
+}
+
+static void AddNodes(const aiNode& node, int parent, const std::unordered_map<std::string, int>& channels,
+                     const std::unordered_map<std::string, int>& bones, std::vector<ImportedMesh::Node>& nodes) {
+    const auto channel = channels.find(node.mName.C_Str());
+    const auto bone = bones.find(node.mName.C_Str());
+    const auto index = static_cast<int>(nodes.size());
+    nodes.push_back({parent, channel != channels.end() ? channel->second : -1, bone != bones.end() ? bone->second : -1,
+                     ToMat4(node.mTransformation)});
+
+    for (unsigned i = 0; i < node.mNumChildren; ++i) {
+        AddNodes(*node.mChildren[i], index, channels, bones, nodes);
+    }
+}
+
+// Texture paths are relative to the model; embedded textures are not supported, as with RigMesh.
+static ImportedMesh::Image LoadImage(const std::string& modelPath, const aiMaterial& material) {
+    ImportedMesh::Image image;
+
+    aiString texturePath;
+    if (!material.GetTextureCount(aiTextureType_DIFFUSE) ||
+        material.GetTexture(aiTextureType_DIFFUSE, 0, &texturePath) != AI_SUCCESS || texturePath.data[0] == '*') {
+        return image;
+    }
+
+    auto relativePath = std::string(texturePath.C_Str());
+    std::replace(relativePath.begin(), relativePath.end(), '\\', '/');
+    const auto fullPath = (std::filesystem::path(modelPath).parent_path() / relativePath).string();
+
+    int channels = 0;
+    auto* pixels = SOIL_load_image(fullPath.c_str(), &image.width, &image.height, &channels, SOIL_LOAD_RGBA);
+    if (!pixels) {
+        image.width = 0;
+        image.height = 0;
+        return image;
+    }
+
+    image.pixels.assign(pixels, pixels + static_cast<std::size_t>(image.width) * image.height * 4);
+    SOIL_free_image_data(pixels);
+    return image;
+}
+
+std::unique_ptr<ImportedMesh> ModelImporter::Import(const std::string& path) {
+    PROFILE_SCOPE("ModelImporter::Import");
+
+    Assimp::Importer importer;
+    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+    const auto* scene = importer.ReadFile(path, modelImporterFlags);
+    if (!scene || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) || !scene->mRootNode) {
+        throw std::string("Could not import \"") + path + "\": " + importer.GetErrorString();
+    }
+
+    auto importedMesh = std::make_unique<ImportedMesh>();
+    auto& mesh = *importedMesh;
+    auto boneOffsets = std::vector<glm::mat4>();
+    auto bones = std::unordered_map<std::string, int>();
+    auto usedWeights = std::vector<unsigned char>();
+
+    for (unsigned i = 0; i < scene->mNumMeshes; ++i) {
+        const auto& sourceMesh = *scene->mMeshes[i];
+        const auto baseVertex = static_cast<unsigned>(mesh.positions.size());
+        const auto baseIndex = static_cast<unsigned>(mesh.indices.size());
+
+        for (unsigned vertex = 0; vertex < sourceMesh.mNumVertices; ++vertex) {
+            const auto& position = sourceMesh.mVertices[vertex];
+            mesh.positions.emplace_back(position.x, position.y, position.z);
+            if (sourceMesh.HasNormals()) {
+                const auto& normal = sourceMesh.mNormals[vertex];
+                mesh.normals.emplace_back(normal.x, normal.y, normal.z);
+            } else {
+                mesh.normals.emplace_back(0.f);
+            }
+            if (sourceMesh.HasTextureCoords(0)) {
+                const auto& texCoord = sourceMesh.mTextureCoords[0][vertex];
+                mesh.texCoords.emplace_back(texCoord.x, texCoord.y);
+            } else {
+                mesh.texCoords.emplace_back(0.f);
+            }
+        }
+
+        for (unsigned face = 0; face < sourceMesh.mNumFaces; ++face) {
+            const auto& sourceFace = sourceMesh.mFaces[face];
+            if (sourceFace.mNumIndices != 3) {
+                throw std::string("Could not import \"") + path + "\": a face with " +
+                      std::to_string(sourceFace.mNumIndices) + " vertices could not be triangulated.";
+            }
+            mesh.indices.insert(mesh.indices.end(), sourceFace.mIndices, sourceFace.mIndices + 3);
+        }
+
+        mesh.boneWeights.resize(mesh.positions.size(), BoneWeights{});
+        usedWeights.resize(mesh.positions.size(), 0);
+        for (unsigned boneIndex = 0; boneIndex < sourceMesh.mNumBones; ++boneIndex) {
+            const auto& bone = *sourceMesh.mBones[boneIndex];
+            auto found = bones.find(bone.mName.C_Str());
+            if (found == bones.end()) {
+                found = bones.emplace(bone.mName.C_Str(), static_cast<int>(boneOffsets.size())).first;
+                boneOffsets.push_back(ToMat4(bone.mOffsetMatrix));
+            }
+
+            // A weight of zero is still a slot taken, so the slots in use are counted rather than searched for.
+            for (unsigned weight = 0; weight < bone.mNumWeights; ++weight) {
+                const auto vertex = baseVertex + bone.mWeights[weight].mVertexId;
+                auto& slot = usedWeights[vertex];
+                if (slot < bonesPerVertex) {
+                    mesh.boneWeights[vertex].weights[slot] = bone.mWeights[weight].mWeight;
+                    mesh.boneWeights[vertex].ids[slot] = found->second;
+                    ++slot;
+                }
+            }
+        }
+
+        mesh.entries.push_back({static_cast<unsigned>(mesh.indices.size()) - baseIndex, baseIndex, baseVertex,
+                                sourceMesh.mMaterialIndex});
+    }
+
+    if (mesh.indices.empty()) {
+        throw std::string("Could not import \"") + path + "\": the model contains no triangles.";
+    }
+
+    // Materials without a texture are drawn with a white one, as long as any material has a texture at all.
+    auto textured = false;
+    for (unsigned i = 0; i < scene->mNumMaterials; ++i) {
+        mesh.images.push_back(LoadImage(path, *scene->mMaterials[i]));
+        textured = textured || !mesh.images.back().pixels.empty();
+    }
+    if (!textured) {
+        mesh.images.clear();
+    }
+    for (auto& image : mesh.images) {
+        if (image.pixels.empty()) {
+            image.width = 1;
+            image.height = 1;
+            image.pixels.assign(4, 255);
+        }
+    }
+
+    if (boneOffsets.empty() || !scene->HasAnimations()) {
+        mesh.boneWeights.clear();
+        return importedMesh;
+    }
+
+    // The palette is uploaded to a fixed-size uniform array, as with the generated skeletons.
+    if (boneOffsets.size() > maxBones - 1) {
+        throw std::string("Could not import \"") + path + "\": the model has " + std::to_string(boneOffsets.size()) +
+              " bones, more than the " + std::to_string(maxBones - 1) + " that skinning supports.";
+    }
+
+    const auto& sourceAnimation = *scene->mAnimations[0];
+    auto& animation = *(mesh.animation = std::make_unique<ImportedMesh::Animation>());
+    animation.duration = static_cast<float>(sourceAnimation.mDuration);
+    animation.ticksPerSecond = sourceAnimation.mTicksPerSecond > 0.0 ? static_cast<float>(sourceAnimation.mTicksPerSecond)
+                                                                     : modelImporterDefaultTicksPerSecond;
+    animation.boneOffsets = std::move(boneOffsets);
+    animation.globalInverseTransform = glm::inverse(ToMat4(scene->mRootNode->mTransformation));
+
+    auto channels = std::unordered_map<std::string, int>();
+    for (unsigned i = 0; i < sourceAnimation.mNumChannels; ++i) {
+        const auto& nodeAnimation = *sourceAnimation.mChannels[i];
+        channels.emplace(nodeAnimation.mNodeName.C_Str(), static_cast<int>(animation.channels.size()));
+        animation.channels.push_back(ToChannel(nodeAnimation));
+    }
+    AddNodes(*scene->mRootNode, -1, channels, bones, animation.nodes);
+
+    return importedMesh;
+}
+
+void ImportedMesh::Animation::Evaluate(float time, std::vector<glm::mat4>& globalTransforms,
+                                       std::vector<glm::mat4>& palette) const {
+    const auto ticks = time * ticksPerSecond;
+    const auto animationTime = duration > 0.f ? std::fmod(ticks, duration) : 0.f;
+
+    globalTransforms.resize(nodes.size());
+    palette.assign(boneOffsets.size(), glm::mat4(1.f));
+
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        const auto& node = nodes[i];
+        auto localTransform = node.transform;
+        if (node.channel >= 0) {
+            const auto& channel = channels[node.channel];
+            const auto lerp = [](const glm::vec3& a, const glm::vec3& b, float factor) { return glm::mix(a, b, factor); };
+            const auto slerp = [](const glm::quat& a, const glm::quat& b, float factor) {
+                return glm::normalize(glm::slerp(a, b, factor));
+            };
+
+            const auto translation = channel.positions.empty() ? glm::vec3(0.f)
+                                   : Interpolate(channel.positionTimes, channel.positions, animationTime, lerp);
+            const auto rotation = channel.rotations.empty() ? glm::quat(1.f, 0.f, 0.f, 0.f)
+                                : Interpolate(channel.rotationTimes, channel.rotations, animationTime, slerp);
+            const auto scaling = channel.scalings.empty() ? glm::vec3(1.f)
+                               : Interpolate(channel.scalingTimes, channel.scalings, animationTime, lerp);
+            localTransform = glm::translate(glm::mat4(1.f), translation) * glm::mat4_cast(rotation) *
+                             glm::scale(glm::mat4(1.f), scaling);
+        }
+
+        globalTransforms[i] = node.parent < 0 ? localTransform : globalTransforms[node.parent] * localTransform;
+        if (node.bone >= 0) {
+            palette[node.bone] = globalInverseTransform * globalTransforms[i] * boneOffsets[node.bone];
+        }
+    }
+}
+
+} // namespace model_viewer_3d
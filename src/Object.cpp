@@ -1,27 +1,29 @@
 // SPDX-License-Identifier: MPL-2.0
 // Copyright (c) 2017 Vangelis Tsiatsianas
 
+#include <cstring>
 #include <random>
 
 #include "Common.h"
 #include "Environment.h"
+#include "GLState.h"
+#include "GPUProfiler.h"
 #include "Object.h"
+#include "ShadowMap.h"
+#include "Utilities.h"
 
 #define GLM_SWIZZLE
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-namespace 3d_model_viewer {
+namespace model_viewer_3d {
 
 using Env = Environment;
 
-auto& camera = Environment::camera;
 auto& light = Environment::light;
 
-Object::Object(const std::string& name, unsigned long id) : name(name), id(std::to_string(id)), isAnimated(false) {
-    formattedName = id ? name + " " + this->id : name;
-    formattedNameCString = std::make_unique<const char[]>(formattedName.length() + 1);
-    std::memcpy(const_cast<char*>(formattedNameCString.get()), formattedName.c_str(), formattedName.length());
+Object::Object(const std::string& name, unsigned long id) : id(std::to_string(id)), isAnimated(false) {
+    SetName(name);
 
     selectedBoundingBoxColor = ImColor(255, 235, 0);
     defaultBoundingBoxColor = GetRandomBoundingBoxColor();
@@ -29,77 +31,88 @@ Object::Object(const std::string& name, unsigned long id) : name(name), id(std::
     LoadDefaultValues();
 }
 
-void Object::Display() {
+// Runs on the main thread and records everything Draw() needs, so that the object can keep changing while the packet is
+// being drawn.
+void Object::Prepare(RenderPacket& packet) {
     if (hidden) {
         return;
     }
 
-    glUseProgram(program);
-    glBindVertexArray(vao);
+    PROFILE_SCOPE(displayScopeName);
 
-    glDisable(GL_CULL_FACE);
-    glPushAttrib(GL_ALL_ATTRIB_BITS);
+    packet.items.emplace_back();
+    auto& item = packet.items.back();
+    item.object = this;
+    item.scopeName = displayScopeName;
+    item.sortKey = 0;
 
-    if (wireframe) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    } else {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    }
+    UpdateModelMatrix();
+    item.modelMatrix = modelMatrix;
+    item.boundsTransform = glm::mat4(1.f);
+    item.uploadModelMatrix = modelMatrixChanged;
+    modelMatrixChanged = false;
 
-    if (transformed) {
-        translationMatrix = glm::translate(glm::mat4(1.f), translation.xyz());
-        rotationMatrix = glm::mat4(1.f);
-        rotationMatrix = glm::rotate(rotationMatrix, rotation.x, glm::vec3(1.f, 0.f, 0.f));
-        rotationMatrix = glm::rotate(rotationMatrix, rotation.y, glm::vec3(0.f, 1.f, 0.f));
-        rotationMatrix = glm::rotate(rotationMatrix, rotation.z, glm::vec3(0.f, 0.f, 1.f));
-        scaleMatrix = glm::scale(glm::mat4(.2f), scaling.xyz());
+    item.ambientProduct = glm::vec4(light.ambientColor.x, light.ambientColor.y, light.ambientColor.z, light.ambientColor.w) *
+                          glm::vec4(materialAmbientColor.x, materialAmbientColor.y, materialAmbientColor.z, materialAmbientColor.w);
+    item.diffuseProduct = glm::vec4(light.diffuseColor.x, light.diffuseColor.y, light.diffuseColor.z, light.diffuseColor.w) *
+                          glm::vec4(materialDiffuseColor.x, materialDiffuseColor.y, materialDiffuseColor.z, materialDiffuseColor.w);
+    item.specularProduct = glm::vec4(light.specularColor.x, light.specularColor.y, light.specularColor.z, light.specularColor.w) *
+                           glm::vec4(materialSpecularColor.x, materialSpecularColor.y, materialSpecularColor.z, materialSpecularColor.w);
+    item.materialShininess = materialShininess;
 
-        modelMatrix = scaleMatrix * rotationMatrix * translationMatrix;
-        glUniformMatrix4fv(modelMatrixUniform, 1, GL_FALSE, glm::value_ptr(modelMatrix));
+    item.wireframe = wireframe;
 
-        transformed = false;
-    }
+    item.animationEnabled = false;
+    item.firstBone = 0;
+    item.numBones = 0;
+    item.geometry = -1;
+    item.batched = false;
 
-    if (camera.changed) {
-        viewMatrix = glm::lookAt(camera.position, camera.center, camera.up);
-        glUniformMatrix4fv(viewMatrixUniform, 1, GL_FALSE, glm::value_ptr(viewMatrix));
+    PrepareRender(packet, item);
 
-        projectionMatrix = glm::perspective(camera.fieldOfView, camera.aspectRatio, camera.nearClippingPlane, camera.farClippingPlane);
-        glUniformMatrix4fv(projectionMatrixUniform, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+    // Skinning would have to be repeated by the pre-pass, and lines would have to match the triangles they outline.
+    item.depthPrepass = packet.depthPrepass && !item.wireframe && !item.animationEnabled && item.geometry >= 0;
+}
 
-        --camera.changed;
+// Runs on the render thread and must only read the packet and the OpenGL objects created by Initialize().
+void Object::Draw(const RenderPacket& packet, const RenderPacket::Item& item) const {
+    // Batched objects draw nothing here, so they spend none of the frame's GPU timer queries.
+    if (item.batched) {
+        return;
     }
 
-    if (light.changed) {
-        ambientProduct = glm::vec4(light.ambientColor.x, light.ambientColor.y, light.ambientColor.z, light.ambientColor.w) *
-                         glm::vec4(materialAmbientColor.x, materialAmbientColor.y, materialAmbientColor.z, materialAmbientColor.w);
-        glUniform4fv(ambientProductUniform, 1, glm::value_ptr(ambientProduct));
+    PROFILE_GPU_SCOPE(item.scopeName);
 
-        diffuseProduct = glm::vec4(light.diffuseColor.x, light.diffuseColor.y, light.diffuseColor.z, light.diffuseColor.w) *
-                         glm::vec4(materialDiffuseColor.x, materialDiffuseColor.y, materialDiffuseColor.z, materialDiffuseColor.w);
-        glUniform4fv(diffuseProductUniform, 1, glm::value_ptr(diffuseProduct));
+    GLState::UseProgram(program);
+    GLState::BindVertexArray(vao);
 
-        specularProduct = glm::vec4(light.specularColor.x, light.specularColor.y, light.specularColor.z, light.specularColor.w) *
-                          glm::vec4(materialSpecularColor.x, materialSpecularColor.y, materialSpecularColor.z, materialSpecularColor.w);
-        glUniform4fv(specularProductUniform, 1, glm::value_ptr(specularProduct));
+    GLState::Disable(GL_CULL_FACE);
+    GLState::PolygonMode(item.wireframe ? GL_LINE : GL_FILL);
+    GLState::DepthFunc(item.depthPrepass ? GL_EQUAL : GL_LESS);
+    GLState::DepthMask(item.depthPrepass ? GL_FALSE : GL_TRUE);
 
-        glUniform4fv(lightPositionUniform, 1, glm::value_ptr(light.position));
-        glUniform1fv(lightIntensityUniform, 1, &light.intensity);
-        glUniform1fv(materialShininessUniform, 1, &materialShininess);
+    // The program is shared with every other object drawn from the same shaders, so none of its uniforms can be assumed
+    // to still hold what this object last uploaded.
+    glUniformMatrix4fv(modelMatrixUniform, 1, GL_FALSE, glm::value_ptr(item.modelMatrix));
+    glUniformMatrix4fv(viewMatrixUniform, 1, GL_FALSE, glm::value_ptr(packet.viewMatrix));
+    glUniformMatrix4fv(projectionMatrixUniform, 1, GL_FALSE, glm::value_ptr(packet.projectionMatrix));
 
-        --light.changed;
-    }
+    glUniform4fv(ambientProductUniform, 1, glm::value_ptr(item.ambientProduct));
+    glUniform4fv(diffuseProductUniform, 1, glm::value_ptr(item.diffuseProduct));
+    glUniform4fv(specularProductUniform, 1, glm::value_ptr(item.specularProduct));
 
-    Render();
+    glUniform4fv(lightPositionUniform, 1, glm::value_ptr(packet.lightPosition));
+    glUniform1fv(lightIntensityUniform, 1, &packet.lightIntensity);
+    glUniform1fv(materialShininessUniform, 1, &item.materialShininess);
 
-    glPopAttrib();
-    glBindVertexArray(0);
+    Render(packet, item);
 }
 
 void Object::DisplayControls() {
-    ImGui::Begin("Options");
+    // Begin returns false while the window is collapsed, in which case none of the panel needs to be emitted.
+    const auto optionsVisible = ImGui::Begin("Options");
 
-    if (ImGui::CollapsingHeader(formattedNameCString.get())) {
+    if (optionsVisible && ImGui::CollapsingHeader(formattedNameCString.get())) {
         if (ImGui::Button(UI_COMPONENT_NAME("Reset Defaults"))) {
             LoadDefaultValues();
         }
@@ -108,9 +121,7 @@ void Object::DisplayControls() {
             ImGui::Checkbox(UI_COMPONENT_NAME("Hidden"), &hidden);
             ImGui::Checkbox(UI_COMPONENT_NAME("Wireframe"), &wireframe);
             ImGui::Checkbox(UI_COMPONENT_NAME("Show Bounding Box"), &showBoundingBox);
-            if (ImGui::ColorEdit3("Bounding Box Color", IMVEC4_POINTER(boundingBoxColor))) {
-                boundingBoxColorChanged = true;
-            }
+            ImGui::ColorEdit3(UI_COMPONENT_NAME("Bounding Box Color"), IMVEC4_POINTER(boundingBoxColor));
             if (isAnimated) {
                 ImGui::Checkbox(UI_COMPONENT_NAME("Enable Animation [DOES NOT WORK]"), &animationEnabled);
             }
@@ -138,18 +149,10 @@ void Object::DisplayControls() {
             }
         }
         if (ImGui::CollapsingHeader(UI_COMPONENT_NAME("Material"))) {
-            if (ImGui::ColorEdit3(UI_COMPONENT_NAME("Ambient Color" "##Material"), IMVEC4_POINTER(materialAmbientColor))) {
-                ++light.changed;
-            }
-            if (ImGui::ColorEdit3(UI_COMPONENT_NAME("Diffuse Color" "##Material"), IMVEC4_POINTER(materialDiffuseColor))) {
-                ++light.changed;
-            }
-            if (ImGui::ColorEdit3(UI_COMPONENT_NAME("Specular Color" "##Material"), IMVEC4_POINTER(materialSpecularColor))) {
-                ++light.changed;
-            }
-            if (ImGui::SliderFloat(UI_COMPONENT_NAME("Shininess"), &materialShininess, .001f, 150.f)) {
-                ++light.changed;
-            }
+            ImGui::ColorEdit3(UI_COMPONENT_NAME("Ambient Color" "##Material"), IMVEC4_POINTER(materialAmbientColor));
+            ImGui::ColorEdit3(UI_COMPONENT_NAME("Diffuse Color" "##Material"), IMVEC4_POINTER(materialDiffuseColor));
+            ImGui::ColorEdit3(UI_COMPONENT_NAME("Specular Color" "##Material"), IMVEC4_POINTER(materialSpecularColor));
+            ImGui::SliderFloat(UI_COMPONENT_NAME("Shininess"), &materialShininess, .001f, 150.f);
         }
         ImGui::Unindent(15);
         ImGui::Spacing();
@@ -187,13 +190,76 @@ void Object::ProcessEvent(SDL_Event* event) {
 void Object::Select() {
     isSelected = true;
     boundingBoxColor = selectedBoundingBoxColor;
-    boundingBoxColorChanged = true;
 }
 
 void Object::Deselect() {
     isSelected = false;
     boundingBoxColor = defaultBoundingBoxColor;
-    boundingBoxColorChanged = true;
+}
+
+void Object::SetName(const std::string& name) {
+    this->name = name;
+    formattedName = id != "0" ? name + " " + id : name;
+    formattedNameCString = std::make_unique<const char[]>(formattedName.length() + 1);
+    std::memcpy(const_cast<char*>(formattedNameCString.get()), formattedName.c_str(), formattedName.length());
+    displayScopeName = Profiler::Intern("Object::Display [" + formattedName + "]");
+
+    labels.clear();
+}
+
+void Object::SetTranslation(const glm::vec3& translation) {
+    this->translation = glm::vec4(translation, 0.f);
+    transformed = true;
+}
+
+void Object::SetRotation(const glm::vec3& rotationInDegrees) {
+    this->rotationInDegrees = rotationInDegrees;
+    rotation = glm::vec4(glm::radians(rotationInDegrees), 0.f);
+    transformed = true;
+}
+
+void Object::SetBoundingBoxVisible(bool visible) {
+    showBoundingBox = visible;
+}
+
+void Object::SetAnimationEnabled(bool enabled) {
+    animationEnabled = enabled && isAnimated;
+}
+
+bool Object::IsAnimated() const {
+    return isAnimated;
+}
+
+bool Object::IsHidden() const {
+    return hidden;
+}
+
+const ImVec4& Object::GetMaterialAmbientColor() const {
+    return materialAmbientColor;
+}
+
+const ImVec4& Object::GetMaterialDiffuseColor() const {
+    return materialDiffuseColor;
+}
+
+const ImVec4& Object::GetMaterialSpecularColor() const {
+    return materialSpecularColor;
+}
+
+float Object::GetMaterialShininess() const {
+    return materialShininess;
+}
+
+bool Object::UpdateModelMatrix() {
+    if (!transformed) {
+        return false;
+    }
+
+    modelMatrix = Utilities::ComposeModelMatrix(translation.xyz(), rotation.xyz(), scaling.xyz());
+
+    transformed = false;
+    modelMatrixChanged = true;
+    return true;
 }
 
 void Object::SetupUniforms() {
@@ -206,6 +272,8 @@ void Object::SetupUniforms() {
     SETUP_UNIFORM(specularProduct);
     SETUP_UNIFORM(lightIntensity);
     SETUP_UNIFORM(materialShininess);
+
+    ShadowMap::SetupProgram(program);
 }
 
 void Object::LoadDefaultValues() {
@@ -229,10 +297,17 @@ void Object::LoadDefaultValues() {
 
     boundingBoxColor = defaultBoundingBoxColor;
 
-    boundingBoxColorChanged = true;
     isSelected = false;
+}
 
-    Environment::ForceUpdate();
+// Widget labels embed the name and id of the object to keep their ImGui IDs unique. They are built the first time each
+// label is used and then reused every frame, until the object is renamed.
+const char* Object::GetLabel(const char* text) {
+    auto& label = labels[text];
+    if (label.empty()) {
+        label = std::string(text) + "##[" + name + " " + id + "]##";
+    }
+    return label.c_str();
 }
 
 ImColor Object::GetRandomBoundingBoxColor() {
@@ -242,4 +317,4 @@ ImColor Object::GetRandomBoundingBoxColor() {
     return {distribution(generator), distribution(generator), distribution(generator), 255};
 }
 
-} // namespace 3d_model_viewer
+} // namespace model_viewer_3d
@@ -0,0 +1,1147 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <algorithm>
+#include <bitset>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#include "Common.h"
+#include "Environment.h"
+#include "GLState.h"
+#include "GPUProfiler.h"
+#include "JobSystem.h"
+#include "PathTracer.h"
+
+#define GLM_SWIZZLE
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glGA/glGAHelper.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#define HASH_VALUE(signature, x) (signature = HashBytes(signature, &(x), sizeof(x)))
+
+#define LANE_DIRECTION(packet, lane)                                                                    \
+    glm::vec3((packet).directionX[lane], (packet).directionY[lane], (packet).directionZ[lane])
+
+#define LANE_ORIGIN(packet, lane)                                                                       \
+    glm::vec3((packet).originX[lane], (packet).originY[lane], (packet).originZ[lane])
+
+#define IMVEC4_TO_VEC3(color) (glm::vec3((color).x, (color).y, (color).z))
+
+namespace model_viewer_3d {
+
+const std::string pathTracerShadersDirectory = std::string(rootDirectory) + "shaders/";
+constexpr auto bvhMaxDepth = 48;
+constexpr auto bvhStackSize = 64;
+constexpr auto rayEpsilon = 1e-4f;
+constexpr auto raysPerSecondRefreshInterval = .5f;
+
+bool PathTracer::enabled = false;
+
+std::unique_ptr<PathTracer::Scene> PathTracer::scene;
+std::unordered_map<std::string, std::shared_ptr<const PathTracer::MeshBVH>> PathTracer::meshBVHs;
+
+int PathTracer::width = 0;
+int PathTracer::height = 0;
+float PathTracer::resolutionScale = .5f;
+float PathTracer::environmentIntensity = .5f;
+int PathTracer::maxBounces = pathTracerMaxBounces;
+
+std::vector<glm::vec3> PathTracer::accumulation;
+std::vector<std::uint32_t> PathTracer::displayPixels;
+std::unique_ptr<PathTracer::Tile[]> PathTracer::tiles;
+int PathTracer::numTiles = 0;
+
+std::vector<std::thread> PathTracer::workers;
+std::mutex PathTracer::workerMutex;
+std::condition_variable PathTracer::workerCondition;
+std::atomic<unsigned> PathTracer::nextTile(0);
+std::atomic<int> PathTracer::activeWorkers(0);
+std::atomic<bool> PathTracer::paused(true);
+std::atomic<bool> PathTracer::stopping(false);
+std::atomic<unsigned long long> PathTracer::raysTraced(0);
+bool PathTracer::converged = false;
+
+std::mutex PathTracer::displayMutex;
+int PathTracer::displayWidth = 0;
+int PathTracer::displayHeight = 0;
+bool PathTracer::displayChanged = false;
+
+std::uint64_t PathTracer::sceneSignature = 0;
+Time PathTracer::raysTracedSince;
+float PathTracer::raysPerSecond = 0.f;
+
+GLuint PathTracer::program = 0;
+GLuint PathTracer::vao = 0;
+GLuint PathTracer::texture = 0;
+int PathTracer::textureWidth = 0;
+int PathTracer::textureHeight = 0;
+
+static std::uint64_t HashBytes(std::uint64_t signature, const void* data, std::size_t size) {
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+        signature = (signature ^ bytes[i]) * 1099511628211ull;
+    }
+    return signature;
+}
+
+static std::uint32_t NextRandom(std::uint32_t& state) {
+    state = state * 747796405u + 2891336453u;
+    const auto word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+static float RandomFloat(std::uint32_t& state) {
+    return static_cast<float>(NextRandom(state) >> 8) * (1.f / 16777216.f);
+}
+
+static glm::vec3 SampleCosineHemisphere(const glm::vec3& normal, std::uint32_t& state) {
+    const auto sign = std::copysign(1.f, normal.z);
+    const auto a = -1.f / (sign + normal.z);
+    const auto b = normal.x * normal.y * a;
+    const auto tangent = glm::vec3(1.f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+    const auto bitangent = glm::vec3(b, sign + normal.y * normal.y * a, -normal.y);
+
+    const auto radius = std::sqrt(RandomFloat(state));
+    const auto angle = 6.2831853f * RandomFloat(state);
+    const auto x = radius * std::cos(angle);
+    const auto y = radius * std::sin(angle);
+    const auto z = std::sqrt(std::max(0.f, 1.f - x * x - y * y));
+
+    return x * tangent + y * bitangent + z * normal;
+}
+
+// The active masks hold one bit per lane of a ray packet.
+static unsigned CountActiveLanes(int activeMask) {
+    return static_cast<unsigned>(std::bitset<rayPacketSize>(static_cast<unsigned>(activeMask)).count());
+}
+
+static std::uint32_t PackColor(const glm::vec3& color) {
+    const auto clamped = glm::clamp(color, glm::vec3(0.f), glm::vec3(1.f));
+    return static_cast<std::uint32_t>(clamped.r * 255.f + .5f) |
+           static_cast<std::uint32_t>(clamped.g * 255.f + .5f) << 8 |
+           static_cast<std::uint32_t>(clamped.b * 255.f + .5f) << 16 |
+           0xFF000000u;
+}
+
+static float SurfaceArea(const glm::vec3& min, const glm::vec3& max) {
+    const auto extent = max - min;
+    return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+void PathTracer::Initialize() {
+    glGenVertexArrays(1, &vao);
+
+    const auto vertexShader = pathTracerShadersDirectory + "PathTracer.vert";
+    const auto fragmentShader = pathTracerShadersDirectory + "PathTracer.frag";
+    program = LoadShaders(vertexShader.c_str(), fragmentShader.c_str());
+
+    glGenTextures(1, &texture);
+    GLState::BindTexture(0, GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    GLState::BindTexture(0, GL_TEXTURE_2D, 0);
+}
+
+void PathTracer::CleanUp() {
+    StopWorkers();
+
+    GLState::DeleteTextures(1, &texture);
+    GLState::DeleteVertexArrays(1, &vao);
+    glDeleteProgram(program);
+
+    scene.reset();
+    meshBVHs.clear();
+}
+
+// Runs on the main thread; only Display() touches OpenGL, so that it can run on the render thread.
+void PathTracer::Update(std::vector<PolygonMesh>& models, const ImVec4& backgroundColor) {
+    if (!enabled) {
+        return;
+    }
+
+    if (workers.empty()) {
+        StartWorkers();
+    }
+
+    PROFILE_SCOPE("PathTracer::Update");
+
+    if (SceneChanged(models, backgroundColor)) {
+        PauseWorkers();
+        BuildScene(models, backgroundColor);
+        ResetAccumulation();
+    }
+
+    if (paused) {
+        ResumeWorkers();
+    }
+
+    const auto now = Utilities::GetCurrentTime();
+    const auto elapsed = Utilities::DurationToFloat(now - raysTracedSince);
+    if (elapsed >= raysPerSecondRefreshInterval) {
+        raysPerSecond = static_cast<float>(raysTraced.exchange(0)) / elapsed;
+        raysTracedSince = now;
+    }
+}
+
+void PathTracer::Display() {
+    PROFILE_GPU_SCOPE("PathTracer::Display");
+
+    GLState::BindTexture(0, GL_TEXTURE_2D, texture);
+    {
+        std::lock_guard<std::mutex> lock(displayMutex);
+        if (displayChanged) {
+            if (textureWidth != displayWidth || textureHeight != displayHeight) {
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, displayWidth, displayHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, displayPixels.data());
+                textureWidth = displayWidth;
+                textureHeight = displayHeight;
+            } else {
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, displayWidth, displayHeight, GL_RGBA, GL_UNSIGNED_BYTE, displayPixels.data());
+            }
+            displayChanged = false;
+        }
+    }
+
+    GLState::UseProgram(program);
+    GLState::BindVertexArray(vao);
+
+    GLState::Disable(GL_DEPTH_TEST);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    GLState::Enable(GL_DEPTH_TEST);
+}
+
+void PathTracer::DisplayControls() {
+    ImGui::Begin("Options");
+
+    if (ImGui::CollapsingHeader("Reference Renderer")) {
+        ImGui::Indent(15);
+        auto isEnabled = enabled;
+        if (ImGui::Checkbox("Enabled" "##PathTracer", &isEnabled)) {
+            isEnabled ? Enable() : Disable();
+        }
+        ImGui::SliderFloat("Resolution Scale" "##PathTracer", &resolutionScale, .1f, 1.f);
+        ImGui::SliderInt("Max Bounces" "##PathTracer", &maxBounces, 1, pathTracerMaxBounces);
+        ImGui::SliderFloat("Environment Intensity" "##PathTracer", &environmentIntensity, 0.f, 2.f);
+
+        if (enabled) {
+            auto samples = pathTracerMaxSamples;
+            for (int i = 0; i < numTiles; ++i) {
+                samples = std::min(samples, tiles[i].samples.load());
+            }
+            const auto numCores = std::max<std::size_t>(workers.size(), 1);
+            ImGui::Text("Samples per Pixel: %u", samples);
+            ImGui::Text("Rays/s: %.2fM (%.2fM per core)", raysPerSecond / 1e6f, raysPerSecond / 1e6f / numCores);
+        }
+        ImGui::Unindent(15);
+        ImGui::Spacing();
+    }
+
+    ImGui::End();
+}
+
+void PathTracer::Enable() {
+    enabled = true;
+    sceneSignature = 0;
+}
+
+void PathTracer::Disable() {
+    enabled = false;
+    if (!workers.empty()) {
+        PauseWorkers();
+    }
+}
+
+void PathTracer::Toggle() {
+    enabled ? Disable() : Enable();
+}
+
+void PathTracer::StartWorkers() {
+    stopping = false;
+    paused = true;
+
+    const auto numWorkers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    for (unsigned i = 0; i < numWorkers; ++i) {
+        workers.emplace_back(WorkerLoop);
+    }
+
+    raysTracedSince = Utilities::GetCurrentTime();
+}
+
+void PathTracer::StopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(workerMutex);
+        stopping = true;
+    }
+    workerCondition.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void PathTracer::PauseWorkers() {
+    std::unique_lock<std::mutex> lock(workerMutex);
+    paused = true;
+    workerCondition.wait(lock, [] { return activeWorkers == 0; });
+}
+
+void PathTracer::ResumeWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(workerMutex);
+        paused = false;
+    }
+    workerCondition.notify_all();
+}
+
+void PathTracer::WorkerLoop() {
+    Profiler::SetThreadName("Path Tracer Worker");
+
+    std::unique_lock<std::mutex> lock(workerMutex);
+
+    while (!stopping) {
+        workerCondition.wait(lock, [] { return stopping || (!paused && !converged); });
+        if (stopping) {
+            break;
+        }
+
+        ++activeWorkers;
+        lock.unlock();
+
+        Tile* tile = nullptr;
+        while (!paused && !stopping && (tile = AcquireTile())) {
+            RenderTile(*tile);
+            ++tile->samples;
+            ResolveTile(*tile);
+            tile->busy = false;
+        }
+
+        lock.lock();
+        --activeWorkers;
+        if (!tile && !paused && !stopping) {
+            converged = true;
+        }
+        workerCondition.notify_all();
+    }
+}
+
+PathTracer::Tile* PathTracer::AcquireTile() {
+    while (!paused && !stopping) {
+        auto remaining = false;
+        for (int attempt = 0; attempt < numTiles; ++attempt) {
+            auto& tile = tiles[nextTile++ % numTiles];
+            if (tile.samples >= pathTracerMaxSamples) {
+                continue;
+            }
+
+            remaining = true;
+            if (!tile.busy.exchange(true)) {
+                return &tile;
+            }
+        }
+
+        if (!remaining) {
+            break;
+        }
+        std::this_thread::yield();
+    }
+    return nullptr;
+}
+
+bool PathTracer::SceneChanged(std::vector<PolygonMesh>& models, const ImVec4& backgroundColor) {
+    const auto& camera = Environment::camera;
+    const auto& light = Environment::light;
+
+    std::uint64_t signature = 14695981039346656037ull;
+    HASH_VALUE(signature, camera.position);
+    HASH_VALUE(signature, camera.center);
+    HASH_VALUE(signature, camera.up);
+    HASH_VALUE(signature, camera.fieldOfView);
+    HASH_VALUE(signature, camera.aspectRatio);
+    HASH_VALUE(signature, light.position);
+    HASH_VALUE(signature, light.ambientColor);
+    HASH_VALUE(signature, light.diffuseColor);
+    HASH_VALUE(signature, light.specularColor);
+    HASH_VALUE(signature, light.intensity);
+    HASH_VALUE(signature, backgroundColor);
+    HASH_VALUE(signature, resolutionScale);
+    HASH_VALUE(signature, environmentIntensity);
+    HASH_VALUE(signature, maxBounces);
+
+    for (auto& model : models) {
+        model.UpdateModelMatrix();
+
+        const auto* identity = model.formattedNameCString.get();
+        const auto hidden = model.IsHidden();
+        const auto shininess = model.GetMaterialShininess();
+        HASH_VALUE(signature, identity);
+        HASH_VALUE(signature, model.modelMatrix);
+        HASH_VALUE(signature, hidden);
+        HASH_VALUE(signature, model.GetMaterialAmbientColor());
+        HASH_VALUE(signature, model.GetMaterialDiffuseColor());
+        HASH_VALUE(signature, model.GetMaterialSpecularColor());
+        HASH_VALUE(signature, shininess);
+    }
+
+    if (signature == sceneSignature) {
+        return false;
+    }
+
+    sceneSignature = signature;
+    return true;
+}
+
+// Instances of the same mesh share one BVH: synthetic meshes are told apart by address and loaded ones by their file.
+std::string PathTracer::GetMeshKey(const PolygonMesh& model) {
+    if (model.syntheticMesh) {
+        return "synthetic:" + std::to_string(reinterpret_cast<std::uintptr_t>(model.syntheticMesh.get()));
+    }
+    return "file:" + model.path;
+}
+
+void PathTracer::BuildScene(std::vector<PolygonMesh>& models, const ImVec4& backgroundColor) {
+    const auto& camera = Environment::camera;
+    const auto& light = Environment::light;
+
+    auto newScene = std::make_unique<Scene>();
+    auto newMeshBVHs = std::unordered_map<std::string, std::shared_ptr<const MeshBVH>>();
+
+    // The missing mesh BVHs are independent of each other, so they are built in parallel before any instance is added.
+    std::vector<std::pair<const PolygonMesh*, std::shared_ptr<MeshBVH>>> bvhBuilds;
+    for (const auto& model : models) {
+        const auto key = GetMeshKey(model);
+        if (model.IsHidden() || newMeshBVHs.count(key)) {
+            continue;
+        }
+
+        auto bvh = meshBVHs[key];
+        if (!bvh) {
+            auto newBVH = std::make_shared<MeshBVH>();
+            newBVH->syntheticMesh = model.syntheticMesh;
+            bvhBuilds.emplace_back(&model, newBVH);
+            bvh = newBVH;
+        }
+        newMeshBVHs[key] = bvh;
+    }
+
+    JobSystem::ParallelFor("MeshBVH::Build", static_cast<unsigned>(bvhBuilds.size()), 1, [&bvhBuilds](unsigned begin, unsigned end) {
+        for (auto i = begin; i < end; ++i) {
+            bvhBuilds[i].second->Build(*bvhBuilds[i].first);
+        }
+    });
+
+    for (auto& model : models) {
+        if (model.IsHidden()) {
+            continue;
+        }
+
+        const auto& bvh = newMeshBVHs[GetMeshKey(model)];
+        if (bvh->nodes.empty()) {
+            continue;
+        }
+
+        Instance instance;
+        instance.bvh = bvh;
+        instance.objectToWorld = model.modelMatrix;
+        instance.worldToObject = glm::inverse(model.modelMatrix);
+        instance.normalMatrix = glm::inverseTranspose(glm::mat3(model.modelMatrix));
+
+        instance.ambientProduct = IMVEC4_TO_VEC3(light.ambientColor) * IMVEC4_TO_VEC3(model.GetMaterialAmbientColor());
+        instance.diffuseProduct = IMVEC4_TO_VEC3(light.diffuseColor) * IMVEC4_TO_VEC3(model.GetMaterialDiffuseColor());
+        instance.specularProduct = IMVEC4_TO_VEC3(light.specularColor) * IMVEC4_TO_VEC3(model.GetMaterialSpecularColor());
+        instance.albedo = IMVEC4_TO_VEC3(model.GetMaterialDiffuseColor());
+        instance.shininess = model.GetMaterialShininess();
+
+        const auto& root = bvh->nodes[0];
+        instance.min = glm::vec3(FLT_MAX);
+        instance.max = glm::vec3(-FLT_MAX);
+        for (int corner = 0; corner < 8; ++corner) {
+            const auto objectCorner = glm::vec3(corner & 1 ? root.max.x : root.min.x,
+                                                corner & 2 ? root.max.y : root.min.y,
+                                                corner & 4 ? root.max.z : root.min.z);
+            const auto worldCorner = (instance.objectToWorld * glm::vec4(objectCorner, 1.f)).xyz();
+            instance.min = glm::min(instance.min, worldCorner);
+            instance.max = glm::max(instance.max, worldCorner);
+        }
+
+        newScene->instances.push_back(instance);
+    }
+
+    meshBVHs = std::move(newMeshBVHs);
+
+    const auto forward = glm::normalize(camera.center - camera.position);
+    const auto right = glm::normalize(glm::cross(forward, camera.up));
+    const auto up = glm::cross(right, forward);
+    const auto tanHalfFieldOfView = std::tan(camera.fieldOfView / 2.f);
+
+    newScene->cameraPosition = camera.position;
+    newScene->cameraForward = forward;
+    newScene->cameraRight = right * tanHalfFieldOfView * camera.aspectRatio;
+    newScene->cameraUp = up * tanHalfFieldOfView;
+
+    newScene->lightPosition = light.position.xyz();
+    newScene->lightIntensity = light.intensity;
+    newScene->environmentColor = IMVEC4_TO_VEC3(backgroundColor);
+    newScene->environmentIntensity = environmentIntensity;
+    newScene->maxBounces = maxBounces;
+
+    scene = std::move(newScene);
+    BuildTopLevelBVH();
+}
+
+void PathTracer::BuildTopLevelBVH() {
+    auto& instances = scene->instances;
+
+    std::vector<glm::vec3> instanceMin(instances.size());
+    std::vector<glm::vec3> instanceMax(instances.size());
+    for (std::size_t i = 0; i < instances.size(); ++i) {
+        instanceMin[i] = instances[i].min;
+        instanceMax[i] = instances[i].max;
+    }
+
+    std::vector<std::uint32_t> order;
+    BuildBVH(scene->nodes, instanceMin, instanceMax, order);
+
+    std::vector<Instance> orderedInstances;
+    orderedInstances.reserve(instances.size());
+    for (const auto index : order) {
+        orderedInstances.push_back(instances[index]);
+    }
+    instances = std::move(orderedInstances);
+}
+
+void PathTracer::BuildBVH(std::vector<BVHNode>& nodes, const std::vector<glm::vec3>& primitiveMin,
+                          const std::vector<glm::vec3>& primitiveMax, std::vector<std::uint32_t>& order) {
+    const auto numPrimitives = static_cast<std::uint32_t>(primitiveMin.size());
+
+    order.resize(numPrimitives);
+    std::iota(order.begin(), order.end(), 0);
+
+    nodes.clear();
+    if (!numPrimitives) {
+        return;
+    }
+
+    nodes.reserve(2 * numPrimitives);
+    nodes.push_back({glm::vec3(), 0, glm::vec3(), numPrimitives});
+
+    const auto centroid = [&](std::uint32_t primitive) {
+        return (primitiveMin[primitive] + primitiveMax[primitive]) * .5f;
+    };
+
+    struct Bin {
+        glm::vec3 min = glm::vec3(FLT_MAX);
+        glm::vec3 max = glm::vec3(-FLT_MAX);
+        std::uint32_t count = 0;
+    };
+
+    std::vector<std::pair<std::uint32_t, int>> stack = {{0, 0}};
+    while (!stack.empty()) {
+        const auto nodeIndex = stack.back().first;
+        const auto depth = stack.back().second;
+        stack.pop_back();
+
+        auto& node = nodes[nodeIndex];
+        const auto first = node.leftOrFirst;
+        const auto count = node.count;
+
+        auto centroidMin = glm::vec3(FLT_MAX);
+        auto centroidMax = glm::vec3(-FLT_MAX);
+        node.min = glm::vec3(FLT_MAX);
+        node.max = glm::vec3(-FLT_MAX);
+        for (auto i = first; i < first + count; ++i) {
+            const auto primitive = order[i];
+            node.min = glm::min(node.min, primitiveMin[primitive]);
+            node.max = glm::max(node.max, primitiveMax[primitive]);
+            centroidMin = glm::min(centroidMin, centroid(primitive));
+            centroidMax = glm::max(centroidMax, centroid(primitive));
+        }
+
+        if (count <= bvhMaxLeafSize || depth >= bvhMaxDepth) {
+            continue;
+        }
+
+        auto bestAxis = -1;
+        auto bestSplit = 0;
+        auto bestCost = static_cast<float>(count) * SurfaceArea(node.min, node.max);
+
+        for (int axis = 0; axis < 3; ++axis) {
+            const auto extent = centroidMax[axis] - centroidMin[axis];
+            if (extent <= 0.f) {
+                continue;
+            }
+
+            Bin bins[bvhNumBins];
+            const auto binScale = bvhNumBins / extent;
+            for (auto i = first; i < first + count; ++i) {
+                const auto primitive = order[i];
+                const auto bin = std::min(bvhNumBins - 1, static_cast<int>((centroid(primitive)[axis] - centroidMin[axis]) * binScale));
+                bins[bin].min = glm::min(bins[bin].min, primitiveMin[primitive]);
+                bins[bin].max = glm::max(bins[bin].max, primitiveMax[primitive]);
+                ++bins[bin].count;
+            }
+
+            float leftArea[bvhNumBins - 1];
+            std::uint32_t leftCount[bvhNumBins - 1];
+            Bin leftBounds;
+            for (int split = 0; split < bvhNumBins - 1; ++split) {
+                leftBounds.min = glm::min(leftBounds.min, bins[split].min);
+                leftBounds.max = glm::max(leftBounds.max, bins[split].max);
+                leftBounds.count += bins[split].count;
+                leftArea[split] = leftBounds.count ? SurfaceArea(leftBounds.min, leftBounds.max) : 0.f;
+                leftCount[split] = leftBounds.count;
+            }
+
+            Bin rightBounds;
+            for (int split = bvhNumBins - 2; split >= 0; --split) {
+                rightBounds.min = glm::min(rightBounds.min, bins[split + 1].min);
+                rightBounds.max = glm::max(rightBounds.max, bins[split + 1].max);
+                rightBounds.count += bins[split + 1].count;
+
+                if (!leftCount[split] || !rightBounds.count) {
+                    continue;
+                }
+
+                const auto cost = leftCount[split] * leftArea[split] +
+                                  rightBounds.count * SurfaceArea(rightBounds.min, rightBounds.max);
+                if (cost < bestCost) {
+                    bestAxis = axis;
+                    bestSplit = split;
+                    bestCost = cost;
+                }
+            }
+        }
+
+        if (bestAxis == -1) {
+            continue;
+        }
+
+        const auto binScale = bvhNumBins / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+        const auto middle = std::partition(order.begin() + first, order.begin() + first + count, [&](std::uint32_t primitive) {
+            const auto bin = std::min(bvhNumBins - 1, static_cast<int>((centroid(primitive)[bestAxis] - centroidMin[bestAxis]) * binScale));
+            return bin <= bestSplit;
+        });
+
+        const auto leftCount = static_cast<std::uint32_t>(middle - (order.begin() + first));
+        if (!leftCount || leftCount == count) {
+            continue;
+        }
+
+        const auto leftIndex = static_cast<std::uint32_t>(nodes.size());
+        nodes.push_back({glm::vec3(), first, glm::vec3(), leftCount});
+        nodes.push_back({glm::vec3(), first + leftCount, glm::vec3(), count - leftCount});
+
+        nodes[nodeIndex].leftOrFirst = leftIndex;
+        nodes[nodeIndex].count = 0;
+
+        stack.emplace_back(leftIndex, depth + 1);
+        stack.emplace_back(leftIndex + 1, depth + 1);
+    }
+}
+
+void PathTracer::MeshBVH::Build(const PolygonMesh& model) {
+    std::vector<Triangle> unorderedTriangles;
+    std::vector<glm::vec3> triangleMin;
+    std::vector<glm::vec3> triangleMax;
+
+    const auto& positions = model.GetPositions();
+    const auto& normals = model.GetNormals();
+    const auto& indices = model.GetIndices();
+
+    const auto hasNormals = normals.size() == positions.size();
+    for (const auto& submesh : model.GetSubmeshes()) {
+        for (unsigned i = 0; i + 2 < submesh.numIndices; i += 3) {
+            const auto index0 = submesh.baseVertex + indices[submesh.baseIndex + i];
+            const auto index1 = submesh.baseVertex + indices[submesh.baseIndex + i + 1];
+            const auto index2 = submesh.baseVertex + indices[submesh.baseIndex + i + 2];
+
+            const auto& position0 = positions[index0];
+            const auto& position1 = positions[index1];
+            const auto& position2 = positions[index2];
+
+            Triangle triangle;
+            triangle.vertex0 = position0;
+            triangle.edge1 = position1 - position0;
+            triangle.edge2 = position2 - position0;
+
+            if (hasNormals) {
+                triangle.normal0 = normals[index0];
+                triangle.normal1 = normals[index1];
+                triangle.normal2 = normals[index2];
+            } else {
+                const auto faceNormal = glm::normalize(glm::cross(triangle.edge1, triangle.edge2));
+                triangle.normal0 = faceNormal;
+                triangle.normal1 = faceNormal;
+                triangle.normal2 = faceNormal;
+            }
+
+            unorderedTriangles.push_back(triangle);
+            triangleMin.push_back(glm::min(position0, glm::min(position1, position2)));
+            triangleMax.push_back(glm::max(position0, glm::max(position1, position2)));
+        }
+    }
+
+    std::vector<std::uint32_t> order;
+    BuildBVH(nodes, triangleMin, triangleMax, order);
+
+    triangles.clear();
+    triangles.reserve(order.size());
+    for (const auto index : order) {
+        triangles.push_back(unorderedTriangles[index]);
+    }
+}
+
+void PathTracer::ResetAccumulation() {
+    const auto newWidth = std::max(1, static_cast<int>(windowWidth * resolutionScale));
+    const auto newHeight = std::max(1, static_cast<int>(windowHeight * resolutionScale));
+
+    if (newWidth != width || newHeight != height || !tiles) {
+        width = newWidth;
+        height = newHeight;
+
+        const auto tilesX = (width + pathTracerTileSize - 1) / pathTracerTileSize;
+        const auto tilesY = (height + pathTracerTileSize - 1) / pathTracerTileSize;
+        numTiles = tilesX * tilesY;
+        tiles = std::make_unique<Tile[]>(numTiles);
+
+        for (int y = 0; y < tilesY; ++y) {
+            for (int x = 0; x < tilesX; ++x) {
+                auto& tile = tiles[y * tilesX + x];
+                tile.x = x * pathTracerTileSize;
+                tile.y = y * pathTracerTileSize;
+                tile.width = std::min(pathTracerTileSize, width - tile.x);
+                tile.height = std::min(pathTracerTileSize, height - tile.y);
+            }
+        }
+    }
+
+    for (int i = 0; i < numTiles; ++i) {
+        tiles[i].samples = 0;
+        tiles[i].busy = false;
+    }
+
+    accumulation.assign(static_cast<std::size_t>(width) * height, glm::vec3(0.f));
+
+    {
+        std::lock_guard<std::mutex> lock(displayMutex);
+        displayPixels.assign(static_cast<std::size_t>(width) * height, PackColor(scene->environmentColor));
+        displayWidth = width;
+        displayHeight = height;
+        displayChanged = true;
+    }
+
+    nextTile = 0;
+    converged = false;
+}
+
+void PathTracer::RenderTile(Tile& tile) {
+    PROFILE_SCOPE("PathTracer::RenderTile");
+
+    const auto sample = tile.samples.load();
+    const auto inverseWidth = 1.f / width;
+    const auto inverseHeight = 1.f / height;
+    unsigned long long numRays = 0;
+
+    auto packet = RayPacket();
+    auto shadowPacket = RayPacket();
+
+    glm::vec3 radiance[rayPacketSize];
+    glm::vec3 throughput[rayPacketSize];
+    glm::vec3 hitPosition[rayPacketSize];
+    glm::vec3 hitNormal[rayPacketSize];
+    std::uint32_t randomState[rayPacketSize];
+
+    for (int quadY = tile.y; quadY < tile.y + tile.height; quadY += 2) {
+        for (int quadX = tile.x; quadX < tile.x + tile.width; quadX += 2) {
+            packet.activeMask = 0;
+
+            for (int lane = 0; lane < rayPacketSize; ++lane) {
+                const auto x = quadX + (lane & 1);
+                const auto y = quadY + (lane >> 1);
+                radiance[lane] = glm::vec3(0.f);
+                throughput[lane] = glm::vec3(1.f);
+
+                if (x >= tile.x + tile.width || y >= tile.y + tile.height) {
+                    continue;
+                }
+
+                randomState[lane] = static_cast<std::uint32_t>(y * width + x) * 9781u + sample * 6271u + 1u;
+                NextRandom(randomState[lane]);
+
+                const auto screenX = ((x + RandomFloat(randomState[lane])) * inverseWidth) * 2.f - 1.f;
+                const auto screenY = 1.f - ((y + RandomFloat(randomState[lane])) * inverseHeight) * 2.f;
+                const auto direction = glm::normalize(scene->cameraForward + screenX * scene->cameraRight +
+                                                      screenY * scene->cameraUp);
+
+                packet.originX[lane] = scene->cameraPosition.x;
+                packet.originY[lane] = scene->cameraPosition.y;
+                packet.originZ[lane] = scene->cameraPosition.z;
+                SetRayDirection(packet, lane, direction);
+                packet.activeMask |= 1 << lane;
+            }
+
+            for (int bounce = 0; bounce < scene->maxBounces && packet.activeMask; ++bounce) {
+                for (int lane = 0; lane < rayPacketSize; ++lane) {
+                    packet.distance[lane] = FLT_MAX;
+                    packet.instanceIndex[lane] = -1;
+                }
+
+                IntersectScene(packet);
+                numRays += CountActiveLanes(packet.activeMask);
+
+                shadowPacket.activeMask = 0;
+                for (int lane = 0; lane < rayPacketSize; ++lane) {
+                    if (!(packet.activeMask & (1 << lane))) {
+                        continue;
+                    }
+
+                    if (packet.instanceIndex[lane] < 0) {
+                        const auto environment = bounce ? scene->environmentColor * scene->environmentIntensity
+                                                        : scene->environmentColor;
+                        radiance[lane] += throughput[lane] * environment;
+                        packet.activeMask &= ~(1 << lane);
+                        continue;
+                    }
+
+                    const auto& instance = scene->instances[packet.instanceIndex[lane]];
+                    const auto& triangle = instance.bvh->triangles[packet.triangleIndex[lane]];
+                    const auto u = packet.u[lane];
+                    const auto v = packet.v[lane];
+                    const auto direction = LANE_DIRECTION(packet, lane);
+
+                    auto normal = glm::normalize(instance.normalMatrix * ((1.f - u - v) * triangle.normal0 +
+                                                                          u * triangle.normal1 +
+                                                                          v * triangle.normal2));
+                    if (glm::dot(normal, direction) > 0.f) {
+                        normal = -normal;
+                    }
+
+                    hitPosition[lane] = LANE_ORIGIN(packet, lane) + packet.distance[lane] * direction;
+                    hitNormal[lane] = normal;
+
+                    const auto shadowOrigin = hitPosition[lane] + normal * rayEpsilon;
+                    shadowPacket.originX[lane] = shadowOrigin.x;
+                    shadowPacket.originY[lane] = shadowOrigin.y;
+                    shadowPacket.originZ[lane] = shadowOrigin.z;
+                    SetRayDirection(shadowPacket, lane, scene->lightPosition - shadowOrigin);
+                    shadowPacket.distance[lane] = 1.f - rayEpsilon;
+                    shadowPacket.instanceIndex[lane] = -1;
+                    shadowPacket.activeMask |= 1 << lane;
+                }
+
+                if (!shadowPacket.activeMask) {
+                    break;
+                }
+
+                IntersectScene(shadowPacket);
+                numRays += CountActiveLanes(shadowPacket.activeMask);
+
+                for (int lane = 0; lane < rayPacketSize; ++lane) {
+                    if (!(packet.activeMask & (1 << lane))) {
+                        continue;
+                    }
+
+                    const auto& instance = scene->instances[packet.instanceIndex[lane]];
+                    const auto& normal = hitNormal[lane];
+                    const auto eye = -glm::normalize(LANE_DIRECTION(packet, lane));
+                    const auto toLight = glm::normalize(scene->lightPosition - hitPosition[lane]);
+                    const auto halfway = glm::normalize(toLight + eye);
+
+                    auto direct = instance.ambientProduct;
+                    if (shadowPacket.instanceIndex[lane] < 0) {
+                        const auto kd = std::max(glm::dot(toLight, normal), 0.f);
+                        const auto ks = kd > 0.f ? std::pow(std::max(glm::dot(normal, halfway), 0.f), instance.shininess) : 0.f;
+                        direct += (scene->lightIntensity / 100.f) * (kd * instance.diffuseProduct + ks * instance.specularProduct);
+                    }
+                    radiance[lane] += throughput[lane] * direct;
+
+                    throughput[lane] *= instance.albedo;
+                    if (bounce >= 2) {
+                        const auto survival = std::max({throughput[lane].r, throughput[lane].g, throughput[lane].b});
+                        if (RandomFloat(randomState[lane]) >= survival) {
+                            packet.activeMask &= ~(1 << lane);
+                            continue;
+                        }
+                        throughput[lane] /= survival;
+                    }
+
+                    const auto origin = hitPosition[lane] + normal * rayEpsilon;
+                    packet.originX[lane] = origin.x;
+                    packet.originY[lane] = origin.y;
+                    packet.originZ[lane] = origin.z;
+                    SetRayDirection(packet, lane, SampleCosineHemisphere(normal, randomState[lane]));
+                }
+            }
+
+            for (int lane = 0; lane < rayPacketSize; ++lane) {
+                const auto x = quadX + (lane & 1);
+                const auto y = quadY + (lane >> 1);
+                if (x < tile.x + tile.width && y < tile.y + tile.height) {
+                    accumulation[static_cast<std::size_t>(y) * width + x] += radiance[lane];
+                }
+            }
+        }
+    }
+
+    raysTraced += numRays;
+}
+
+void PathTracer::ResolveTile(const Tile& tile) {
+    const auto inverseSamples = 1.f / static_cast<float>(tile.samples.load());
+
+    std::lock_guard<std::mutex> lock(displayMutex);
+    for (int y = tile.y; y < tile.y + tile.height; ++y) {
+        for (int x = tile.x; x < tile.x + tile.width; ++x) {
+            const auto pixel = static_cast<std::size_t>(y) * width + x;
+            displayPixels[pixel] = PackColor(accumulation[pixel] * inverseSamples);
+        }
+    }
+    displayChanged = true;
+}
+
+void PathTracer::SetRayDirection(RayPacket& packet, int lane, const glm::vec3& direction) {
+    packet.directionX[lane] = direction.x;
+    packet.directionY[lane] = direction.y;
+    packet.directionZ[lane] = direction.z;
+    packet.inverseDirectionX[lane] = 1.f / direction.x;
+    packet.inverseDirectionY[lane] = 1.f / direction.y;
+    packet.inverseDirectionZ[lane] = 1.f / direction.z;
+}
+
+int PathTracer::IntersectBounds(const glm::vec3& min, const glm::vec3& max, const RayPacket& packet, int mask) {
+#if defined(__SSE__)
+    const auto originX = _mm_load_ps(packet.originX);
+    const auto originY = _mm_load_ps(packet.originY);
+    const auto originZ = _mm_load_ps(packet.originZ);
+    const auto inverseDirectionX = _mm_load_ps(packet.inverseDirectionX);
+    const auto inverseDirectionY = _mm_load_ps(packet.inverseDirectionY);
+    const auto inverseDirectionZ = _mm_load_ps(packet.inverseDirectionZ);
+
+    const auto t1X = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(min.x), originX), inverseDirectionX);
+    const auto t2X = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(max.x), originX), inverseDirectionX);
+    const auto t1Y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(min.y), originY), inverseDirectionY);
+    const auto t2Y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(max.y), originY), inverseDirectionY);
+    const auto t1Z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(min.z), originZ), inverseDirectionZ);
+    const auto t2Z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(max.z), originZ), inverseDirectionZ);
+
+    auto tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(t1X, t2X), _mm_min_ps(t1Y, t2Y)), _mm_min_ps(t1Z, t2Z));
+    auto tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(t1X, t2X), _mm_max_ps(t1Y, t2Y)), _mm_max_ps(t1Z, t2Z));
+    tNear = _mm_max_ps(tNear, _mm_setzero_ps());
+    tFar = _mm_min_ps(tFar, _mm_load_ps(packet.distance));
+
+    return _mm_movemask_ps(_mm_cmple_ps(tNear, tFar)) & mask;
+#else
+    auto hitMask = 0;
+    for (int lane = 0; lane < rayPacketSize; ++lane) {
+        if (!(mask & (1 << lane))) {
+            continue;
+        }
+
+        const auto t1X = (min.x - packet.originX[lane]) * packet.inverseDirectionX[lane];
+        const auto t2X = (max.x - packet.originX[lane]) * packet.inverseDirectionX[lane];
+        const auto t1Y = (min.y - packet.originY[lane]) * packet.inverseDirectionY[lane];
+        const auto t2Y = (max.y - packet.originY[lane]) * packet.inverseDirectionY[lane];
+        const auto t1Z = (min.z - packet.originZ[lane]) * packet.inverseDirectionZ[lane];
+        const auto t2Z = (max.z - packet.originZ[lane]) * packet.inverseDirectionZ[lane];
+
+        const auto tNear = std::max({std::min(t1X, t2X), std::min(t1Y, t2Y), std::min(t1Z, t2Z), 0.f});
+        const auto tFar = std::min({std::max(t1X, t2X), std::max(t1Y, t2Y), std::max(t1Z, t2Z), packet.distance[lane]});
+        if (tNear <= tFar) {
+            hitMask |= 1 << lane;
+        }
+    }
+    return hitMask;
+#endif
+}
+
+void PathTracer::IntersectTriangle(const Triangle& triangle, int triangleIndex, int instanceIndex,
+                                   RayPacket& packet, int mask) {
+    alignas(16) float distance[rayPacketSize];
+    alignas(16) float u[rayPacketSize];
+    alignas(16) float v[rayPacketSize];
+    auto hitMask = 0;
+
+#if defined(__SSE__)
+    const auto edge1X = _mm_set1_ps(triangle.edge1.x);
+    const auto edge1Y = _mm_set1_ps(triangle.edge1.y);
+    const auto edge1Z = _mm_set1_ps(triangle.edge1.z);
+    const auto edge2X = _mm_set1_ps(triangle.edge2.x);
+    const auto edge2Y = _mm_set1_ps(triangle.edge2.y);
+    const auto edge2Z = _mm_set1_ps(triangle.edge2.z);
+    const auto directionX = _mm_load_ps(packet.directionX);
+    const auto directionY = _mm_load_ps(packet.directionY);
+    const auto directionZ = _mm_load_ps(packet.directionZ);
+
+    const auto hX = _mm_sub_ps(_mm_mul_ps(directionY, edge2Z), _mm_mul_ps(directionZ, edge2Y));
+    const auto hY = _mm_sub_ps(_mm_mul_ps(directionZ, edge2X), _mm_mul_ps(directionX, edge2Z));
+    const auto hZ = _mm_sub_ps(_mm_mul_ps(directionX, edge2Y), _mm_mul_ps(directionY, edge2X));
+    const auto a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, hX), _mm_mul_ps(edge1Y, hY)), _mm_mul_ps(edge1Z, hZ));
+    const auto f = _mm_div_ps(_mm_set1_ps(1.f), a);
+
+    const auto sX = _mm_sub_ps(_mm_load_ps(packet.originX), _mm_set1_ps(triangle.vertex0.x));
+    const auto sY = _mm_sub_ps(_mm_load_ps(packet.originY), _mm_set1_ps(triangle.vertex0.y));
+    const auto sZ = _mm_sub_ps(_mm_load_ps(packet.originZ), _mm_set1_ps(triangle.vertex0.z));
+    const auto uLanes = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sX, hX), _mm_mul_ps(sY, hY)), _mm_mul_ps(sZ, hZ)));
+
+    const auto qX = _mm_sub_ps(_mm_mul_ps(sY, edge1Z), _mm_mul_ps(sZ, edge1Y));
+    const auto qY = _mm_sub_ps(_mm_mul_ps(sZ, edge1X), _mm_mul_ps(sX, edge1Z));
+    const auto qZ = _mm_sub_ps(_mm_mul_ps(sX, edge1Y), _mm_mul_ps(sY, edge1X));
+    const auto vLanes = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, qX), _mm_mul_ps(directionY, qY)),
+                                                 _mm_mul_ps(directionZ, qZ)));
+    const auto tLanes = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qX), _mm_mul_ps(edge2Y, qY)),
+                                                 _mm_mul_ps(edge2Z, qZ)));
+
+    const auto zero = _mm_setzero_ps();
+    const auto absoluteA = _mm_max_ps(a, _mm_sub_ps(zero, a));
+    auto valid = _mm_cmpgt_ps(absoluteA, _mm_set1_ps(1e-12f));
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(uLanes, zero));
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(vLanes, zero));
+    valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(uLanes, vLanes), _mm_set1_ps(1.f)));
+    valid = _mm_and_ps(valid, _mm_cmpgt_ps(tLanes, _mm_set1_ps(rayEpsilon)));
+    valid = _mm_and_ps(valid, _mm_cmplt_ps(tLanes, _mm_load_ps(packet.distance)));
+
+    hitMask = _mm_movemask_ps(valid) & mask;
+    if (!hitMask) {
+        return;
+    }
+
+    _mm_store_ps(distance, tLanes);
+    _mm_store_ps(u, uLanes);
+    _mm_store_ps(v, vLanes);
+#else
+    for (int lane = 0; lane < rayPacketSize; ++lane) {
+        if (!(mask & (1 << lane))) {
+            continue;
+        }
+
+        const auto direction = LANE_DIRECTION(packet, lane);
+        const auto h = glm::cross(direction, triangle.edge2);
+        const auto a = glm::dot(triangle.edge1, h);
+        if (std::abs(a) <= 1e-12f) {
+            continue;
+        }
+
+        const auto f = 1.f / a;
+        const auto s = LANE_ORIGIN(packet, lane) - triangle.vertex0;
+        u[lane] = f * glm::dot(s, h);
+        if (u[lane] < 0.f || u[lane] > 1.f) {
+            continue;
+        }
+
+        const auto q = glm::cross(s, triangle.edge1);
+        v[lane] = f * glm::dot(direction, q);
+        if (v[lane] < 0.f || u[lane] + v[lane] > 1.f) {
+            continue;
+        }
+
+        distance[lane] = f * glm::dot(triangle.edge2, q);
+        if (distance[lane] > rayEpsilon && distance[lane] < packet.distance[lane]) {
+            hitMask |= 1 << lane;
+        }
+    }
+#endif
+
+    for (int lane = 0; lane < rayPacketSize; ++lane) {
+        if (hitMask & (1 << lane)) {
+            packet.distance[lane] = distance[lane];
+            packet.u[lane] = u[lane];
+            packet.v[lane] = v[lane];
+            packet.triangleIndex[lane] = triangleIndex;
+            packet.instanceIndex[lane] = instanceIndex;
+        }
+    }
+}
+
+void PathTracer::IntersectMesh(const MeshBVH& bvh, int instanceIndex, RayPacket& packet, int mask) {
+    std::uint32_t stack[bvhStackSize];
+    auto stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize) {
+        const auto& node = bvh.nodes[stack[--stackSize]];
+        const auto nodeMask = IntersectBounds(node.min, node.max, packet, mask);
+        if (!nodeMask) {
+            continue;
+        }
+
+        if (node.count) {
+            for (auto i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i) {
+                IntersectTriangle(bvh.triangles[i], static_cast<int>(i), instanceIndex, packet, nodeMask);
+            }
+        } else {
+            stack[stackSize++] = node.leftOrFirst + 1;
+            stack[stackSize++] = node.leftOrFirst;
+        }
+    }
+}
+
+void PathTracer::IntersectScene(RayPacket& packet) {
+    if (scene->nodes.empty()) {
+        return;
+    }
+
+    std::uint32_t stack[bvhStackSize];
+    auto stackSize = 0;
+    stack[stackSize++] = 0;
+
+    auto localPacket = RayPacket();
+    while (stackSize) {
+        const auto& node = scene->nodes[stack[--stackSize]];
+        const auto nodeMask = IntersectBounds(node.min, node.max, packet, packet.activeMask);
+        if (!nodeMask) {
+            continue;
+        }
+
+        if (!node.count) {
+            stack[stackSize++] = node.leftOrFirst + 1;
+            stack[stackSize++] = node.leftOrFirst;
+            continue;
+        }
+
+        for (auto i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i) {
+            const auto& instance = scene->instances[i];
+            const auto instanceMask = IntersectBounds(instance.min, instance.max, packet, nodeMask);
+            if (!instanceMask) {
+                continue;
+            }
+
+            for (int lane = 0; lane < rayPacketSize; ++lane) {
+                if (!(instanceMask & (1 << lane))) {
+                    continue;
+                }
+
+                const auto origin = (instance.worldToObject * glm::vec4(LANE_ORIGIN(packet, lane), 1.f)).xyz();
+                const auto direction = (instance.worldToObject * glm::vec4(LANE_DIRECTION(packet, lane), 0.f)).xyz();
+                localPacket.originX[lane] = origin.x;
+                localPacket.originY[lane] = origin.y;
+                localPacket.originZ[lane] = origin.z;
+                SetRayDirection(localPacket, lane, direction);
+                localPacket.distance[lane] = packet.distance[lane];
+                localPacket.instanceIndex[lane] = packet.instanceIndex[lane];
+            }
+
+            IntersectMesh(*instance.bvh, static_cast<int>(i), localPacket, instanceMask);
+
+            for (int lane = 0; lane < rayPacketSize; ++lane) {
+                if ((instanceMask & (1 << lane)) && localPacket.instanceIndex[lane] == static_cast<int>(i)) {
+                    packet.distance[lane] = localPacket.distance[lane];
+                    packet.u[lane] = localPacket.u[lane];
+                    packet.v[lane] = localPacket.v[lane];
+                    packet.triangleIndex[lane] = localPacket.triangleIndex[lane];
+                    packet.instanceIndex[lane] = localPacket.instanceIndex[lane];
+                }
+            }
+        }
+    }
+}
+
+} // namespace model_viewer_3d
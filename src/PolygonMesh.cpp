@@ -2,47 +2,95 @@
 // Copyright (c) 2017 Vangelis Tsiatsianas
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <cstddef>
 
 #include "Common.h"
-#include "PolygonMesh.h>"
+#include "Environment.h"
+#include "PolygonMesh.h"
+#include "GLState.h"
+#include "GPUProfiler.h"
+#include "GeometryPool.h"
+#include "InputRecorder.h"
+#include "ProgramCache.h"
+#include "RenderQueue.h"
+#include "StaticBatch.h"
 #include "Utilities.h"
 
 #include <glGA/glGAHelper.h>
 
-#define ARRAY_SIZE(x) (sizeof(mesh.x[0]) * mesh.x.size())
-
-#define SETUP_VBO(type, name)                                           \
-    const auto sizeOf##name = ARRAY_SIZE(name);                         \
-    glBindBuffer(type, vbo[vboCount++]);                                \
-    glBufferData(type, sizeOf##name, mesh.name.data(), GL_STATIC_DRAW);
-
-#define GET_AND_ENABLE_ATTRIBUTE(x)                                         \
-    const auto x = static_cast<GLuint>(glGetAttribLocation(program, #x));   \
-    glEnableVertexAttribArray(x);
-
-#define RESET_VBO_COUNT() (vboCount = 0)
-
 #define SETUP_UNIFORM_ARRAY(array, index, x)                                    \
     ((array)[index] = static_cast<GLuint>(glGetUniformLocation(program, x)))
 
-#define UPLOAD_MESH_UNIFORM_MATRIX_4FV(x)                                       \
-    glUniformMatrix4fv(x##Uniform, 1, GL_FALSE, glm::value_ptr(polygonMesh.x));
+namespace model_viewer_3d {
 
-#define UPLOAD_UNIFORM_MATRIX_4FV(x)                                \
-    glUniformMatrix4fv(x##Uniform, 1, GL_FALSE, glm::value_ptr(x));
+const std::string shadersDirectory = std::string(rootDirectory) + "shaders/";
 
-#define UPLOAD_UNIFORM_BONE_TRANSFORM(x)                                                                                    \
-    glUniformMatrix4fv(boneUniforms[x], 1, GL_TRUE, reinterpret_cast<const GLfloat*>(glm::value_ptr(boneTransforms[x])))
+static std::atomic<unsigned> nextTextureSet(1);
+
+// Interleaves the attributes of a mesh in the layout of its vertex format and hands them to the pool, which is where the
+// vertex array objects for every format live.
+template <typename BoneFunction>
+static int AllocateGeometry(VertexFormat format, const std::vector<glm::vec3>& positions,
+                            const std::vector<glm::vec3>& normals, const std::vector<glm::vec2>& texCoords,
+                            const std::vector<unsigned int>& indices, const std::vector<PolygonMesh::Submesh>& submeshes,
+                            BoneFunction getBones) {
+    std::vector<GeometryPool::Submesh> relativeSubmeshes;
+    for (const auto& submesh : submeshes) {
+        relativeSubmeshes.push_back({submesh.numIndices, submesh.baseIndex, static_cast<GLint>(submesh.baseVertex)});
+    }
 
-namespace 3d_model_viewer {
+    const auto numVertices = positions.size();
+    const auto normal = [&normals](std::size_t i) { return i < normals.size() ? normals[i] : glm::vec3(0.f); };
+    const auto texCoord = [&texCoords](std::size_t i) { return i < texCoords.size() ? texCoords[i] : glm::vec2(0.f); };
 
-const std::string shadersDirectory = std::string(rootDirectory) + "shaders/";
-unsigned vboCount = 0;
+    switch (format) {
+        case VertexFormat::PositionNormalTexCoord: {
+            std::vector<PositionNormalTexCoordVertex> vertices(numVertices);
+            for (std::size_t i = 0; i < numVertices; ++i) {
+                vertices[i] = {positions[i], normal(i), texCoord(i)};
+            }
+            return GeometryPool::Allocate(format, vertices.data(), numVertices, indices, relativeSubmeshes);
+        }
+        case VertexFormat::Skinned: {
+            std::vector<SkinnedVertex> vertices(numVertices);
+            for (std::size_t i = 0; i < numVertices; ++i) {
+                vertices[i].position = positions[i];
+                vertices[i].normal = normal(i);
+                vertices[i].texCoord = texCoord(i);
+                getBones(i, vertices[i].boneIDs, vertices[i].weights);
+            }
+            return GeometryPool::Allocate(format, vertices.data(), numVertices, indices, relativeSubmeshes);
+        }
+        default: {
+            std::vector<PositionNormalVertex> vertices(numVertices);
+            for (std::size_t i = 0; i < numVertices; ++i) {
+                vertices[i] = {positions[i], normal(i)};
+            }
+            return GeometryPool::Allocate(VertexFormat::PositionNormal, vertices.data(), numVertices, indices,
+                                          relativeSubmeshes);
+        }
+    }
+}
+
+static VertexFormat GetVertexFormat(bool hasTextures, bool isAnimated) {
+    if (isAnimated) {
+        return VertexFormat::Skinned;
+    }
+    return hasTextures ? VertexFormat::PositionNormalTexCoord : VertexFormat::PositionNormal;
+}
 
 PolygonMesh::PolygonMesh(const std::string& path, unsigned long id) : Object(Utilities::GetFilenameFromPath(path), id),
                                                                       path(path),
-                                                                      animationStartTime(Utilities::GetCurrentTime()) {
+                                                                      animationStartTime(InputRecorder::GetFrameTime()) {
+    ValidatePath(path);
+}
+
+PolygonMesh::PolygonMesh(std::shared_ptr<const SyntheticMesh> syntheticMesh, const std::string& name, unsigned long id)
+    : Object(name, id), syntheticMesh(std::move(syntheticMesh)), animationStartTime(InputRecorder::GetFrameTime()) {}
+
+void PolygonMesh::ValidatePath(const std::string& path) {
     auto extension = Utilities::GetExtensionFromPath(path);
     std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
     if (extension != ".fbx" && extension != ".dae" && extension != ".obj" && extension != ".3ds" &&
@@ -58,98 +106,162 @@ PolygonMesh::PolygonMesh(const std::string& path, unsigned long id) : Object(Uti
 }
 
 void PolygonMesh::Initialize() {
-    mesh.loadRigMesh(path);
-
-    hasTextures = mesh.m_Textures.empty() ? 0 : 1;
-    isAnimated = !mesh.m_BoneInfo.empty() && mesh.m_pScene->HasAnimations();
-    vAnimationEnabled = animationEnabled ? 1 : 0;
+    PROFILE_SCOPE("PolygonMesh::Initialize");
 
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-
-    const auto vertexShader = shadersDirectory + "Object.vert";
-    const auto fragmentShader = shadersDirectory + "Object.frag";
-    program = LoadShaders(vertexShader.c_str(), fragmentShader.c_str());
-
-    glUseProgram(program);
-    glGenBuffers(sizeof(vbo) / sizeof(GLuint), vbo);
+    if (syntheticMesh) {
+        InitializeSynthetic();
+        return;
+    }
 
-    SETUP_VBO(GL_ARRAY_BUFFER, Positions);
-    GET_AND_ENABLE_ATTRIBUTE(vPosition);
-    glVertexAttribPointer(vPosition, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+    if (!importedMesh) {
+        importedMesh = ModelImporter::Import(path);
+    }
+    const auto& mesh = *importedMesh;
+
+    hasTextures = mesh.images.empty() ? 0 : 1;
+    textureSet = hasTextures ? nextTextureSet++ : 0;
+    isAnimated = static_cast<bool>(mesh.animation);
+
+    // The decoded images are only needed until they are uploaded.
+    textures.resize(mesh.images.size());
+    glGenTextures(static_cast<GLsizei>(textures.size()), textures.data());
+    for (std::size_t i = 0; i < textures.size(); ++i) {
+        const auto& image = mesh.images[i];
+        GLState::BindTexture(0, GL_TEXTURE_2D, textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     image.pixels.data());
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    }
+    importedMesh->images.clear();
+    importedMesh->images.shrink_to_fit();
 
-    SETUP_VBO(GL_ELEMENT_ARRAY_BUFFER, Indices);
+    program = ProgramCache::Acquire(shadersDirectory + "Object.vert", shadersDirectory + "Object.frag");
+    programIndex = ProgramCache::GetIndex(program);
 
-    SETUP_VBO(GL_ARRAY_BUFFER, Normals);
-    GET_AND_ENABLE_ATTRIBUTE(vNormal);
-    glVertexAttribPointer(vNormal, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+    vertexFormat = GetVertexFormat(hasTextures, isAnimated);
+    vao = GeometryPool::GetVertexArray(vertexFormat);
+    const auto& boneWeights = mesh.boneWeights;
+    geometry = AllocateGeometry(vertexFormat, mesh.positions, mesh.normals, mesh.texCoords, mesh.indices, GetSubmeshes(),
+                                [&boneWeights](std::size_t i, std::int32_t* boneIDs, float* weights) {
+                                    std::copy_n(boneWeights[i].ids, bonesPerVertex, boneIDs);
+                                    std::copy_n(boneWeights[i].weights, bonesPerVertex, weights);
+                                });
 
-    if (hasTextures) {
-        SETUP_VBO(GL_ARRAY_BUFFER, TexCoords);
-        GET_AND_ENABLE_ATTRIBUTE(vTexCoord);
-        glVertexAttribPointer(vTexCoord, 2, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
-    }
+    SetupUniforms();
 
-    if (isAnimated) {
-        const auto sizeOfVertexBoneData = sizeof(mesh.Bones[0]);
-        SETUP_VBO(GL_ARRAY_BUFFER, Bones);
+    GLState::Enable(GL_DEPTH_TEST);
 
-        GET_AND_ENABLE_ATTRIBUTE(boneIDs);
-        glVertexAttribIPointer(boneIDs, 4, GL_UNSIGNED_BYTE, sizeOfVertexBoneData, BUFFER_OFFSET(0));
+    boundingBox.Initialize(*this);
+}
 
-        GET_AND_ENABLE_ATTRIBUTE(weights);
-        glVertexAttribPointer(weights, 4, GL_FLOAT, GL_FALSE, sizeOfVertexBoneData, BUFFER_OFFSET(16));
+void PolygonMesh::InitializeSynthetic() {
+    hasTextures = 0;
+    isAnimated = static_cast<bool>(syntheticMesh->skeleton);
+
+    program = ProgramCache::Acquire(shadersDirectory + "Object.vert", shadersDirectory + "Object.frag");
+    programIndex = ProgramCache::GetIndex(program);
+
+    vertexFormat = GetVertexFormat(false, isAnimated);
+    vao = GeometryPool::GetVertexArray(vertexFormat);
+    if (!syntheticMesh->numUsers++) {
+        const auto& boneWeights = syntheticMesh->boneWeights;
+        syntheticMesh->geometry = AllocateGeometry(vertexFormat, syntheticMesh->positions, syntheticMesh->normals, {},
+                                                   syntheticMesh->indices, GetSubmeshes(),
+                                                   [&boneWeights](std::size_t i, std::int32_t* boneIDs, float* weights) {
+                                                       std::copy_n(boneWeights[i].ids, bonesPerVertex, boneIDs);
+                                                       std::copy_n(boneWeights[i].weights, bonesPerVertex, weights);
+                                                   });
     }
-
-    RESET_VBO_COUNT();
+    geometry = syntheticMesh->geometry;
 
     SetupUniforms();
 
-    glEnable(GL_DEPTH_TEST);
-    glBindVertexArray(0);
+    GLState::Enable(GL_DEPTH_TEST);
 
-    boundingBox.Initialize();
+    boundingBox.Initialize(*this);
 }
 
-void PolygonMesh::Render() {
-    if (isAnimated) {
-        vAnimationEnabled = animationEnabled ? 1 : 0;
+void PolygonMesh::PrepareRender(RenderPacket& packet, RenderPacket::Item& item) {
+    item.geometry = geometry;
+    item.boundsTransform = boundingBox.boundingBoxTransform;
+    item.batched = vertexFormat == VertexFormat::PositionNormal && StaticBatch::supported && StaticBatch::enabled;
 
-        if (animationEnabled) {
-            std::vector<glm::mat4> boneTransforms;
-            const auto runningTime = GetRunningTime();
+    const auto center = packet.viewMatrix * modelMatrix * glm::vec4(boundingBox.center, 1.f);
+    item.sortKey = RenderQueue::MakeKey(item.batched, programIndex, vertexFormat, wireframe, textureSet,
+                                        -center.z / Environment::camera.farClippingPlane);
+
+    if (showBoundingBox) {
+        const auto& color = boundingBoxColor;
+        packet.boundingBoxes.push_back({modelMatrix * boundingBox.boundingBoxTransform,
+                                        glm::vec4(color.x, color.y, color.z, color.w)});
+    }
 
-            mesh.boneTransform(runningTime, boneTransforms);
-            assert(boneTransforms.size() <= maxBones);
+    item.animationEnabled = isAnimated && animationEnabled;
+    if (!item.animationEnabled) {
+        return;
+    }
 
-            for (unsigned i = 0; i < boneTransforms.size(); ++i) {
-                UPLOAD_UNIFORM_BONE_TRANSFORM(i);
-            }
-        }
+    if (syntheticMesh) {
+        PROFILE_SCOPE("Skeleton::Evaluate");
+        syntheticMesh->skeleton->Evaluate(GetRunningTime(), globalTransforms, bonePalette);
     } else {
-        vAnimationEnabled = 0;
+        PROFILE_SCOPE("ImportedMesh::Animation::Evaluate");
+        importedMesh->animation->Evaluate(GetRunningTime(), globalTransforms, bonePalette);
+    }
+    assert(bonePalette.size() < maxBones);
+
+    item.firstBone = static_cast<unsigned>(packet.bonePalettes.size());
+    item.numBones = static_cast<unsigned>(bonePalette.size());
+    packet.bonePalettes.insert(packet.bonePalettes.end(), bonePalette.begin(), bonePalette.end());
+}
+
+// Imported and synthetic palettes alike are column-major, so they are uploaded in one call.
+void PolygonMesh::Render(const RenderPacket& packet, const RenderPacket::Item& item) const {
+    if (item.animationEnabled) {
+        glUniformMatrix4fv(boneUniforms[0], static_cast<GLsizei>(item.numBones), GL_FALSE,
+                           glm::value_ptr(packet.bonePalettes[item.firstBone]));
     }
 
     glUniform1ui(hasTexturesUniform, hasTextures);
-    glUniform1ui(vAnimationEnabledUniform, vAnimationEnabled);
+    glUniform1ui(vAnimationEnabledUniform, item.animationEnabled ? 1 : 0);
 
-    mesh.render();
+    DrawSubmeshes();
+}
 
-    if (showBoundingBox) {
-        if (boundingBoxColorChanged) {
-            glUseProgram(boundingBox.program);
-            glUniform4fv(boundingBox.boundingBoxColorUniform, 1, IMVEC4_POINTER(boundingBoxColor));
-            boundingBoxColorChanged = false;
+// Draws the submeshes from the arenas of the pool, binding the texture of the material of each one.
+void PolygonMesh::DrawSubmeshes() const {
+    const auto& submeshes = GeometryPool::GetGeometry(geometry).submeshes;
+    for (std::size_t i = 0; i < submeshes.size(); ++i) {
+        if (hasTextures) {
+            const auto materialIndex = importedMesh->entries[i].materialIndex;
+            if (materialIndex < textures.size()) {
+                GLState::BindTexture(0, GL_TEXTURE_2D, textures[materialIndex]);
+            }
         }
 
-        boundingBox.Render(*this);
+        const auto& submesh = submeshes[i];
+        glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(submesh.numIndices), GL_UNSIGNED_INT,
+                                 BUFFER_OFFSET(submesh.firstIndex * sizeof(GLuint)), submesh.baseVertex);
     }
 }
 
 void PolygonMesh::CleanUp() {
-    glDeleteBuffers(sizeof(vbo) / sizeof(GLuint), vbo);
-    glDeleteVertexArrays(1, &vao);
-    glDeleteProgram(program);
+    if (!syntheticMesh) {
+        GeometryPool::Free(geometry);
+    } else if (!--syntheticMesh->numUsers) {
+        GeometryPool::Free(syntheticMesh->geometry);
+        syntheticMesh->geometry = -1;
+    }
+    geometry = -1;
+
+    GLState::DeleteTextures(static_cast<GLsizei>(textures.size()), textures.data());
+    textures.clear();
+
+    ProgramCache::Release(program);
 }
 
 void PolygonMesh::SetupUniforms() {
@@ -165,89 +277,46 @@ void PolygonMesh::SetupUniforms() {
     }
 }
 
-float PolygonMesh::GetRunningTime() {
-    return Utilities::DurationToFloat(Utilities::GetCurrentTime() - animationStartTime);
+const std::vector<glm::vec3>& PolygonMesh::GetPositions() const {
+    return syntheticMesh ? syntheticMesh->positions : importedMesh->positions;
 }
 
-void PolygonMesh::BoundingBox::Initialize() {
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-
-    const std::string vertexShader = shadersDirectory + "BoundingBox.vert";
-    const std::string fragmentShader = shadersDirectory + "BoundingBox.frag";
-    program = LoadShaders(vertexShader.c_str(), fragmentShader.c_str());
-
-    glUseProgram(program);
-    glGenBuffers(2, vbo);
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+const std::vector<glm::vec3>& PolygonMesh::GetNormals() const {
+    return syntheticMesh ? syntheticMesh->normals : importedMesh->normals;
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+const std::vector<unsigned int>& PolygonMesh::GetIndices() const {
+    return syntheticMesh ? syntheticMesh->indices : importedMesh->indices;
+}
 
-    SetupUniforms();
+std::vector<PolygonMesh::Submesh> PolygonMesh::GetSubmeshes() const {
+    if (syntheticMesh) {
+        return {{static_cast<unsigned>(syntheticMesh->indices.size()), 0, 0}};
+    }
 
-    glEnable(GL_DEPTH_TEST);
-    glBindVertexArray(0);
+    std::vector<Submesh> submeshes;
+    for (const auto& entry : importedMesh->entries) {
+        submeshes.push_back({entry.numIndices, entry.baseIndex, entry.baseVertex});
+    }
+    return submeshes;
 }
 
-void PolygonMesh::BoundingBox::Render(PolygonMesh& polygonMesh) {
-    const auto& meshVertices = polygonMesh.mesh.Positions;
-    min = meshVertices[0];
-    max = meshVertices[0];
-
-    const auto sizeOfMeshVertices = meshVertices.size();
-    for (unsigned int i = 1; i < sizeOfMeshVertices; ++i) {
-        const auto meshVertex = meshVertices[i];
+float PolygonMesh::GetRunningTime() {
+    return Utilities::DurationToFloat(InputRecorder::GetFrameTime() - animationStartTime);
+}
 
-        min.x = std::min(meshVertex.x, min.x);
-        max.x = std::max(meshVertex.x, max.x);
-        min.y = std::min(meshVertex.y, min.y);
-        max.y = std::max(meshVertex.y, max.y);
-        min.z = std::min(meshVertex.z, min.z);
-        max.z = std::max(meshVertex.z, max.z);
+// The bounds are computed once, since the vertex positions never change after loading; skinning happens on the GPU.
+void PolygonMesh::BoundingBox::Initialize(const PolygonMesh& polygonMesh) {
+    if (polygonMesh.syntheticMesh) {
+        min = polygonMesh.syntheticMesh->min;
+        max = polygonMesh.syntheticMesh->max;
+    } else {
+        Utilities::ComputeBounds(polygonMesh.importedMesh->positions, min, max);
     }
 
     size = glm::vec3(max.x - min.x, max.y - min.y, max.z - min.z);
     center = glm::vec3((min.x + max.x) / 2, (min.y + max.y) / 2, (min.z + max.z) / 2);
     boundingBoxTransform = glm::translate(glm::mat4(1.0), center) * glm::scale(glm::mat4(1.0), size);
-
-    glUseProgram(program);
-    glBindVertexArray(vao);
-
-    glDisable(GL_CULL_FACE);
-    glPushAttrib(GL_ALL_ATTRIB_BITS);
-
-    UPLOAD_MESH_UNIFORM_MATRIX_4FV(modelMatrix);
-    UPLOAD_MESH_UNIFORM_MATRIX_4FV(viewMatrix);
-    UPLOAD_MESH_UNIFORM_MATRIX_4FV(projectionMatrix);
-    UPLOAD_UNIFORM_MATRIX_4FV(boundingBoxTransform);
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo[0]);
-    GET_AND_ENABLE_ATTRIBUTE(vPosition);
-    glVertexAttribPointer(vPosition, 4, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[1]);
-    glDrawElements(GL_LINE_LOOP, 4, GL_UNSIGNED_SHORT, nullptr);
-    glDrawElements(GL_LINE_LOOP, 4, GL_UNSIGNED_SHORT, reinterpret_cast<GLvoid*>(4 * sizeof(GLushort)));
-    glDrawElements(GL_LINES, 8, GL_UNSIGNED_SHORT, reinterpret_cast<GLvoid*>(8 * sizeof(GLushort)));
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-    glPopAttrib();
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-}
-
-void PolygonMesh::BoundingBox::SetupUniforms() {
-    SETUP_UNIFORM(modelMatrix);
-    SETUP_UNIFORM(viewMatrix);
-    SETUP_UNIFORM(projectionMatrix);
-    SETUP_UNIFORM(boundingBoxTransform);
-    SETUP_UNIFORM(boundingBoxColor);
-    SETUP_UNIFORM(vAnimationEnabled);
 }
 
-} // namespace 3d_model_viewer
+} // namespace model_viewer_3d
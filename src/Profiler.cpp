@@ -0,0 +1,437 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+
+#include "Common.h"
+#include "Profiler.h"
+
+namespace model_viewer_3d {
+
+constexpr auto profilerRowHeight = 18.f;
+constexpr auto profilerThreadSpacing = 6.f;
+
+std::atomic<bool> Profiler::enabled(false);
+bool Profiler::showWindow = false;
+
+unsigned Profiler::numConsumers = 0;
+std::array<Profiler::Counter, profilerMaxCounters> Profiler::counters;
+unsigned Profiler::numCounters = 0;
+std::vector<Profiler::ScopeTotal> Profiler::latestTotals;
+
+std::array<std::atomic<Profiler::ThreadBuffer*>, profilerMaxThreads> Profiler::threadBuffers;
+std::atomic<unsigned> Profiler::numThreadBuffers(0);
+thread_local Profiler::ThreadBuffer* Profiler::threadBuffer = nullptr;
+thread_local Profiler::ThreadBufferReleaser Profiler::threadBufferReleaser;
+
+std::array<Profiler::Frame, profilerHistoryFrames> Profiler::frames;
+Profiler::Frame Profiler::discardedFrame;
+unsigned Profiler::latestFrame = 0;
+unsigned long Profiler::frameSequence = 0;
+int Profiler::selectedFrameOffset = 0;
+bool Profiler::paused = false;
+std::uint64_t Profiler::frameBegin = 0;
+
+std::mutex Profiler::internMutex;
+std::unordered_set<std::string> Profiler::internedNames;
+
+Profiler::Scope::Scope(const char* name)
+    : name(name), parentAllocationScope(AllocationTracker::EnterScope(name)), begin(0), allocationsBegin(), active(enabled) {
+    if (active) {
+        auto* buffer = GetThreadBuffer();
+        if (buffer) {
+            ++buffer->depth;
+            allocationsBegin = AllocationTracker::GetThreadCounts();
+            begin = Now();
+        } else {
+            active = false;
+        }
+    }
+}
+
+Profiler::Scope::~Scope() {
+    AllocationTracker::LeaveScope(parentAllocationScope);
+
+    if (active) {
+        const auto end = Now();
+        const auto allocationsEnd = AllocationTracker::GetThreadCounts();
+        auto* buffer = threadBuffer;
+        --buffer->depth;
+        Record(buffer, {name, begin, end, buffer->depth, buffer->threadIndex,
+                        static_cast<std::uint32_t>(allocationsEnd.allocations - allocationsBegin.allocations),
+                        allocationsEnd.bytes - allocationsBegin.bytes});
+    }
+}
+
+void Profiler::BeginFrame() {
+    if (enabled) {
+        frameBegin = Now();
+    }
+}
+
+void Profiler::EndFrame() {
+    if (!enabled) {
+        return;
+    }
+
+    if (paused) {
+        Collect(discardedFrame);
+        return;
+    }
+
+    latestFrame = (latestFrame + 1) % profilerHistoryFrames;
+    ++frameSequence;
+    auto& frame = frames[latestFrame];
+    frame.begin = frameBegin;
+    frame.end = Now();
+    Collect(frame);
+
+    latestTotals.clear();
+    for (const auto& event : frame.events) {
+        latestTotals.push_back({event.name, (event.end - event.begin) / 1e6f, 1});
+    }
+    MergeScopeTotals(latestTotals);
+}
+
+void Profiler::Display() {
+    if (!showWindow) {
+        return;
+    }
+
+    ImGui::SetNextWindowSize(ImVec2(720, 420), ImGuiSetCond_FirstUseEver);
+    ImGui::SetNextWindowPos(ImVec2(windowWidth - 1140, windowHeight - 430), ImGuiSetCond_FirstUseEver);
+
+    ImGui::Begin("Profiler", &showWindow);
+    if (!showWindow) {
+        RemoveConsumer();
+    }
+
+    ImGui::Checkbox("Pause" "##Profiler", &paused);
+    DisplayTimeline();
+
+    const auto selectedFrame = (latestFrame + profilerHistoryFrames - selectedFrameOffset) % profilerHistoryFrames;
+    const auto& frame = frames[selectedFrame];
+
+    DisplayFlameGraph(frame);
+    if (ImGui::CollapsingHeader("Scopes" "##Profiler")) {
+        DisplayScopeTotals(frame);
+    }
+
+    ImGui::End();
+}
+
+void Profiler::Toggle() {
+    showWindow = !showWindow;
+    showWindow ? AddConsumer() : RemoveConsumer();
+}
+
+void Profiler::AddConsumer() {
+    ++numConsumers;
+    enabled = true;
+}
+
+void Profiler::RemoveConsumer() {
+    if (numConsumers) {
+        --numConsumers;
+    }
+    enabled = numConsumers > 0;
+}
+
+float Profiler::GetScopeTime(const char* name) {
+    const auto* total = FindScopeTotal(latestTotals, name);
+    return total ? total->milliseconds : 0.f;
+}
+
+void Profiler::MergeScopeTotals(std::vector<ScopeTotal>& totals) {
+    std::sort(totals.begin(), totals.end(), [](const ScopeTotal& lhs, const ScopeTotal& rhs) {
+        return std::strcmp(lhs.name, rhs.name) < 0;
+    });
+
+    std::size_t merged = 0;
+    for (std::size_t i = 0; i < totals.size(); ++i) {
+        if (merged && !std::strcmp(totals[merged - 1].name, totals[i].name)) {
+            totals[merged - 1].milliseconds += totals[i].milliseconds;
+            totals[merged - 1].calls += totals[i].calls;
+        } else {
+            totals[merged++] = totals[i];
+        }
+    }
+    totals.resize(merged);
+}
+
+const Profiler::ScopeTotal* Profiler::FindScopeTotal(const std::vector<ScopeTotal>& totals, const char* name) {
+    const auto total = std::lower_bound(totals.begin(), totals.end(), name, [](const ScopeTotal& lhs, const char* rhs) {
+        return std::strcmp(lhs.name, rhs) < 0;
+    });
+    return total != totals.end() && !std::strcmp(total->name, name) ? &*total : nullptr;
+}
+
+const std::vector<Profiler::Event>& Profiler::GetLatestFrameEvents() {
+    return frames[latestFrame].events;
+}
+
+unsigned long Profiler::GetFrameSequence() {
+    return frameSequence;
+}
+
+const char* Profiler::GetThreadName(unsigned threadIndex) {
+    const auto* buffer = threadIndex < profilerMaxThreads ? threadBuffers[threadIndex].load() : nullptr;
+    return buffer ? buffer->threadName : "Unnamed Thread";
+}
+
+unsigned Profiler::GetNumThreads() {
+    return std::min(numThreadBuffers.load(), profilerMaxThreads);
+}
+
+void Profiler::SetCounter(const char* name, double value) {
+    for (unsigned i = 0; i < numCounters; ++i) {
+        if (!std::strcmp(counters[i].name, name)) {
+            counters[i].value = value;
+            return;
+        }
+    }
+
+    if (numCounters < profilerMaxCounters) {
+        counters[numCounters++] = {name, value};
+    }
+}
+
+const Profiler::Counter* Profiler::GetCounters(unsigned& numCounters) {
+    numCounters = Profiler::numCounters;
+    return counters.data();
+}
+
+void Profiler::SetThreadName(const char* threadName) {
+    auto* buffer = GetThreadBuffer();
+    if (buffer) {
+        buffer->threadName = threadName;
+    }
+}
+
+const char* Profiler::Intern(const std::string& name) {
+    std::lock_guard<std::mutex> lock(internMutex);
+    return internedNames.insert(name).first->c_str();
+}
+
+std::uint64_t Profiler::Now() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::high_resolution_clock::now().time_since_epoch()).count());
+}
+
+Profiler::ThreadBuffer* Profiler::GetThreadBuffer() {
+    if (threadBuffer) {
+        return threadBuffer;
+    }
+
+    // The buffers of threads that exited are reused first, so that short-lived threads do not use up the slots.
+    const auto numBuffers = std::min(numThreadBuffers.load(), profilerMaxThreads);
+    for (unsigned i = 0; i < numBuffers && !threadBuffer; ++i) {
+        auto* buffer = threadBuffers[i].load(std::memory_order_acquire);
+        auto inUse = false;
+        if (buffer && buffer->inUse.compare_exchange_strong(inUse, true, std::memory_order_acquire)) {
+            buffer->depth = 0;
+            buffer->threadName = "Unnamed Thread";
+            threadBuffer = buffer;
+        }
+    }
+
+    if (!threadBuffer) {
+        auto threadIndex = numThreadBuffers.load();
+        while (threadIndex < profilerMaxThreads && !numThreadBuffers.compare_exchange_weak(threadIndex, threadIndex + 1)) {}
+        if (threadIndex >= profilerMaxThreads) {
+            return nullptr;
+        }
+
+        threadBuffer = new ThreadBuffer();
+        threadBuffer->threadIndex = static_cast<std::uint16_t>(threadIndex);
+        threadBuffer->threadName = "Unnamed Thread";
+        threadBuffer->inUse.store(true, std::memory_order_relaxed);
+        threadBuffers[threadIndex].store(threadBuffer, std::memory_order_release);
+    }
+
+    threadBufferReleaser.buffer = threadBuffer;
+    return threadBuffer;
+}
+
+// The events the thread recorded stay in the ring until the next frame collects them.
+Profiler::ThreadBufferReleaser::~ThreadBufferReleaser() {
+    if (buffer) {
+        threadBuffer = nullptr;
+        buffer->inUse.store(false, std::memory_order_release);
+    }
+}
+
+void Profiler::Record(ThreadBuffer* buffer, const Event& event) {
+    const auto head = buffer->head.load(std::memory_order_relaxed);
+    if (head - buffer->tail.load(std::memory_order_acquire) >= profilerRingCapacity) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    buffer->events[head % profilerRingCapacity] = event;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::Collect(Frame& frame) {
+    frame.events.clear();
+
+    const auto numBuffers = std::min(numThreadBuffers.load(), profilerMaxThreads);
+    for (unsigned i = 0; i < numBuffers; ++i) {
+        auto* buffer = threadBuffers[i].load(std::memory_order_acquire);
+        if (!buffer) {
+            continue;
+        }
+
+        const auto head = buffer->head.load(std::memory_order_acquire);
+        for (auto tail = buffer->tail.load(std::memory_order_relaxed); tail < head; ++tail) {
+            frame.events.push_back(buffer->events[tail % profilerRingCapacity]);
+        }
+        buffer->tail.store(head, std::memory_order_release);
+    }
+}
+
+void Profiler::DisplayTimeline() {
+    static float frameTimes[profilerHistoryFrames];
+
+    auto maxFrameTime = 0.f;
+    for (unsigned i = 0; i < profilerHistoryFrames; ++i) {
+        const auto& frame = frames[(latestFrame + 1 + i) % profilerHistoryFrames];
+        frameTimes[i] = frame.end > frame.begin ? (frame.end - frame.begin) / 1e6f : 0.f;
+        maxFrameTime = std::max(maxFrameTime, frameTimes[i]);
+    }
+
+    ImGui::PlotHistogram("##Profiler Timeline", frameTimes, profilerHistoryFrames, 0, "Frame Time (ms)",
+                         0.f, std::max(maxFrameTime, 16.6f), ImVec2(ImGui::GetContentRegionAvailWidth(), 60));
+    ImGui::SliderInt("Frames Ago" "##Profiler", &selectedFrameOffset, 0, profilerHistoryFrames - 1);
+
+    const auto& frame = frames[(latestFrame + profilerHistoryFrames - selectedFrameOffset) % profilerHistoryFrames];
+    ImGui::Text("Frame Time: %.3f ms (%u scopes)", frame.end > frame.begin ? (frame.end - frame.begin) / 1e6f : 0.f,
+                static_cast<unsigned>(frame.events.size()));
+}
+
+void Profiler::DisplayFlameGraph(const Frame& frame) {
+    if (frame.end <= frame.begin) {
+        return;
+    }
+
+    auto* drawList = ImGui::GetWindowDrawList();
+    const auto origin = ImGui::GetCursorScreenPos();
+    const auto width = std::max(ImGui::GetContentRegionAvailWidth(), 1.f);
+    const auto duration = static_cast<double>(frame.end - frame.begin);
+    const auto textColor = ImColor(255, 255, 255);
+    auto y = origin.y;
+
+    const auto numBuffers = std::min(numThreadBuffers.load(), profilerMaxThreads);
+    for (unsigned thread = 0; thread < numBuffers; ++thread) {
+        auto maxDepth = -1;
+        for (const auto& event : frame.events) {
+            if (event.threadIndex == thread) {
+                maxDepth = std::max(maxDepth, static_cast<int>(event.depth));
+            }
+        }
+        const auto* buffer = threadBuffers[thread].load();
+        if (maxDepth < 0 || !buffer) {
+            continue;
+        }
+
+        drawList->AddText(ImVec2(origin.x, y), textColor, buffer->threadName);
+        y += profilerRowHeight;
+
+        for (const auto& event : frame.events) {
+            if (event.threadIndex != thread) {
+                continue;
+            }
+
+            const auto begin = std::max(event.begin, frame.begin);
+            const auto end = std::min(std::max(event.end, begin), frame.end);
+            const auto x0 = origin.x + static_cast<float>((begin - frame.begin) / duration) * width;
+            const auto x1 = std::max(origin.x + static_cast<float>((end - frame.begin) / duration) * width, x0 + 1.f);
+            const auto y0 = y + event.depth * profilerRowHeight;
+            const auto y1 = y0 + profilerRowHeight - 1.f;
+
+            const auto hue = static_cast<float>(std::hash<const void*>()(event.name) % 360) / 360.f;
+            drawList->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y1), ImColor::HSV(hue, .55f, .65f));
+
+            const auto textSize = ImGui::CalcTextSize(event.name);
+            if (textSize.x + 4.f < x1 - x0) {
+                drawList->AddText(ImVec2(x0 + 2.f, y0 + 1.f), textColor, event.name);
+            }
+
+            if (ImGui::IsMouseHoveringRect(ImVec2(x0, y0), ImVec2(x1, y1))) {
+                if (AllocationTracker::IsAvailable()) {
+                    ImGui::SetTooltip("%s\n%.3f ms\n%u allocations (%.2f KiB)", event.name, (event.end - event.begin) / 1e6f,
+                                      event.allocations, event.allocatedBytes / 1024.f);
+                } else {
+                    ImGui::SetTooltip("%s\n%.3f ms", event.name, (event.end - event.begin) / 1e6f);
+                }
+            }
+        }
+
+        y += (maxDepth + 1) * profilerRowHeight + profilerThreadSpacing;
+    }
+
+    ImGui::Dummy(ImVec2(width, y - origin.y));
+}
+
+void Profiler::DisplayScopeTotals(const Frame& frame) {
+    static const char* names[profilerMaxScopeTotals];
+    static std::uint64_t totals[profilerMaxScopeTotals];
+    static unsigned calls[profilerMaxScopeTotals];
+    static std::uint64_t allocations[profilerMaxScopeTotals];
+
+    unsigned numScopes = 0;
+    for (const auto& event : frame.events) {
+        unsigned scope = 0;
+        while (scope < numScopes && names[scope] != event.name) {
+            ++scope;
+        }
+
+        if (scope == numScopes) {
+            if (numScopes == profilerMaxScopeTotals) {
+                continue;
+            }
+            names[scope] = event.name;
+            totals[scope] = 0;
+            calls[scope] = 0;
+            allocations[scope] = 0;
+            ++numScopes;
+        }
+
+        totals[scope] += event.end - event.begin;
+        ++calls[scope];
+        allocations[scope] += event.allocations;
+    }
+
+    ImGui::Columns(4, "##Profiler Scopes");
+    ImGui::Text("Scope");
+    ImGui::NextColumn();
+    ImGui::Text("Total (ms)");
+    ImGui::NextColumn();
+    ImGui::Text("Calls");
+    ImGui::NextColumn();
+    ImGui::Text("Allocations");
+    ImGui::NextColumn();
+    ImGui::Separator();
+
+    for (unsigned scope = 0; scope < numScopes; ++scope) {
+        ImGui::Text("%s", names[scope]);
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", totals[scope] / 1e6f);
+        ImGui::NextColumn();
+        ImGui::Text("%u", calls[scope]);
+        ImGui::NextColumn();
+        if (AllocationTracker::IsAvailable()) {
+            ImGui::Text("%llu", static_cast<unsigned long long>(allocations[scope]));
+        } else {
+            ImGui::Text("-");
+        }
+        ImGui::NextColumn();
+    }
+
+    ImGui::Columns(1);
+}
+
+} // namespace model_viewer_3d
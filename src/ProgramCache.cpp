@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <algorithm>
+
+#include "ProgramCache.h"
+
+#include <glGA/glGAHelper.h>
+
+namespace model_viewer_3d {
+
+std::vector<ProgramCache::Entry> ProgramCache::entries;
+
+GLuint ProgramCache::Acquire(const std::string& vertexShader, const std::string& fragmentShader) {
+    auto entry = std::find_if(entries.begin(), entries.end(), [&](const Entry& entry) {
+        return entry.numUsers && entry.vertexShader == vertexShader && entry.fragmentShader == fragmentShader;
+    });
+    if (entry == entries.end()) {
+        entry = std::find_if(entries.begin(), entries.end(), [](const Entry& entry) { return !entry.numUsers; });
+        if (entry == entries.end()) {
+            entry = entries.insert(entries.end(), Entry());
+        }
+        *entry = {vertexShader, fragmentShader, LoadShaders(vertexShader.c_str(), fragmentShader.c_str()), 0};
+    }
+
+    ++entry->numUsers;
+    return entry->program;
+}
+
+void ProgramCache::Release(GLuint program) {
+    const auto entry = std::find_if(entries.begin(), entries.end(), [program](const Entry& entry) {
+        return entry.numUsers && entry.program == program;
+    });
+    if (entry != entries.end() && !--entry->numUsers) {
+        glDeleteProgram(entry->program);
+        entry->program = 0;
+    }
+}
+
+unsigned ProgramCache::GetIndex(GLuint program) {
+    const auto entry = std::find_if(entries.begin(), entries.end(), [program](const Entry& entry) {
+        return entry.numUsers && entry.program == program;
+    });
+    return static_cast<unsigned>(entry - entries.begin());
+}
+
+} // namespace model_viewer_3d
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <algorithm>
+#include <array>
+
+#include "Profiler.h"
+#include "RenderQueue.h"
+
+namespace model_viewer_3d {
+
+bool RenderQueue::enabled = true;
+
+std::vector<RenderQueue::Entry> RenderQueue::entries;
+std::vector<RenderQueue::Entry> RenderQueue::scratch;
+
+// Batched items come first, since StaticBatch has already drawn them and they only need to be told so.
+std::uint64_t RenderQueue::MakeKey(bool batched, unsigned program, VertexFormat format, bool wireframe, unsigned textureSet,
+                                   float depth) {
+    constexpr auto maxDepth = (1u << renderQueueDepthBits) - 1;
+    constexpr auto maxProgram = (1u << renderQueueProgramBits) - 1;
+    constexpr auto maxTextureSet = (1u << renderQueueTextureSetBits) - 1;
+
+    const auto quantizedDepth = static_cast<std::uint64_t>(std::min(std::max(depth, 0.f), 1.f) * maxDepth);
+
+    auto key = static_cast<std::uint64_t>(batched ? 0 : 1);
+    key = (key << renderQueueProgramBits) | (program & maxProgram);
+    key = (key << renderQueueFormatBits) | static_cast<std::uint64_t>(format);
+    key = (key << 1) | static_cast<std::uint64_t>(wireframe ? 1 : 0);
+    key = (key << renderQueueTextureSetBits) | (textureSet & maxTextureSet);
+    key = (key << renderQueueDepthBits) | quantizedDepth;
+    return key << (64 - 1 - renderQueueProgramBits - renderQueueFormatBits - 1 - renderQueueTextureSetBits -
+                   renderQueueDepthBits);
+}
+
+void RenderQueue::Sort(RenderPacket& packet) {
+    PROFILE_SCOPE("RenderQueue::Sort");
+
+    const auto numItems = static_cast<std::uint32_t>(packet.items.size());
+    entries.resize(numItems);
+    for (std::uint32_t i = 0; i < numItems; ++i) {
+        entries[i] = {enabled ? packet.items[i].sortKey : 0, i};
+    }
+
+    if (enabled) {
+        RadixSort();
+    }
+
+    packet.drawOrder.resize(numItems);
+    for (std::uint32_t i = 0; i < numItems; ++i) {
+        packet.drawOrder[i] = entries[i].item;
+    }
+}
+
+// Least significant byte first, which keeps items with equal keys in the order they were prepared. The histograms of
+// all eight bytes are built in one pass, and bytes that are the same in every key are skipped altogether.
+void RenderQueue::RadixSort() {
+    const auto numEntries = entries.size();
+    if (numEntries < 2) {
+        return;
+    }
+
+    std::array<std::array<std::uint32_t, 256>, 8> histograms{};
+    for (const auto& entry : entries) {
+        for (unsigned byte = 0; byte < 8; ++byte) {
+            ++histograms[byte][(entry.key >> (byte * 8)) & 0xFF];
+        }
+    }
+
+    scratch.resize(numEntries);
+    for (unsigned byte = 0; byte < 8; ++byte) {
+        auto& histogram = histograms[byte];
+        if (histogram[(entries.front().key >> (byte * 8)) & 0xFF] == numEntries) {
+            continue;
+        }
+
+        std::uint32_t offset = 0;
+        for (auto& count : histogram) {
+            const auto bucketSize = count;
+            count = offset;
+            offset += bucketSize;
+        }
+
+        for (const auto& entry : entries) {
+            scratch[histogram[(entry.key >> (byte * 8)) & 0xFF]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+}
+
+} // namespace model_viewer_3d
@@ -0,0 +1,324 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <cstring>
+#include <utility>
+
+#include "Environment.h"
+#include "BoundingBoxOverlay.h"
+#include "DepthPrepass.h"
+#include "DynamicResolution.h"
+#include "GLState.h"
+#include "GPUProfiler.h"
+#include "GeometryPool.h"
+#include "LightClusters.h"
+#include "Object.h"
+#include "PathTracer.h"
+#include "Profiler.h"
+#include "RenderQueue.h"
+#include "RenderThread.h"
+#include "ShadowMap.h"
+#include "StaticBatch.h"
+
+#include <GL/glew.h>
+
+#define GLM_SWIZZLE
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace model_viewer_3d {
+
+// Cocoa only lets the main thread present a window, and the context cannot move between threads every frame, so on macOS
+// packets are always drawn inline.
+#ifdef __APPLE__
+bool RenderThread::enabled = false;
+#else
+bool RenderThread::enabled = true;
+#endif
+
+SDL_Window* RenderThread::window = nullptr;
+SDL_GLContext RenderThread::glContext = nullptr;
+RenderDrawListsFunction RenderThread::renderDrawLists = nullptr;
+
+std::array<RenderPacket, 2> RenderThread::packets;
+unsigned RenderThread::buildIndex = 0;
+
+std::thread RenderThread::thread;
+std::mutex RenderThread::mutex;
+std::condition_variable RenderThread::workAvailable;
+std::condition_variable RenderThread::workFinished;
+RenderPacket* RenderThread::submittedPacket = nullptr;
+const std::function<void()>* RenderThread::task = nullptr;
+std::exception_ptr RenderThread::taskException;
+bool RenderThread::stopping = false;
+
+template <typename T>
+static void CopyImVector(const ImVector<T>& source, ImVector<T>& destination) {
+    destination.resize(source.Size);
+    if (source.Size) {
+        std::memcpy(destination.Data, source.Data, source.Size * sizeof(T));
+    }
+}
+
+void RenderThread::Initialize(SDL_Window* window, SDL_GLContext glContext) {
+    RenderThread::window = window;
+    RenderThread::glContext = glContext;
+
+    // ImGui::Render() only copies the draw lists into the packet being built; they are replayed when it is drawn.
+    auto& io = ImGui::GetIO();
+    renderDrawLists = io.RenderDrawListsFn;
+    io.RenderDrawListsFn = CaptureDrawLists;
+
+    if (enabled) {
+        stopping = false;
+        SDL_GL_MakeCurrent(window, nullptr);
+        thread = std::thread(Run);
+    }
+}
+
+void RenderThread::CleanUp() {
+    if (thread.joinable()) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            WaitUntilIdle(lock);
+            stopping = true;
+        }
+        workAvailable.notify_one();
+        thread.join();
+        SDL_GL_MakeCurrent(window, glContext);
+    }
+
+    if (renderDrawLists) {
+        ImGui::GetIO().RenderDrawListsFn = renderDrawLists;
+        renderDrawLists = nullptr;
+    }
+
+    for (auto& packet : packets) {
+        packet.drawLists.clear();
+        packet.drawListPointers.clear();
+        packet.drawData = ImDrawData();
+    }
+}
+
+RenderPacket& RenderThread::BeginPacket() {
+    const auto& camera = Environment::camera;
+    const auto& light = Environment::light;
+
+    auto& packet = packets[buildIndex];
+    packet.viewMatrix = glm::lookAt(camera.position, camera.center, camera.up);
+    packet.projectionMatrix = glm::perspective(camera.fieldOfView, camera.aspectRatio, camera.nearClippingPlane, camera.farClippingPlane);
+    packet.lightPosition = light.position;
+    packet.lightIntensity = light.intensity;
+
+    packet.backgroundColor = ImVec4(0.f, 0.f, 0.f, 1.f);
+    packet.pathTracing = false;
+    packet.depthPrepass = DepthPrepass::enabled;
+    DynamicResolution::Prepare(packet);
+
+    packet.items.clear();
+    packet.drawOrder.clear();
+    packet.bonePalettes.clear();
+    packet.boundingBoxes.clear();
+    packet.localLights.clear();
+    packet.lightClusters.clear();
+    packet.lightIndices.clear();
+    packet.shadow.enabled = false;
+    packet.shadow.drawStatic = false;
+    packet.shadow.drawDynamic = false;
+    packet.shadow.staticCasters.clear();
+    packet.shadow.dynamicCasters.clear();
+    packet.drawData = ImDrawData();
+
+    return packet;
+}
+
+void RenderThread::Submit() {
+    auto& packet = packets[buildIndex];
+    RenderQueue::Sort(packet);
+    LightClusters::Assign(packet);
+    ShadowMap::Prepare(packet);
+
+    if (!thread.joinable()) {
+        Present(packet);
+        GPUProfiler::Publish();
+        return;
+    }
+
+    {
+        PROFILE_SCOPE("RenderThread::Wait");
+        std::unique_lock<std::mutex> lock(mutex);
+        WaitUntilIdle(lock);
+
+        // The render thread is idle, so the GPU timings it read back can be handed over to this thread.
+        GPUProfiler::Publish();
+        submittedPacket = &packet;
+    }
+    workAvailable.notify_one();
+
+    buildIndex = (buildIndex + 1) % packets.size();
+}
+
+void RenderThread::Draw(RenderPacket& packet) {
+    PROFILE_SCOPE("RenderThread::Draw");
+
+    GLState::BeginFrame();
+    GPUProfiler::BeginFrame();
+    GeometryPool::Update();
+    LightClusters::Upload(packet);
+    // The static casters of the shadow map are drawn with the commands of the batch.
+    StaticBatch::Update(packet);
+    ShadowMap::Draw(packet);
+    DynamicResolution::Begin(packet);
+
+    glClearColor(packet.backgroundColor.x, packet.backgroundColor.y, packet.backgroundColor.z, packet.backgroundColor.w);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    if (!packet.items.empty()) {
+        PROFILE_GPU_SCOPE("Scene");
+
+        DepthPrepass::Draw(packet);
+        StaticBatch::Draw(packet);
+        for (const auto index : packet.drawOrder) {
+            const auto& item = packet.items[index];
+            item.object->Draw(packet, item);
+        }
+
+        // Clearing and the overlay expect the default depth state.
+        GLState::DepthFunc(GL_LESS);
+        GLState::DepthMask(GL_TRUE);
+    }
+
+    BoundingBoxOverlay::Draw(packet);
+
+    GLState::PolygonMode(GL_FILL);
+
+    // Everything after the scene is drawn at the window size.
+    DynamicResolution::Resolve(packet);
+
+    if (packet.pathTracing) {
+        PathTracer::Display();
+    }
+
+    // ImGui restores whatever it finds bound, so nothing drawn by it or by glGA between frames can reach the scene's
+    // vertex arrays, and everything it changes is forgotten.
+    GLState::BindVertexArray(0);
+
+    if (renderDrawLists && packet.drawData.Valid) {
+        PROFILE_GPU_SCOPE("ImGui::Render");
+        renderDrawLists(&packet.drawData);
+        GLState::Invalidate();
+    }
+
+    GPUProfiler::EndFrame();
+}
+
+// Runs the task on the thread that owns the context and waits for it, rethrowing anything it throws. Used for the
+// OpenGL resource creation and destruction that happens outside of drawing, such as loading and unloading models.
+void RenderThread::Execute(const std::function<void()>& function) {
+    if (!thread.joinable()) {
+        function();
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    WaitUntilIdle(lock);
+
+    task = &function;
+    workAvailable.notify_one();
+    workFinished.wait(lock, [] { return !task; });
+
+    if (taskException) {
+        std::rethrow_exception(std::exchange(taskException, nullptr));
+    }
+}
+
+void RenderThread::WaitForIdle() {
+    if (!thread.joinable()) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    WaitUntilIdle(lock);
+}
+
+bool RenderThread::IsRunning() {
+    return thread.joinable();
+}
+
+void RenderThread::Run() {
+    Profiler::SetThreadName("Render Thread");
+    SDL_GL_MakeCurrent(window, glContext);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        workAvailable.wait(lock, [] { return submittedPacket || task || stopping; });
+
+        if (task) {
+            const auto* currentTask = task;
+            auto exception = std::exception_ptr();
+
+            lock.unlock();
+            try {
+                (*currentTask)();
+            } catch (...) {
+                exception = std::current_exception();
+            }
+            lock.lock();
+
+            taskException = exception;
+            task = nullptr;
+        } else if (submittedPacket) {
+            auto* packet = submittedPacket;
+
+            lock.unlock();
+            Present(*packet);
+            lock.lock();
+
+            submittedPacket = nullptr;
+        } else {
+            break;
+        }
+
+        workFinished.notify_all();
+    }
+    lock.unlock();
+
+    SDL_GL_MakeCurrent(window, nullptr);
+}
+
+void RenderThread::WaitUntilIdle(std::unique_lock<std::mutex>& lock) {
+    workFinished.wait(lock, [] { return !submittedPacket && !task; });
+}
+
+void RenderThread::Present(RenderPacket& packet) {
+    Draw(packet);
+
+    {
+        PROFILE_SCOPE("SDL_GL_SwapWindow");
+        SDL_GL_SwapWindow(window);
+    }
+}
+
+void RenderThread::CaptureDrawLists(ImDrawData* drawData) {
+    auto& packet = packets[buildIndex];
+
+    const auto numDrawLists = static_cast<std::size_t>(drawData->CmdListsCount);
+    while (packet.drawLists.size() < numDrawLists) {
+        packet.drawLists.push_back(std::make_unique<ImDrawList>());
+    }
+    packet.drawListPointers.resize(numDrawLists);
+
+    for (std::size_t i = 0; i < numDrawLists; ++i) {
+        const auto* source = drawData->CmdLists[i];
+        auto* destination = packet.drawLists[i].get();
+
+        CopyImVector(source->CmdBuffer, destination->CmdBuffer);
+        CopyImVector(source->IdxBuffer, destination->IdxBuffer);
+        CopyImVector(source->VtxBuffer, destination->VtxBuffer);
+        packet.drawListPointers[i] = destination;
+    }
+
+    packet.drawData = *drawData;
+    packet.drawData.CmdLists = packet.drawListPointers.data();
+}
+
+} // namespace model_viewer_3d
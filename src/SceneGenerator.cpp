@@ -0,0 +1,392 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#include "Environment.h"
+#include "Profiler.h"
+#include "SceneGenerator.h"
+#include "Utilities.h"
+
+#include <ImGUI/imgui.h>
+
+namespace model_viewer_3d {
+
+constexpr float syntheticSpacing = 3.f;
+constexpr float torusMajorRadius = 1.f;
+constexpr float torusMinorRadius = 0.35f;
+constexpr float terrainSize = 2.f;
+constexpr float terrainHeight = 0.3f;
+constexpr unsigned terrainOctaves = 4;
+constexpr unsigned maxSphereSubdivisions = 10;
+
+SceneGenerator::Settings SceneGenerator::settings;
+
+unsigned long SceneGenerator::lastUniqueTriangles = 0;
+unsigned long SceneGenerator::lastDrawnTriangles = 0;
+
+std::shared_ptr<SyntheticMesh> SceneGenerator::GenerateSphere(unsigned numTriangles) {
+    auto mesh = std::make_shared<SyntheticMesh>();
+
+    // Icosahedron subdivision quadruples the triangle count per level, so pick the level closest to the request.
+    const auto level = static_cast<unsigned>(std::min<double>(
+        maxSphereSubdivisions, std::max(0.0, std::round(std::log(std::max(numTriangles, 20u) / 20.0) / std::log(4.0)))));
+
+    const auto t = (1.f + std::sqrt(5.f)) / 2.f;
+    mesh->positions = {
+        {-1.f, t, 0.f}, {1.f, t, 0.f}, {-1.f, -t, 0.f}, {1.f, -t, 0.f},
+        {0.f, -1.f, t}, {0.f, 1.f, t}, {0.f, -1.f, -t}, {0.f, 1.f, -t},
+        {t, 0.f, -1.f}, {t, 0.f, 1.f}, {-t, 0.f, -1.f}, {-t, 0.f, 1.f}
+    };
+    mesh->indices = {
+        0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+        1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+        3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+        4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1
+    };
+    for (auto& position : mesh->positions) {
+        position = glm::normalize(position);
+    }
+
+    std::unordered_map<std::uint64_t, unsigned> midpoints;
+    const auto midpoint = [&mesh, &midpoints](unsigned index0, unsigned index1) {
+        const auto key = (static_cast<std::uint64_t>(std::min(index0, index1)) << 32) | std::max(index0, index1);
+        const auto found = midpoints.find(key);
+        if (found != midpoints.end()) {
+            return found->second;
+        }
+
+        const auto index = static_cast<unsigned>(mesh->positions.size());
+        mesh->positions.push_back(glm::normalize(mesh->positions[index0] + mesh->positions[index1]));
+        midpoints.emplace(key, index);
+        return index;
+    };
+
+    for (unsigned subdivision = 0; subdivision < level; ++subdivision) {
+        std::vector<unsigned int> subdividedIndices;
+        subdividedIndices.reserve(mesh->indices.size() * 4);
+        midpoints.clear();
+
+        for (std::size_t i = 0; i < mesh->indices.size(); i += 3) {
+            const auto index0 = mesh->indices[i];
+            const auto index1 = mesh->indices[i + 1];
+            const auto index2 = mesh->indices[i + 2];
+            const auto index01 = midpoint(index0, index1);
+            const auto index12 = midpoint(index1, index2);
+            const auto index20 = midpoint(index2, index0);
+
+            subdividedIndices.insert(subdividedIndices.end(), { index0, index01, index20, index1, index12, index01,
+                                                                index2, index20, index12, index01, index12, index20 });
+        }
+        mesh->indices = std::move(subdividedIndices);
+    }
+
+    mesh->normals = mesh->positions;
+    Finalize(*mesh);
+    return mesh;
+}
+
+std::shared_ptr<SyntheticMesh> SceneGenerator::GenerateTorus(unsigned numTriangles) {
+    auto mesh = std::make_shared<SyntheticMesh>();
+
+    // Two triangles per quad, with twice as many segments around the ring as around the tube.
+    const auto minorSegments = std::max(3u, static_cast<unsigned>(std::round(std::sqrt(numTriangles / 4.0))));
+    const auto majorSegments = 2 * minorSegments;
+
+    mesh->positions.reserve(majorSegments * minorSegments);
+    mesh->normals.reserve(majorSegments * minorSegments);
+    for (unsigned major = 0; major < majorSegments; ++major) {
+        const auto u = 2.f * glm::pi<float>() * major / majorSegments;
+        const auto ringCenter = glm::vec3(std::cos(u), 0.f, std::sin(u)) * torusMajorRadius;
+
+        for (unsigned minor = 0; minor < minorSegments; ++minor) {
+            const auto v = 2.f * glm::pi<float>() * minor / minorSegments;
+            const auto normal = glm::vec3(std::cos(u) * std::cos(v), std::sin(v), std::sin(u) * std::cos(v));
+            mesh->positions.push_back(ringCenter + normal * torusMinorRadius);
+            mesh->normals.push_back(normal);
+        }
+    }
+
+    mesh->indices.reserve(6 * majorSegments * minorSegments);
+    for (unsigned major = 0; major < majorSegments; ++major) {
+        const auto nextMajor = (major + 1) % majorSegments;
+        for (unsigned minor = 0; minor < minorSegments; ++minor) {
+            const auto nextMinor = (minor + 1) % minorSegments;
+            const auto index00 = major * minorSegments + minor;
+            const auto index01 = major * minorSegments + nextMinor;
+            const auto index10 = nextMajor * minorSegments + minor;
+            const auto index11 = nextMajor * minorSegments + nextMinor;
+            mesh->indices.insert(mesh->indices.end(), { index00, index01, index10, index10, index01, index11 });
+        }
+    }
+
+    Finalize(*mesh);
+    return mesh;
+}
+
+std::shared_ptr<SyntheticMesh> SceneGenerator::GenerateTerrain(unsigned numTriangles, unsigned seed) {
+    auto mesh = std::make_shared<SyntheticMesh>();
+
+    const auto quadsPerSide = std::max(1u, static_cast<unsigned>(std::round(std::sqrt(numTriangles / 2.0))));
+    const auto verticesPerSide = quadsPerSide + 1;
+    const auto step = terrainSize / quadsPerSide;
+
+    mesh->positions.reserve(verticesPerSide * verticesPerSide);
+    mesh->normals.reserve(verticesPerSide * verticesPerSide);
+    for (unsigned row = 0; row < verticesPerSide; ++row) {
+        for (unsigned column = 0; column < verticesPerSide; ++column) {
+            const auto x = column * step - terrainSize / 2.f;
+            const auto z = row * step - terrainSize / 2.f;
+            mesh->positions.emplace_back(x, TerrainHeight(x, z, seed), z);
+
+            const auto dx = TerrainHeight(x + step, z, seed) - TerrainHeight(x - step, z, seed);
+            const auto dz = TerrainHeight(x, z + step, seed) - TerrainHeight(x, z - step, seed);
+            mesh->normals.push_back(glm::normalize(glm::vec3(-dx, 2.f * step, -dz)));
+        }
+    }
+
+    mesh->indices.reserve(6 * quadsPerSide * quadsPerSide);
+    for (unsigned row = 0; row < quadsPerSide; ++row) {
+        for (unsigned column = 0; column < quadsPerSide; ++column) {
+            const auto index00 = row * verticesPerSide + column;
+            const auto index01 = index00 + 1;
+            const auto index10 = index00 + verticesPerSide;
+            const auto index11 = index10 + 1;
+            mesh->indices.insert(mesh->indices.end(), { index00, index10, index01, index01, index10, index11 });
+        }
+    }
+
+    Finalize(*mesh);
+    return mesh;
+}
+
+// Builds a chain of bones along the mesh's vertical extent and skins every vertex to its two closest joints.
+void SceneGenerator::AttachSkeleton(SyntheticMesh& mesh, unsigned numBones, unsigned seed) {
+    numBones = std::max(1u, std::min(numBones, maxBones - 1));
+
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> frequency(1.f, 3.f);
+    std::uniform_real_distribution<float> phase(0.f, 2.f * glm::pi<float>());
+
+    const auto height = std::max(mesh.max.y - mesh.min.y, 1e-3f);
+    const auto boneLength = height / numBones;
+
+    auto skeleton = std::make_shared<Skeleton>();
+    for (unsigned bone = 0; bone < numBones; ++bone) {
+        const auto joint = glm::vec3(0.f, mesh.min.y + bone * boneLength, 0.f);
+
+        skeleton->parents.push_back(static_cast<int>(bone) - 1);
+        skeleton->jointOffsets.push_back(bone ? glm::vec3(0.f, boneLength, 0.f) : joint);
+        skeleton->inverseBindTransforms.push_back(glm::translate(glm::mat4(1.f), -joint));
+        skeleton->axes.push_back(bone % 2 ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 0.f, 1.f));
+        skeleton->amplitudes.push_back(1.2f / numBones);
+        skeleton->frequencies.push_back(frequency(generator));
+        skeleton->phases.push_back(phase(generator));
+    }
+
+    mesh.boneWeights.resize(mesh.positions.size());
+    for (std::size_t i = 0; i < mesh.positions.size(); ++i) {
+        const auto position = (mesh.positions[i].y - mesh.min.y) / boneLength - 0.5f;
+        const auto bone0 = static_cast<int>(std::max(0.f, std::min(std::floor(position), static_cast<float>(numBones - 1))));
+        const auto bone1 = std::min(bone0 + 1, static_cast<int>(numBones) - 1);
+        const auto weight1 = bone0 == bone1 ? 0.f : std::max(0.f, std::min(position - bone0, 1.f));
+
+        mesh.boneWeights[i] = {{bone0, bone1, 0, 0}, {1.f - weight1, weight1, 0.f, 0.f}};
+    }
+
+    mesh.skeleton = std::move(skeleton);
+}
+
+SceneGenerator::GeneratedScene SceneGenerator::GenerateMeshes(const Settings& settings) {
+    PROFILE_SCOPE("SceneGenerator::GenerateMeshes");
+
+    const auto numObjects = static_cast<unsigned>(std::max(1, std::min(settings.numObjects, maxSyntheticObjects)));
+    const auto numTriangles = static_cast<unsigned>(std::max(1, std::min(settings.trianglesPerMesh, maxSyntheticTriangles)));
+    const auto instancingRatio = std::max(0.f, std::min(settings.instancingRatio, 1.f));
+    const auto numUniqueMeshes = std::max(1u, static_cast<unsigned>(std::round(numObjects * (1.f - instancingRatio))));
+    const auto numSkinnedMeshes = static_cast<unsigned>(std::round(numUniqueMeshes * std::max(0.f, std::min(settings.skinnedRatio, 1.f))));
+
+    enum class Shape { Sphere, Torus, Terrain };
+    std::vector<Shape> shapes;
+    if (settings.spheres) {
+        shapes.push_back(Shape::Sphere);
+    }
+    if (settings.tori) {
+        shapes.push_back(Shape::Torus);
+    }
+    if (settings.terrains) {
+        shapes.push_back(Shape::Terrain);
+    }
+    if (shapes.empty()) {
+        shapes.push_back(Shape::Sphere);
+    }
+
+    GeneratedScene scene;
+    scene.settings = settings;
+    for (unsigned i = 0; i < numUniqueMeshes; ++i) {
+        const auto seed = static_cast<unsigned>(settings.seed) + i;
+
+        std::shared_ptr<SyntheticMesh> mesh;
+        switch (shapes[i % shapes.size()]) {
+            case Shape::Sphere:
+                mesh = GenerateSphere(numTriangles);
+                scene.names.emplace_back("Synthetic Sphere");
+                break;
+            case Shape::Torus:
+                mesh = GenerateTorus(numTriangles);
+                scene.names.emplace_back("Synthetic Torus");
+                break;
+            case Shape::Terrain:
+                mesh = GenerateTerrain(numTriangles, seed);
+                scene.names.emplace_back("Synthetic Terrain");
+                break;
+        }
+
+        if (i < numSkinnedMeshes) {
+            AttachSkeleton(*mesh, static_cast<unsigned>(std::max(1, settings.bonesPerSkeleton)), seed);
+        }
+
+        scene.uniqueTriangles += mesh->indices.size() / 3;
+        scene.meshes.push_back(std::move(mesh));
+    }
+
+    return scene;
+}
+
+void SceneGenerator::Instantiate(const GeneratedScene& scene, std::vector<PolygonMesh>& models) {
+    PROFILE_SCOPE("SceneGenerator::Instantiate");
+
+    const auto& settings = scene.settings;
+    const auto& uniqueMeshes = scene.meshes;
+    const auto numObjects = static_cast<unsigned>(std::max(1, std::min(settings.numObjects, maxSyntheticObjects)));
+    const auto numUniqueMeshes = static_cast<unsigned>(uniqueMeshes.size());
+
+    // The new scene replaces the previously generated one, while models loaded from files are kept.
+    for (auto& model : models) {
+        if (model.syntheticMesh) {
+            model.CleanUp();
+        }
+    }
+    models.erase(std::remove_if(models.begin(), models.end(), [](const PolygonMesh& model) {
+        return model.syntheticMesh != nullptr;
+    }), models.end());
+
+    std::mt19937 generator(static_cast<unsigned>(settings.seed));
+    std::uniform_real_distribution<float> angle(-180.f, 180.f);
+
+    const auto firstObject = models.size();
+    const auto side = static_cast<unsigned>(std::ceil(std::sqrt(static_cast<float>(numObjects))));
+    Environment::numObjects = firstObject + numObjects;
+    models.reserve(firstObject + numObjects);
+    lastUniqueTriangles = scene.uniqueTriangles;
+    lastDrawnTriangles = 0;
+
+    for (unsigned i = 0; i < numObjects; ++i) {
+        const auto uniqueMesh = i % numUniqueMeshes;
+        models.emplace_back(uniqueMeshes[uniqueMesh], scene.names[uniqueMesh], firstObject + i + 1);
+
+        auto& model = models.back();
+        model.Initialize();
+
+        const auto column = static_cast<float>(i % side) - 0.5f * static_cast<float>(side - 1);
+        const auto row = static_cast<float>(i / side) - 0.5f * static_cast<float>(side - 1);
+        model.SetTranslation(glm::vec3(column * syntheticSpacing, 0.f, row * syntheticSpacing));
+        model.SetRotation(glm::vec3(0.f, angle(generator), 0.f));
+        model.SetBoundingBoxVisible(false);
+        model.SetAnimationEnabled(true);
+        model.UpdateModelMatrix();
+
+        lastDrawnTriangles += uniqueMeshes[uniqueMesh]->indices.size() / 3;
+    }
+
+    auto extent = 0.f;
+    for (auto i = firstObject; i < models.size(); ++i) {
+        const auto center = models[i].modelMatrix * glm::vec4(0.f, 0.f, 0.f, 1.f);
+        extent = std::max(extent, glm::length(glm::vec3(center / center.w)));
+    }
+
+    auto& camera = Environment::camera;
+    camera.focusOnOrigin = true;
+    camera.position = glm::vec3(std::max(2.f * extent, 1.f));
+}
+
+void SceneGenerator::Generate(const Settings& settings, std::vector<PolygonMesh>& models) {
+    Instantiate(GenerateMeshes(settings), models);
+}
+
+bool SceneGenerator::DisplayControls() {
+    auto generate = false;
+
+    ImGui::Begin("Options");
+
+    if (ImGui::CollapsingHeader("Scene Generator")) {
+        ImGui::Indent(15);
+        ImGui::InputInt("Objects" "##Scene Generator", &settings.numObjects, 100, 1000);
+        ImGui::InputInt("Triangles per Mesh" "##Scene Generator", &settings.trianglesPerMesh, 1000, 100000);
+        ImGui::SliderFloat("Instancing Ratio" "##Scene Generator", &settings.instancingRatio, 0.f, 1.f);
+        ImGui::SliderFloat("Skinned Ratio" "##Scene Generator", &settings.skinnedRatio, 0.f, 1.f);
+        ImGui::SliderInt("Bones" "##Scene Generator", &settings.bonesPerSkeleton, 1, static_cast<int>(maxBones) - 1);
+        ImGui::Checkbox("Spheres" "##Scene Generator", &settings.spheres);
+        ImGui::SameLine();
+        ImGui::Checkbox("Tori" "##Scene Generator", &settings.tori);
+        ImGui::SameLine();
+        ImGui::Checkbox("Terrains" "##Scene Generator", &settings.terrains);
+        ImGui::InputInt("Seed" "##Scene Generator", &settings.seed);
+
+        settings.numObjects = std::max(1, std::min(settings.numObjects, maxSyntheticObjects));
+        settings.trianglesPerMesh = std::max(1, std::min(settings.trianglesPerMesh, maxSyntheticTriangles));
+
+        generate = ImGui::Button("Generate" "##Scene Generator");
+        if (lastDrawnTriangles) {
+            ImGui::Text("Last scene: %lu unique / %lu drawn triangles", lastUniqueTriangles, lastDrawnTriangles);
+        }
+        ImGui::Unindent(15);
+        ImGui::Spacing();
+    }
+
+    ImGui::End();
+
+    return generate;
+}
+
+void SceneGenerator::Finalize(SyntheticMesh& mesh) {
+    Utilities::ComputeBounds(mesh.positions, mesh.min, mesh.max);
+}
+
+float SceneGenerator::Noise(float x, float z, unsigned seed) {
+    const auto hash = [seed](int ix, int iz) {
+        auto h = static_cast<std::uint32_t>(ix) * 374761393u + static_cast<std::uint32_t>(iz) * 668265263u + seed * 2246822519u;
+        h = (h ^ (h >> 13)) * 1274126177u;
+        return static_cast<float>((h ^ (h >> 16)) & 0xffffff) / static_cast<float>(0xffffff);
+    };
+
+    const auto cellX = static_cast<int>(std::floor(x));
+    const auto cellZ = static_cast<int>(std::floor(z));
+    const auto fractionX = x - cellX;
+    const auto fractionZ = z - cellZ;
+    const auto smoothX = fractionX * fractionX * (3.f - 2.f * fractionX);
+    const auto smoothZ = fractionZ * fractionZ * (3.f - 2.f * fractionZ);
+
+    const auto top = glm::mix(hash(cellX, cellZ), hash(cellX + 1, cellZ), smoothX);
+    const auto bottom = glm::mix(hash(cellX, cellZ + 1), hash(cellX + 1, cellZ + 1), smoothX);
+    return glm::mix(top, bottom, smoothZ);
+}
+
+float SceneGenerator::TerrainHeight(float x, float z, unsigned seed) {
+    auto height = 0.f;
+    auto amplitude = terrainHeight;
+    auto frequency = 2.f;
+    for (unsigned octave = 0; octave < terrainOctaves; ++octave) {
+        height += amplitude * (Noise(x * frequency, z * frequency, seed + octave) - 0.5f);
+        amplitude *= 0.5f;
+        frequency *= 2.f;
+    }
+    return height;
+}
+
+} // namespace model_viewer_3d
@@ -0,0 +1,437 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "Common.h"
+#include "GLState.h"
+#include "GPUProfiler.h"
+#include "GeometryPool.h"
+#include "Profiler.h"
+#include "ShadowMap.h"
+#include "StaticBatch.h"
+
+#define GLM_SWIZZLE
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glGA/glGAHelper.h>
+
+namespace model_viewer_3d {
+
+const std::string shadowMapShadersDirectory = std::string(rootDirectory) + "shaders/";
+
+// The frustum is fitted with some room to spare, so that objects moving about inside the scene do not refit it.
+constexpr float shadowMapFrustumSlack = 1.25f;
+const float shadowMapMaxFieldOfView = glm::radians(150.f);
+constexpr float shadowMapDepthBias = .0005f;
+constexpr GLfloat shadowMapPolygonOffsetFactor = 2.f;
+constexpr GLfloat shadowMapPolygonOffsetUnits = 4.f;
+
+bool ShadowMap::enabled = true;
+
+unsigned ShadowMap::numStaticUpdates = 0;
+unsigned ShadowMap::numDynamicUpdates = 0;
+float ShadowMap::staticUpdateCoverage = 0.f;
+
+GLuint ShadowMap::texture = 0;
+GLuint ShadowMap::framebuffer = 0;
+GLuint ShadowMap::uniformBuffer = 0;
+GLuint ShadowMap::depthProgram = 0;
+GLuint ShadowMap::skinnedProgram = 0;
+
+GLuint ShadowMap::modelMatrixUniform;
+GLuint ShadowMap::viewMatrixUniform;
+GLuint ShadowMap::projectionMatrixUniform;
+GLuint ShadowMap::skinnedModelMatrixUniform;
+GLuint ShadowMap::skinnedViewMatrixUniform;
+GLuint ShadowMap::skinnedProjectionMatrixUniform;
+GLuint ShadowMap::bonesUniform;
+
+ShadowMap::ShadowBlock ShadowMap::uploadedBlock;
+
+std::unordered_map<const Object*, ShadowMap::Caster> ShadowMap::casters;
+std::vector<std::pair<std::uint32_t, ShadowMap::Caster*>> ShadowMap::frameCasters;
+std::uint64_t ShadowMap::frame = 0;
+bool ShadowMap::valid = false;
+bool ShadowMap::dynamicLayerEmpty = true;
+glm::vec3 ShadowMap::lightPosition;
+glm::vec3 ShadowMap::frustumCenter;
+float ShadowMap::frustumRadius = 0.f;
+glm::mat4 ShadowMap::viewMatrix;
+glm::mat4 ShadowMap::projectionMatrix;
+
+// Regions are empty once clamped to the map if they lie entirely outside of it.
+static bool IsEmpty(const glm::vec4& region) {
+    return region.x >= region.z || region.y >= region.w;
+}
+
+static bool Overlaps(const glm::vec4& a, const glm::vec4& b) {
+    return a.x < b.z && b.x < a.z && a.y < b.w && b.y < a.w;
+}
+
+static void Include(glm::vec4& region, const glm::vec4& other) {
+    if (IsEmpty(other)) {
+        return;
+    }
+
+    region = glm::vec4(std::min(region.x, other.x), std::min(region.y, other.y), std::max(region.z, other.z),
+                       std::max(region.w, other.w));
+}
+
+void ShadowMap::Initialize() {
+    glGenTextures(1, &texture);
+    GLState::BindTexture(shadowMapTextureUnit, GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, shadowMapSize, shadowMapSize, 2, 0, GL_DEPTH_COMPONENT,
+                 GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    glGenFramebuffers(1, &framebuffer);
+    GLState::BindFramebuffer(framebuffer);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    GLState::DepthMask(GL_TRUE);
+    for (GLint layer = 0; layer < 2; ++layer) {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            GLState::BindFramebuffer(0);
+            throw std::string("The shadow map framebuffer is incomplete");
+        }
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+    GLState::BindFramebuffer(0);
+
+    glGenBuffers(1, &uniformBuffer);
+    GLState::BindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ShadowBlock), nullptr, GL_DYNAMIC_DRAW);
+    uploadedBlock.parameters = glm::vec4(-1.f);
+
+    const auto vertexShader = shadowMapShadersDirectory + "DepthOnly.vert";
+    const auto fragmentShader = shadowMapShadersDirectory + "DepthOnly.frag";
+    auto program = LoadShaders(vertexShader.c_str(), fragmentShader.c_str());
+    SETUP_UNIFORM(modelMatrix);
+    SETUP_UNIFORM(viewMatrix);
+    SETUP_UNIFORM(projectionMatrix);
+    depthProgram = program;
+
+    const auto skinnedVertexShader = shadowMapShadersDirectory + "SkinnedDepthOnly.vert";
+    program = LoadShaders(skinnedVertexShader.c_str(), fragmentShader.c_str());
+    skinnedModelMatrixUniform = static_cast<GLuint>(glGetUniformLocation(program, "modelMatrix"));
+    skinnedViewMatrixUniform = static_cast<GLuint>(glGetUniformLocation(program, "viewMatrix"));
+    skinnedProjectionMatrixUniform = static_cast<GLuint>(glGetUniformLocation(program, "projectionMatrix"));
+    SETUP_UNIFORM(bones);
+    skinnedProgram = program;
+
+    valid = false;
+}
+
+void ShadowMap::CleanUp() {
+    GLState::DeleteTextures(1, &texture);
+    GLState::DeleteFramebuffers(1, &framebuffer);
+    GLState::DeleteBuffers(1, &uniformBuffer);
+    glDeleteProgram(depthProgram);
+    glDeleteProgram(skinnedProgram);
+
+    casters.clear();
+    frameCasters.clear();
+    valid = false;
+    dynamicLayerEmpty = true;
+}
+
+void ShadowMap::Invalidate() {
+    casters.clear();
+    valid = false;
+    dynamicLayerEmpty = false;
+}
+
+void ShadowMap::SetupProgram(GLuint program) {
+    GLState::UseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "shadowMap"), static_cast<GLint>(shadowMapTextureUnit));
+
+    const auto blockIndex = glGetUniformBlockIndex(program, "ShadowBlock");
+    if (blockIndex != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, blockIndex, shadowMapUniformBlockBinding);
+    }
+}
+
+// Decides what has to be redrawn. The bounds of a caster are only recomputed when its model matrix changes, and the
+// regions of the static layer it covered before and after are redrawn; casters that were hidden or removed are found by
+// not having been seen this frame.
+void ShadowMap::Prepare(RenderPacket& packet) {
+    auto& shadow = packet.shadow;
+    if (!enabled) {
+        // The bounds of whatever moves in the meantime would go stale, so everything starts over once re-enabled.
+        Invalidate();
+        return;
+    }
+
+    PROFILE_SCOPE("ShadowMap::Prepare");
+
+    ++frame;
+    auto dirtyRegion = glm::vec4(1.f, 1.f, 0.f, 0.f);
+    auto sceneMin = glm::vec3(std::numeric_limits<float>::max());
+    auto sceneMax = glm::vec3(std::numeric_limits<float>::lowest());
+
+    frameCasters.clear();
+    const auto numItems = static_cast<std::uint32_t>(packet.items.size());
+    for (std::uint32_t i = 0; i < numItems; ++i) {
+        const auto& item = packet.items[i];
+        if (item.geometry < 0 || item.wireframe) {
+            continue;
+        }
+
+        // The geometry tells apart a different object that ended up at the address of one seen before.
+        auto& caster = casters[item.object];
+        const auto added = caster.frame == 0;
+        const auto replaced = !added && caster.geometry != item.geometry;
+        caster.changed = added || replaced || item.uploadModelMatrix || caster.dynamic != item.animationEnabled;
+        if (caster.changed) {
+            if (!added && !caster.dynamic) {
+                Include(dirtyRegion, caster.region);
+            }
+
+            caster.min = glm::vec3(std::numeric_limits<float>::max());
+            caster.max = glm::vec3(std::numeric_limits<float>::lowest());
+            const auto transform = item.modelMatrix * item.boundsTransform;
+            for (unsigned corner = 0; corner < 8; ++corner) {
+                const auto point = transform * glm::vec4(corner & 1 ? .5f : -.5f, corner & 2 ? .5f : -.5f,
+                                                         corner & 4 ? .5f : -.5f, 1.f);
+                caster.min = glm::min(caster.min, glm::vec3(point));
+                caster.max = glm::max(caster.max, glm::vec3(point));
+            }
+        }
+        caster.frame = frame;
+        caster.geometry = item.geometry;
+        caster.dynamic = item.animationEnabled;
+
+        sceneMin = glm::min(sceneMin, caster.min);
+        sceneMax = glm::max(sceneMax, caster.max);
+        frameCasters.push_back({i, &caster});
+    }
+
+    for (auto it = casters.begin(); it != casters.end();) {
+        if (it->second.frame == frame) {
+            ++it;
+            continue;
+        }
+        if (!it->second.dynamic) {
+            Include(dirtyRegion, it->second.region);
+        }
+        it = casters.erase(it);
+    }
+
+    // Without casters the frustum is kept, so that whatever was removed is still cleared from the map.
+    auto redrawAll = false;
+    if (!frameCasters.empty()) {
+        redrawAll = FitFrustum(glm::vec3(packet.lightPosition), sceneMin, sceneMax) || !valid;
+    } else if (!valid) {
+        return;
+    }
+    valid = true;
+
+    const auto lightMatrix = projectionMatrix * viewMatrix;
+    for (auto& frameCaster : frameCasters) {
+        auto& caster = *frameCaster.second;
+        if (caster.changed || redrawAll) {
+            caster.region = GetRegion(lightMatrix, caster.min, caster.max);
+            if (!caster.dynamic) {
+                Include(dirtyRegion, caster.region);
+            }
+        }
+    }
+    if (redrawAll) {
+        dirtyRegion = glm::vec4(0.f, 0.f, 1.f, 1.f);
+    }
+
+    // The bias matrix maps clip space onto texture coordinates and depth.
+    const auto biasMatrix = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(.5f)), glm::vec3(.5f));
+    shadow.enabled = true;
+    shadow.viewMatrix = viewMatrix;
+    shadow.projectionMatrix = projectionMatrix;
+    shadow.matrix = biasMatrix * lightMatrix * glm::inverse(packet.viewMatrix);
+
+    const auto fullRegion = glm::vec4(0.f, 0.f, 1.f, 1.f);
+    shadow.drawStatic = !IsEmpty(dirtyRegion);
+    if (shadow.drawStatic) {
+        // One texel of margin, since the shadow lookups filter between neighbouring texels.
+        const auto size = static_cast<float>(shadowMapSize);
+        const auto x0 = std::max(static_cast<GLint>(std::floor(dirtyRegion.x * size)) - 1, 0);
+        const auto y0 = std::max(static_cast<GLint>(std::floor(dirtyRegion.y * size)) - 1, 0);
+        const auto x1 = std::min(static_cast<GLint>(std::ceil(dirtyRegion.z * size)) + 1, shadowMapSize);
+        const auto y1 = std::min(static_cast<GLint>(std::ceil(dirtyRegion.w * size)) + 1, shadowMapSize);
+        shadow.staticRegion = glm::ivec4(x0, y0, x1 - x0, y1 - y0);
+
+        ++numStaticUpdates;
+        staticUpdateCoverage = static_cast<float>(x1 - x0) * static_cast<float>(y1 - y0) / (size * size);
+    }
+
+    for (const auto& frameCaster : frameCasters) {
+        const auto& caster = *frameCaster.second;
+        const auto& item = packet.items[frameCaster.first];
+        if (caster.dynamic) {
+            if (Overlaps(caster.region, fullRegion)) {
+                shadow.dynamicCasters.push_back(frameCaster.first);
+            }
+        } else if (shadow.drawStatic && !item.batched && Overlaps(caster.region, dirtyRegion)) {
+            shadow.staticCasters.push_back(frameCaster.first);
+        }
+    }
+
+    // The dynamic layer is cleared once after the last animated caster leaves the frustum, and then left alone.
+    shadow.drawDynamic = !shadow.dynamicCasters.empty() || !dynamicLayerEmpty;
+    dynamicLayerEmpty = shadow.dynamicCasters.empty();
+    if (shadow.drawDynamic) {
+        ++numDynamicUpdates;
+    }
+}
+
+// Runs on the render thread. The uniform block and the texture are bound every frame, since Object.frag reads them
+// whether or not anything has to be redrawn.
+void ShadowMap::Draw(const RenderPacket& packet) {
+    const auto& shadow = packet.shadow;
+
+    ShadowBlock block;
+    block.matrix = shadow.matrix;
+    block.parameters = glm::vec4(shadow.enabled ? 1.f : 0.f, shadowMapDepthBias, 0.f, 0.f);
+
+    GLState::BindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+    if (std::memcmp(&block, &uploadedBlock, sizeof(block))) {
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+        uploadedBlock = block;
+    }
+    GLState::BindBufferBase(GL_UNIFORM_BUFFER, shadowMapUniformBlockBinding, uniformBuffer);
+    GLState::BindTexture(shadowMapTextureUnit, GL_TEXTURE_2D_ARRAY, texture);
+
+    if (!shadow.enabled || (!shadow.drawStatic && !shadow.drawDynamic)) {
+        return;
+    }
+
+    PROFILE_GPU_SCOPE("ShadowMap::Draw");
+
+    GLState::BindFramebuffer(framebuffer);
+    GLState::Viewport(0, 0, shadowMapSize, shadowMapSize);
+    GLState::DepthFunc(GL_LESS);
+    GLState::DepthMask(GL_TRUE);
+    GLState::Disable(GL_CULL_FACE);
+    GLState::PolygonMode(GL_FILL);
+    GLState::Enable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(shadowMapPolygonOffsetFactor, shadowMapPolygonOffsetUnits);
+
+    if (shadow.drawStatic) {
+        const auto& region = shadow.staticRegion;
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, 0);
+        GLState::Enable(GL_SCISSOR_TEST);
+        glScissor(region.x, region.y, region.z, region.w);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        StaticBatch::DrawDepth(shadow.viewMatrix, shadow.projectionMatrix);
+        DrawCasters(packet, shadow.staticCasters, false);
+
+        GLState::Disable(GL_SCISSOR_TEST);
+    }
+
+    if (shadow.drawDynamic) {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, 1);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        DrawCasters(packet, shadow.dynamicCasters, true);
+    }
+
+    GLState::Disable(GL_POLYGON_OFFSET_FILL);
+    GLState::BindFramebuffer(0);
+    GLState::Viewport(0, 0, static_cast<GLsizei>(windowWidth), static_cast<GLsizei>(windowHeight));
+}
+
+// Refits the bounding sphere of the frustum only when the scene leaves it or shrinks well inside it. Returns whether
+// the frustum changed, in which case the whole map has to be redrawn.
+bool ShadowMap::FitFrustum(const glm::vec3& light, const glm::vec3& sceneMin, const glm::vec3& sceneMax) {
+    const auto sceneCenter = (sceneMin + sceneMax) * .5f;
+    const auto sceneRadius = std::max(glm::length(sceneMax - sceneMin) * .5f, .001f);
+    const auto contained = glm::distance(sceneCenter, frustumCenter) + sceneRadius <= frustumRadius;
+    const auto shrunk = sceneRadius * shadowMapFrustumSlack * 2.f < frustumRadius;
+    if (valid && light == lightPosition && contained && !shrunk) {
+        return false;
+    }
+
+    if (!valid || !contained || shrunk) {
+        frustumCenter = sceneCenter;
+        frustumRadius = sceneRadius * shadowMapFrustumSlack;
+    }
+    lightPosition = light;
+
+    // From outside the sphere, the frustum is the cone that just contains it; from inside, as wide as is sensible.
+    const auto toCenter = frustumCenter - lightPosition;
+    const auto distance = glm::length(toCenter);
+    auto fieldOfView = shadowMapMaxFieldOfView;
+    if (distance * std::sin(shadowMapMaxFieldOfView * .5f) > frustumRadius) {
+        fieldOfView = 2.f * std::asin(frustumRadius / distance);
+    }
+    const auto nearPlane = std::max(distance - frustumRadius, frustumRadius * .01f);
+    const auto farPlane = distance + frustumRadius;
+
+    const auto direction = distance > 0.f ? toCenter / distance : glm::vec3(0.f, -1.f, 0.f);
+    const auto up = std::abs(direction.y) > .99f ? glm::vec3(0.f, 0.f, 1.f) : glm::vec3(0.f, 1.f, 0.f);
+    viewMatrix = glm::lookAt(lightPosition, lightPosition + direction, up);
+    projectionMatrix = glm::perspective(fieldOfView, 1.f, nearPlane, farPlane);
+    return true;
+}
+
+// Bounds that reach behind the light may cover any part of the map once projected.
+glm::vec4 ShadowMap::GetRegion(const glm::mat4& lightMatrix, const glm::vec3& min, const glm::vec3& max) {
+    auto region = glm::vec4(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                            std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
+    for (unsigned corner = 0; corner < 8; ++corner) {
+        const auto point = lightMatrix * glm::vec4(corner & 1 ? max.x : min.x, corner & 2 ? max.y : min.y,
+                                                   corner & 4 ? max.z : min.z, 1.f);
+        if (point.w <= 0.f) {
+            return glm::vec4(0.f, 0.f, 1.f, 1.f);
+        }
+
+        const auto x = point.x / point.w * .5f + .5f;
+        const auto y = point.y / point.w * .5f + .5f;
+        region = glm::vec4(std::min(region.x, x), std::min(region.y, y), std::max(region.z, x), std::max(region.w, y));
+    }
+    return glm::clamp(region, 0.f, 1.f);
+}
+
+void ShadowMap::DrawCasters(const RenderPacket& packet, const std::vector<std::uint32_t>& indices, bool skinned) {
+    if (indices.empty()) {
+        return;
+    }
+
+    const auto& shadow = packet.shadow;
+    GLState::UseProgram(skinned ? skinnedProgram : depthProgram);
+    const auto itemModelMatrixUniform = skinned ? skinnedModelMatrixUniform : modelMatrixUniform;
+    glUniformMatrix4fv(skinned ? skinnedViewMatrixUniform : viewMatrixUniform, 1, GL_FALSE,
+                       glm::value_ptr(shadow.viewMatrix));
+    glUniformMatrix4fv(skinned ? skinnedProjectionMatrixUniform : projectionMatrixUniform, 1, GL_FALSE,
+                       glm::value_ptr(shadow.projectionMatrix));
+
+    for (const auto index : indices) {
+        const auto& item = packet.items[index];
+        const auto& geometry = GeometryPool::GetGeometry(item.geometry);
+        if (skinned) {
+            GLState::BindVertexArray(GeometryPool::GetVertexArray(geometry.format));
+            glUniformMatrix4fv(bonesUniform, static_cast<GLsizei>(item.numBones), GL_FALSE,
+                               glm::value_ptr(packet.bonePalettes[item.firstBone]));
+        } else {
+            GLState::BindVertexArray(GeometryPool::GetPositionOnlyVertexArray(geometry.format));
+        }
+        glUniformMatrix4fv(itemModelMatrixUniform, 1, GL_FALSE, glm::value_ptr(item.modelMatrix));
+
+        for (const auto& submesh : geometry.submeshes) {
+            glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(submesh.numIndices), GL_UNSIGNED_INT,
+                                     BUFFER_OFFSET(submesh.firstIndex * sizeof(GLuint)), submesh.baseVertex);
+        }
+    }
+}
+
+} // namespace model_viewer_3d
@@ -0,0 +1,268 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include "Common.h"
+#include "GLState.h"
+#include "GPUProfiler.h"
+#include "GeometryPool.h"
+#include "ShadowMap.h"
+#include "StaticBatch.h"
+
+#define GLM_SWIZZLE
+#include <glm/gtc/type_ptr.hpp>
+#include <glGA/glGAHelper.h>
+
+namespace model_viewer_3d {
+
+const std::string staticBatchShadersDirectory = std::string(rootDirectory) + "shaders/";
+
+bool StaticBatch::supported = false;
+bool StaticBatch::enabled = true;
+
+std::atomic<unsigned> StaticBatch::numObjects(0);
+std::atomic<unsigned> StaticBatch::numCommands(0);
+std::atomic<unsigned> StaticBatch::numRebuilds(0);
+
+GLuint StaticBatch::program = 0;
+GLuint StaticBatch::depthProgram = 0;
+GLuint StaticBatch::commandBuffer = 0;
+GLuint StaticBatch::drawDataBuffer = 0;
+
+GLuint StaticBatch::viewMatrixUniform;
+GLuint StaticBatch::projectionMatrixUniform;
+GLuint StaticBatch::lightPositionUniform;
+GLuint StaticBatch::lightIntensityUniform;
+GLuint StaticBatch::hasTexturesUniform;
+GLuint StaticBatch::depthViewMatrixUniform;
+GLuint StaticBatch::depthProjectionMatrixUniform;
+
+std::vector<StaticBatch::DrawKey> StaticBatch::drawKeys;
+std::vector<StaticBatch::DrawCommand> StaticBatch::commands;
+std::vector<StaticBatch::DrawData> StaticBatch::drawData;
+GLsizei StaticBatch::numSolidCommands = 0;
+unsigned StaticBatch::geometryGeneration = 0;
+
+void StaticBatch::Initialize() {
+    supported = GLEW_VERSION_4_3;
+    if (!supported) {
+        return;
+    }
+
+    const auto vertexShader = staticBatchShadersDirectory + "StaticObject.vert";
+    const auto fragmentShader = staticBatchShadersDirectory + "Object.frag";
+    program = LoadShaders(vertexShader.c_str(), fragmentShader.c_str());
+
+    SETUP_UNIFORM(viewMatrix);
+    SETUP_UNIFORM(projectionMatrix);
+    SETUP_UNIFORM(lightPosition);
+    SETUP_UNIFORM(lightIntensity);
+    SETUP_UNIFORM(hasTextures);
+
+    GLState::UseProgram(program);
+    glUniform1ui(hasTexturesUniform, 0);
+    ShadowMap::SetupProgram(program);
+
+    const auto depthVertexShader = staticBatchShadersDirectory + "StaticDepthOnly.vert";
+    const auto depthFragmentShader = staticBatchShadersDirectory + "DepthOnly.frag";
+    depthProgram = LoadShaders(depthVertexShader.c_str(), depthFragmentShader.c_str());
+    depthViewMatrixUniform = static_cast<GLuint>(glGetUniformLocation(depthProgram, "viewMatrix"));
+    depthProjectionMatrixUniform = static_cast<GLuint>(glGetUniformLocation(depthProgram, "projectionMatrix"));
+
+    glGenBuffers(1, &commandBuffer);
+    glGenBuffers(1, &drawDataBuffer);
+}
+
+void StaticBatch::CleanUp() {
+    if (!supported) {
+        return;
+    }
+
+    GLState::DeleteBuffers(1, &commandBuffer);
+    GLState::DeleteBuffers(1, &drawDataBuffer);
+    glDeleteProgram(program);
+    glDeleteProgram(depthProgram);
+
+    drawKeys.clear();
+    commands.clear();
+    drawData.clear();
+    numSolidCommands = 0;
+    supported = false;
+}
+
+// Runs on the render thread before the shadow map, the depth pre-pass and the objects that are not batched.
+void StaticBatch::Update(const RenderPacket& packet) {
+    if (!supported) {
+        return;
+    }
+
+    PROFILE_SCOPE("StaticBatch::Update");
+
+    auto changed = geometryGeneration != GeometryPool::GetGeneration();
+    std::size_t numBatched = 0;
+    for (const auto& item : packet.items) {
+        if (!item.batched) {
+            continue;
+        }
+        if (!changed) {
+            const DrawKey key{item.object, item.geometry, item.wireframe};
+            changed = numBatched >= drawKeys.size() || !(drawKeys[numBatched] == key);
+        }
+        ++numBatched;
+    }
+    changed = changed || numBatched != drawKeys.size();
+
+    if (changed) {
+        RebuildCommands(packet);
+    }
+    UpdateDrawData(packet, changed);
+
+    numObjects = static_cast<unsigned>(drawKeys.size());
+    numCommands = static_cast<unsigned>(commands.size());
+}
+
+void StaticBatch::Draw(const RenderPacket& packet) {
+    if (!supported || commands.empty()) {
+        return;
+    }
+
+    PROFILE_GPU_SCOPE("StaticBatch::Draw");
+
+    GLState::UseProgram(program);
+    GLState::BindVertexArray(GeometryPool::GetVertexArray(VertexFormat::PositionNormal));
+
+    glUniformMatrix4fv(viewMatrixUniform, 1, GL_FALSE, glm::value_ptr(packet.viewMatrix));
+    glUniformMatrix4fv(projectionMatrixUniform, 1, GL_FALSE, glm::value_ptr(packet.projectionMatrix));
+    glUniform4fv(lightPositionUniform, 1, glm::value_ptr(packet.lightPosition));
+    glUniform1fv(lightIntensityUniform, 1, &packet.lightIntensity);
+
+    GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, drawDataBuffer);
+    GLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+
+    GLState::Disable(GL_CULL_FACE);
+
+    // Only the solid objects are in the depth pre-pass, so only they can be shaded where their depth is equal to it.
+    if (numSolidCommands) {
+        GLState::PolygonMode(GL_FILL);
+        GLState::DepthFunc(packet.depthPrepass ? GL_EQUAL : GL_LESS);
+        GLState::DepthMask(packet.depthPrepass ? GL_FALSE : GL_TRUE);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, numSolidCommands, 0);
+    }
+
+    const auto numWireframeCommands = static_cast<GLsizei>(commands.size()) - numSolidCommands;
+    if (numWireframeCommands) {
+        GLState::PolygonMode(GL_LINE);
+        GLState::DepthFunc(GL_LESS);
+        GLState::DepthMask(GL_TRUE);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                    reinterpret_cast<const GLvoid*>(numSolidCommands * sizeof(DrawCommand)),
+                                    numWireframeCommands, 0);
+    }
+}
+
+// Lays down the depth of the solid objects with the same commands, reading nothing but positions.
+void StaticBatch::DrawDepth(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) {
+    if (!supported || !numSolidCommands) {
+        return;
+    }
+
+    GLState::UseProgram(depthProgram);
+    GLState::BindVertexArray(GeometryPool::GetPositionOnlyVertexArray(VertexFormat::PositionNormal));
+
+    glUniformMatrix4fv(depthViewMatrixUniform, 1, GL_FALSE, glm::value_ptr(viewMatrix));
+    glUniformMatrix4fv(depthProjectionMatrixUniform, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+
+    GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, drawDataBuffer);
+    GLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, numSolidCommands, 0);
+}
+
+// Solid objects come first, so that each polygon mode is a single contiguous range of the indirect buffer.
+void StaticBatch::RebuildCommands(const RenderPacket& packet) {
+    PROFILE_SCOPE("StaticBatch::RebuildCommands");
+
+    drawKeys.clear();
+    for (const auto& item : packet.items) {
+        if (item.batched) {
+            drawKeys.push_back({item.object, item.geometry, item.wireframe});
+        }
+    }
+
+    commands.clear();
+    for (const auto wireframe : {false, true}) {
+        for (std::size_t slot = 0; slot < drawKeys.size(); ++slot) {
+            const auto& key = drawKeys[slot];
+            if (key.wireframe != wireframe || !GeometryPool::IsAllocated(key.geometry)) {
+                continue;
+            }
+
+            const auto& geometry = GeometryPool::GetGeometry(key.geometry);
+            if (geometry.format != VertexFormat::PositionNormal) {
+                continue;
+            }
+
+            for (const auto& submesh : geometry.submeshes) {
+                commands.push_back({submesh.numIndices, 1, submesh.firstIndex, submesh.baseVertex,
+                                    static_cast<GLuint>(slot)});
+            }
+        }
+        if (!wireframe) {
+            numSolidCommands = static_cast<GLsizei>(commands.size());
+        }
+    }
+
+    GeometryPool::ReserveDrawIDs(static_cast<GLsizeiptr>(drawKeys.size()));
+
+    GLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_DYNAMIC_DRAW);
+    GLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    drawData.resize(drawKeys.size());
+
+    GLState::BindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<std::size_t>(drawData.size(), 1) * sizeof(DrawData), nullptr,
+                 GL_DYNAMIC_DRAW);
+    GLState::BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    geometryGeneration = GeometryPool::GetGeneration();
+    ++numRebuilds;
+}
+
+// Only the range of entries that differ from what was last uploaded is sent, which is nothing for a still scene.
+void StaticBatch::UpdateDrawData(const RenderPacket& packet, bool uploadAll) {
+    auto firstDirty = drawData.size();
+    std::size_t lastDirty = 0;
+
+    std::size_t slot = 0;
+    for (const auto& item : packet.items) {
+        if (!item.batched) {
+            continue;
+        }
+
+        DrawData data;
+        data.modelMatrix = item.modelMatrix;
+        data.ambientProduct = item.ambientProduct;
+        data.diffuseProduct = item.diffuseProduct;
+        data.specularProduct = item.specularProduct;
+        data.shininess = glm::vec4(item.materialShininess, 0.f, 0.f, 0.f);
+
+        if (uploadAll || std::memcmp(&drawData[slot], &data, sizeof(DrawData))) {
+            drawData[slot] = data;
+            firstDirty = std::min(firstDirty, slot);
+            lastDirty = slot;
+        }
+        ++slot;
+    }
+
+    if (firstDirty < drawData.size()) {
+        GLState::BindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, firstDirty * sizeof(DrawData),
+                        (lastDirty - firstDirty + 1) * sizeof(DrawData), drawData.data() + firstDirty);
+    }
+}
+
+} // namespace model_viewer_3d
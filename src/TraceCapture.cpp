@@ -0,0 +1,206 @@
+// SPDX-License-Identifier: MPL-2.0
+// Copyright (c) 2017 Vangelis Tsiatsianas
+
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+
+#include "GUI.h"
+#include "RenderThread.h"
+#include "TraceCapture.h"
+
+#include <ImGUI/imgui.h>
+
+namespace model_viewer_3d {
+
+int TraceCapture::numFramesToCapture = defaultTraceCaptureFrames;
+
+bool TraceCapture::capturing = false;
+int TraceCapture::framesRemaining = 0;
+int TraceCapture::gpuFramesRemaining = 0;
+std::string TraceCapture::outputPath;
+std::string TraceCapture::lastOutputPath;
+
+std::int64_t TraceCapture::gpuClockOffset = 0;
+unsigned long TraceCapture::cpuFrameSequence = 0;
+unsigned long TraceCapture::gpuResultsSequence = 0;
+std::uint64_t TraceCapture::captureStart = 0;
+
+std::vector<Profiler::Event> TraceCapture::cpuEvents;
+std::vector<GPUProfiler::Timestamp> TraceCapture::gpuEvents;
+std::vector<TraceCapture::CounterSample> TraceCapture::counterSamples;
+
+static std::string EscapeJSON(const char* text) {
+    std::string escaped;
+    for (; *text; ++text) {
+        switch (*text) {
+            case '"':
+                escaped += "\\\"";
+                break;
+            case '\\':
+                escaped += "\\\\";
+                break;
+            default:
+                if (static_cast<unsigned char>(*text) >= 0x20) {
+                    escaped += *text;
+                }
+                break;
+        }
+    }
+    return escaped;
+}
+
+void TraceCapture::Start(int numFrames, const std::string& outputPath) {
+    if (capturing || numFrames <= 0) {
+        return;
+    }
+
+    capturing = true;
+    framesRemaining = numFrames;
+    gpuFramesRemaining = gpuProfilerFrameLatency;
+    TraceCapture::outputPath = outputPath.empty() ? GetDefaultOutputPath() : outputPath;
+
+    cpuEvents.clear();
+    gpuEvents.clear();
+    counterSamples.clear();
+
+    Profiler::AddConsumer();
+    GPUProfiler::AddConsumer();
+
+    // The GPU clock can only be read on the thread that owns the context.
+    RenderThread::Execute([] {
+        captureStart = Profiler::Now();
+        gpuClockOffset = static_cast<std::int64_t>(captureStart) - GPUProfiler::GetTimestamp();
+    });
+    cpuFrameSequence = Profiler::GetFrameSequence();
+    gpuResultsSequence = GPUProfiler::GetResultsSequence();
+}
+
+void TraceCapture::EndFrame() {
+    if (!capturing) {
+        return;
+    }
+
+    // While the profiler is paused its latest frame stays the same, so it is captured once and the capture waits for
+    // the profiler to be resumed.
+    if (framesRemaining > 0) {
+        if (Profiler::GetFrameSequence() != cpuFrameSequence) {
+            const auto& events = Profiler::GetLatestFrameEvents();
+            cpuEvents.insert(cpuEvents.end(), events.begin(), events.end());
+
+            unsigned numCounters = 0;
+            const auto* counters = Profiler::GetCounters(numCounters);
+            const auto now = Profiler::Now();
+            for (unsigned i = 0; i < numCounters; ++i) {
+                counterSamples.push_back({counters[i].name, now, counters[i].value});
+            }
+
+            cpuFrameSequence = Profiler::GetFrameSequence();
+            --framesRemaining;
+        }
+    } else {
+        --gpuFramesRemaining;
+    }
+
+    if (GPUProfiler::GetResultsSequence() != gpuResultsSequence) {
+        const auto& scopes = GPUProfiler::GetLatestScopes();
+        gpuEvents.insert(gpuEvents.end(), scopes.begin(), scopes.end());
+        gpuResultsSequence = GPUProfiler::GetResultsSequence();
+    }
+
+    if (!framesRemaining && gpuFramesRemaining <= 0) {
+        Finish();
+    }
+}
+
+void TraceCapture::DisplayControls() {
+    if (ImGui::CollapsingHeader("Trace Capture")) {
+        ImGui::InputInt("Frames" "##Trace Capture", &numFramesToCapture);
+        if (numFramesToCapture < 1) {
+            numFramesToCapture = 1;
+        }
+
+        if (capturing) {
+            ImGui::Text("Capturing... (%d frames left)", framesRemaining);
+        } else {
+            if (ImGui::Button("Capture" "##Trace Capture")) {
+                Start(numFramesToCapture);
+            }
+            if (!lastOutputPath.empty()) {
+                ImGui::TextWrapped("Last trace: %s", lastOutputPath.c_str());
+            }
+        }
+    }
+}
+
+bool TraceCapture::IsCapturing() {
+    return capturing;
+}
+
+void TraceCapture::Finish() {
+    capturing = false;
+
+    Profiler::RemoveConsumer();
+    GPUProfiler::RemoveConsumer();
+
+    if (Write(outputPath)) {
+        lastOutputPath = outputPath;
+    }
+
+    cpuEvents.clear();
+    gpuEvents.clear();
+    counterSamples.clear();
+}
+
+bool TraceCapture::Write(const std::string& path) {
+    std::ofstream file(path);
+    if (!file) {
+        GUI::DisplayErrorMessage("Could not write trace file \"" + path + "\"!");
+        return false;
+    }
+
+    const auto toMicroseconds = [](std::int64_t timestamp) {
+        return static_cast<double>(timestamp - static_cast<std::int64_t>(captureStart)) / 1e3;
+    };
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"GPU\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":2,\"tid\":0,\"args\":{\"name\":\"GL Queue\"}}";
+
+    for (unsigned thread = 0; thread < Profiler::GetNumThreads(); ++thread) {
+        file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+             << ",\"args\":{\"name\":\"" << EscapeJSON(Profiler::GetThreadName(thread)) << "\"}}";
+    }
+
+    for (const auto& event : cpuEvents) {
+        file << ",\n{\"name\":\"" << EscapeJSON(event.name) << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+             << event.threadIndex << ",\"ts\":" << toMicroseconds(static_cast<std::int64_t>(event.begin))
+             << ",\"dur\":" << (event.end - event.begin) / 1e3 << "}";
+    }
+
+    for (const auto& event : gpuEvents) {
+        file << ",\n{\"name\":\"" << EscapeJSON(event.name) << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":2,\"tid\":0,\"ts\":"
+             << toMicroseconds(static_cast<std::int64_t>(event.begin) + gpuClockOffset)
+             << ",\"dur\":" << (event.end > event.begin ? event.end - event.begin : 0) / 1e3 << "}";
+    }
+
+    for (const auto& sample : counterSamples) {
+        file << ",\n{\"name\":\"" << EscapeJSON(sample.name) << "\",\"ph\":\"C\",\"pid\":1,\"ts\":"
+             << toMicroseconds(static_cast<std::int64_t>(sample.timestamp))
+             << ",\"args\":{\"value\":" << sample.value << "}}";
+    }
+
+    file << "\n]}\n";
+    return static_cast<bool>(file);
+}
+
+std::string TraceCapture::GetDefaultOutputPath() {
+    char timestamp[32];
+    const auto now = std::time(nullptr);
+    std::strftime(timestamp, sizeof(timestamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+    return std::string("trace-") + timestamp + ".json";
+}
+
+} // namespace model_viewer_3d